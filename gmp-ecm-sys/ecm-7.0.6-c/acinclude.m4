@@ -372,6 +372,27 @@ AC_DEFUN([ECM_C_INLINESSE2_PROG], dnl
   }
 ]])])
 
+dnl  Test if the compiler has the x86_64 AVX2 and AVX-512 intrinsics with
+dnl  target attributes, and __builtin_cpu_supports
+AC_DEFUN([ECM_C_SIMD_TARGET_PROG], dnl
+[AC_LANG_PROGRAM([[#include <immintrin.h>
+#ifndef __x86_64__
+#error "not x86_64"
+#endif
+__attribute__ ((target ("avx2"))) __m256i
+f2 (__m256i a)
+{
+  return _mm256_mul_epu32 (a, _mm256_cmpgt_epi64 (a, a));
+}
+__attribute__ ((target ("avx512f"))) __m512i
+f5 (__m512i a)
+{
+  return _mm512_maskz_mov_epi64 (_mm512_cmpge_epu64_mask (a, a), a);
+}]], dnl
+[[  __builtin_cpu_init ();
+  return __builtin_cpu_supports ("avx512f") + __builtin_cpu_supports ("avx2");
+]])])
+
 dnl  NVCC_CHECK_COMPILE(body, flags, action-if-true, action-if-false)
 dnl  Similiar to AC_LANG_PUSH(CUDA) AC_COMPILE_IFELSE($1+$2, $3, $4) AC_LANG_POP(CUDA)
 dnl  Check if conftest.cu with <body> compiles with $NVCC $flags
@@ -321,6 +321,241 @@ pt_w_sub(mpz_t f, mpres_t x3, mpres_t y3, mpres_t z3,
 }
 #endif
 
+/* Jacobian coordinates for y^2 = x^3 + a4*x + a6, used by ell_point_mul in
+   the homogeneous case: (X:Y:Z) stands for (X/Z^2, Y/Z^3), O_E has Z = 0.
+   Once Z = 0 mod p for a prime p | n, it stays so, which is detected by a
+   gcd on Z as for the homogeneous law. */
+
+/* [X3, Y3, Z3] <- [2] * [X1, Y1, Z1]; P3 can be P1. O_E and the
+   [2]-torsion points give Z3 = 0 without special cases. */
+static void
+pt_w_jac_duplicate(ell_point_t R, ell_point_t P, mpmod_t n, ell_curve_t E)
+{
+    /* source is dbl-2007-bl: 2M + 8S + 1*a */
+    /* mapping: XX = buf[0], YY = buf[1], YYYY = buf[2], ZZ = buf[3],
+       Z3 = buf[4], S = buf[5] */
+    mpres_sqr(E->buf[0], P->x, n);
+    mpres_sqr(E->buf[1], P->y, n);
+    mpres_sqr(E->buf[2], E->buf[1], n);
+    mpres_sqr(E->buf[3], P->z, n);
+    /* Z3:=(Y1+Z1)^2-YY-ZZ */
+    mpres_add(E->buf[4], P->y, P->z, n);
+    mpres_sqr(E->buf[4], E->buf[4], n);
+    mpres_sub(E->buf[4], E->buf[4], E->buf[1], n);
+    mpres_sub(E->buf[4], E->buf[4], E->buf[3], n);
+    /* S:=2*((X1+YY)^2-XX-YYYY) */
+    mpres_add(E->buf[5], P->x, E->buf[1], n);
+    mpres_sqr(E->buf[5], E->buf[5], n);
+    mpres_sub(E->buf[5], E->buf[5], E->buf[0], n);
+    mpres_sub(E->buf[5], E->buf[5], E->buf[2], n);
+    mpres_add(E->buf[5], E->buf[5], E->buf[5], n);
+    /* M:=3*XX+a*ZZ^2 */
+    mpres_sqr(E->buf[3], E->buf[3], n);
+    mpres_mul(E->buf[3], E->buf[3], E->a4, n);
+    mpres_mul_ui(E->buf[0], E->buf[0], 3, n);
+    mpres_add(E->buf[3], E->buf[3], E->buf[0], n);
+    /* X3:=M^2-2*S */
+    mpres_sqr(E->buf[0], E->buf[3], n);
+    mpres_sub(E->buf[0], E->buf[0], E->buf[5], n);
+    mpres_sub(R->x, E->buf[0], E->buf[5], n);
+    /* Y3:=M*(S-X3)-8*YYYY */
+    mpres_sub(E->buf[5], E->buf[5], R->x, n);
+    mpres_mul(E->buf[5], E->buf[5], E->buf[3], n);
+    mpres_mul_ui(E->buf[2], E->buf[2], 8, n);
+    mpres_sub(R->y, E->buf[5], E->buf[2], n);
+    mpres_set(R->z, E->buf[4], n);
+}
+
+/* [X3, Y3, Z3] <- [X1, Y1, Z1] + [X2, Y2, Z2]; P3 can be P1 or P2. */
+static void
+pt_w_jac_add(ell_point_t R, ell_point_t P, ell_point_t Q,
+	     mpmod_t n, ell_curve_t E)
+{
+    if(pt_w_is_zero(P->z, n)){
+	ell_point_set(R, Q, E, n);
+	return;
+    }
+    if(pt_w_is_zero(Q->z, n)){
+	ell_point_set(R, P, E, n);
+	return;
+    }
+    /* source is add-2007-bl: 11M + 5S */
+    /* mapping: Z1Z1 = buf[0], Z2Z2 = buf[1], U1 = buf[2], H = buf[3],
+       S1 = buf[4], r = buf[5], I = buf[6], J = buf[7], V = buf[8] */
+    mpres_sqr(E->buf[0], P->z, n);
+    mpres_sqr(E->buf[1], Q->z, n);
+    mpres_mul(E->buf[2], P->x, E->buf[1], n);
+    mpres_mul(E->buf[3], Q->x, E->buf[0], n);
+    mpres_mul(E->buf[4], P->y, Q->z, n);
+    mpres_mul(E->buf[4], E->buf[4], E->buf[1], n);
+    mpres_mul(E->buf[5], Q->y, P->z, n);
+    mpres_mul(E->buf[5], E->buf[5], E->buf[0], n);
+    /* H:=U2-U1, r:=2*(S2-S1) */
+    mpres_sub(E->buf[3], E->buf[3], E->buf[2], n);
+    mpres_sub(E->buf[5], E->buf[5], E->buf[4], n);
+    mpres_add(E->buf[5], E->buf[5], E->buf[5], n);
+    if(mpres_is_zero(E->buf[3], n)){
+	/* same x-coordinate: P = Q or P = -Q */
+	if(mpres_is_zero(E->buf[5], n))
+	    pt_w_jac_duplicate(R, P, n, E);
+	else
+	    pt_w_set_to_zero(R, n);
+	return;
+    }
+    /* I:=(2*H)^2, J:=H*I, V:=U1*I */
+    mpres_add(E->buf[6], E->buf[3], E->buf[3], n);
+    mpres_sqr(E->buf[6], E->buf[6], n);
+    mpres_mul(E->buf[7], E->buf[3], E->buf[6], n);
+    mpres_mul(E->buf[8], E->buf[2], E->buf[6], n);
+    /* Z3:=((Z1+Z2)^2-Z1Z1-Z2Z2)*H */
+    mpres_add(E->buf[2], P->z, Q->z, n);
+    mpres_sqr(E->buf[2], E->buf[2], n);
+    mpres_sub(E->buf[2], E->buf[2], E->buf[0], n);
+    mpres_sub(E->buf[2], E->buf[2], E->buf[1], n);
+    mpres_mul(R->z, E->buf[2], E->buf[3], n);
+    /* X3:=r^2-J-2*V */
+    mpres_sqr(E->buf[0], E->buf[5], n);
+    mpres_sub(E->buf[0], E->buf[0], E->buf[7], n);
+    mpres_sub(E->buf[0], E->buf[0], E->buf[8], n);
+    mpres_sub(R->x, E->buf[0], E->buf[8], n);
+    /* Y3:=r*(V-X3)-2*S1*J */
+    mpres_sub(E->buf[8], E->buf[8], R->x, n);
+    mpres_mul(E->buf[8], E->buf[8], E->buf[5], n);
+    mpres_mul(E->buf[4], E->buf[4], E->buf[7], n);
+    mpres_add(E->buf[4], E->buf[4], E->buf[4], n);
+    mpres_sub(R->y, E->buf[8], E->buf[4], n);
+}
+
+/* Signed window recoding of e > 0: e = sum(d[i]*2^i) with d[i] odd and
+   |d[i]| < 2^(w-1), or zero, and at least w-1 zeros after each non-zero
+   digit. d must have room for sizeinbase(e, 2)+w digits.
+   Returns the number of digits. */
+static size_t
+pt_w_signed_window(signed char *d, mpz_t e, int w)
+{
+    size_t i = 0, j, l = mpz_sizeinbase(e, 2);
+    int carry = 0, v;
+
+    while(i < l || carry){
+	if((int)mpz_tstbit(e, i) == carry){
+	    /* even: the carry propagates */
+	    d[i++] = 0;
+	    continue;
+	}
+	/* v = bits i..i+w-1 of e, plus carry, is odd */
+	for(v = carry, j = 0; j < (size_t)w; j++)
+	    v += (int)mpz_tstbit(e, i+j) << j;
+	if(v >= (1 << (w-1))){
+	    v -= 1 << w;
+	    carry = 1;
+	}
+	else
+	    carry = 0;
+	d[i] = (signed char)v;
+	for(j = 1; j < (size_t)w; j++)
+	    d[i+j] = 0;
+	i += w;
+    }
+    /* strip the zeros written after the last window */
+    while(i > 0 && d[i-1] == 0)
+	i--;
+    return i;
+}
+
+/* Window width minimizing the number of additions for an l-bit scalar:
+   2^(w-2)-1 for the table of odd multiples, about l/(w+1) in the loop. */
+static int
+pt_w_window_size(size_t l)
+{
+    int w = 2;
+
+    while(w < 8 && (1 << (w-1)) - 1 + (double)l / (w+2)
+	  < (1 << (w-2)) - 1 + (double)l / (w+1))
+	w++;
+    return w;
+}
+
+/* Q <- [e]*P for the homogeneous law, in Jacobian coordinates with
+   signed windows. P and Q are given in homogeneous coordinates.
+   Always returns 1: a factor shows up as Q->z = 0 mod p. */
+static int
+pt_w_mul_jacobian(ell_point_t Q, mpz_t e, ell_point_t P,
+		  ell_curve_t E, mpmod_t n)
+{
+    ell_point_t *T, R;
+    signed char *d;
+    size_t i;
+    int w, nT, k, negated = 0;
+
+    if(pt_w_is_zero(P->z, n) || mpz_sgn(e) == 0){
+	if(mpz_sgn(e) == 0)
+	    pt_w_set_to_zero(Q, n);
+	else
+	    ell_point_set(Q, P, E, n);
+	return 1;
+    }
+
+    w = pt_w_window_size(mpz_sizeinbase(e, 2));
+    nT = 1 << (w-2);
+    T = (ell_point_t *) malloc(nT * sizeof(ell_point_t));
+    ASSERT_ALWAYS(T != NULL);
+    d = (signed char *) malloc(mpz_sizeinbase(e, 2) + w);
+    ASSERT_ALWAYS(d != NULL);
+
+    /* T[0] <- P: (x:y:z) ~ (x*z:y*z^2:z) */
+    ell_point_init(R, E, n);
+    for(k = 0; k < nT; k++)
+	ell_point_init(T[k], E, n);
+    mpres_mul(T[0]->x, P->x, P->z, n);
+    mpres_sqr(T[0]->y, P->z, n);
+    mpres_mul(T[0]->y, T[0]->y, P->y, n);
+    mpres_set(T[0]->z, P->z, n);
+    /* T[k] <- [2*k+1]*P */
+    if(nT > 1){
+	pt_w_jac_duplicate(R, T[0], n, E);
+	for(k = 1; k < nT; k++)
+	    pt_w_jac_add(T[k], T[k-1], R, n, E);
+    }
+
+    if(mpz_sgn(e) < 0){
+	negated = 1;
+	mpz_neg(e, e);
+    }
+    i = pt_w_signed_window(d, e, w);
+    /* undo negation to avoid changing the caller's e value */
+    if(negated)
+	mpz_neg(e, e);
+    /* the top digit is positive */
+    ell_point_set(R, T[(d[--i]-1) / 2], E, n);
+    while(i-- > 0){
+	pt_w_jac_duplicate(R, R, n, E);
+	if(d[i] > 0)
+	    pt_w_jac_add(R, R, T[(d[i]-1) / 2], n, E);
+	else if(d[i] < 0){
+	    k = (-d[i]-1) / 2;
+	    mpres_neg(T[k]->y, T[k]->y, n);
+	    pt_w_jac_add(R, R, T[k], n, E);
+	    mpres_neg(T[k]->y, T[k]->y, n);
+	}
+    }
+
+    /* back to homogeneous coordinates: (X:Y:Z) ~ (X*Z:Y:Z^3) */
+    mpres_mul(Q->x, R->x, R->z, n);
+    if(negated)
+	mpres_neg(Q->y, R->y, n);
+    else
+	mpres_set(Q->y, R->y, n);
+    mpres_sqr(Q->z, R->z, n);
+    mpres_mul(Q->z, Q->z, R->z, n);
+
+    for(k = 0; k < nT; k++)
+	ell_point_clear(T[k], E, n);
+    ell_point_clear(R, E, n);
+    free(T);
+    free(d);
+    return 1;
+}
+
 /******************** projective Hessian form ********************/
 
 /* U^3+V^3+W^3 = 3*D*U*V*W, D^3 <> 1.
@@ -1296,6 +1531,8 @@ ell_point_mul_plain_end:
 int
 ell_point_mul(mpz_t f, ell_point_t Q, mpz_t e, ell_point_t P, ell_curve_t E, mpmod_t n)
 {
+    if(E->type == ECM_EC_TYPE_WEIERSTRASS && E->law == ECM_LAW_HOMOGENEOUS)
+	return pt_w_mul_jacobian(Q, e, P, E, n);
 #if 1 /* keeping it simple */
     return ell_point_mul_plain(f, Q, e, P, E, n);
 #else
@@ -30,6 +30,7 @@
 #include <stdlib.h>
 #include <gmp.h>
 #include "mpz_aprcl.h"
+#include "jacobi_sum.h"
 
 #ifndef HAVE_U64_T
 #define HAVE_U64_T
@@ -194,91 +195,78 @@ s64_t aiT[] =  {
   6983776800};/* | 7.4712 E3010 | 618 | 1745944201 | p={2,3,5,7,11,13,17,19} */
 
 
-int aiInv[PWmax];
-mpz_t biTmp;
-mpz_t biExp;
-mpz_t biN;
-mpz_t biR;
-mpz_t biS;
-mpz_t biT;
-mpz_t *aiJS; /* [PWmax] */
-mpz_t *aiJW; /* [PWmax] */
-mpz_t *aiJX; /* [PWmax] */
-mpz_t *aiJ0; /* [PWmax] */
-mpz_t *aiJ1; /* [PWmax] */
-mpz_t *aiJ2; /* [PWmax] */
-mpz_t *aiJ00; /* [PWmax] */
-mpz_t *aiJ01; /* [PWmax] */
-int NumberLength; /* Length of multiple precision nbrs */
-mpz_t TestNbr;
+
+/* Work space of one Jacobi sum test. Each test has its own, so that the  */
+/* tests for different (P, Q) can run at the same time in several threads */
+typedef struct
+{
+  int aiInv[PWmax];
+  mpz_t biTmp;
+  mpz_t biExp;
+  mpz_t biR;
+  mpz_t biT;
+  mpz_t aiJS[PWmax];
+  mpz_t aiJW[PWmax];
+  mpz_t aiJX[PWmax];
+  mpz_t aiJ0[PWmax];
+  mpz_t aiJ1[PWmax];
+  mpz_t aiJ2[PWmax];
+  mpz_t aiJ00[PWmax];
+  mpz_t aiJ01[PWmax];
+  mpz_srcptr TestNbr; /* the number to test, shared by all the tests */
+} aprcl_vars;
 
 /* ============================================================================================== */
 
-void allocate_vars (void)
+static void allocate_vars (aprcl_vars *v, mpz_srcptr N)
 {
   int i = 0;
-  aiJS = malloc(PWmax * sizeof(mpz_t));
-  aiJW = malloc(PWmax * sizeof(mpz_t));
-  aiJX = malloc(PWmax * sizeof(mpz_t));
-  aiJ0 = malloc(PWmax * sizeof(mpz_t));
-  aiJ1 = malloc(PWmax * sizeof(mpz_t));
-  aiJ2 = malloc(PWmax * sizeof(mpz_t));
-  aiJ00 = malloc(PWmax * sizeof(mpz_t));
-  aiJ01 = malloc(PWmax * sizeof(mpz_t));
   for (i = 0 ; i < PWmax; i++)
   {
-    mpz_init(aiJS[i]);
-    mpz_init(aiJW[i]);
-    mpz_init(aiJX[i]);
-    mpz_init(aiJ0[i]);
-    mpz_init(aiJ1[i]);
-    mpz_init(aiJ2[i]);
-    mpz_init(aiJ00[i]);
-    mpz_init(aiJ01[i]);
+    mpz_init(v->aiJS[i]);
+    mpz_init(v->aiJW[i]);
+    mpz_init(v->aiJX[i]);
+    mpz_init(v->aiJ0[i]);
+    mpz_init(v->aiJ1[i]);
+    mpz_init(v->aiJ2[i]);
+    mpz_init(v->aiJ00[i]);
+    mpz_init(v->aiJ01[i]);
   }
 
-  mpz_init(TestNbr);
-  mpz_init(biN);
-  mpz_init(biR);
-  mpz_init(biS);
-  mpz_init(biT);
-  mpz_init(biExp);
-  mpz_init(biTmp);
+  v->TestNbr = N;
+  mpz_init(v->biR);
+  mpz_init(v->biT);
+  mpz_init(v->biExp);
+  mpz_init(v->biTmp);
 }
 
 /* ============================================================================================== */
 
-void free_vars (int verbose)
+static void free_vars (aprcl_vars *v)
 {
   int i = 0;
   for (i = 0 ; i < PWmax; i++)
   {
-    mpz_clear(aiJS[i]);
-    mpz_clear(aiJW[i]);
-    mpz_clear(aiJX[i]);
-    mpz_clear(aiJ0[i]);
-    mpz_clear(aiJ1[i]);
-    mpz_clear(aiJ2[i]);
-    mpz_clear(aiJ00[i]);
-    mpz_clear(aiJ01[i]);
+    mpz_clear(v->aiJS[i]);
+    mpz_clear(v->aiJW[i]);
+    mpz_clear(v->aiJX[i]);
+    mpz_clear(v->aiJ0[i]);
+    mpz_clear(v->aiJ1[i]);
+    mpz_clear(v->aiJ2[i]);
+    mpz_clear(v->aiJ00[i]);
+    mpz_clear(v->aiJ01[i]);
   }
-  free(aiJS);
-  free(aiJW);
-  free(aiJX);
-  free(aiJ0);
-  free(aiJ1);
-  free(aiJ2);
-  free(aiJ00);
-  free(aiJ01);
-
-  mpz_clear(TestNbr);
-  mpz_clear(biN);
-  mpz_clear(biR);
-  mpz_clear(biS);
-  mpz_clear(biT);
-  mpz_clear(biExp);
-  mpz_clear(biTmp);
 
+  mpz_clear(v->biR);
+  mpz_clear(v->biT);
+  mpz_clear(v->biExp);
+  mpz_clear(v->biTmp);
+}
+
+/* ============================================================================================== */
+
+static void clear_line (int verbose)
+{
   // clear the APR line (issue #21872)
   if (verbose >= APRTCLE_VERBOSE1)
     printf ("                                                          \r");
@@ -290,7 +278,7 @@ void free_vars (int verbose)
 // -1 -> Nbr1^2 < Nbr2
 //  0 -> Nbr1^2 == Nbr2
 //  1 -> Nbr1^2 > Nbr2
-int CompareSquare(mpz_t Nbr1, mpz_t Nbr2)
+static int CompareSquare(mpz_t Nbr1, mpz_t Nbr2)
 {
   mpz_t tmp;
   int cmp = 0;
@@ -307,59 +295,59 @@ int CompareSquare(mpz_t Nbr1, mpz_t Nbr2)
 /* ============================================================================================== */
 
 // Normalize coefficient of JS
-void NormalizeJS(int PK, int PL, int PM, int P)
+static void NormalizeJS(aprcl_vars *v, int PK, int PL, int PM, int P)
 {
   int I, J;
   for (I = PL; I < PK; I++)
   {
-    if (mpz_cmp_ui(aiJS[I], 0) != 0) /* (!BigNbrIsZero(aiJS[I])) */
+    if (mpz_cmp_ui(v->aiJS[I], 0) != 0) /* (!BigNbrIsZero(aiJS[I])) */
     {
       /* biT = aiJS[I]; */
-      mpz_set(biT, aiJS[I]);
+      mpz_set(v->biT, v->aiJS[I]);
       for (J = 1; J < P; J++)
       {
         /* SubtractBigNbrModN(aiJS[I - J * PM], biT, aiJS[I - J * PM], TestNbr, NumberLength); */
-        mpz_sub(aiJS[I - J * PM], aiJS[I - J * PM], biT);
+        mpz_sub(v->aiJS[I - J * PM], v->aiJS[I - J * PM], v->biT);
       }
       /* aiJS[I] = 0; */
-      mpz_set_ui(aiJS[I], 0);
+      mpz_set_ui(v->aiJS[I], 0);
     }
   }
   for (I = 0; I < PK; I++)
-    mpz_mod(aiJS[I], aiJS[I], TestNbr);
+    mpz_mod(v->aiJS[I], v->aiJS[I], v->TestNbr);
 }
 
 /* ============================================================================================== */
 
 // Normalize coefficient of JW
-void NormalizeJW(int PK, int PL, int PM, int P)
+static void NormalizeJW(aprcl_vars *v, int PK, int PL, int PM, int P)
 {
   int I, J;
   for (I = PL; I < PK; I++)
   {
-    if (mpz_cmp_ui(aiJW[I], 0) != 0) /* (!BigNbrIsZero(aiJW[I])) */
+    if (mpz_cmp_ui(v->aiJW[I], 0) != 0) /* (!BigNbrIsZero(aiJW[I])) */
     {
       /* biT = aiJW[I]; */
-      mpz_set(biT, aiJW[I]);
+      mpz_set(v->biT, v->aiJW[I]);
 
       for (J = 1; J < P; J++)
       {
         /* SubtractBigNbrModN(aiJW[I - J * PM], biT, aiJW[I - J * PM], TestNbr, NumberLength); */
-        mpz_sub(aiJW[I - J * PM], aiJW[I - J * PM], biT);
+        mpz_sub(v->aiJW[I - J * PM], v->aiJW[I - J * PM], v->biT);
       }
       /* aiJW[I] = 0; */
-      mpz_set_ui(aiJW[I], 0);
+      mpz_set_ui(v->aiJW[I], 0);
     }
   }
   for (I = 0; I < PK; I++)
-    mpz_mod(aiJW[I], aiJW[I], TestNbr);
+    mpz_mod(v->aiJW[I], v->aiJW[I], v->TestNbr);
 }
 
 /* ============================================================================================== */
 
 // Perform JS <- JS * JW
 
-void JS_JW(int PK, int PL, int PM, int P)
+static void JS_JW(aprcl_vars *v, int PK, int PL, int PM, int P)
 {
   int I, J, K;
   for (I = 0; I < PL; I++)
@@ -369,25 +357,25 @@ void JS_JW(int PK, int PL, int PM, int P)
       K = (I + J) % PK;
       /* MontgomeryMult(aiJS[I], aiJW[J], biTmp); */
       /* AddBigNbrModN(aiJX[K], biTmp, aiJX[K], TestNbr, NumberLength); */
-      mpz_mul(biTmp, aiJS[I], aiJW[J]);
-      mpz_add(aiJX[K], aiJX[K], biTmp);
+      mpz_mul(v->biTmp, v->aiJS[I], v->aiJW[J]);
+      mpz_add(v->aiJX[K], v->aiJX[K], v->biTmp);
     }
   }
   for (I = 0; I < PK; I++)
   {
     /* aiJS[I] = aiJX[I]; */
     /* aiJX[I] = 0; */
-    mpz_swap(aiJS[I], aiJX[I]);
-    mpz_set_ui(aiJX[I], 0);
+    mpz_swap(v->aiJS[I], v->aiJX[I]);
+    mpz_set_ui(v->aiJX[I], 0);
   }
-  NormalizeJS(PK, PL, PM, P);
+  NormalizeJS(v, PK, PL, PM, P);
 }
 
 /* ============================================================================================== */
 
 // Perform JS <- JS ^ 2
 
-void JS_2(int PK, int PL, int PM, int P)
+static void JS_2(aprcl_vars *v, int PK, int PL, int PM, int P)
 {
   int I, J, K;
   for (I = 0; I < PL; I++)
@@ -396,38 +384,38 @@ void JS_2(int PK, int PL, int PM, int P)
     /* MontgomeryMult(aiJS[I], aiJS[I], biTmp); */
     /* AddBigNbrModN(aiJX[K], biTmp, aiJX[K], TestNbr, NumberLength); */
     /* AddBigNbrModN(aiJS[I], aiJS[I], biT, TestNbr, NumberLength); */
-    mpz_mul(biTmp, aiJS[I], aiJS[I]);
-    mpz_add(aiJX[K], aiJX[K], biTmp);
-    mpz_add(biT, aiJS[I], aiJS[I]);
+    mpz_mul(v->biTmp, v->aiJS[I], v->aiJS[I]);
+    mpz_add(v->aiJX[K], v->aiJX[K], v->biTmp);
+    mpz_add(v->biT, v->aiJS[I], v->aiJS[I]);
     for (J = I + 1; J < PL; J++)
     {
       K = (I + J) % PK;
       /* MontgomeryMult(biT, aiJS[J], biTmp); */
       /* AddBigNbrModN(aiJX[K], biTmp, aiJX[K], TestNbr, NumberLength); */
-      mpz_mul(biTmp, biT, aiJS[J]);
-      mpz_add(aiJX[K], aiJX[K], biTmp);
+      mpz_mul(v->biTmp, v->biT, v->aiJS[J]);
+      mpz_add(v->aiJX[K], v->aiJX[K], v->biTmp);
     }
   }
   for (I = 0; I < PK; I++)
   {
     /* aiJS[I] = aiJX[I]; */
     /* aiJX[I] = 0; */
-    mpz_swap(aiJS[I], aiJX[I]);
-    mpz_set_ui(aiJX[I], 0);
+    mpz_swap(v->aiJS[I], v->aiJX[I]);
+    mpz_set_ui(v->aiJX[I], 0);
   }
-  NormalizeJS(PK, PL, PM, P);
+  NormalizeJS(v, PK, PL, PM, P);
 }
 
 /* ============================================================================================== */
 
 // Perform JS <- JS ^ E
 
-void JS_E(int PK, int PL, int PM, int P)
+static void JS_E(aprcl_vars *v, int PK, int PL, int PM, int P)
 {
   int K;
   long Mask;
 
-  if (mpz_cmp_ui(biExp, 1) == 0)
+  if (mpz_cmp_ui(v->biExp, 1) == 0)
   {
     return;
   } // Return if E == 1
@@ -435,19 +423,19 @@ void JS_E(int PK, int PL, int PM, int P)
 
   for (K = 0; K < PL; K++)
   {
-    mpz_set(aiJW[K], aiJS[K]);
+    mpz_set(v->aiJW[K], v->aiJS[K]);
   }
 
 
-  Mask = mpz_sizeinbase(biExp, 2)-1;
+  Mask = mpz_sizeinbase(v->biExp, 2)-1;
 
   do
   {
-    JS_2(PK, PL, PM, P);
+    JS_2(v, PK, PL, PM, P);
     Mask--;
-    if (mpz_tstbit(biExp, Mask))
+    if (mpz_tstbit(v->biExp, Mask))
     {
-      JS_JW(PK, PL, PM, P);
+      JS_JW(v, PK, PL, PM, P);
     }
   }
   while (Mask > 0);
@@ -460,12 +448,12 @@ void JS_E(int PK, int PL, int PM, int P)
 // if mode==2 then p=2, look for p==4, and stores Jhash(q) ie 3x+f(x)
 // This is based on ideas and code from Jason Moxham
 
-void JacobiSum(int mode, int P, int PL, int Q)
+static void JacobiSum(aprcl_vars *v, int mode, int P, int PL, int Q)
 {
   int I, a, myP;
 
   for (I = 0; I < PL; I++)
-    mpz_set_ui(aiJ0[I], 0);
+    mpz_set_ui(v->aiJ0[I], 0);
 
   myP = P; /* if (mode == 0) */
   if (mode == 1) myP = 1;
@@ -476,7 +464,513 @@ void JacobiSum(int mode, int P, int PL, int Q)
       break;
 
   for (I = 0; I < PL; I++)
-    mpz_set_si(aiJ0[I], sls[jpqs[a].index+I]);
+    mpz_set_si(v->aiJ0[I], sls[jpqs[a].index+I]);
+}
+
+/* ============================================================================================== */
+
+/* Prime checking routine                       */
+/* Return codes: 0 = N is composite.            */
+/*               1 = N is a bpsw probable prime */
+/* ============================================================================================== */
+
+/* Jacobi sum test for the prime P and the q-prime Q, with P^K || Q-1 (K > 0) */
+/* Return codes: -1 = N is composite.                                         */
+/*                0 = the test passed.                                        */
+/*                1 = the test passed and N satisfies the condition on P      */
+/*                    (no need for other Q's for this P).                     */
+static int JacobiSumTest(aprcl_vars *v, int P, int Q, int K)
+{
+  int H, I, J, W, X;
+  int IV, InvX, PK, PL, PM, VK;
+  int QQ, T1, T3, U1, U3, V1, V3;
+
+  PM = 1;
+  for (I = 1; I < K; I++)
+  {
+    PM = PM * P;
+  }
+  PL = (P - 1) * PM;
+  PK = P * PM;
+  for (I = 0; I < PK; I++)
+  {
+    /* aiJ0[I] = aiJ1[I] = 0; */
+    mpz_set_ui(v->aiJ0[I], 0);
+    mpz_set_ui(v->aiJ1[I], 0);
+  }
+  if (P > 2)
+  {
+    JacobiSum(v, 0, P, PL, Q);
+  }
+  else
+  {
+    if (K != 1)
+    {
+      JacobiSum(v, 0, P, PL, Q);
+      for (I = 0; I < PK; I++)
+      {
+        /* aiJW[I] = 0; */
+        mpz_set_ui(v->aiJW[I], 0);
+      }
+      if (K != 2)
+      {
+        for (I = 0; I < PM; I++)
+        {
+          /* aiJW[I] = aiJ0[I]; */
+          mpz_set(v->aiJW[I], v->aiJ0[I]);
+        }
+        JacobiSum(v, 1, P, PL, Q);
+        for (I = 0; I < PM; I++)
+        {
+          /* aiJS[I] = aiJ0[I]; */
+          mpz_set(v->aiJS[I], v->aiJ0[I]);
+        }
+        JS_JW(v, PK, PL, PM, P);
+        for (I = 0; I < PM; I++)
+        {
+          /* aiJ1[I] = aiJS[I]; */
+          mpz_set(v->aiJ1[I], v->aiJS[I]);
+        }
+        JacobiSum(v, 2, P, PL, Q);
+        for (I = 0; I < PK; I++)
+        {
+          /* aiJW[I] = 0; */
+          mpz_set_ui(v->aiJW[I], 0);
+        }
+        for (I = 0; I < PM; I++)
+        {
+          /* aiJS[I] = aiJ0[I]; */
+          mpz_set(v->aiJS[I], v->aiJ0[I]);
+        }
+        JS_2(v, PK, PL, PM, P);
+        for (I = 0; I < PM; I++)
+        {
+          /* aiJ2[I] = aiJS[I]; */
+          mpz_set(v->aiJ2[I], v->aiJS[I]);
+        }
+      }
+    }
+  }
+  /* aiJ00[0] = aiJ01[0] = 1; */
+  mpz_set_ui(v->aiJ00[0], 1);
+  mpz_set_ui(v->aiJ01[0], 1);
+  for (I = 1; I < PK; I++)
+  {
+    /* aiJ00[I] = aiJ01[I] = 0; */
+    mpz_set_ui(v->aiJ00[I], 0);
+    mpz_set_ui(v->aiJ01[I], 0);
+  }
+  /* VK = (int) BigNbrModLong(TestNbr, PK); */
+  VK = mpz_fdiv_ui(v->TestNbr, PK);
+  for (I = 1; I < PK; I++)
+  {
+    if (I % P != 0)
+    {
+      U1 = 1;
+      U3 = I;
+      V1 = 0;
+      V3 = PK;
+      while (V3 != 0)
+      {
+        QQ = U3 / V3;
+        T1 = U1 - V1 * QQ;
+        T3 = U3 - V3 * QQ;
+        U1 = V1;
+        U3 = V3;
+        V1 = T1;
+        V3 = T3;
+      }
+      v->aiInv[I] = (U1 + PK) % PK;
+    }
+    else
+    {
+      v->aiInv[I] = 0;
+    }
+  }
+  if (P != 2)
+  {
+    for (IV = 0; IV <= 1; IV++)
+    {
+      for (X = 1; X < PK; X++)
+      {
+        for (I = 0; I < PK; I++)
+        {
+          /* aiJS[I] = aiJ0[I]; */
+          mpz_set(v->aiJS[I], v->aiJ0[I]);
+        }
+        if (X % P == 0)
+        {
+          continue;
+        }
+        if (IV == 0)
+        {
+          /* LongToBigNbr(X, biExp, NumberLength); */
+          mpz_set_ui(v->biExp, X);
+        }
+        else
+        {
+          /* LongToBigNbr(VK * X / PK, biExp, NumberLength); */
+          mpz_set_ui(v->biExp, (VK * X) / PK);
+          if ((VK * X) / PK == 0)
+          {
+            continue;
+          }
+        }
+        JS_E(v, PK, PL, PM, P);
+        for (I = 0; I < PK; I++)
+        {
+          /* aiJW[I] = 0; */
+          mpz_set_ui(v->aiJW[I], 0);
+        }
+        InvX = v->aiInv[X];
+        for (I = 0; I < PK; I++)
+        {
+          J = (I * InvX) % PK;
+          /* AddBigNbrModN(aiJW[J], aiJS[I], aiJW[J], TestNbr, NumberLength); */
+          mpz_add(v->aiJW[J], v->aiJW[J], v->aiJS[I]);
+        }
+        NormalizeJW(v, PK, PL, PM, P);
+        if (IV == 0)
+        {
+          for (I = 0; I < PK; I++)
+          {
+            /* aiJS[I] = aiJ00[I]; */
+            mpz_set(v->aiJS[I], v->aiJ00[I]);
+          }
+        }
+        else
+        {
+          for (I = 0; I < PK; I++)
+          {
+            /* aiJS[I] = aiJ01[I]; */
+            mpz_set(v->aiJS[I], v->aiJ01[I]);
+          }
+        }
+        JS_JW(v, PK, PL, PM, P);
+        if (IV == 0)
+        {
+          for (I = 0; I < PK; I++)
+          {
+            /* aiJ00[I] = aiJS[I]; */
+            mpz_set(v->aiJ00[I], v->aiJS[I]);
+          }
+        }
+        else
+        {
+          for (I = 0; I < PK; I++)
+          {
+            /* aiJ01[I] = aiJS[I]; */
+            mpz_set(v->aiJ01[I], v->aiJS[I]);
+          }
+        }
+      } /* end for X */
+    } /* end for IV */
+  }
+  else
+  {
+    if (K == 1)
+    {
+      /* MultBigNbrByLongModN(1, Q, aiJ00[0], TestNbr, NumberLength); */
+      mpz_set_ui(v->aiJ00[0], Q);
+      /* aiJ01[0] = 1; */
+      mpz_set_ui(v->aiJ01[0], 1);
+    }
+    else
+    {
+      if (K == 2)
+      {
+        if (VK == 1)
+        {
+          /* aiJ01[0] = 1; */
+          mpz_set_ui(v->aiJ01[0], 1);
+        }
+        /* aiJS[0] = aiJ0[0]; */
+        /* aiJS[1] = aiJ0[1]; */
+        mpz_set(v->aiJS[0], v->aiJ0[0]);
+        mpz_set(v->aiJS[1], v->aiJ0[1]);
+        JS_2(v, PK, PL, PM, P);
+        if (VK == 3)
+        {
+          /* aiJ01[0] = aiJS[0]; */
+          /* aiJ01[1] = aiJS[1]; */
+          mpz_set(v->aiJ01[0], v->aiJS[0]);
+          mpz_set(v->aiJ01[1], v->aiJS[1]);
+        }
+        /* MultBigNbrByLongModN(aiJS[0], Q, aiJ00[0], TestNbr, NumberLength); */
+        mpz_mul_ui(v->aiJ00[0], v->aiJS[0], Q);
+        /* MultBigNbrByLongModN(aiJS[1], Q, aiJ00[1], TestNbr, NumberLength); */
+        mpz_mul_ui(v->aiJ00[1], v->aiJS[1], Q);
+      }
+      else
+      {
+        for (IV = 0; IV <= 1; IV++)
+        {
+          for (X = 1; X < PK; X += 2)
+          {
+            for (I = 0; I <= PM; I++)
+            {
+              /* aiJS[I] = aiJ1[I]; */
+              mpz_set(v->aiJS[I], v->aiJ1[I]);
+            }
+            if (X % 8 == 5 || X % 8 == 7)
+            {
+              continue;
+            }
+            if (IV == 0)
+            {
+              /* LongToBigNbr(X, biExp, NumberLength); */
+              mpz_set_ui(v->biExp, X);
+            }
+            else
+            {
+              /* LongToBigNbr(VK * X / PK, biExp, NumberLength); */
+              mpz_set_ui(v->biExp, VK * X / PK);
+              if (VK * X / PK == 0)
+              {
+                continue;
+              }
+            }
+            JS_E(v, PK, PL, PM, P);
+            for (I = 0; I < PK; I++)
+            {
+              /* aiJW[I] = 0; */
+              mpz_set_ui(v->aiJW[I], 0);
+            }
+            InvX = v->aiInv[X];
+            for (I = 0; I < PK; I++)
+            {
+              J = I * InvX % PK;
+              /* AddBigNbrModN(aiJW[J], aiJS[I], aiJW[J], TestNbr, NumberLength); */
+              mpz_add(v->aiJW[J], v->aiJW[J], v->aiJS[I]);
+            }
+            NormalizeJW(v, PK, PL, PM, P);
+            if (IV == 0)
+            {
+              for (I = 0; I < PK; I++)
+              {
+                /* aiJS[I] = aiJ00[I]; */
+                mpz_set(v->aiJS[I], v->aiJ00[I]);
+              }
+            }
+            else
+            {
+              for (I = 0; I < PK; I++)
+              {
+                /* aiJS[I] = aiJ01[I]; */
+                mpz_set(v->aiJS[I], v->aiJ01[I]);
+              }
+            }
+            NormalizeJS(v, PK, PL, PM, P);
+            JS_JW(v, PK, PL, PM, P);
+            if (IV == 0)
+            {
+              for (I = 0; I < PK; I++)
+              {
+                /* aiJ00[I] = aiJS[I]; */
+                mpz_set(v->aiJ00[I], v->aiJS[I]);
+              }
+            }
+            else
+            {
+              for (I = 0; I < PK; I++)
+              {
+                /* aiJ01[I] = aiJS[I]; */
+                mpz_set(v->aiJ01[I], v->aiJS[I]);
+              }
+            }
+          } /* end for X */
+          if (IV == 0 || VK % 8 == 1 || VK % 8 == 3)
+          {
+            continue;
+          }
+          for (I = 0; I < PM; I++)
+          {
+            /* aiJW[I] = aiJ2[I]; */
+            /* aiJS[I] = aiJ01[I]; */
+            mpz_set(v->aiJW[I], v->aiJ2[I]);
+            mpz_set(v->aiJS[I], v->aiJ01[I]);
+          }
+          for (; I < PK; I++)
+          {
+            /* aiJW[I] = aiJS[I] = 0; */
+            mpz_set_ui(v->aiJW[I], 0);
+            mpz_set_ui(v->aiJS[I], 0);
+          }
+          JS_JW(v, PK, PL, PM, P);
+          for (I = 0; I < PM; I++)
+          {
+            /* aiJ01[I] = aiJS[I]; */
+            mpz_set(v->aiJ01[I], v->aiJS[I]);
+          }
+        } /* end for IV */
+      }
+    }
+  }
+  for (I = 0; I < PL; I++)
+  {
+    /* aiJS[I] = aiJ00[I]; */
+    mpz_set(v->aiJS[I], v->aiJ00[I]);
+  }
+  for (; I < PK; I++)
+  {
+    /* aiJS[I] = 0; */
+    mpz_set_ui(v->aiJS[I], 0);
+  }
+  /* DivBigNbrByLong(TestNbr, PK, biExp, NumberLength); */
+  mpz_fdiv_q_ui(v->biExp, v->TestNbr, PK);
+  JS_E(v, PK, PL, PM, P);
+  for (I = 0; I < PK; I++)
+  {
+    /* aiJW[I] = 0; */
+    mpz_set_ui(v->aiJW[I], 0);
+  }
+  for (I = 0; I < PL; I++)
+  {
+    for (J = 0; J < PL; J++)
+    {
+      /* MontgomeryMult(aiJS[I], aiJ01[J], biTmp); */
+      /* AddBigNbrModN(biTmp, aiJW[(I + J) % PK], aiJW[(I + J) % PK], TestNbr, NumberLength); */
+      mpz_mul(v->biTmp, v->aiJS[I], v->aiJ01[J]);
+      mpz_add(v->aiJW[(I + J) % PK], v->biTmp, v->aiJW[(I + J) % PK]);
+    }
+  }
+  NormalizeJW(v, PK, PL, PM, P);
+/* MatchingRoot : */
+  do
+  {
+    H = -1;
+    W = 0;
+    for (I = 0; I < PL; I++)
+    {
+      if (mpz_cmp_ui(v->aiJW[I], 0) != 0)/* (!BigNbrIsZero(aiJW[I])) */
+      {
+        /* if (H == -1 && BigNbrAreEqual(aiJW[I], 1)) */
+        if (H == -1 && (mpz_cmp_ui(v->aiJW[I], 1) == 0))
+        {
+          H = I;
+        }
+        else
+        {
+          H = -2;
+          /* AddBigNbrModN(aiJW[I], MontgomeryMultR1, biTmp, TestNbr, NumberLength); */
+          mpz_add_ui(v->biTmp, v->aiJW[I], 1);
+          mpz_mod(v->biTmp, v->biTmp, v->TestNbr);
+          if (mpz_cmp_ui(v->biTmp, 0) == 0) /* (BigNbrIsZero(biTmp)) */
+          {
+            W++;
+          }
+        }
+      }
+    }
+    if (H >= 0)
+    {
+      /* break MatchingRoot; */
+      break;
+    }
+    if (W != P - 1)
+    {
+      /* Not prime */
+      return -1;
+    }
+    for (I = 0; I < PM; I++)
+    {
+      /* AddBigNbrModN(aiJW[I], 1, biTmp, TestNbr, NumberLength); */
+      mpz_add_ui(v->biTmp, v->aiJW[I], 1);
+      mpz_mod(v->biTmp, v->biTmp, v->TestNbr);
+      if (mpz_cmp_ui(v->biTmp, 0) == 0) /* (BigNbrIsZero(biTmp)) */
+      {
+        break;
+      }
+    }
+    if (I == PM)
+    {
+      /* Not prime */
+      return -1;
+    }
+    for (J = 1; J <= P - 2; J++)
+    {
+      /* AddBigNbrModN(aiJW[I + J * PM], 1, biTmp, TestNbr, NumberLength); */
+      mpz_add_ui(v->biTmp, v->aiJW[I + J * PM], 1);
+      mpz_mod(v->biTmp, v->biTmp, v->TestNbr);
+      if (mpz_cmp_ui(v->biTmp, 0) != 0)/* (!BigNbrIsZero(biTmp)) */
+      {
+        /* Not prime */
+        return -1;
+      }
+    }
+    H = I + PL;
+  }
+  while (0);
+
+  if (H % P == 0)
+  {
+    return 0;
+  }
+  if (P != 2)
+  {
+    return 1;
+  }
+  if (K == 1)
+  {
+    return (mpz_get_ui(v->TestNbr) & 3) == 1;
+  }
+
+  // if (Q^((N-1)/2) mod N != N-1), N is not prime.
+
+  /* MultBigNbrByLongModN(1, Q, biTmp, TestNbr, NumberLength); */
+  mpz_set_ui(v->biTmp, Q);
+  mpz_mod(v->biTmp, v->biTmp, v->TestNbr);
+
+  mpz_sub_ui(v->biT, v->TestNbr, 1); /* biT = n-1 */
+  mpz_divexact_ui(v->biT, v->biT, 2); /* biT = (n-1)/2 */
+  mpz_powm(v->biR, v->biTmp, v->biT, v->TestNbr); /* biR = Q^((n-1)/2) mod n */
+  mpz_add_ui(v->biTmp, v->biR, 1);
+  mpz_mod(v->biTmp, v->biTmp, v->TestNbr);
+
+  if (mpz_cmp_ui(v->biTmp, 0) != 0)/* (!BigNbrIsZero(biTmp)) */
+  {
+    /* Not prime */
+    return -1;
+  }
+  return 1;
+}
+
+/* ============================================================================================== */
+
+/* The Jacobi sum tests to run for a given set of q-primes */
+typedef struct
+{
+  mpz_srcptr N;
+  int verbose;
+  unsigned long count;
+  int *P, *Q, *K; /* [count] */
+  int *result;    /* [count], result of JacobiSumTest */
+  volatile int composite; /* set when a test finds N composite, to skip the others */
+} aprcl_tests;
+
+static void JacobiSumTest_body(unsigned long i, void *data)
+{
+  aprcl_tests *t = (aprcl_tests *) data;
+  aprcl_vars v;
+
+  if (t->composite)
+  {
+    t->result[i] = -1;
+    return;
+  }
+
+  if (t->verbose >= APRTCLE_VERBOSE1)
+  {
+    printf("APR primality test: P = %2d, Q = %12d  (%3.2f%%)\r", t->P[i], t->Q[i], i * 100.0 / t->count);
+    fflush(stdout);
+  }
+
+  allocate_vars(&v, t->N);
+  t->result[i] = JacobiSumTest(&v, t->P[i], t->Q[i], t->K[i]);
+  free_vars(&v);
+
+  if (t->result[i] < 0)
+    t->composite = 1;
 }
 
 /* ============================================================================================== */
@@ -485,13 +979,19 @@ void JacobiSum(int mode, int P, int PL, int Q)
 /* Return codes: 0 = N is composite.            */
 /*               1 = N is a bpsw probable prime */
 /*               2 = N is prime.                */
-int mpz_aprtcle(mpz_t N, int verbose)
+/* The Jacobi sum tests for the different (P, Q) are independent, they are  */
+/* run through parallel_for when it is not NULL (with OpenMP otherwise).    */
+int mpz_aprtcle_parallel(mpz_t N, int verbose, aprcl_parallel_for_t parallel_for, void *ctx)
 {
   s64_t T, U;
-  int i, j, H, I, J, K, P, Q, W, X;
-  int IV, InvX, LEVELnow, NP, PK, PL, PM, SW, VK, TestedQs, TestingQs;
-  int QQ, T1, T3, U1, U3, V1, V3;
+  int i, j, J, K, P, Q, W;
+  int LEVELnow, NP, TestedQs, TestingQs, done;
+  int SW[8]; /* SW[i] = 1 when N satisfies the condition on aiP[i] */
   int break_this = 0;
+  int res;
+  unsigned long n;
+  aprcl_tests tests;
+  mpz_t biN, biR, biS;
 
 
   /* make sure the input is >= 2 and odd */
@@ -517,23 +1017,17 @@ int mpz_aprtcle(mpz_t N, int verbose)
 
   /* If the input number is larger than 7000 decimal digits
      we will just return whether it is a BPSW (probable) prime */
-  NumberLength = mpz_sizeinbase(N, 10);
-  if (NumberLength > 7000)
+  if (mpz_sizeinbase(N, 10) > 7000)
   {
     return mpz_probab_prime_p(N, 1); // mpz_probab_prime_p mpz_bpsw_prp
   }
 
-  allocate_vars();
-
-  mpz_set(TestNbr, N);
-  mpz_set_si(biS, 0);
+  mpz_init(biN);
+  mpz_init(biR);
+  mpz_init_set_si(biS, 0);
+  tests.P = tests.Q = tests.K = tests.result = NULL;
 
-  j = PK = PL = PM = 0;
-  for (J = 0; J < PWmax; J++)
-  {
-    /* aiJX[J] = 0; */
-    mpz_set_ui(aiJX[J], 0);
-  }
+  j = 0;
   break_this = 0;
 /* GetPrimes2Test : */
   for (i = 0; i < LEVELmax; i++)
@@ -555,7 +1049,7 @@ int mpz_aprtcle(mpz_t N, int verbose)
       while (U % Q == 0);
 
       // Exit loop if S^2 > N.
-      if (CompareSquare(biS, TestNbr) > 0)
+      if (CompareSquare(biS, N) > 0)
       {
         /* break GetPrimes2Test; */
         break_this = 1;
@@ -566,598 +1060,204 @@ int mpz_aprtcle(mpz_t N, int verbose)
   } /* End for i */
   if (i == LEVELmax)
   { /* too big */
-    free_vars (verbose);
-    return mpz_probab_prime_p(N, 1);
+    res = mpz_probab_prime_p(N, 1);
+    goto end;
   }
   LEVELnow = i;
   TestingQs = j;
-  T = aiT[LEVELnow];
-  NP = aiNP[LEVELnow];
 
-MainStart:
+  /* at most one test for each P and each q-prime */
+  tests.N = N;
+  tests.verbose = verbose;
+  tests.P = malloc(8 * aiNQ[LEVELmax - 1] * sizeof(int));
+  tests.Q = malloc(8 * aiNQ[LEVELmax - 1] * sizeof(int));
+  tests.K = malloc(8 * aiNQ[LEVELmax - 1] * sizeof(int));
+  tests.result = malloc(8 * aiNQ[LEVELmax - 1] * sizeof(int));
+
+/* MainStart : */
   for (;;)
   {
+    T = aiT[LEVELnow];
+    NP = aiNP[LEVELnow];
+
     for (i = 0; i < NP; i++)
     {
       P = aiP[i];
-      if (T%P != 0) continue;
-
-      SW = TestedQs = 0;
+      SW[i] = 0;
       /* Q = W = (int) BigNbrModLong(TestNbr, P * P); */
-      Q = W = mpz_fdiv_ui(TestNbr, P * P);
+      Q = W = mpz_fdiv_ui(N, P * P);
       for (J = P - 2; J > 0; J--)
       {
         W = (W * Q) % (P * P);
       }
       if (P > 2 && W != 1)
       {
-        SW = 1;
+        SW[i] = 1;
       }
-      for (;;)
+    }
+
+    TestedQs = 0;
+    for (;;)
+    {
+      /* all the tests for the new q-primes, for all P */
+      n = 0;
+      for (i = 0; i < NP; i++)
       {
+        P = aiP[i];
+        if (T%P != 0) continue;
+
         for (j = TestedQs; j <= TestingQs; j++)
         {
           Q = aiQ[j] - 1;
-          /* G = aiG[j]; */
           K = 0;
           while (Q % P == 0)
           {
             K++;
             Q /= P;
           }
-          Q = aiQ[j];
           if (K == 0)
           {
             continue;
           }
+          tests.P[n] = P;
+          tests.Q[n] = aiQ[j];
+          tests.K[n] = K;
+          n++;
+        }
+      }
 
-          if (verbose >= APRTCLE_VERBOSE1)
-          {
-            printf("APR primality test: P = %2d, Q = %12d  (%3.2f%%)\r", P, Q, (i * (TestingQs + 1) + j) * 100.0 / (NP * (TestingQs + 1)));
-            fflush(stdout);
-          }
-
-          PM = 1;
-          for (I = 1; I < K; I++)
-          {
-            PM = PM * P;
-          }
-          PL = (P - 1) * PM;
-          PK = P * PM;
-          for (I = 0; I < PK; I++)
-          {
-            /* aiJ0[I] = aiJ1[I] = 0; */
-            mpz_set_ui(aiJ0[I], 0);
-            mpz_set_ui(aiJ1[I], 0);
-          }
-          if (P > 2)
-          {
-            JacobiSum(0, P, PL, Q);
-          }
-          else
-          {
-            if (K != 1)
-            {
-              JacobiSum(0, P, PL, Q);
-              for (I = 0; I < PK; I++)
-              {
-                /* aiJW[I] = 0; */
-                mpz_set_ui(aiJW[I], 0);
-              }
-              if (K != 2)
-              {
-                for (I = 0; I < PM; I++)
-                {
-                  /* aiJW[I] = aiJ0[I]; */
-                  mpz_set(aiJW[I], aiJ0[I]);
-                }
-                JacobiSum(1, P, PL, Q);
-                for (I = 0; I < PM; I++)
-                {
-                  /* aiJS[I] = aiJ0[I]; */
-                  mpz_set(aiJS[I], aiJ0[I]);
-                }
-                JS_JW(PK, PL, PM, P);
-                for (I = 0; I < PM; I++)
-                {
-                  /* aiJ1[I] = aiJS[I]; */
-                  mpz_set(aiJ1[I], aiJS[I]);
-                }
-                JacobiSum(2, P, PL, Q);
-                for (I = 0; I < PK; I++)
-                {
-                  /* aiJW[I] = 0; */
-                  mpz_set_ui(aiJW[I], 0);
-                }
-                for (I = 0; I < PM; I++)
-                {
-                  /* aiJS[I] = aiJ0[I]; */
-                  mpz_set(aiJS[I], aiJ0[I]);
-                }
-                JS_2(PK, PL, PM, P);
-                for (I = 0; I < PM; I++)
-                {
-                  /* aiJ2[I] = aiJS[I]; */
-                  mpz_set(aiJ2[I], aiJS[I]);
-                }
-              }
-            }
-          }
-          /* aiJ00[0] = aiJ01[0] = 1; */
-          mpz_set_ui(aiJ00[0], 1);
-          mpz_set_ui(aiJ01[0], 1);
-          for (I = 1; I < PK; I++)
-          {
-            /* aiJ00[I] = aiJ01[I] = 0; */
-            mpz_set_ui(aiJ00[I], 0);
-            mpz_set_ui(aiJ01[I], 0);
-          }
-          /* VK = (int) BigNbrModLong(TestNbr, PK); */
-          VK = mpz_fdiv_ui(TestNbr, PK);
-          for (I = 1; I < PK; I++)
-          {
-            if (I % P != 0)
-            {
-              U1 = 1;
-              U3 = I;
-              V1 = 0;
-              V3 = PK;
-              while (V3 != 0)
-              {
-                QQ = U3 / V3;
-                T1 = U1 - V1 * QQ;
-                T3 = U3 - V3 * QQ;
-                U1 = V1;
-                U3 = V3;
-                V1 = T1;
-                V3 = T3;
-              }
-              aiInv[I] = (U1 + PK) % PK;
-            }
-            else
-            {
-              aiInv[I] = 0;
-            }
-          }
-          if (P != 2)
-          {
-            for (IV = 0; IV <= 1; IV++)
-            {
-              for (X = 1; X < PK; X++)
-              {
-                for (I = 0; I < PK; I++)
-                {
-                  /* aiJS[I] = aiJ0[I]; */
-                  mpz_set(aiJS[I], aiJ0[I]);
-                }
-                if (X % P == 0)
-                {
-                  continue;
-                }
-                if (IV == 0)
-                {
-                  /* LongToBigNbr(X, biExp, NumberLength); */
-                  mpz_set_ui(biExp, X);
-                }
-                else
-                {
-                  /* LongToBigNbr(VK * X / PK, biExp, NumberLength); */
-                  mpz_set_ui(biExp, (VK * X) / PK);
-                  if ((VK * X) / PK == 0)
-                  {
-                    continue;
-                  }
-                }
-                JS_E(PK, PL, PM, P);
-                for (I = 0; I < PK; I++)
-                {
-                  /* aiJW[I] = 0; */
-                  mpz_set_ui(aiJW[I], 0);
-                }
-                InvX = aiInv[X];
-                for (I = 0; I < PK; I++)
-                {
-                  J = (I * InvX) % PK;
-                  /* AddBigNbrModN(aiJW[J], aiJS[I], aiJW[J], TestNbr, NumberLength); */
-                  mpz_add(aiJW[J], aiJW[J], aiJS[I]);
-                }
-                NormalizeJW(PK, PL, PM, P);
-                if (IV == 0)
-                {
-                  for (I = 0; I < PK; I++)
-                  {
-                    /* aiJS[I] = aiJ00[I]; */
-                    mpz_set(aiJS[I], aiJ00[I]);
-                  }
-                }
-                else
-                {
-                  for (I = 0; I < PK; I++)
-                  {
-                    /* aiJS[I] = aiJ01[I]; */
-                    mpz_set(aiJS[I], aiJ01[I]);
-                  }
-                }
-                JS_JW(PK, PL, PM, P);
-                if (IV == 0)
-                {
-                  for (I = 0; I < PK; I++)
-                  {
-                    /* aiJ00[I] = aiJS[I]; */
-                    mpz_set(aiJ00[I], aiJS[I]);
-                  }
-                }
-                else
-                {
-                  for (I = 0; I < PK; I++)
-                  {
-                    /* aiJ01[I] = aiJS[I]; */
-                    mpz_set(aiJ01[I], aiJS[I]);
-                  }
-                }
-              } /* end for X */
-            } /* end for IV */
-          }
-          else
-          {
-            if (K == 1)
-            {
-              /* MultBigNbrByLongModN(1, Q, aiJ00[0], TestNbr, NumberLength); */
-              mpz_set_ui(aiJ00[0], Q);
-              /* aiJ01[0] = 1; */
-              mpz_set_ui(aiJ01[0], 1);
-            }
-            else
-            {
-              if (K == 2)
-              {
-                if (VK == 1)
-                {
-                  /* aiJ01[0] = 1; */
-                  mpz_set_ui(aiJ01[0], 1);
-                }
-                /* aiJS[0] = aiJ0[0]; */
-                /* aiJS[1] = aiJ0[1]; */
-                mpz_set(aiJS[0], aiJ0[0]);
-                mpz_set(aiJS[1], aiJ0[1]);
-                JS_2(PK, PL, PM, P);
-                if (VK == 3)
-                {
-                  /* aiJ01[0] = aiJS[0]; */
-                  /* aiJ01[1] = aiJS[1]; */
-                  mpz_set(aiJ01[0], aiJS[0]);
-                  mpz_set(aiJ01[1], aiJS[1]);
-                }
-                /* MultBigNbrByLongModN(aiJS[0], Q, aiJ00[0], TestNbr, NumberLength); */
-                mpz_mul_ui(aiJ00[0], aiJS[0], Q);
-                /* MultBigNbrByLongModN(aiJS[1], Q, aiJ00[1], TestNbr, NumberLength); */
-                mpz_mul_ui(aiJ00[1], aiJS[1], Q);
-              }
-              else
-              {
-                for (IV = 0; IV <= 1; IV++)
-                {
-                  for (X = 1; X < PK; X += 2)
-                  {
-                    for (I = 0; I <= PM; I++)
-                    {
-                      /* aiJS[I] = aiJ1[I]; */
-                      mpz_set(aiJS[I], aiJ1[I]);
-                    }
-                    if (X % 8 == 5 || X % 8 == 7)
-                    {
-                      continue;
-                    }
-                    if (IV == 0)
-                    {
-                      /* LongToBigNbr(X, biExp, NumberLength); */
-                      mpz_set_ui(biExp, X);
-                    }
-                    else
-                    {
-                      /* LongToBigNbr(VK * X / PK, biExp, NumberLength); */
-                      mpz_set_ui(biExp, VK * X / PK);
-                      if (VK * X / PK == 0)
-                      {
-                        continue;
-                      }
-                    }
-                    JS_E(PK, PL, PM, P);
-                    for (I = 0; I < PK; I++)
-                    {
-                      /* aiJW[I] = 0; */
-                      mpz_set_ui(aiJW[I], 0);
-                    }
-                    InvX = aiInv[X];
-                    for (I = 0; I < PK; I++)
-                    {
-                      J = I * InvX % PK;
-                      /* AddBigNbrModN(aiJW[J], aiJS[I], aiJW[J], TestNbr, NumberLength); */
-                      mpz_add(aiJW[J], aiJW[J], aiJS[I]);
-                    }
-                    NormalizeJW(PK, PL, PM, P);
-                    if (IV == 0)
-                    {
-                      for (I = 0; I < PK; I++)
-                      {
-                        /* aiJS[I] = aiJ00[I]; */
-                        mpz_set(aiJS[I], aiJ00[I]);
-                      }
-                    }
-                    else
-                    {
-                      for (I = 0; I < PK; I++)
-                      {
-                        /* aiJS[I] = aiJ01[I]; */
-                        mpz_set(aiJS[I], aiJ01[I]);
-                      }
-                    }
-                    NormalizeJS(PK, PL, PM, P);
-                    JS_JW(PK, PL, PM, P);
-                    if (IV == 0)
-                    {
-                      for (I = 0; I < PK; I++)
-                      {
-                        /* aiJ00[I] = aiJS[I]; */
-                        mpz_set(aiJ00[I], aiJS[I]);
-                      }
-                    }
-                    else
-                    {
-                      for (I = 0; I < PK; I++)
-                      {
-                        /* aiJ01[I] = aiJS[I]; */
-                        mpz_set(aiJ01[I], aiJS[I]);
-                      }
-                    }
-                  } /* end for X */
-                  if (IV == 0 || VK % 8 == 1 || VK % 8 == 3)
-                  {
-                    continue;
-                  }
-                  for (I = 0; I < PM; I++)
-                  {
-                    /* aiJW[I] = aiJ2[I]; */
-                    /* aiJS[I] = aiJ01[I]; */
-                    mpz_set(aiJW[I], aiJ2[I]);
-                    mpz_set(aiJS[I], aiJ01[I]);
-                  }
-                  for (; I < PK; I++)
-                  {
-                    /* aiJW[I] = aiJS[I] = 0; */
-                    mpz_set_ui(aiJW[I], 0);
-                    mpz_set_ui(aiJS[I], 0);
-                  }
-                  JS_JW(PK, PL, PM, P);
-                  for (I = 0; I < PM; I++)
-                  {
-                    /* aiJ01[I] = aiJS[I]; */
-                    mpz_set(aiJ01[I], aiJS[I]);
-                  }
-                } /* end for IV */
-              }
-            }
-          }
-          for (I = 0; I < PL; I++)
-          {
-            /* aiJS[I] = aiJ00[I]; */
-            mpz_set(aiJS[I], aiJ00[I]);
-          }
-          for (; I < PK; I++)
-          {
-            /* aiJS[I] = 0; */
-            mpz_set_ui(aiJS[I], 0);
-          }
-          /* DivBigNbrByLong(TestNbr, PK, biExp, NumberLength); */
-          mpz_fdiv_q_ui(biExp, TestNbr, PK);
-          JS_E(PK, PL, PM, P);
-          for (I = 0; I < PK; I++)
-          {
-            /* aiJW[I] = 0; */
-            mpz_set_ui(aiJW[I], 0);
-          }
-          for (I = 0; I < PL; I++)
-          {
-            for (J = 0; J < PL; J++)
-            {
-              /* MontgomeryMult(aiJS[I], aiJ01[J], biTmp); */
-              /* AddBigNbrModN(biTmp, aiJW[(I + J) % PK], aiJW[(I + J) % PK], TestNbr, NumberLength); */
-              mpz_mul(biTmp, aiJS[I], aiJ01[J]);
-              mpz_add(aiJW[(I + J) % PK], biTmp, aiJW[(I + J) % PK]);
-            }
-          }
-          NormalizeJW(PK, PL, PM, P);
-/* MatchingRoot : */
-          do
-          {
-            H = -1;
-            W = 0;
-            for (I = 0; I < PL; I++)
-            {
-              if (mpz_cmp_ui(aiJW[I], 0) != 0)/* (!BigNbrIsZero(aiJW[I])) */
-              {
-                /* if (H == -1 && BigNbrAreEqual(aiJW[I], 1)) */
-                if (H == -1 && (mpz_cmp_ui(aiJW[I], 1) == 0))
-                {
-                  H = I;
-                }
-                else
-                {
-                  H = -2;
-                  /* AddBigNbrModN(aiJW[I], MontgomeryMultR1, biTmp, TestNbr, NumberLength); */
-                  mpz_add_ui(biTmp, aiJW[I], 1);
-                  mpz_mod(biTmp, biTmp, TestNbr);
-                  if (mpz_cmp_ui(biTmp, 0) == 0) /* (BigNbrIsZero(biTmp)) */
-                  {
-                    W++;
-                  }
-                }
-              }
-            }
-            if (H >= 0)
-            {
-              /* break MatchingRoot; */
-              break;
-            }
-            if (W != P - 1)
-            {
-              /* Not prime */
-              free_vars (verbose);
-              return APRTCLE_COMPOSITE;
-            }
-            for (I = 0; I < PM; I++)
-            {
-              /* AddBigNbrModN(aiJW[I], 1, biTmp, TestNbr, NumberLength); */
-              mpz_add_ui(biTmp, aiJW[I], 1);
-              mpz_mod(biTmp, biTmp, TestNbr);
-              if (mpz_cmp_ui(biTmp, 0) == 0) /* (BigNbrIsZero(biTmp)) */
-              {
-                break;
-              }
-            }
-            if (I == PM)
-            {
-              /* Not prime */
-              free_vars (verbose);
-              return APRTCLE_COMPOSITE;
-            }
-            for (J = 1; J <= P - 2; J++)
-            {
-              /* AddBigNbrModN(aiJW[I + J * PM], 1, biTmp, TestNbr, NumberLength); */
-              mpz_add_ui(biTmp, aiJW[I + J * PM], 1);
-              mpz_mod(biTmp, biTmp, TestNbr);
-              if (mpz_cmp_ui(biTmp, 0) != 0)/* (!BigNbrIsZero(biTmp)) */
-              {
-                /* Not prime */
-                free_vars (verbose);
-                return APRTCLE_COMPOSITE;
-              }
-            }
-            H = I + PL;
-          }
-          while (0);
-
-          if (SW == 1 || H % P == 0)
-          {
-            continue;
-          }
-          if (P != 2)
-          {
-            SW = 1;
-            continue;
-          }
-          if (K == 1)
-          {
-            if ((mpz_get_ui(TestNbr) & 3) == 1)
-            {
-              SW = 1;
-            }
-            continue;
-          }
-
-          // if (Q^((N-1)/2) mod N != N-1), N is not prime.
-
-          /* MultBigNbrByLongModN(1, Q, biTmp, TestNbr, NumberLength); */
-          mpz_set_ui(biTmp, Q);
-          mpz_mod(biTmp, biTmp, TestNbr);
-
-          mpz_sub_ui(biT, TestNbr, 1); /* biT = n-1 */
-          mpz_divexact_ui(biT, biT, 2); /* biT = (n-1)/2 */
-          mpz_powm(biR, biTmp, biT, TestNbr); /* biR = Q^((n-1)/2) mod n */
-          mpz_add_ui(biTmp, biR, 1);
-          mpz_mod(biTmp, biTmp, TestNbr);
-
-          if (mpz_cmp_ui(biTmp, 0) != 0)/* (!BigNbrIsZero(biTmp)) */
-          {
-            /* Not prime */
-            free_vars (verbose);
-            return APRTCLE_COMPOSITE;
-          }
-          SW = 1;
-        } /* end for j */
-        if (SW == 0)
-        {
-          TestedQs = TestingQs + 1;
-          if (TestingQs < aiNQ[LEVELnow] - 1)
-          {
-            TestingQs++;
-            Q = aiQ[TestingQs];
-            U = T * Q;
-            do
-            {
-              /* MultBigNbrByLong(biS, Q, biS, NumberLength); */
-              mpz_mul_ui(biS, biS, Q);
-              U /= Q;
-            }
-            while (U % Q == 0);
+      tests.count = n;
+      tests.composite = 0;
+      if (parallel_for != NULL && n > 1)
+        parallel_for(n, JacobiSumTest_body, &tests, ctx);
+      else
+      {
+        long l;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for (l = 0; l < (long) n; l++)
+          JacobiSumTest_body(l, &tests);
+      }
 
-            continue; /* Retry */
-          }
-          LEVELnow++;
-          if (LEVELnow == LEVELmax)
-          {
-            free_vars (verbose);
-            return mpz_probab_prime_p(N, 1); /* Cannot tell */
-          }
-          T = aiT[LEVELnow];
-          NP = aiNP[LEVELnow];
-          /* biS = 2; */
-          mpz_set_ui(biS, 2);
-          for (J = 0; J <= aiNQ[LEVELnow]; J++)
-          {
-            Q = aiQ[J];
-            if (T%(Q-1) != 0) continue;
-            U = T * Q;
-            do
-            {
-              /* MultBigNbrByLong(biS, Q, biS, NumberLength); */
-              mpz_mul_ui(biS, biS, Q);
-              U /= Q;
-            }
-            while (U % Q == 0);
-            if (CompareSquare(biS, TestNbr) > 0)
-            {
-              TestingQs = J;
-              /* continue MainStart; */ /* Retry from the beginning */
-              goto MainStart;
-            }
-          } /* end for J */
-          free_vars (verbose);
-          return mpz_probab_prime_p(N, 1); /* Program error */
-        } /* end if */
+      if (tests.composite)
+      {
+        /* Not prime */
+        res = APRTCLE_COMPOSITE;
+        goto end;
+      }
+      for (n = 0; n < tests.count; n++)
+        if (tests.result[n] == 1)
+          for (i = 0; i < NP; i++)
+            if (aiP[i] == tests.P[n])
+              SW[i] = 1;
+
+      done = 1;
+      for (i = 0; i < NP; i++)
+        if (T%aiP[i] == 0 && SW[i] == 0)
+          done = 0;
+      if (done || TestingQs == aiNQ[LEVELnow] - 1)
         break;
-      } /* end for (;;) */
-    } /* end for i */
 
-    // Final Test
-   
-    /* biR = 1 */
-    mpz_set_ui(biR, 1);
-    /* biN <- TestNbr mod biS */ /* Compute N mod S */
-    mpz_fdiv_r(biN, TestNbr, biS);
-   
-    for (U = 1; U <= T; U++)
+      /* Retry with one more q-prime */
+      TestedQs = TestingQs + 1;
+      TestingQs++;
+      Q = aiQ[TestingQs];
+      U = T * Q;
+      do
+      {
+        /* MultBigNbrByLong(biS, Q, biS, NumberLength); */
+        mpz_mul_ui(biS, biS, Q);
+        U /= Q;
+      }
+      while (U % Q == 0);
+    }
+    if (done)
+      break;
+
+    LEVELnow++;
+    if (LEVELnow == LEVELmax)
+    {
+      res = mpz_probab_prime_p(N, 1); /* Cannot tell */
+      goto end;
+    }
+    T = aiT[LEVELnow];
+    /* biS = 2; */
+    mpz_set_ui(biS, 2);
+    for (J = 0; J < aiNQ[LEVELnow]; J++)
     {
-      /* biR <- (biN * biR) mod biS */
-      mpz_mul(biR, biN, biR);
-      mpz_mod(biR, biR, biS);
-      if (mpz_cmp_ui(biR, 1) == 0) /* biR == 1 */
+      Q = aiQ[J];
+      if (T%(Q-1) != 0) continue;
+      U = T * Q;
+      do
       {
-        /* Number is prime */
-        free_vars (verbose);
-        return APRTCLE_PRIME;
+        /* MultBigNbrByLong(biS, Q, biS, NumberLength); */
+        mpz_mul_ui(biS, biS, Q);
+        U /= Q;
       }
-      if (mpz_divisible_p(TestNbr, biR) && mpz_cmp(biR, TestNbr) < 0) /* biR < N and biR | TestNbr */
+      while (U % Q == 0);
+      if (CompareSquare(biS, N) > 0)
       {
-        /* Number is composite */
-        free_vars (verbose);
-        return APRTCLE_COMPOSITE;
+        TestingQs = J;
+        break;
       }
-    } /* End for U */
-    /* This should never be reached. */
-    free_vars (verbose);
-    return mpz_probab_prime_p(N, 1);
+    } /* end for J */
+    if (J == aiNQ[LEVELnow])
+    {
+      res = mpz_probab_prime_p(N, 1); /* Program error */
+      goto end;
+    }
+    /* Retry from the beginning */
   }
+
+  // Final Test
+   
+  /* biR = 1 */
+  mpz_set_ui(biR, 1);
+  /* biN <- TestNbr mod biS */ /* Compute N mod S */
+  mpz_fdiv_r(biN, N, biS);
+   
+  res = -1;
+  for (U = 1; U <= T; U++)
+  {
+    /* biR <- (biN * biR) mod biS */
+    mpz_mul(biR, biN, biR);
+    mpz_mod(biR, biR, biS);
+    if (mpz_cmp_ui(biR, 1) == 0) /* biR == 1 */
+    {
+      /* Number is prime */
+      res = APRTCLE_PRIME;
+      break;
+    }
+    if (mpz_divisible_p(N, biR) && mpz_cmp(biR, N) < 0) /* biR < N and biR | TestNbr */
+    {
+      /* Number is composite */
+      res = APRTCLE_COMPOSITE;
+      break;
+    }
+  } /* End for U */
+  /* This should never be reached. */
+  if (res < 0)
+    res = mpz_probab_prime_p(N, 1);
+
+end:
+  free(tests.P);
+  free(tests.Q);
+  free(tests.K);
+  free(tests.result);
+  mpz_clear(biN);
+  mpz_clear(biR);
+  mpz_clear(biS);
+  clear_line(verbose);
+
+  return res;
+}
+
+/* ============================================================================================== */
+
+int mpz_aprtcle(mpz_t N, int verbose)
+{
+  return mpz_aprtcle_parallel(N, verbose, NULL, NULL);
 }
 
 /* ============================================================================================== */
@@ -23,8 +23,6 @@ typedef long long s64_t;
 typedef unsigned long long u64_t;
 #endif
 
-#include "jacobi_sum.h"
-
 /*******************************************************/
 /*******************************************************/
 /* These are the definitions for the APRT-CLE routines */
@@ -85,7 +83,16 @@ typedef unsigned long long u64_t;
  *
  * *********************************************************************************/
 
+/* Loop executor for mpz_aprtcle_parallel: calls body (i, data) once for  */
+/* each 0 <= i < n, in any order and possibly from several threads, and    */
+/* returns when all calls are done. The last argument is the ctx given to  */
+/* mpz_aprtcle_parallel. Same as ecm_parallel_for_t in ecm.h.              */
+typedef void (*aprcl_parallel_body_t) (unsigned long, void *);
+typedef void (*aprcl_parallel_for_t) (unsigned long, aprcl_parallel_body_t, void *, void *);
+
 int mpz_aprcl(mpz_t N); /* Just return the status of the input, no progress is printed out */
 int mpz_aprtcle(mpz_t N, int verbose);
+/* Same as mpz_aprtcle, with the Jacobi sum tests run through parallel_for */
+int mpz_aprtcle_parallel(mpz_t N, int verbose, aprcl_parallel_for_t parallel_for, void *ctx);
 
 #endif
@@ -30,6 +30,13 @@ http://www.gnu.org/licenses/ or write to the Free Software Foundation, Inc.,
 # include <sys/time.h>
 #endif
 #include <time.h>
+#include <stdlib.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h> /* for close, getpid */
+#endif
+#ifdef HAVE_FCHMOD
+#include <sys/stat.h>
+#endif
 
 #ifdef HAVE_LIMITS_H
 # include <limits.h>
@@ -263,7 +270,7 @@ writechkfile (char *chkfilename, int method, double p, mpmod_t modulus,
   fclose (chkfile);
 }
 
-#if 0 /* currently unused (only used in listz_handle.c, currently inactive) */
+/* Used by tree files without mmap (listz.c) and by listz_handle.c */
 int 
 aux_fseek64(FILE *f, const int64_t offset, const int whence)
 {
@@ -276,7 +283,46 @@ aux_fseek64(FILE *f, const int64_t offset, const int whence)
   ASSERT_ALWAYS (offset <= LONG_MAX);
   return fseek (f, (long) offset, whence);
 }
+
+/* Create a file to write instead of path, then to rename to path once
+   complete, so that readers never see a partial file. Its name, put in tmp
+   of size n, is unique where mkstemp is available (or else to the
+   process), so that processes writing path at once never share it.
+   Returns the file opened for writing, or NULL. */
+FILE *
+aux_fopen_tmp (char *tmp, size_t n, const char *path)
+{
+#ifdef HAVE_MKSTEMP
+  FILE *f;
+  int fd;
+
+  if (snprintf (tmp, n, "%s.XXXXXX", path) >= (int) n)
+    return NULL;
+  fd = mkstemp (tmp);
+  if (fd < 0)
+    return NULL;
+#ifdef HAVE_FCHMOD
+  /* mkstemp only lets the owner read the file, unlike fopen */
+  fchmod (fd, 0644);
 #endif
+  f = fdopen (fd, "wb");
+  if (f == NULL)
+    {
+      close (fd);
+      remove (tmp);
+    }
+  return f;
+#else
+#if defined(HAVE_GETPID) && defined(HAVE_UNISTD_H)
+  if (snprintf (tmp, n, "%s.%ld.tmp", path, (long) getpid ()) >= (int) n)
+    return NULL;
+#else
+  if (snprintf (tmp, n, "%s.tmp", path) >= (int) n)
+    return NULL;
+#endif
+  return fopen (tmp, "wb");
+#endif
+}
 
 int
 ecm_tstbit (mpz_srcptr u, ecm_uint bit_index)
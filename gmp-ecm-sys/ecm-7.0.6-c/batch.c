@@ -30,8 +30,16 @@ http://www.gnu.org/licenses/ or write to the Free Software Foundation, Inc.,
 */
 
 #include <stdlib.h>
+#include <string.h>
 #include "ecm-impl.h"
 #include "getprime_r.h"
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+#include <sys/mman.h>
+#define BATCH_S_USE_MMAP
+#endif
 
 #define MAX_HEIGHT 32
 
@@ -65,6 +73,7 @@ compute_s (mpz_t s, ecm_uint B1, int *forbiddenres ATTRIBUTE_UNUSED)
   ecm_uint pi = 2, pp, maxpp, qi;
   prime_info_t prime_info;
 
+  prime_table_reserve (MIN ((double) B1, PRIME_TABLE_AUTO_BOUND));
   prime_info_init (prime_info);
 
   ASSERT_ALWAYS (B1 <= MAX_B1_BATCH);
@@ -148,6 +157,246 @@ compute_s (mpz_t s, ecm_uint B1, int *forbiddenres ATTRIBUTE_UNUSED)
   mpz_clear (ppz);
 }
 
+/* The batch exponent only depends on B1, so it is computed once per B1 and
+   cached for all curves and threads. With a cache directory it is also
+   saved there, and the next processes map the file read-only instead of
+   computing it, as prime_table_load() does. As for the prime table, a
+   cached exponent is never modified nor freed before batch_s_clear(), so
+   that the read-only aliases returned by batch_s_get() remain valid.
+   File format: magic, then sizeof(mp_limb_t), B1 and the number of limbs
+   of s as uint64_t, then the limbs of s. */
+#define BATCH_S_MAGIC "ECMBATCH"
+#define BATCH_S_NHEADER 3
+
+struct batch_s_s {
+  mpz_t s;       /* read-only alias when map != NULL */
+  ecm_uint B1;
+  void *map;     /* mmap()ed file containing the limbs of s, or NULL */
+  size_t map_len;
+  struct batch_s_s *prev;
+};
+
+static struct batch_s_s *batch_s_cache = NULL;
+static char *batch_s_cache_dir = NULL;
+
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t batch_s_lock = PTHREAD_MUTEX_INITIALIZER;
+#define BATCH_S_LOCK() pthread_mutex_lock (&batch_s_lock)
+#define BATCH_S_UNLOCK() pthread_mutex_unlock (&batch_s_lock)
+#else
+#define BATCH_S_LOCK()
+#define BATCH_S_UNLOCK()
+#endif
+
+static int
+batch_s_filename (char *name, size_t len, ecm_uint B1)
+{
+  return snprintf (name, len, "%s/batch_s_%" PRIu64 ".bin",
+                   batch_s_cache_dir, (uint64_t) B1) >= (int) len;
+}
+
+/* Write c->s to the cache directory. Returns 0 on success. */
+static int
+batch_s_save (struct batch_s_s *c)
+{
+  char name[FILENAME_MAX], tmp[FILENAME_MAX];
+  uint64_t h[BATCH_S_NHEADER];
+  size_t nl = (size_t) ABSIZ (c->s);
+  FILE *f;
+  int ret = 1;
+
+  if (batch_s_filename (name, sizeof (name), c->B1) != 0)
+    return 1;
+  f = aux_fopen_tmp (tmp, sizeof (tmp), name);
+  if (f == NULL)
+    return 1;
+  h[0] = sizeof (mp_limb_t);
+  h[1] = c->B1;
+  h[2] = nl;
+  if (fwrite (BATCH_S_MAGIC, sizeof (BATCH_S_MAGIC) - 1, 1, f) == 1
+      && fwrite (h, sizeof (h), 1, f) == 1
+      && fwrite (PTR (c->s), sizeof (mp_limb_t), nl, f) == nl)
+    ret = 0;
+  if (fclose (f) != 0)
+    ret = 1;
+
+  /* readers never see a partial file */
+  if (ret == 0 && rename (tmp, name) != 0)
+    ret = 1;
+  if (ret != 0)
+    remove (tmp);
+  return ret;
+}
+
+static void
+batch_s_free (struct batch_s_s *c)
+{
+#ifdef BATCH_S_USE_MMAP
+  if (c->map != NULL)
+    munmap (c->map, c->map_len);
+  else
+#endif
+    mpz_clear (c->s);
+  free (c);
+}
+
+/* Load the exponent for B1 from the cache directory. Where mmap() is
+   available, its s points into the mapping, which is kept until
+   batch_s_clear(). Returns NULL on failure. */
+static struct batch_s_s *
+batch_s_load (ecm_uint B1)
+{
+  char name[FILENAME_MAX];
+  char magic[sizeof (BATCH_S_MAGIC) - 1];
+  uint64_t h[BATCH_S_NHEADER];
+  size_t header = sizeof (magic) + sizeof (h), nl;
+  struct batch_s_s *c;
+  FILE *f;
+
+  if (batch_s_filename (name, sizeof (name), B1) != 0)
+    return NULL;
+  f = fopen (name, "rb");
+  if (f == NULL)
+    return NULL;
+  if (fread (magic, sizeof (magic), 1, f) != 1
+      || memcmp (magic, BATCH_S_MAGIC, sizeof (magic)) != 0
+      || fread (h, sizeof (h), 1, f) != 1
+      || h[0] != sizeof (mp_limb_t) || h[1] != B1 || h[2] == 0
+      || h[2] > INT_MAX || fseek (f, 0, SEEK_END) != 0
+      || ftell (f) != (long) (header + h[2] * sizeof (mp_limb_t))
+      || fseek (f, header, SEEK_SET) != 0)
+    {
+      fclose (f);
+      return NULL;
+    }
+  nl = (size_t) h[2];
+
+  c = (struct batch_s_s *) malloc (sizeof (struct batch_s_s));
+  if (c == NULL)
+    {
+      fclose (f);
+      return NULL;
+    }
+  c->B1 = B1;
+  c->map = NULL;
+  c->map_len = 0;
+#ifdef BATCH_S_USE_MMAP
+  c->map_len = header + nl * sizeof (mp_limb_t);
+  c->map = mmap (NULL, c->map_len, PROT_READ, MAP_SHARED, fileno (f), 0);
+  if (c->map == MAP_FAILED)
+    c->map = NULL;
+  else
+    {
+      /* the header is a multiple of the limb size, thus the limbs are
+         aligned; s is never written to nor cleared */
+      PTR (c->s) = (mp_limb_t *) ((char *) c->map + header);
+      SIZ (c->s) = (int) nl;
+      ALLOC (c->s) = (int) nl;
+    }
+#endif
+  if (c->map == NULL)
+    {
+      mpz_init2 (c->s, nl * GMP_NUMB_BITS);
+      if (fread (PTR (c->s), sizeof (mp_limb_t), nl, f) != nl)
+        {
+          fclose (f);
+          batch_s_free (c);
+          return NULL;
+        }
+      SIZ (c->s) = (int) nl;
+    }
+  fclose (f);
+
+  /* a corrupted file could give a non-normalized s */
+  if (PTR (c->s)[nl - 1] == 0)
+    {
+      batch_s_free (c);
+      return NULL;
+    }
+  return c;
+}
+
+/* Set s to a read-only alias of the product of the prime powers up to B1,
+   as computed by compute_s (s, B1, NULL): s must not be modified nor
+   cleared, and remains valid until batch_s_clear(). Returns 0 on success. */
+int
+batch_s_get (mpz_t s, ecm_uint B1)
+{
+  struct batch_s_s *c;
+  int ret = 0;
+
+  BATCH_S_LOCK();
+  for (c = batch_s_cache; c != NULL && c->B1 != B1; c = c->prev);
+  if (c != NULL)
+    goto alias;
+
+  if (batch_s_cache_dir != NULL)
+    c = batch_s_load (B1);
+  if (c == NULL)
+    {
+      c = (struct batch_s_s *) malloc (sizeof (struct batch_s_s));
+      if (c == NULL)
+        {
+          ret = 1;
+          goto unlock;
+        }
+      mpz_init (c->s);
+      compute_s (c->s, B1, NULL);
+      c->B1 = B1;
+      c->map = NULL;
+      c->map_len = 0;
+      if (batch_s_cache_dir != NULL && batch_s_save (c) != 0)
+        outputf (OUTPUT_VERBOSE, "Could not save the batch product in %s\n",
+                 batch_s_cache_dir);
+    }
+  c->prev = batch_s_cache;
+  batch_s_cache = c;
+
+ alias:
+  PTR (s) = PTR (c->s);
+  SIZ (s) = SIZ (c->s);
+  ALLOC (s) = ALLOC (c->s);
+ unlock:
+  BATCH_S_UNLOCK();
+  return ret;
+}
+
+/* Save the exponents computed from now on in dir, and look for them there
+   before computing them (NULL to stop). Returns 0 on success. */
+int
+batch_s_dir (const char *dir)
+{
+  char *d = NULL;
+
+  if (dir != NULL)
+    {
+      d = (char *) malloc (strlen (dir) + 1);
+      if (d == NULL)
+        return 1;
+      strcpy (d, dir);
+    }
+  BATCH_S_LOCK();
+  free (batch_s_cache_dir);
+  batch_s_cache_dir = d;
+  BATCH_S_UNLOCK();
+  return 0;
+}
+
+void
+batch_s_clear (void)
+{
+  struct batch_s_s *c;
+
+  BATCH_S_LOCK();
+  while (batch_s_cache != NULL)
+    {
+      c = batch_s_cache->prev;
+      batch_s_free (batch_s_cache);
+      batch_s_cache = c;
+    }
+  BATCH_S_UNLOCK();
+}
+
 #if 0
 /* this function is useful in debug mode to print non-normalized residues */
 static void
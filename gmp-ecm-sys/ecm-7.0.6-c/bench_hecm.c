@@ -0,0 +1,119 @@
+/* bench_hecm.c - compare HECM with ECM (Montgomery curves) at equal B1.
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 3 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, see
+http://www.gnu.org/licenses/ or write to the Free Software Foundation, Inc.,
+51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA. */
+
+/* Runs the same number of elliptic curves with both methods on the same
+   input, with random curves from the same seed (-seed). Each HECM run
+   tests two elliptic curves, so the time to compare with one ECM curve is
+   half the time of one HECM run. By default only stage 1 is done (-B2 for
+   stage 2 too). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <gmp.h> /* GMP header file */
+#include "ecm.h" /* ecm header file */
+
+static double
+run_curves (mpz_t n, double B1, mpz_t B2, int method, unsigned long seed,
+            unsigned long curves, unsigned long *found)
+{
+  ecm_params q;
+  mpz_t f;
+  unsigned long i;
+  clock_t st;
+
+  mpz_init (f);
+  ecm_init (q);
+  gmp_randseed_ui (q->rng, seed);
+  *found = 0;
+  st = clock ();
+  for (i = 0; i < curves; i++)
+    {
+      ecm_reset (q); /* random sigma */
+      q->method = method;
+      mpz_set (q->B2, B2);
+      if (ecm_factor (f, n, B1, q) > 0)
+        (*found)++;
+    }
+  st = clock () - st;
+  ecm_clear (q);
+  mpz_clear (f);
+
+  return 1000.0 * (double) st / CLOCKS_PER_SEC;
+}
+
+int
+main (int argc, char *argv[])
+{
+  mpz_t n, B2;
+  double B1 = 1e4, t_ecm, t_hecm;
+  unsigned long curves = 10, seed = 1, found_ecm, found_hecm;
+
+  mpz_init_set_si (B2, 0); /* stage 1 only */
+  while (argc > 2 && argv[1][0] == '-')
+    {
+      if (strcmp (argv[1], "-B1") == 0)
+        B1 = strtod (argv[2], NULL);
+      else if (strcmp (argv[1], "-B2") == 0)
+        mpz_set_str (B2, argv[2], 10);
+      else if (strcmp (argv[1], "-c") == 0)
+        curves = strtoul (argv[2], NULL, 10);
+      else if (strcmp (argv[1], "-seed") == 0)
+        seed = strtoul (argv[2], NULL, 10);
+      else
+        break;
+      argc -= 2;
+      argv += 2;
+    }
+
+  if (argc != 2)
+    {
+      fprintf (stderr, "Usage: bench_hecm [-B1 nnn] [-B2 nnn] [-c curves] "
+               "<number>\n");
+      fprintf (stderr, "-B2 -1 uses the default stage 2 bound\n");
+      exit (1);
+    }
+
+  mpz_init (n);
+  if (mpz_set_str (n, argv[1], 10))
+    {
+      fprintf (stderr, "Invalid number: %s\n", argv[1]);
+      exit (1);
+    }
+
+  /* default parametrization of ECM (param 1 unless n has a special form) */
+  t_ecm = run_curves (n, B1, B2, ECM_ECM, seed, curves, &found_ecm);
+  /* each HECM run is two elliptic curves */
+  t_hecm = run_curves (n, B1, B2, ECM_HECM, seed, (curves + 1) / 2,
+                       &found_hecm);
+
+  gmp_printf ("%lu digits, B1=%1.0f, %s\n", mpz_sizeinbase (n, 10), B1,
+              mpz_sgn (B2) == 0 ? "stage 1 only" : "stage 1 and 2");
+  printf ("ECM:  %lu curves in %.0fms, %.2fms per curve, %lu factors\n",
+          curves, t_ecm, t_ecm / curves, found_ecm);
+  printf ("HECM: %lu runs (%lu curves) in %.0fms, %.2fms per curve, "
+          "%lu factors\n", (curves + 1) / 2, 2 * ((curves + 1) / 2), t_hecm,
+          t_hecm / (2 * ((curves + 1) / 2)), found_hecm);
+  printf ("HECM/ECM time per curve: %.2f\n",
+          (t_hecm / (2 * ((curves + 1) / 2))) / (t_ecm / curves));
+
+  mpz_clear (n);
+  mpz_clear (B2);
+
+  return 0;
+}
@@ -174,6 +174,8 @@ gpu_ecm (mpz_t f, const ecm_params params, ecm_params mutable_params, mpz_t n, d
   unsigned int firstsigma_ui;
   float gputime = 0.0;
   mpz_t tmp_A;
+  mpz_t cached_s;  /* read-only alias of the shared batch exponent */
+  mpz_ptr s = mutable_params->batch_s; /* batch exponent used in stage 1 */
   mpz_t *factors = NULL; /* Contains either a factor of n either end-of-stage-1
                          residue (depending of the value of array_found */
   int *array_found = NULL;
@@ -375,17 +377,25 @@ gpu_ecm (mpz_t f, const ecm_params params, ecm_params mutable_params, mpz_t n, d
       mutable_params->batch_last_B1_used = B1;
 
       st = cputime ();
-      /* construct the batch exponent */
-      compute_s (mutable_params->batch_s, B1, NULL);
+      /* construct the batch exponent, shared by all runs as in ecm() */
+      if (batch_s_get (cached_s, (ecm_uint) B1) != 0)
+        {
+          youpi = ECM_ERROR;
+          goto end_gpu_ecm_factors;
+        }
+      if (mpz_cmp_ui (params->batch_s, 1) == 0)
+        s = cached_s;
+      else
+        mpz_set (mutable_params->batch_s, cached_s);
       outputf (OUTPUT_VERBOSE, "Computing batch product (of %" PRIu64
                                " bits) of primes up to B1=%1.0f took %ldms\n",
-                               mpz_sizeinbase (params->batch_s, 2), B1, cputime () - st);
+                               mpz_sizeinbase (s, 2), B1, cputime () - st);
     }
 
 
   st = cputime ();
 
-  youpi = cgbn_ecm_stage1 (factors, array_found, n, params->batch_s, nb_curves,
+  youpi = cgbn_ecm_stage1 (factors, array_found, n, s, nb_curves,
                            firstsigma_ui, &gputime, params->verbose);
 
   outputf (OUTPUT_NORMAL, "Computing %u Step 1 took %ldms of CPU time / "
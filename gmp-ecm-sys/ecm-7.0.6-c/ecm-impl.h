@@ -166,6 +166,27 @@ typedef mpz_t mpres_t;
 
 typedef mpz_t* listz_t;
 
+/* Product tree of F stored on disk in stage 2, see listz.c */
+typedef struct
+{
+  char *filename;
+  mpz_t modulus;
+  unsigned int levels;
+  unsigned long len;    /* capacity of each level, in residues */
+  size_t stride;        /* limbs per residue */
+  unsigned int level;   /* level being written or read */
+  unsigned long pos;    /* next residue in that level */
+  mp_limb_t *map;       /* NULL if the file is accessed through stdio */
+  size_t map_size;      /* in bytes */
+  int fd;
+  FILE *file;
+  listz_t view;         /* read-only residues returned by treefile_read */
+  mp_limb_t *buf;       /* stdio buffer of buf_len residues */
+  unsigned int buf_len;
+  mpz_t tmp;
+} __treefile_struct;
+typedef __treefile_struct * treefile_t;
+
 typedef struct
 {
   mpres_t x;
@@ -356,9 +377,28 @@ int     ecm_rootsG       (mpz_t, listz_t, unsigned long, ecm_roots_state_t *,
 void    ecm_rootsG_clear (ecm_roots_state_t *, mpmod_t);
 
 /* lucas.c */
+/* number of candidate multipliers tried by PRAC, and the cost tables
+   (ECM or P+1 Lucas chains) for which the best one is chosen */
+#define PRAC_NV 10
+#define PRAC_ECM 0
+#define PRAC_PP1 1
+#define prac_val __ECM(prac_val)
+extern const double prac_val[PRAC_NV];
 #define pp1_mul_prac __ECM(pp1_mul_prac)
 void  pp1_mul_prac     (mpres_t, ecm_uint, mpmod_t, mpres_t, mpres_t,
-                        mpres_t, mpres_t, mpres_t);
+                        mpres_t, mpres_t, mpres_t, unsigned int);
+#define lucas_cost __ECM(lucas_cost)
+double lucas_cost (ecm_uint, double, int);
+#define prac_best_val __ECM(prac_best_val)
+unsigned int prac_best_val (ecm_uint, int);
+#define prac_chains_reserve __ECM(prac_chains_reserve)
+const unsigned char *prac_chains_reserve (int, double, double, ecm_uint *);
+#define prac_chains_clear __ECM(prac_chains_clear)
+void prac_chains_clear (void);
+/* index in prac_val[] of the best chain for the j-th odd prime k, from the
+   cached chains c[0..n-1] if possible */
+#define PRAC_CHAIN(c, n, j, k, w) ((j) < (n) ? (unsigned int) (c)[j] \
+                                    : prac_best_val (k, w))
 
 /* stage2.c */
 #define stage2 __ECM(stage2)
@@ -388,6 +428,18 @@ void         clear_list (listz_t, unsigned int);
 int          list_inp_raw (listz_t, FILE *, unsigned int);
 #define list_out_raw __ECM(list_out_raw)
 int          list_out_raw (FILE *, listz_t, unsigned int);
+#define treefile_open __ECM(treefile_open)
+treefile_t   treefile_open (const char *, unsigned int, unsigned long, mpz_t);
+#define treefile_close __ECM(treefile_close)
+void         treefile_close (treefile_t);
+#define treefile_clear __ECM(treefile_clear)
+void         treefile_clear (void);
+#define treefile_seek __ECM(treefile_seek)
+void         treefile_seek (treefile_t, unsigned int);
+#define treefile_write __ECM(treefile_write)
+int          treefile_write (treefile_t, listz_t, unsigned int);
+#define treefile_read __ECM(treefile_read)
+listz_t      treefile_read (treefile_t, unsigned int);
 #define print_list __ECM(print_list)
 void         print_list (listz_t, unsigned int);
 #define list_set __ECM(list_set)
@@ -422,16 +474,16 @@ void        list_mulmod (listz_t, listz_t, listz_t, listz_t, unsigned int,
 void      PolyFromRoots (listz_t, listz_t, unsigned int, listz_t, mpz_t);
 #define PolyFromRoots_Tree __ECM(PolyFromRoots_Tree)
 int       PolyFromRoots_Tree (listz_t, listz_t, unsigned int, listz_t, int, 
-                         mpz_t, listz_t*, FILE*, unsigned int);
+                         mpz_t, listz_t*, treefile_t, unsigned int);
 
 #define ntt_PolyFromRoots __ECM(ntt_PolyFromRoots)
 void	  ntt_PolyFromRoots (mpzv_t, mpzv_t, spv_size_t, mpzv_t, mpzspm_t);
 #define ntt_PolyFromRoots_Tree __ECM(ntt_PolyFromRoots_Tree)
 int       ntt_PolyFromRoots_Tree (mpzv_t, mpzv_t, spv_size_t, mpzv_t,
-                         int, mpzspm_t, mpzv_t *, FILE *);
+                         int, mpzspm_t, mpzv_t *, treefile_t);
 #define ntt_polyevalT __ECM(ntt_polyevalT)
 int  ntt_polyevalT (mpzv_t, spv_size_t, mpzv_t *, mpzv_t, mpzspv_t,
-		mpzspm_t, char *);
+		mpzspm_t, treefile_t);
 #define ntt_mul __ECM(ntt_mul)
 void  ntt_mul (mpzv_t, mpzv_t, mpzv_t, spv_size_t, mpzv_t, int, mpzspm_t);
 #define ntt_PrerevertDivision __ECM(ntt_PrerevertDivision)
@@ -455,10 +507,10 @@ void  RecursiveDivision (listz_t, listz_t, listz_t, unsigned int,
 void polyeval (listz_t, unsigned int, listz_t*, listz_t, mpz_t, unsigned int);
 #define polyeval_tellegen __ECM(polyeval_tellegen)
 int polyeval_tellegen (listz_t, unsigned int, listz_t*, listz_t,
-		       unsigned int, listz_t, mpz_t, char *);
+		       unsigned int, listz_t, mpz_t, treefile_t);
 #define TUpTree __ECM(TUpTree)
-void TUpTree (listz_t, listz_t *, unsigned int, listz_t, int, unsigned int,
-		mpz_t, FILE *);
+int  TUpTree (listz_t, listz_t *, unsigned int, listz_t, int, unsigned int,
+		mpz_t, treefile_t);
 
 /* ks-multiply.c */
 #define list_mul_n_basecase __ECM(list_mul_n_basecase)
@@ -498,6 +550,18 @@ void mpmod_init_MODMULN (mpmod_t, const mpz_t);
 void mpmod_init_REDC (mpmod_t, const mpz_t);
 #define mpmod_clear __ECM(mpmod_clear)
 void mpmod_clear (mpmod_t);
+#define mpmod_tune_mul __ECM(mpmod_tune_mul)
+double mpmod_tune_mul (mp_size_t, int, int, gmp_randstate_t, long);
+#define mpmod_mul_run __ECM(mpmod_mul_run)
+void mpmod_mul_run (const mpz_t, int, int, unsigned long);
+#define mpmod_tune __ECM(mpmod_tune)
+void mpmod_tune (void);
+#define mpmod_profile_save __ECM(mpmod_profile_save)
+int mpmod_profile_save (const char *);
+#define mpmod_profile_load __ECM(mpmod_profile_load)
+int mpmod_profile_load (const char *);
+#define mpmod_profile_skip __ECM(mpmod_profile_skip)
+void mpmod_profile_skip (void);
 #define mpmod_init_set __ECM(mpmod_init_set)
 void mpmod_init_set (mpmod_t, const mpmod_t);
 #define mpmod_pausegw __ECM(mpmod_pausegw)
@@ -644,6 +708,8 @@ int          outputf (int, const char *, ...);
 void writechkfile (char *, int, double, mpmod_t, mpres_t, mpres_t, mpres_t, mpres_t);
 #define aux_fseek64 __ECM(aux_fseek64)
 int aux_fseek64(FILE *, const int64_t, const int);
+#define aux_fopen_tmp __ECM(aux_fopen_tmp)
+FILE *aux_fopen_tmp (char *, size_t, const char *);
 #define ecm_tstbit __ECM(ecm_tstbit)
 int ecm_tstbit (mpz_srcptr, ecm_uint);
 
@@ -697,6 +763,12 @@ int  gw_ecm_stage1 (mpz_t, curve *, mpmod_t, double, double *, mpz_t,
 /* batch.c */
 #define compute_s  __ECM(compute_s )
 void compute_s (mpz_t, ecm_uint, int *);
+#define batch_s_get  __ECM(batch_s_get)
+int batch_s_get (mpz_t, ecm_uint);
+#define batch_s_dir  __ECM(batch_s_dir)
+int batch_s_dir (const char *);
+#define batch_s_clear  __ECM(batch_s_clear)
+void batch_s_clear (void);
 #define ecm_stage1_batch  __ECM(ecm_stage1_batch)
 int ecm_stage1_batch (mpz_t, mpres_t, mpres_t, mpmod_t, double, double *, 
                                                                 int,  mpz_t);
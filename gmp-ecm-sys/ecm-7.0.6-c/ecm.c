@@ -285,89 +285,6 @@ ecm_mul_end:
     mpz_neg (e, e);
 }
 
-#define ADD 6.0 /* number of multiplications in an addition */
-#define DUP 5.0 /* number of multiplications in a duplicate */
-
-/* returns the number of modular multiplications for computing
-   V_n from V_r * V_{n-r} - V_{n-2r}.
-   ADD is the cost of an addition
-   DUP is the cost of a duplicate
-*/
-static double
-lucas_cost (ecm_uint n, double v)
-{
-  ecm_uint d, e, r;
-  double c; /* cost */
-
-  d = n;
-  r = (ecm_uint) ((double) d * v + 0.5);
-  if (r >= n)
-    return (ADD * (double) n);
-  d = n - r;
-  e = 2 * r - n;
-  c = DUP + ADD; /* initial duplicate and final addition */
-  while (d != e)
-    {
-      if (d < e)
-        {
-          r = d;
-          d = e;
-          e = r;
-        }
-      if (d - e <= e / 4 && ((d + e) % 3) == 0)
-        { /* condition 1 */
-          d = (2 * d - e) / 3;
-          e = (e - d) / 2;
-          c += 3.0 * ADD; /* 3 additions */
-        }
-      else if (d - e <= e / 4 && (d - e) % 6 == 0)
-        { /* condition 2 */
-          d = (d - e) / 2;
-          c += ADD + DUP; /* one addition, one duplicate */
-        }
-      else if ((d + 3) / 4 <= e)
-        { /* condition 3 */
-          d -= e;
-          c += ADD; /* one addition */
-        }
-      else if ((d + e) % 2 == 0)
-        { /* condition 4 */
-          d = (d - e) / 2;
-          c += ADD + DUP; /* one addition, one duplicate */
-        }
-      /* now d+e is odd */
-      else if (d % 2 == 0)
-        { /* condition 5 */
-          d /= 2;
-          c += ADD + DUP; /* one addition, one duplicate */
-        }
-      /* now d is odd and e is even */
-      else if (d % 3 == 0)
-        { /* condition 6 */
-          d = d / 3 - e;
-          c += 3.0 * ADD + DUP; /* three additions, one duplicate */
-        }
-      else if ((d + e) % 3 == 0)
-        { /* condition 7 */
-          d = (d - 2 * e) / 3;
-          c += 3.0 * ADD + DUP; /* three additions, one duplicate */
-        }
-      else if ((d - e) % 3 == 0)
-        { /* condition 8 */
-          d = (d - e) / 3;
-          c += 3.0 * ADD + DUP; /* three additions, one duplicate */
-        }
-      else /* necessarily e is even: catches all cases */
-        { /* condition 9 */
-          e /= 2;
-          c += ADD + DUP; /* one addition, one duplicate */
-        }
-    }
-  
-  return c;
-}
-
-
 /* computes kP from P=(xA:zA) and puts the result in (xA:zA). Assumes k>2. 
    WARNING! The calls to add3() assume that the two input points are distinct,
    which is not neccessarily satisfied. The result can be that in rare cases
@@ -382,42 +299,16 @@ lucas_cost (ecm_uint n, double v)
 static void
 prac (mpres_t xA, mpres_t zA, ecm_uint k, mpmod_t n, mpres_t b,
       mpres_t u, mpres_t v, mpres_t w, mpres_t xB, mpres_t zB, mpres_t xC, 
-      mpres_t zC, mpres_t xT, mpres_t zT, mpres_t xT2, mpres_t zT2)
+      mpres_t zC, mpres_t xT, mpres_t zT, mpres_t xT2, mpres_t zT2,
+      unsigned int vi)
 {
-  ecm_uint d, e, r, i = 0, nv;
-  double c, cmin;
+  ecm_uint d, e, r;
   __mpz_struct *tmp;
-#define NV 10  
-  /* 1/val[0] = the golden ratio (1+sqrt(5))/2, and 1/val[i] for i>0
-     is the real number whose continued fraction expansion is all 1s
-     except for a 2 in i+1-st place */
-  static double val[NV] =
-    { 0.61803398874989485, 0.72360679774997897, 0.58017872829546410,
-      0.63283980608870629, 0.61242994950949500, 0.62018198080741576,
-      0.61721461653440386, 0.61834711965622806, 0.61791440652881789,
-      0.61807966846989581};
-
-  /* for small n, it makes no sense to try 10 different Lucas chains */
-  nv = mpz_size ((mpz_ptr) n);
-  if (nv > NV)
-    nv = NV;
-
-  if (nv > 1)
-    {
-      /* chooses the best value of v */
-      for (d = 0, cmin = ADD * (double) k; d < nv; d++)
-        {
-          c = lucas_cost (k, val[d]);
-          if (c < cmin)
-            {
-              cmin = c;
-              i = d;
-            }
-        }
-    }
 
+  /* the multiplier prac_val[vi] giving the cheapest chain is chosen by
+     the caller, see PRAC_CHAIN() */
   d = k;
-  r = (ecm_uint) ((double) d * val[i] + 0.5);
+  r = (ecm_uint) ((double) d * prac_val[vi] + 0.5);
   
   /* first iteration always begins by Condition 3, then a swap */
   d = k - r;
@@ -1077,6 +968,9 @@ ecm_stage1 (mpz_t f, mpres_t x, mpres_t A, mpmod_t n, double B1,
   int ret = ECM_NO_FACTOR_FOUND;
   long last_chkpnt_time;
   prime_info_t prime_info;
+  const unsigned char *chains;
+  ecm_uint nchains;
+  unsigned int vi = 0;
 
   /* Lucas chain code file mods */
   uint64_t chain_code;
@@ -1092,6 +986,8 @@ ecm_stage1 (mpz_t f, mpres_t x, mpres_t A, mpmod_t n, double B1,
   uint8_t base_indx, next_indx, s1_indx, s2_indx, dif_indx;
   /* end mods */
 
+  prime_table_reserve (MIN (B1, PRIME_TABLE_AUTO_BOUND));
+  chains = prac_chains_reserve (PRAC_ECM, *B1done, B1, &nchains);
   prime_info_init (prime_info);
 
   mpres_init (b, n);
@@ -1204,6 +1100,10 @@ ecm_stage1 (mpz_t f, mpres_t x, mpres_t A, mpmod_t n, double B1,
         }
       } /* end if( using_code_file) */
 
+      if (!using_code_file)
+        vi = PRAC_CHAIN (chains, nchains, prime_info_index (prime_info), p,
+                         PRAC_ECM);
+
        for (r = p; r <= B1; r *= p)
        {
          if (r > *B1done)
@@ -1236,7 +1136,8 @@ ecm_stage1 (mpz_t f, mpres_t x, mpres_t A, mpmod_t n, double B1,
              }
            }
            else
-             prac (x, z, (ecm_uint) p, n, b, u, v, w, xB, zB, xC, zC, xT, zT, xT2, zT2);
+             prac (x, z, (ecm_uint) p, n, b, u, v, w, xB, zB, xC, zC, xT, zT,
+                   xT2, zT2, vi);
          }
  
          if(using_code_file)
@@ -1332,6 +1233,98 @@ ecm_stage1 (mpz_t f, mpres_t x, mpres_t A, mpmod_t n, double B1,
 #define DEBUG_EC_W 0
 
 #ifdef HAVE_ADDLAWS
+/* Number of primes whose powers are multiplied at once in ecm_stage1_W,
+   so that the window table of ell_point_mul serves the whole chunk. */
+#define EC_W_CHUNK 32
+
+/* Q <- [e]*P in ecm_stage1_W. Returns 0 if a factor is found, in f: with
+   the homogeneous laws, this is when Q->z (Q->x for the twisted Hessian
+   form) has a non-trivial gcd with n. */
+static int
+ecm_stage1_W_mul (mpz_t f, ell_point_t Q, mpz_t e, ell_point_t P,
+		  ell_curve_t E, mpmod_t n)
+{
+    int status = ell_point_mul (f, Q, e, P, E, n);
+
+    if(status != 0 && E->law == ECM_LAW_HOMOGENEOUS){
+	if(E->type == ECM_EC_TYPE_TWISTED_HESSIAN)
+	    mpres_gcd(f, Q->x, n);
+	else
+	    mpres_gcd(f, Q->z, n);
+	if(mpz_cmp(f, n->orig_modulus) < 0 && mpz_cmp_ui(f, 1) > 0)
+	    status = 0;
+    }
+    return status;
+}
+
+/* P <- [prod(tp[i]^tk[i], 0 <= i < np)]*P, with Q as buffer and e as
+   scratch. If the chunk finds a factor or reaches O_E, it is done again
+   prime by prime from P, so that the outcome is the one of a prime by
+   prime stage 1 (keeping the factor of the chunk if that one misses it).
+   *p is set to the last prime processed.
+   Returns 0 if a factor is found, in f, 1 otherwise. */
+static int
+ecm_stage1_W_chunk (mpz_t f, ell_point_t P, ell_point_t Q, mpz_t e,
+		    uint64_t *tp, int *tk, int np, uint64_t *p,
+		    ell_curve_t E, mpmod_t n)
+{
+    mpz_t g;
+    int i, j, status;
+
+    mpz_set_ui (e, 1);
+    for (i = 0; i < np; i++)
+	for (j = 0; j < tk[i]; j++)
+	    mpz_mul_ui (e, e, (ecm_uint) tp[i]);
+    status = ecm_stage1_W_mul (f, Q, e, P, E, n);
+    if (status != 0 && ell_point_is_zero (Q, E, n) == 0){
+	ell_point_set (P, Q, E, n);
+	*p = tp[np-1];
+	return 1;
+    }
+
+    mpz_init_set (g, f);
+    for (i = 0; i < np; i++){
+	*p = tp[i];
+	for (j = 0; j < tk[i]; j++){
+	    mpz_set_ui (e, (ecm_uint) tp[i]);
+	    if (ecm_stage1_W_mul (f, Q, e, P, E, n) == 0){
+		mpz_clear (g);
+		return 0;
+	    }
+	    ell_point_set (P, Q, E, n);
+	}
+	if (ell_point_is_zero (P, E, n))
+	    break;
+    }
+    if (status == 0)
+	mpz_set (f, g);
+    mpz_clear (g);
+    return status != 0;
+}
+
+/* Normalizes the homogeneous point P != O_E to get (x:y:1), valid in W or
+   H form, using t as temporary. Returns 0 if the inversion of z found a
+   factor (put in f), 1 otherwise. */
+static int
+ecm_stage1_W_normalize (mpz_t f, ell_point_t P, mpres_t t, mpmod_t n)
+{
+    if (!mpres_invert (t, P->z, n)){ /* Factor found? */
+	mpres_gcd (f, P->z, n);
+	return 0;
+    }
+#if DEBUG_EC_W >= 2
+    mpres_get_z(f, t, n); gmp_printf("1/z=%Zd\n", f);
+#endif
+    mpres_mul (P->x, P->x, t, n);
+    mpres_mul (P->y, P->y, t, n);
+#if DEBUG_EC_W >= 2
+    mpres_get_z(f, P->x, n); gmp_printf("x/z=%Zd\n", f);
+    mpres_get_z(f, P->y, n); gmp_printf("y/z=%Zd\n", f);
+#endif
+    mpres_set_ui (P->z, 1, n);
+    return 1;
+}
+
 /* Input: when Etype == ECM_EC_TYPE_WEIERSTRASS*:
             (x, y) is initial point
             A is curve parameter in Weierstrass's form:
@@ -1357,15 +1350,31 @@ ecm_stage1_W (mpz_t f, ell_curve_t E, ell_point_t P, mpmod_t n,
 {
     mpres_t xB;
     ell_point_t Q;
-    uint64_t p = 0, r, last_chkpnt_p;
-    int ret = ECM_NO_FACTOR_FOUND, status;
+    mpz_t e;
+    uint64_t p = 0, r, last_chkpnt_p, last, tp[EC_W_CHUNK];
+    int ret = ECM_NO_FACTOR_FOUND, tk[EC_W_CHUNK], np = 0, k;
     long last_chkpnt_time;
     prime_info_t prime_info;
+    int law = E->law;
 
+    prime_table_reserve (MIN (B1, PRIME_TABLE_AUTO_BOUND));
     prime_info_init (prime_info);
     
     mpres_init (xB, n);
 
+    /* The affine law costs one inversion per addition: for short
+       Weierstrass curves, run stage 1 with the homogeneous law instead
+       (ell_point_mul then works in Jacobian coordinates) and go back to
+       an affine point at the end. */
+    if (E->type == ECM_EC_TYPE_WEIERSTRASS && law == ECM_LAW_AFFINE
+	&& mpres_is_zero (E->a1, n) && mpres_is_zero (E->a3, n)
+	&& mpres_is_zero (E->a2, n))
+      {
+	E->law = ECM_LAW_HOMOGENEOUS;
+	if (ell_point_is_zero (P, E, n) == 0)
+	  mpres_set_ui (P->z, 1, n);
+      }
+
     ell_point_init(Q, E, n);
     
     last_chkpnt_time = cputime ();
@@ -1404,55 +1413,61 @@ ecm_stage1_W (mpz_t f, ell_curve_t E, ell_point_t P, mpmod_t n,
 #endif
 	    }
 	
+	/* the powers of EC_W_CHUNK primes are multiplied at once */
 	last_chkpnt_p = 3;
-	for (p = getprime_mt (prime_info); p <= B1; p = getprime_mt (prime_info)){
-	    for (r = p; r <= B1; r *= p){
-		if (r > *B1done){
-		    mpz_set_ui(f, (ecm_uint)p);
-		    status = ell_point_mul (f, Q, f, P, E, n);
-		    if(status == 0){
-		    }
-		    else if(E->law == ECM_LAW_HOMOGENEOUS){
-			if(E->type == ECM_EC_TYPE_TWISTED_HESSIAN)
-			    mpres_gcd(f, Q->x, n);
-			else
-			    mpres_gcd(f, Q->z, n);
-			//			gmp_printf("gcd=%Zd\n", f);
-			if(mpz_cmp(f, n->orig_modulus) < 0 
-			   && mpz_cmp_ui(f, 1) > 0)
-			    status = 0;
-		    }
-		    if(status == 0){
-			ret = ECM_FACTOR_FOUND_STEP1;
-			goto end_of_stage1_w;
-		    }
-#if DEBUG_EC_W >= 2
-		    printf("R%ld:=", (long)r); ell_point_print(Q, E, n);
-		    printf(";\nQ:=EcmMult(%ld, Q, E, N);\n", (long)p);
-		    printf("(Q[1]*R%ld[3]-Q[3]*R%ld[1]) mod N;\n",(long)r,(long)r);
-#endif
-		    ell_point_set(P, Q, E, n);
+	mpz_init (e);
+	for (p = getprime_mt (prime_info); ; p = getprime_mt (prime_info)){
+	    if (p <= B1){
+		for (k = 0, r = p; r <= B1; r *= p)
+		    if (r > *B1done)
+			k++;
+		if (k > 0){
+		    tp[np] = p;
+		    tk[np++] = k;
 		}
+		if (np < EC_W_CHUNK)
+		    continue;
+	    }
+	    else if (np == 0)
+		break;
+	    if (ecm_stage1_W_chunk (f, P, Q, e, tp, tk, np, &last, E, n) == 0){
+		p = last;
+		ret = ECM_FACTOR_FOUND_STEP1;
+		mpz_clear (e);
+		goto end_of_stage1_w;
 	    }
+	    np = 0;
 	    if (ell_point_is_zero (P, E, n)){
+		p = last;
 		outputf (OUTPUT_VERBOSE, "Reached point at infinity, "
-			 "%.0f divides group orders\n", p);
+			 "%.0f divides group orders\n", (double) p);
 		break;
 	    }
+	    if (p > B1)
+		break;
 	    
 	    if (stop_asap != NULL && (*stop_asap) ()){
-		outputf (OUTPUT_NORMAL, "Interrupted at prime %.0f\n", p);
+		outputf (OUTPUT_NORMAL, "Interrupted at prime %.0f\n",
+			 (double) p);
 		break;
 	    }
 	    
 	    if (chkfilename != NULL && p > last_chkpnt_p + 10000 && 
 		elltime (last_chkpnt_time, cputime ()) > CHKPNT_PERIOD){
+		/* writechkfile writes (x:y:1): normalize P first */
+		if (E->law == ECM_LAW_HOMOGENEOUS
+		    && ecm_stage1_W_normalize (f, P, xB, n) == 0){
+		    ret = ECM_FACTOR_FOUND_STEP1;
+		    mpz_clear (e);
+		    goto end_of_stage1_w;
+		}
 		writechkfile (chkfilename, ECM_ECM, MAX(p, *B1done), 
 			      n, E->a4, P->x, P->y, P->z);
 		last_chkpnt_p = p;
 		last_chkpnt_time = cputime ();
 	    }
 	}
+	mpz_clear (e);
     }
     else{
 #if USE_ADD_SUB_CHAINS == 0 /* keeping it simple */
@@ -1482,8 +1497,6 @@ ecm_stage1_W (mpz_t f, ell_curve_t E, ell_point_t P, mpmod_t n,
     if (p > *B1done)
 	*B1done = p;
     
-    if (chkfilename != NULL)
-	writechkfile (chkfilename, ECM_ECM, *B1done, n, E->a4, P->x, P->y,P->z);
     prime_info_clear (prime_info);
 #if DEBUG_EC_W >= 2
     printf("lastP="); ell_point_print(P, E, n); printf("\n");
@@ -1497,28 +1510,23 @@ ecm_stage1_W (mpz_t f, ell_curve_t E, ell_point_t P, mpmod_t n,
 	}
 	else{
 	    /* for affine case, z = 1 anyway */
-	    if(E->law == ECM_LAW_HOMOGENEOUS){
-		if (!mpres_invert (xB, P->z, n)){ /* Factor found? */
-		    mpres_gcd (f, P->z, n);
-		    gmp_printf("# factor found during normalization: %Zd\n", f);
-		    ret = ECM_FACTOR_FOUND_STEP1;
-		}
-		else{
-		    /* normalize to get (x:y:1) valid in W or H form... */
-#if DEBUG_EC_W >= 2
-		    mpres_get_z(f, xB, n); gmp_printf("1/z=%Zd\n", f);
-#endif
-		    mpres_mul (P->x, P->x, xB, n);
-		    mpres_mul (P->y, P->y, xB, n);
-#if DEBUG_EC_W >= 2
-		    mpres_get_z(f, P->x, n); gmp_printf("x/z=%Zd\n", f);
-		    mpres_get_z(f, P->y, n); gmp_printf("y/z=%Zd\n", f);
-#endif
-		    mpres_set_ui (P->z, 1, n);
-		}
+	    if(E->law == ECM_LAW_HOMOGENEOUS
+	       && ecm_stage1_W_normalize (f, P, xB, n) == 0){
+		gmp_printf("# factor found during normalization: %Zd\n", f);
+		ret = ECM_FACTOR_FOUND_STEP1;
 	    }
 	}
     }
+    if (E->law != law)
+      {
+	E->law = law;
+	if (ell_point_is_zero (P, E, n) == 0)
+	  mpz_set_ui (P->z, 1); /* as in ell_point_init */
+      }
+
+    /* written after normalization, so that it can be resumed */
+    if (chkfilename != NULL)
+	writechkfile (chkfilename, ECM_ECM, *B1done, n, E->a4, P->x, P->y,P->z);
 
     mpres_clear (xB, n);
     ell_point_clear(Q, E, n);
@@ -1833,6 +1841,8 @@ ecm (mpz_t f, mpz_t x, mpz_t y, int param, mpz_t sigma, mpz_t n, mpz_t go,
   ell_point_t PE;
 #endif
   mpz_t B2min, B2; /* Local B2, B2min to avoid changing caller's values */
+  mpz_t cached_s;  /* read-only alias of the shared batch exponent */
+  mpz_ptr s = batch_s; /* batch exponent used in stage 1 */
   unsigned long dF;
 #ifdef HAVE_GWNUM  
   unsigned long kbnc_bitsize;
@@ -2135,7 +2145,9 @@ ecm (mpz_t f, mpz_t x, mpz_t y, int param, mpz_t sigma, mpz_t n, mpz_t go,
         }
     }
 
-  /* Compute s for the batch mode */
+  /* Compute s for the batch mode. The exponent for B1 is shared by all
+     runs (see batch_s_get), and only copied into batch_s when the caller
+     asked for it, with batch_s <> 1 (for example 2 for -bsaves). */
   if (IS_BATCH_MODE(param) && ECM_IS_DEFAULT_B1_DONE(*B1done) &&
       (B1 != *batch_last_B1_used || mpz_cmp_ui (batch_s, 1) <= 0))
     {
@@ -2143,10 +2155,18 @@ ecm (mpz_t f, mpz_t x, mpz_t y, int param, mpz_t sigma, mpz_t n, mpz_t go,
 
       st = cputime ();
       /* construct the batch exponent */
-      compute_s (batch_s, B1, NULL);
+      if (batch_s_get (cached_s, (ecm_uint) B1) != 0)
+        {
+          youpi = ECM_ERROR;
+          goto end_of_ecm;
+        }
+      if (mpz_cmp_ui (batch_s, 1) == 0)
+        s = cached_s;
+      else
+        mpz_set (batch_s, cached_s);
       outputf (OUTPUT_VERBOSE, "Computing batch product (of %" PRIu64
                                " bits) of primes up to B1=%1.0f took %ldms\n",
-                               mpz_sizeinbase (batch_s, 2), B1,
+                               mpz_sizeinbase (s, 2), B1,
                                elltime (st, cputime ()));
     }
 
@@ -2244,7 +2264,7 @@ ecm (mpz_t f, mpz_t x, mpz_t y, int param, mpz_t sigma, mpz_t n, mpz_t go,
         if (IS_BATCH_MODE(param))
         /* FIXME: go, stop_asap and chkfilename are ignored in batch mode */
 	    youpi = ecm_stage1_batch (f, P.x, P.A, modulus, B1, B1done, 
-				      param, batch_s);
+				      param, s);
         else{
 #ifdef HAVE_ADDLAWS
 	    if(E->type == ECM_EC_TYPE_MONTGOMERY)
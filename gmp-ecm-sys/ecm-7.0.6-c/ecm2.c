@@ -22,6 +22,9 @@ http://www.gnu.org/licenses/ or write to the Free Software Foundation, Inc.,
 
 #include <stdlib.h>
 #include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "ecm-impl.h"
 
 /* R_i <- q_i * S, 0 <= i < n, where q_i are large integers, S is a point on
@@ -418,6 +421,119 @@ addWnm (mpz_t p, point *X, curve *S, mpmod_t modulus, unsigned int m,
   return ECM_NO_FACTOR_FOUND;
 }
 
+/* Works on the progressions a <= j < b of fd, with a part of T of
+   (b - a) * (S + 5) entries.
+   If coeffs is not NULL, sets these progressions to X * coeffs[], as
+   multiplyW2n does. Otherwise, root i (0 <= i < n) belongs to the step
+   p = step[i], or p = first + i if step is NULL: it is taken from
+   progression p % nr once the progressions have been updated p / nr times.
+   This puts the roots of our progressions into R, and updates them
+   "updates" times in total, one inversion per update for the chunk.
+   Returns whether factor was found or not found, factor goes into f. */
+
+static int
+ecm_roots_chunk (mpz_t f, listz_t R, unsigned long n, 
+                 const unsigned long *step, unsigned long first, 
+                 unsigned long updates, listz_t coeffs, point *fd, curve *X, 
+                 progression_params_t *params, unsigned int a, unsigned int b, 
+                 mpres_t *T, mpmod_t modulus, unsigned long *muls, 
+                 unsigned long *gcds)
+{
+  const unsigned int S = params->S;
+  point *chunk = fd + a * (S + 1);
+  unsigned long i, done = 0;
+  int youpi = ECM_NO_FACTOR_FOUND;
+
+  if (a == b)
+    return ECM_NO_FACTOR_FOUND;
+
+  if (coeffs != NULL)
+    return multiplyW2n (f, chunk, X, coeffs + a * (S + 1), (b - a) * (S + 1),
+                        modulus, T[0], T[1], T + 2, muls, gcds);
+
+  for (i = 0; i < n && youpi == ECM_NO_FACTOR_FOUND; i++)
+    {
+      const unsigned long p = (step != NULL) ? step[i] : first + i;
+      const unsigned int j = p % params->nr;
+
+      if (j < a || j >= b)
+        continue;
+
+      for ( ; done < p / params->nr && youpi == ECM_NO_FACTOR_FOUND; done++)
+        youpi = addWnm (f, chunk, X, modulus, b - a, S, T, muls, gcds);
+
+      if (youpi == ECM_NO_FACTOR_FOUND)
+        mpres_get_z (R[i], fd[j * (S + 1)].x, modulus);
+    }
+
+  /* The progressions without a root in the last rounds must be updated
+     as well, so that the state is the same as with a single chunk */
+  for ( ; done < updates && youpi == ECM_NO_FACTOR_FOUND; done++)
+    youpi = addWnm (f, chunk, X, modulus, b - a, S, T, muls, gcds);
+
+  ASSERT(youpi != ECM_ERROR); /* no error can occur in addWnm */
+  return youpi;
+}
+
+/* Calls ecm_roots_chunk on the nr progressions, split into chunks of
+   consecutive progressions, one per thread. The progressions are
+   independent, so each chunk does its own batched inversions, with its
+   own copy of the modulus. T needs nr * (S + 5) entries. */
+
+static int
+ecm_roots_chunks (mpz_t f, listz_t R, unsigned long n, 
+                  const unsigned long *step, unsigned long first, 
+                  unsigned long updates, listz_t coeffs, point *fd, curve *X,
+                  progression_params_t *params, mpres_t *T, mpmod_t modulus,
+                  unsigned long *muls, unsigned long *gcds)
+{
+  int youpi = ECM_NO_FACTOR_FOUND;
+
+#ifdef _OPENMP
+#pragma omp parallel if (params->nr > 1)
+  {
+    const unsigned int nr_chunks = omp_get_num_threads ();
+    const unsigned int thread_nr = omp_get_thread_num ();
+    const unsigned int a = 
+      (unsigned long) params->nr * thread_nr / nr_chunks;
+    const unsigned int b = 
+      (unsigned long) params->nr * (thread_nr + 1) / nr_chunks;
+    unsigned long muls_local = 0, gcds_local = 0;
+    mpmod_t modulus_local;
+    mpz_t f_local;
+    int youpi_local;
+
+    mpmod_init_set (modulus_local, modulus);
+    mpz_init (f_local);
+
+    youpi_local = ecm_roots_chunk (f_local, R, n, step, first, updates, 
+                                   coeffs, fd, X, params, a, b, 
+                                   T + a * (params->S + 5), modulus_local, 
+                                   &muls_local, &gcds_local);
+
+#pragma omp critical
+    {
+      if (youpi_local != ECM_NO_FACTOR_FOUND 
+          && youpi == ECM_NO_FACTOR_FOUND)
+        {
+          youpi = youpi_local;
+          mpz_set (f, f_local);
+        }
+      *muls += muls_local;
+      *gcds += gcds_local;
+    }
+
+    mpz_clear (f_local);
+    mpmod_clear (modulus_local);
+  }
+#else
+  youpi = ecm_roots_chunk (f, R, n, step, first, updates, coeffs, fd, X, 
+                           params, 0, params->nr, T, modulus, muls, gcds);
+#endif
+
+  return youpi;
+}
+
 /* puts in F[0..dF-1] the successive values of 
 
    Dickson_{S, a} (j * d2) * s  where s is a point on the elliptic curve
@@ -431,8 +547,9 @@ int
 ecm_rootsF (mpz_t f, listz_t F, root_params_t *root_params, 
             unsigned long dF, curve *s, mpmod_t modulus)
 {
-  unsigned long i;
+  unsigned long i, rounds;
   unsigned long muls = 0, gcds = 0;
+  unsigned long *step;
   long st;
   int youpi = ECM_NO_FACTOR_FOUND;
   listz_t coeffs;
@@ -489,19 +606,22 @@ ecm_rootsF (mpz_t f, listz_t F, root_params_t *root_params,
       mpres_init (state.fd[i].y, modulus);
     }
 
-  state.T = (mpres_t *) malloc ((params->size_fd + 4) * sizeof (mpres_t));
+  /* 4 more entries per progression, so that every chunk of
+     ecm_roots_chunks() has some room for its own inversions */
+  state.size_T = params->size_fd + 4 * params->nr;
+  state.T = (mpres_t *) malloc (state.size_T * sizeof (mpres_t));
   if (state.T == NULL)
     {
       youpi = ECM_ERROR;
       goto ecm_rootsF_clearfdi;
     }
-  for (i = 0 ; i < params->size_fd + 4; i++)
+  for (i = 0 ; i < state.size_T; i++)
     mpres_init (state.T[i], modulus);
 
   /* Multiply fd[] = s * coeffs[] */
 
-  youpi = multiplyW2n (f, state.fd, s, coeffs, params->size_fd, modulus,
-                       state.T[0], state.T[1], state.T + 2, &muls, &gcds);
+  youpi = ecm_roots_chunks (f, NULL, 0, NULL, 0, 0, coeffs, state.fd, s, 
+                            params, state.T, modulus, &muls, &gcds);
   if (youpi == ECM_FACTOR_FOUND_STEP2)
     outputf (OUTPUT_VERBOSE, "Found factor while computing coeff[] * X\n");  
 
@@ -532,9 +652,22 @@ ecm_rootsF (mpz_t f, listz_t F, root_params_t *root_params,
       gcds = 0;
     }
 
-  /* Now for the actual calculation of the roots. */
+  /* Now for the actual calculation of the roots. First find out which
+     progression each root comes from, and after how many updates, so
+     that the chunks of progressions can compute their roots
+     independently. */
+
+  if (youpi != ECM_NO_FACTOR_FOUND)
+    goto clear;
 
-  for (i = 0; i < dF && !youpi;)
+  step = (unsigned long *) malloc (dF * sizeof (unsigned long));
+  if (step == NULL)
+    {
+      youpi = ECM_ERROR;
+      goto clear;
+    }
+
+  for (i = 0, rounds = 0; i < dF;)
     {
       /* Is this a rsieve value where we computed Dickson(j * d2) * X? */
       if (gcd ((unsigned long) params->rsieve, 
@@ -544,28 +677,28 @@ ecm_rootsF (mpz_t f, listz_t F, root_params_t *root_params,
           if (params->next == params->nr)
             {
               /* Yes, time to update again */
-              youpi = addWnm (f, state.fd, s, modulus, params->nr, params->S, 
-                              state.T, &muls, &gcds);
-	      ASSERT(youpi != ECM_ERROR); /* no error can occur in addWnm */
+              rounds++;
               params->next = 0;
-              if (youpi == ECM_FACTOR_FOUND_STEP2)
-                outputf (OUTPUT_VERBOSE,
-			 "Found factor while computing roots of F\n");
             }
           
           /* Is this a j value where we want Dickson(j * d2) * X as a root? */
           if (gcd ((unsigned long) params->rsieve, root_params->d1) 
 	      == 1UL) 
-            mpres_get_z (F[i++], 
-			 state.fd[params->next * (params->S + 1)].x, modulus);
+            step[i++] = rounds * params->nr + params->next;
 
           params->next ++;
         }
       params->rsieve += 6;
     }
 
+  youpi = ecm_roots_chunks (f, F, dF, step, 0, rounds, NULL, state.fd, s, 
+                            params, state.T, modulus, &muls, &gcds);
+  if (youpi == ECM_FACTOR_FOUND_STEP2)
+    outputf (OUTPUT_VERBOSE, "Found factor while computing roots of F\n");
+  free (step);
+
  clear:
-  for (i = 0 ; i < params->size_fd + 4; i++)
+  for (i = 0 ; i < state.size_T; i++)
     mpres_clear (state.T[i], modulus);
   free (state.T);
 
@@ -695,7 +828,8 @@ ecm_rootsG_init (mpz_t f, curve *X, root_params_t *root_params,
       mpres_init (state->fd[k].y, modulus);
     }
   
-  state->size_T = params->size_fd + 4;
+  /* 4 more entries per progression for the chunks, see ecm_rootsF() */
+  state->size_T = params->size_fd + 4 * params->nr;
   state->T = (mpres_t *) malloc (state->size_T * sizeof (mpres_t));
   if (state->T == NULL)
     {
@@ -720,8 +854,8 @@ ecm_rootsG_init (mpz_t f, curve *X, root_params_t *root_params,
       outputf (OUTPUT_TRACE, "ecm_rootsG_init: coeffs[%d] == %Zd\n", 
                k, coeffs[k]);
 
-  youpi = multiplyW2n (f, state->fd, X, coeffs, params->size_fd, modulus, 
-                     state->T[0], state->T[1], state->T + 2, &muls, &gcds);
+  youpi = ecm_roots_chunks (f, NULL, 0, NULL, 0, 0, coeffs, state->fd, X, 
+                            params, state->T, modulus, &muls, &gcds);
   if (youpi == ECM_ERROR)
     mpz_set_si (f, -1); /* fall through */
 
@@ -798,11 +932,10 @@ int
 ecm_rootsG (mpz_t f, listz_t G, unsigned long dF, ecm_roots_state_t *state, 
             mpmod_t modulus)
 {
-  unsigned long i;
+  unsigned long updates;
   unsigned long muls = 0, gcds = 0;
   int youpi = ECM_NO_FACTOR_FOUND;
   long st;
-  point *fd = state->fd; /* to save typing */
   progression_params_t *params = &(state->params); /* for less typing */
   
   st = cputime ();
@@ -812,37 +945,28 @@ ecm_rootsG (mpz_t f, listz_t G, unsigned long dF, ecm_roots_state_t *state,
            dF, params->nr, params->next, params->S, params->dsieve, 
 	   params->rsieve, params->dickson_a);
   
-  for (i = 0; i < dF;)
+  if (dF == 0)
+    return ECM_NO_FACTOR_FOUND;
+
+  /* All residues are taken (dsieve = 1), so the i-th root comes from
+     progression (next + i) % nr, after (next + i) / nr updates */
+  ASSERT (params->dsieve == 1);
+  updates = (params->next + dF - 1) / params->nr;
+
+  youpi = ecm_roots_chunks (f, G, dF, NULL, params->next, updates, NULL, 
+                            state->fd, state->X, params, state->T, modulus, 
+                            &muls, &gcds);
+  if (youpi == ECM_FACTOR_FOUND_STEP2)
+    outputf (OUTPUT_VERBOSE, "Found factor while computing G[]\n");
+
+  params->next += dF - updates * params->nr;
+  params->rsieve += dF;
+
+  if (test_verbose (OUTPUT_TRACE))
     {
-      /* Did we use every progression since the last update? */
-      if (params->next == params->nr)
-        {
-          /* Yes, time to update again */
-	  youpi = addWnm (f, fd, state->X, modulus, params->nr, params->S, 
-			  state->T, &muls, &gcds);
-	  ASSERT(youpi != ECM_ERROR); /* no error can occur in addWnm */
-	  params->next = 0;
-          
-          if (youpi == ECM_FACTOR_FOUND_STEP2)
-            {
-	      outputf (OUTPUT_VERBOSE, "Found factor while computing G[]\n");
-              break;
-            }
-        }
-      
-      /* Is this a root we should skip? (Take only if gcd == 1) */
-      if (gcd ((unsigned long) params->rsieve,  
-               (unsigned long) params->dsieve) == 1UL)
-	{
-	  mpres_get_z (G[i++], (fd + params->next * (params->S + 1))->x, 
-		       modulus);
-	  outputf (OUTPUT_TRACE, 
-		   "ecm_rootsG: storing d1*%u*X = %Zd in G[%lu]\n",
-		   params->rsieve, G[i - 1], i);
-	}
-      
-      params->next ++;
-      params->rsieve ++;
+      unsigned long i;
+      for (i = 0; i < dF; i++)
+        outputf (OUTPUT_TRACE, "ecm_rootsG: G[%lu] = %Zd\n", i, G[i]);
     }
 
   outputf (OUTPUT_VERBOSE, "Computing roots of G took %ldms",
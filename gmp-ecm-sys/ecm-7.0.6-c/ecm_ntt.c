@@ -25,19 +25,32 @@ http://www.gnu.org/licenses/ or write to the Free Software Foundation, Inc.,
 #include <string.h>
 #include "sp.h"
 #include "ecm-impl.h"
-
-#ifdef HAVE_UNISTD_H
-#include <unistd.h> /* for unlink */
+#ifdef _OPENMP
+#include <omp.h>
 #endif
 
 #define UNUSED 0
 
+#ifdef _OPENMP
+/* The branches of a level of the product tree are independent, so each 
+   level is processed in parallel, one branch at a time per thread. Returns 
+   the number of threads to use for n branches. */
+static int
+ntt_tree_threads (spv_size_t n)
+{
+  return (int) MIN ((spv_size_t) omp_get_max_threads (), n);
+}
+#else
+static int omp_get_thread_num (void) {return 0;}
+#endif
+
 /* memory: 4 * len mpspv coeffs */
 void
 ntt_mul (mpzv_t r, mpzv_t x, mpzv_t y, spv_size_t len, mpzv_t t,
     int monic, mpzspm_t mpzspm)
 {
   mpzspv_t u, v;
+  spv_size_t ntt_size;
 	
   if (len < MUL_NTT_THRESHOLD)
     {
@@ -45,13 +58,15 @@ ntt_mul (mpzv_t r, mpzv_t x, mpzv_t y, spv_size_t len, mpzv_t t,
       return;
     }
 
-  u = mpzspv_init (2 * len, mpzspm);
-  v = mpzspv_init (2 * len, mpzspm);
+  /* the product has 2 * len coefficients below the monic term */
+  ntt_size = mpzspm_ntt_size (mpzspm, 2 * len);
+  u = mpzspv_init (ntt_size, mpzspm);
+  v = mpzspv_init (ntt_size, mpzspm);
   
   mpzspv_from_mpzv (v, 0, y, len, mpzspm);
   mpzspv_from_mpzv (u, 0, x, len, mpzspm);
 
-  mpzspv_mul_ntt(u, 0, u, 0, len, v, 0, len, 2 * len, monic, 
+  mpzspv_mul_ntt(u, 0, u, 0, len, v, 0, len, ntt_size, monic, 
     monic ? 2 * len : 0, mpzspm, 
     NTT_MUL_STEP_FFT1 + NTT_MUL_STEP_FFT2 + NTT_MUL_STEP_MUL + NTT_MUL_STEP_IFFT);
   mpzspv_to_mpzv (u, 0, r, 2 * len - 1 + monic, mpzspm);
@@ -105,10 +120,11 @@ ntt_PolyFromRoots (mpzv_t r, mpzv_t a, spv_size_t len, mpzv_t t,
 /* memory: 2 * len mpzspv coeffs */
 int
 ntt_PolyFromRoots_Tree (mpzv_t r, mpzv_t a, spv_size_t len, mpzv_t t,
-    int dolvl, mpzspm_t mpzspm, mpzv_t *Tree, FILE *TreeFile)
+    int dolvl, mpzspm_t mpzspm, mpzv_t *Tree, treefile_t TreeFile)
 {
   mpzspv_t x;
   spv_size_t i, m, m_max;
+  long j;
   mpzv_t src;
   mpzv_t *dst = Tree + ceil_log2 (len) - 1;
 
@@ -141,14 +157,26 @@ ntt_PolyFromRoots_Tree (mpzv_t r, mpzv_t a, spv_size_t len, mpzv_t t,
       if (m == len / 2)
 	dst = &r;
       
-      if (TreeFile && list_out_raw (TreeFile, src, len) == ECM_ERROR)
+      if (TreeFile && treefile_write (TreeFile, src, len) == ECM_ERROR)
         {
           outputf (OUTPUT_ERROR, "Error writing product tree of F\n");
           return ECM_ERROR;
         }
 
-      for (i = 0; i < len; i += 2 * m)
-	list_mul (t + i, src + i, m, src + i + m, m, 1, t + len);
+      /* Each thread gets its own list_mul_mem (m) cells of t + len as
+         scratch space. There are at most len / (2 * m) threads, so this
+         is no more than the 2 * m <= len cells of a serial run at the 
+         top level. */
+#ifdef _OPENMP
+#pragma omp parallel for private(i) schedule(static) \
+  num_threads(ntt_tree_threads (len / (2 * m)))
+#endif
+      for (j = 0; j < (long) (len / (2 * m)); j++)
+        {
+          i = 2 * m * j;
+	  list_mul (t + i, src + i, m, src + i + m, m, 1, 
+	            t + len + omp_get_thread_num () * list_mul_mem (m));
+        }
 
       list_mod (*dst, t, len, mpzspm->modulus);
       
@@ -164,19 +192,27 @@ ntt_PolyFromRoots_Tree (mpzv_t r, mpzv_t a, spv_size_t len, mpzv_t t,
       if (m == len / 2)
         dst = &r;
       
-      for (i = 0; i < 2 * len; i += 4 * m)
+      /* With dolvl >= 0 we may have *dst == src, so the whole level has
+         to be written out before any branch overwrites it */
+      if (TreeFile && treefile_write (TreeFile, src, len) == ECM_ERROR)
+        return ECM_ERROR;
+
+      /* Branch j uses the 4 * m coefficients of x starting at i = 4 * m * j
+         and writes the 2 * m coefficients of *dst starting at i / 2 */
+#ifdef _OPENMP
+#pragma omp parallel for private(i) schedule(dynamic) \
+  num_threads(ntt_tree_threads (len / (2 * m)))
+#endif
+      for (j = 0; j < (long) (len / (2 * m)); j++)
         {
- 	  if (TreeFile &&
-	      list_out_raw (TreeFile, src + i / 2, 2 * m) == ECM_ERROR)
-	    return ECM_ERROR;
-	  
+          i = 4 * m * j;
 	  mpzspv_from_mpzv (x, i, src + i / 2, m, mpzspm);
 	  mpzspv_from_mpzv (x, i + 2 * m, src + i / 2 + m, m, mpzspm);
           mpzspv_mul_ntt (x, i, x, i, m, x, i + 2 * m, m, 2 * m, 1, 2 * m, mpzspm,
             NTT_MUL_STEP_FFT1 + NTT_MUL_STEP_FFT2 + NTT_MUL_STEP_MUL + NTT_MUL_STEP_IFFT);
           mpzspv_to_mpzv (x, i, *dst + i / 2, 2 * m, mpzspm);
 
-          /* we only do the mod reduction to reduce the file size a bit */
+          /* the tree file only stores reduced residues */
 	  if (TreeFile)
 	    list_mod (*dst + i / 2, *dst + i / 2, 2 * m, mpzspm->modulus);
 	}
@@ -291,27 +327,16 @@ void ntt_PolyInvert (mpzv_t q, mpzv_t b, spv_size_t len, mpzv_t t,
 /* memory: 4 * len mpzspv coeffs */
 int
 ntt_polyevalT (mpzv_t b, spv_size_t len, mpzv_t *Tree, mpzv_t T,
-                   mpzspv_t sp_invF, mpzspm_t mpzspm, char *TreeFilenameStem)
+                   mpzspv_t sp_invF, mpzspm_t mpzspm, treefile_t TreeFile)
 {
   spv_size_t m, i;
-  FILE *TreeFile = NULL;
-  /* assume this "small" malloc will not fail in normal usage */
-  char *TreeFilename = NULL;
+  long j;
+  mpzv_t TreeLevel;
   mpzv_t *Tree_orig = Tree;
   int level = 0; /* = ceil_log2 (len / m) - 1 */
   mpzspv_t x = mpzspv_init (2 * len, mpzspm);
   mpzspv_t y = mpzspv_init (2 * len, mpzspm);
 
-  if (TreeFilenameStem)
-    {
-      TreeFilename = (char *) malloc (strlen (TreeFilenameStem) + 1 + 2 + 1);
-      if (TreeFilename == NULL)
-        {
-          fprintf (stderr, "Cannot allocate memory in ntt_polyevalT\n");
-          exit (1);
-        }
-    }
-  
   mpzspv_from_mpzv (x, 0, b, len, mpzspm);
   mpzspv_mul_ntt(x, 0, x, 0, len, sp_invF, 0, UNUSED, 2 * len, 0, 0, mpzspm,
     NTT_MUL_STEP_FFT1 + NTT_MUL_STEP_MUL + NTT_MUL_STEP_IFFT);
@@ -321,51 +346,51 @@ ntt_polyevalT (mpzv_t b, spv_size_t len, mpzv_t *Tree, mpzv_t T,
     
   for (m = len / 2; m >= POLYEVALT_NTT_THRESHOLD; m /= 2)
     {
-      if (TreeFilenameStem)
+      if (TreeFile)
         {
-          Tree = &T;
-	  
-          sprintf (TreeFilename, "%s.%d", TreeFilenameStem, level);
-          
-	  TreeFile = fopen (TreeFilename, "rb");
-          if (TreeFile == NULL)
+          /* The level is used in place in the tree file */
+          treefile_seek (TreeFile, level);
+          TreeLevel = treefile_read (TreeFile, len);
+          if (TreeLevel == NULL)
             {
-              outputf (OUTPUT_ERROR,
-		  "Error opening file %s for product tree of F\n",
-                        TreeFilename);
               mpzspv_clear (x, mpzspm);
 	      mpzspv_clear (y, mpzspm);
 	      return ECM_ERROR;
             }
-
-	  list_inp_raw (*Tree, TreeFile, len);
-
-	  fclose (TreeFile);
-	  unlink (TreeFilename);
+          Tree = &TreeLevel;
 	}
 
-      for (i = 0; i < len; i += 2 * m)
+      /* Branch j works on the coefficients i = 2 * m * j, ..., i + 2 * m - 1
+         of y and uses the 4 * m coefficients of x starting at 2 * i */
+#ifdef _OPENMP
+#pragma omp parallel for private(i) schedule(dynamic) \
+  num_threads(ntt_tree_threads (len / (2 * m)))
+#endif
+      for (j = 0; j < (long) (len / (2 * m)); j++)
         {
-	  
+          spv_size_t o;
+
+          i = 2 * m * j;
+          o = 2 * i;
 	  list_revert (*Tree + i, m);
-          mpzspv_set_sp (x, 0, 1, 1, mpzspm);
-          mpzspv_from_mpzv (x, 1, *Tree + i, m, mpzspm);
+          mpzspv_set_sp (x, o, 1, 1, mpzspm);
+          mpzspv_from_mpzv (x, o + 1, *Tree + i, m, mpzspm);
 	  /* x contains reversed monic poly */
-          mpzspv_mul_ntt (x, 0, x, 0, m + 1, y, i, 2 * m, 2 * m, 0, 0, mpzspm, 
+          mpzspv_mul_ntt (x, o, x, o, m + 1, y, i, 2 * m, 2 * m, 0, 0, mpzspm, 
             NTT_MUL_STEP_FFT1 + NTT_MUL_STEP_FFT2 + NTT_MUL_STEP_MUL + NTT_MUL_STEP_IFFT);
           if (m > POLYEVALT_NTT_THRESHOLD)
-	    mpzspv_normalise (x, m, m, mpzspm);
+	    mpzspv_normalise (x, o + m, m, mpzspm);
 	    
 	  list_revert (*Tree + i + m, m);
-	  mpzspv_set_sp (x, 2 * m, 1, 1, mpzspm);
-	  mpzspv_from_mpzv (x, 2 * m + 1, *Tree + i + m, m, mpzspm);
-          mpzspv_mul_ntt(x, 2 * m, x, 2 * m, m + 1, y, i, UNUSED, 2 * m, 0, 0, mpzspm, 
+	  mpzspv_set_sp (x, o + 2 * m, 1, 1, mpzspm);
+	  mpzspv_from_mpzv (x, o + 2 * m + 1, *Tree + i + m, m, mpzspm);
+          mpzspv_mul_ntt(x, o + 2 * m, x, o + 2 * m, m + 1, y, i, UNUSED, 2 * m, 0, 0, mpzspm, 
             NTT_MUL_STEP_FFT1 + NTT_MUL_STEP_MUL + NTT_MUL_STEP_IFFT);
 	  if (m > POLYEVALT_NTT_THRESHOLD)
-	    mpzspv_normalise (x, 3 * m, m, mpzspm);
+	    mpzspv_normalise (x, o + 3 * m, m, mpzspm);
 	  
-	  mpzspv_set (y, i, x, 3 * m, m, mpzspm);
-	  mpzspv_set (y, i + m, x, m, m, mpzspm);
+	  mpzspv_set (y, i, x, o + 3 * m, m, mpzspm);
+	  mpzspv_set (y, i + m, x, o + m, m, mpzspm);
         }
       
       Tree++;
@@ -380,32 +405,14 @@ ntt_polyevalT (mpzv_t b, spv_size_t len, mpzv_t *Tree, mpzv_t T,
 
   for (; m >= 1; m /= 2)
     {
-      if (TreeFilenameStem)
-        {
-          sprintf (TreeFilename, "%s.%d", TreeFilenameStem, level);
-
-          TreeFile = fopen (TreeFilename, "rb");
-          if (TreeFile == NULL)
-            {
-              outputf (OUTPUT_ERROR,
-		  "Error opening file %s for product tree of F\n",
-                        TreeFilename);
-	      return ECM_ERROR;
-            }
-	}
+      if (TreeFile)
+        treefile_seek (TreeFile, level);
       
-      TUpTree (T, Tree_orig, len, T + len, level++, 0,
-	  mpzspm->modulus, TreeFile);
-
-      if (TreeFilenameStem)
-        {
-	  fclose (TreeFile);
-	  unlink (TreeFilename);
-	}
+      if (TUpTree (T, Tree_orig, len, T + len, level++, 0,
+	  mpzspm->modulus, TreeFile) == ECM_ERROR)
+        return ECM_ERROR;
     }
   
-  if (TreeFilenameStem)
-    free (TreeFilename);
   list_swap (b, T, len);
   return 0;
 }
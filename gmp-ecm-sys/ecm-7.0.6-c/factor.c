@@ -24,6 +24,10 @@ http://www.gnu.org/licenses/ or write to the Free Software Foundation, Inc.,
 #include <math.h>
 #include "ecm-impl.h"
 #include "ecm-gpu.h"
+#include "getprime_r.h"
+#include "manycurves.h"
+#include "hecm/hecm.h"
+#include "aprtcle/mpz_aprcl.h"
 
 
 const char *
@@ -177,6 +181,8 @@ ecm_factor (mpz_t f, mpz_t n, double B1, ecm_params p0)
                p->k, p->verbose, p->repr, p->use_ntt, p->os, p->es,
                p->chkfilename, p->TreeFilename, p->maxmem, p->rng,
                p->stop_asap);
+  else if (p->method == ECM_HECM)
+    res = hecm (f, n, B1, p);
   else
     {
       fprintf (p->es, "Error, unknown method: %d\n", p->method);
@@ -188,3 +194,130 @@ ecm_factor (mpz_t f, mpz_t n, double B1, ecm_params p0)
 
   return res;
 }
+
+int
+ecm_factor_many_curves (mpz_t *f, int *res, mpz_t n, double B1,
+                        const char *torsion, int smin, int ncurves,
+                        ecm_params p0)
+{
+  int ret;
+  ecm_params q;
+  ecm_params_ptr p;
+
+  if (mpz_cmp_ui (n, 1) <= 0 || mpz_divisible_2exp_p (n, 1) || ncurves <= 0)
+    {
+      fprintf ((p0 == NULL) ? stderr : p0->es,
+               "Error, n should be odd and greater than 1, and ncurves "
+               "positive.\n");
+      return ECM_ERROR;
+    }
+
+  if (p0 == NULL)
+    {
+      p = q;
+      ecm_init (q);
+    }
+  else
+    p = p0;
+
+  ret = factor_many_curves (f, res, n, B1, torsion, smin, ncurves, p);
+
+  if (p0 == NULL)
+    ecm_clear (q);
+
+  return ret;
+}
+
+int
+ecm_prime_table_reserve (double B1)
+{
+  return prime_table_reserve (B1);
+}
+
+int
+ecm_prime_table_save (const char *filename)
+{
+  return prime_table_save (filename);
+}
+
+int
+ecm_prime_table_load (const char *filename)
+{
+  return prime_table_load (filename);
+}
+
+/* must not be called while another thread runs ecm_factor() */
+void
+ecm_prime_table_clear (void)
+{
+  prime_table_clear ();
+  prac_chains_clear (); /* indexed like the prime table */
+}
+
+void
+ecm_treefile_clear (void)
+{
+  treefile_clear ();
+}
+
+int
+ecm_batch_s_dir (const char *dir)
+{
+  return batch_s_dir (dir);
+}
+
+/* must not be called while another thread runs ecm_factor() */
+void
+ecm_batch_s_clear (void)
+{
+  batch_s_clear ();
+}
+
+int
+ecm_mpmod_profile_load (const char *filename)
+{
+  return mpmod_profile_load (filename);
+}
+
+void
+ecm_mpmod_profile_skip (void)
+{
+  mpmod_profile_skip ();
+}
+
+int
+ecm_mpmod_tune (const char *filename)
+{
+  mpmod_tune ();
+  return mpmod_profile_save (filename);
+}
+
+int
+ecm_mpmod_autotune (const char *filename)
+{
+  if (mpmod_profile_load (filename) == 0)
+    return 0;
+  return ecm_mpmod_tune (filename);
+}
+
+int
+ecm_mpres_mul_run (mpz_t N, int repr, int sqr, unsigned long n)
+{
+  if (mpz_cmp_ui (N, 3) < 0 || mpz_even_p (N) ||
+      (repr != ECM_MOD_MPZ && repr != ECM_MOD_MODMULN && repr != ECM_MOD_REDC))
+    return 1;
+  mpmod_mul_run (N, repr, sqr, n);
+  return 0;
+}
+
+void
+ecm_set_parallel_for (ecm_parallel_for_t parallel_for, void *ctx)
+{
+  mpzspm_set_parallel_for (parallel_for, ctx);
+}
+
+int
+ecm_prove_prime (mpz_t n, ecm_parallel_for_t parallel_for, void *ctx)
+{
+  return mpz_aprtcle_parallel (n, APRTCLE_VERBOSE0, parallel_for, ctx);
+}
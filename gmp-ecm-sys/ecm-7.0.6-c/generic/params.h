@@ -18,6 +18,10 @@
 #define NTT_GFP_TWIDDLE_DIT_BREAKOVER 11
 #endif
 
+#ifndef NTT_GFP_FOURSTEP_THRESHOLD
+#define NTT_GFP_FOURSTEP_THRESHOLD 23
+#endif
+
 #ifndef MUL_NTT_THRESHOLD
 #define MUL_NTT_THRESHOLD 1024
 #endif
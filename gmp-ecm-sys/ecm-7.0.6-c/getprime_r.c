@@ -28,12 +28,50 @@
 #include <stdlib.h>
 #include <string.h>
 #include "getprime_r.h"
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+#include <sys/mman.h>
+#define PRIME_TABLE_USE_MMAP
+#endif
 
 /* provided for in cado.h, but we want getprime.c to be standalone */
 #ifndef ASSERT
 #define ASSERT(x)
 #endif
 
+/* The shared prime table stores the odd primes 3, 5, 7, ... as half-gaps,
+   gaps[k] = (p[k+1] - p[k]) / 2, which fit in one byte for all primes
+   below the first gap larger than 2*255, which follows 304599508537.
+   A published table is never modified: extending it publishes a new one and
+   keeps the old one alive until prime_table_clear(), so that iterators
+   attached to it remain valid. */
+#define PRIME_TABLE_MAX_BOUND 304599508537.0
+
+/* file header: magic, sizeof (ecm_uint), n, bound */
+#define PRIME_TABLE_MAGIC "ECMPTBL"
+
+struct prime_table_s {
+  unsigned char *gaps;  /* n-1 half-gaps */
+  ecm_uint n;           /* number of odd primes in the table */
+  ecm_uint bound;       /* all primes <= bound, and the next one, are in */
+  void *map;            /* mmap()ed file containing gaps, or NULL */
+  size_t map_len;
+  struct prime_table_s *prev; /* superseded table */
+};
+
+static struct prime_table_s *prime_table = NULL;
+
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t prime_table_lock = PTHREAD_MUTEX_INITIALIZER;
+#define PRIME_TABLE_LOCK() pthread_mutex_lock (&prime_table_lock)
+#define PRIME_TABLE_UNLOCK() pthread_mutex_unlock (&prime_table_lock)
+#else
+#define PRIME_TABLE_LOCK()
+#define PRIME_TABLE_UNLOCK()
+#endif
+
 /* This function returns successive odd primes, starting with 3.
    To perform a loop over all primes <= B1, do the following
    (compile this file with -DMAIN to count primes):
@@ -48,8 +86,8 @@
       prime_info_clear (pi);
 */
 
-void
-prime_info_init (prime_info_t i)
+static void
+prime_info_init_sieve (prime_info_t i)
 {
   i->offset = 0;
   i->current = -1;
@@ -58,6 +96,24 @@ prime_info_init (prime_info_t i)
   i->sieve = NULL;
   i->len = 0;
   i->moduli = NULL;
+  i->table = NULL;
+  i->table_n = 0;
+  i->table_i = 0;
+  i->table_p = 0;
+}
+
+void
+prime_info_init (prime_info_t i)
+{
+  prime_info_init_sieve (i);
+
+  PRIME_TABLE_LOCK();
+  if (prime_table != NULL)
+    {
+      i->table = prime_table->gaps;
+      i->table_n = prime_table->n;
+    }
+  PRIME_TABLE_UNLOCK();
 }
 
 void
@@ -72,6 +128,25 @@ prime_info_clear (prime_info_t i)
 ecm_uint
 getprime_mt (prime_info_t i)
 {
+  if (i->table != NULL)
+    {
+      if (i->table_i == 0)
+        i->table_p = 3;
+      else if (i->table_i < i->table_n)
+        i->table_p += 2 * (ecm_uint) i->table[i->table_i - 1];
+      else
+        {
+          /* we ran past the end of the table, go on with the sieve */
+          ecm_uint p;
+
+          i->table = NULL;
+          while ((p = getprime_mt (i)) <= i->table_p);
+          return p;
+        }
+      i->table_i++;
+      return i->table_p;
+    }
+
   if (i->len)
     {
       unsigned char *ptr = i->sieve + i->current;
@@ -187,6 +262,220 @@ getprime_mt (prime_info_t i)
   return i->offset + 2 * i->current;
 }
 
+static void
+prime_table_free (struct prime_table_s *t)
+{
+#ifdef PRIME_TABLE_USE_MMAP
+  if (t->map != NULL)
+    munmap (t->map, t->map_len);
+  else
+#endif
+    free (t->gaps);
+  free (t);
+}
+
+/* Publish t if it covers more than the current table, otherwise free it.
+   Must be called with the lock held. */
+static void
+prime_table_publish (struct prime_table_s *t)
+{
+  if (prime_table != NULL && prime_table->bound >= t->bound)
+    {
+      prime_table_free (t);
+      return;
+    }
+  t->prev = prime_table;
+  prime_table = t;
+}
+
+int
+prime_table_reserve (double B)
+{
+  struct prime_table_s *t;
+  prime_info_t i;
+  ecm_uint bound, p, q, alloc;
+  unsigned char *gaps;
+  int ret = 0;
+
+  if (B > PRIME_TABLE_MAX_BOUND)
+    return 1;
+  bound = (B < 3.0) ? 3 : (ecm_uint) B;
+
+  PRIME_TABLE_LOCK();
+  if (prime_table != NULL && prime_table->bound >= bound)
+    goto unlock;
+
+  /* grow geometrically, so that slowly increasing bounds do not rebuild
+     the table each time */
+  if (prime_table != NULL && (double) prime_table->bound * 2.0 > (double) bound)
+    bound = ((double) prime_table->bound * 2.0 > PRIME_TABLE_MAX_BOUND)
+      ? (ecm_uint) PRIME_TABLE_MAX_BOUND : prime_table->bound * 2;
+
+  t = (struct prime_table_s *) malloc (sizeof (struct prime_table_s));
+  alloc = 1024;
+  gaps = (unsigned char *) malloc (alloc);
+  if (t == NULL || gaps == NULL)
+    {
+      free (t);
+      free (gaps);
+      ret = 1;
+      goto unlock;
+    }
+
+  /* we keep the first prime > bound in the table, so that the usual
+     "for (p = ...; p <= B; p = getprime_mt (i))" loops never fall back
+     to sieving */
+  prime_info_init_sieve (i);
+  t->n = 1;
+  for (q = getprime_mt (i); q <= bound; q = p, t->n++)
+    {
+      p = getprime_mt (i);
+      if (t->n > alloc)
+        {
+          unsigned char *newgaps;
+          alloc *= 2;
+          newgaps = (unsigned char *) realloc (gaps, alloc);
+          if (newgaps == NULL)
+            {
+              prime_info_clear (i);
+              free (gaps);
+              free (t);
+              ret = 1;
+              goto unlock;
+            }
+          gaps = newgaps;
+        }
+      gaps[t->n - 1] = (unsigned char) ((p - q) / 2);
+    }
+  prime_info_clear (i);
+
+  t->gaps = gaps;
+  t->bound = bound;
+  t->map = NULL;
+  t->map_len = 0;
+  prime_table_publish (t);
+
+ unlock:
+  PRIME_TABLE_UNLOCK();
+  return ret;
+}
+
+/* Write the current table to a file that prime_table_load() can map.
+   The file is only meant to be read on hosts with the same ecm_uint size
+   and endianness. Returns 0 on success. */
+int
+prime_table_save (const char *filename)
+{
+  FILE *f;
+  unsigned char w = sizeof (ecm_uint);
+  int ret = 1;
+
+  PRIME_TABLE_LOCK();
+  if (prime_table == NULL)
+    goto unlock;
+  f = fopen (filename, "wb");
+  if (f == NULL)
+    goto unlock;
+  if (fwrite (PRIME_TABLE_MAGIC, sizeof (PRIME_TABLE_MAGIC) - 1, 1, f) == 1
+      && fwrite (&w, 1, 1, f) == 1
+      && fwrite (&prime_table->n, sizeof (ecm_uint), 1, f) == 1
+      && fwrite (&prime_table->bound, sizeof (ecm_uint), 1, f) == 1
+      && fwrite (prime_table->gaps, 1, prime_table->n - 1, f)
+         == prime_table->n - 1)
+    ret = 0;
+  if (fclose (f) != 0)
+    ret = 1;
+ unlock:
+  PRIME_TABLE_UNLOCK();
+  return ret;
+}
+
+/* Load a table written by prime_table_save(). Where mmap() is available the
+   file is mapped read-only, so that all processes using the same file share
+   one copy in the page cache. Returns 0 on success. */
+int
+prime_table_load (const char *filename)
+{
+  FILE *f;
+  char magic[sizeof (PRIME_TABLE_MAGIC) - 1];
+  unsigned char w;
+  ecm_uint n, bound;
+  size_t header = sizeof (magic) + 1 + 2 * sizeof (ecm_uint);
+  struct prime_table_s *t;
+
+  f = fopen (filename, "rb");
+  if (f == NULL)
+    return 1;
+  if (fread (magic, sizeof (magic), 1, f) != 1
+      || memcmp (magic, PRIME_TABLE_MAGIC, sizeof (magic)) != 0
+      || fread (&w, 1, 1, f) != 1 || w != sizeof (ecm_uint)
+      || fread (&n, sizeof (ecm_uint), 1, f) != 1
+      || fread (&bound, sizeof (ecm_uint), 1, f) != 1 || n == 0
+      || fseek (f, 0, SEEK_END) != 0
+      || ftell (f) < (long) (header + n - 1)
+      || fseek (f, header, SEEK_SET) != 0)
+    {
+      fclose (f);
+      return 1;
+    }
+
+  t = (struct prime_table_s *) malloc (sizeof (struct prime_table_s));
+  if (t == NULL)
+    {
+      fclose (f);
+      return 1;
+    }
+  t->n = n;
+  t->bound = bound;
+  t->map = NULL;
+  t->map_len = 0;
+#ifdef PRIME_TABLE_USE_MMAP
+  t->map_len = header + n - 1;
+  t->map = mmap (NULL, t->map_len, PROT_READ, MAP_SHARED, fileno (f), 0);
+  if (t->map == MAP_FAILED)
+    t->map = NULL;
+  else
+    {
+      t->gaps = (unsigned char *) t->map + header;
+#ifdef HAVE_MADVISE
+      madvise (t->map, t->map_len, MADV_SEQUENTIAL);
+#endif
+    }
+#endif
+  if (t->map == NULL)
+    {
+      t->gaps = (unsigned char *) malloc (n);
+      if (t->gaps == NULL || fread (t->gaps, 1, n - 1, f) != n - 1)
+        {
+          free (t->gaps);
+          free (t);
+          fclose (f);
+          return 1;
+        }
+    }
+  fclose (f);
+
+  PRIME_TABLE_LOCK();
+  prime_table_publish (t);
+  PRIME_TABLE_UNLOCK();
+  return 0;
+}
+
+void
+prime_table_clear (void)
+{
+  struct prime_table_s *t;
+
+  PRIME_TABLE_LOCK();
+  while (prime_table != NULL)
+    {
+      t = prime_table->prev;
+      prime_table_free (prime_table);
+      prime_table = t;
+    }
+  PRIME_TABLE_UNLOCK();
+}
+
 #ifdef MAIN
 int
 main (int argc, char *argv[])
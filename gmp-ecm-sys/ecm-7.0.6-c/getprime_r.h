@@ -11,6 +11,10 @@ struct prime_info_s {
   unsigned char *sieve;  /* sieving table */
   ecm_int len;              /* length of sieving table */
   ecm_uint *moduli;  /* offset for small primes */
+  const unsigned char *table; /* shared prime table, see below, or NULL */
+  ecm_uint table_n;  /* number of primes in table */
+  ecm_uint table_i;  /* number of primes already returned from table */
+  ecm_uint table_p;  /* last prime returned from table */
 };
 typedef struct prime_info_s prime_info_t[1];
 
@@ -18,11 +22,31 @@ typedef struct prime_info_s prime_info_t[1];
 extern "C" {
 #endif
 
+/* Index of the last prime returned (0 for 3) while getprime_mt() reads
+   from the shared table, ECM_UINT_MAX once it sieves privately. */
+#define prime_info_index(i) \
+  ((i)->table != NULL ? (i)->table_i - 1 : ECM_UINT_MAX)
+
 /* The getprime_mt function returns successive odd primes, starting with 3. */
 void prime_info_init (prime_info_t);
 void prime_info_clear (prime_info_t);
 ecm_uint getprime_mt (prime_info_t);
 
+/* Process-wide, read-only prime table shared by all threads. prime_info_init
+   attaches to the current table, and getprime_mt() then reads primes from
+   it instead of sieving. prime_table_reserve (B) makes sure the table
+   covers all primes up to B; it returns 0 on success, non-zero if the table
+   could not be built, in which case getprime_mt() sieves privately. */
+int prime_table_reserve (double);
+/* Stage 1 reserves the table up to MIN(B1, PRIME_TABLE_AUTO_BOUND) only, to
+   bound its memory (about 51MB); past the table, getprime_mt() sieves.
+   Larger tables can still be reserved or loaded explicitly. */
+#define PRIME_TABLE_AUTO_BOUND 1e9
+int prime_table_save (const char *);
+int prime_table_load (const char *);
+/* Must not be called while another thread iterates over primes. */
+void prime_table_clear (void);
+
 #ifdef __cplusplus
 }
 #endif
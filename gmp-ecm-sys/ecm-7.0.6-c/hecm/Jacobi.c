@@ -18,7 +18,7 @@ void coorJacobi_clear (coorJacobi P, mpmod_t n ) {
   mpres_clear (P->Y ,n);
 }
 
-void coorJacobi_set (coorJacobi P,coorJacobi Q, mpmod_t n ) {
+void coorJacobi_set (coorJacobi P,coorJacobi Q, ATTRIBUTE_UNUSED mpmod_t n ) {
   mpres_set (P->U ,Q->U ,n);
   mpres_set (P->V ,Q->V ,n);
   mpres_set (P->W ,Q->W ,n);
@@ -305,9 +305,9 @@ int mulJacobi2 (mpz_t f,mpmod_t n,
   begin with X=1, Y=1-ep (Z=1)
   We want x,y
 */
-void doubleJacobi2DebFin(mpz_t f,mpmod_t n,
+void doubleJacobi2DebFin(ATTRIBUTE_UNUSED mpz_t f,mpmod_t n,
 			mpres_t x,mpres_t y,
-			mpres_t Y,mpres_t ep,mpres_t dep) {
+			ATTRIBUTE_UNUSED mpres_t Y,mpres_t ep,ATTRIBUTE_UNUSED mpres_t dep) {
 
 
 
@@ -3,160 +3,12 @@
 
 
 /*
-  compute k=lcm(2,..,B1)
-  WARNING: slow version  (no product tree)
-  NOT USED
-*/
-void calculk (mpz_t k,double B1) {
-  double p,r;
-  mpz_t q;
-
-  mpz_set_ui (k,1);
-  mpz_init (q);
-
-  for ( p = 2.0; p <= B1; p = getprime () ) {
-    mpz_set_d (q ,p);
-    for (r = p; r <= B1; r *= p) {
-      mpz_mul (k ,k ,q);
-    }
-  }
-
-  mpz_clear (q);
-
-}
-
-
-/*
-  Compute k=lcm(2,..,B1) with the use of a product tree
-  This is what is used
+  Compute k=lcm(2,..,B1), i.e. the product of the largest powers of the
+  primes that are <= B1, with the product tree of the batch code
+  (compute_s uses the shared prime table, so this is thread-safe)
 */
 void prodTreeCalculk (mpz_t k,double B1) {
-  int stop = 0;
-  int n=0;
-  double r;
-  mpz_t t;
-
-  mpz_init (t);
-
-  mpz_set_ui (k,1);
-  for (r = 2.0; r <= B1; r *= 2.0) {
-    mpz_mul_ui (k ,k ,2);
-  }
-
-  while (stop == 0) {
-    prodTreeCalculkInter (t,B1,n,&stop);
-    mpz_mul (k ,k ,t);
-    n++;
-  }
-
-  mpz_clear (t);
-}
-
-
-void prodTreeCalculkInter (mpz_t Pr,double B1, int n, int* pstop) {
-  double p,r;
-  mpz_t t1,q;
-
-  mpz_init (t1);
-  mpz_init (q);
-
-  if (n==0) {
-    p = getprime();
-    if ( p>B1 ) {
-      mpz_set_ui (Pr,1);
-      *pstop = 1;
-    }
-    else {
-      mpz_set_ui (Pr,1);
-      mpz_set_ui (q,p);
-      for (r = p; r <= B1; r *= p) {
-	mpz_mul (Pr,Pr,q);
-      }
-    }
-  }
-  else { // n>0
-    if (*pstop == 1) {
-      mpz_set_ui (Pr,1);
-    }
-    else {
-      prodTreeCalculkInter (Pr,B1,n-1,pstop);
-      prodTreeCalculkInter (t1,B1,n-1,pstop);
-      mpz_mul (Pr,Pr,t1);
-    }
-  }
-
-  mpz_clear(q);
-  mpz_clear(t1);
-
-}
-
-
-
-
-
-
-/*
-  compute k="lcm(2,..,B1)" with one power more for each prime
-  Use a product tree.
-  NOT USED
-*/
-
-void prodTreeCalculkPlus (mpz_t k,double B1) {
-  int stop = 0;
-  int n=0;
-  double r;
-  mpz_t t;
-
-  mpz_init (t);
-
-  for (r = 2.0; r <= B1; r *= 2.0) {
-  }
-  mpz_set_d (k,r);
-
-  while (stop == 0) {
-    prodTreeCalculkInterPlus (t,B1,n,&stop);
-    mpz_mul (k ,k ,t);
-    n++;
-  }
-
-  mpz_clear (t);
-}
-
-
-
-//  NOT USED
-void prodTreeCalculkInterPlus (mpz_t Pr,double B1, int n, int* pstop) {
-  double p,r;
-  mpz_t t1;
-
-  mpz_init (t1);
-
-  if (n==0) {
-    p = getprime();
-    if ( p>B1 ) {
-      mpz_set_ui (Pr,1);
-      *pstop = 1;
-    }
-    else {
-      for (r = p; r <= B1; r *= p) {
-      }
-      mpz_set_d (Pr ,r);
-    }
-  }
-  else { // n>0
-    if (*pstop == 1) {
-      mpz_set_ui (Pr,1);
-    }
-    else {
-      prodTreeCalculkInter (Pr,B1,n-1,pstop);
-      prodTreeCalculkInter (t1,B1,n-1,pstop);
-      mpz_mul (Pr,Pr,t1);
-    }
-  }
-
-
-  mpz_clear(t1);
-
+  compute_s (k ,(ecm_uint) B1 ,NULL);
 }
 
 
@@ -194,7 +46,7 @@ void mpalgpol_clear (mpalgpol_t pol, mpmod_t n) {
 }
 
 // give the gcd of aP[i] with n
-void mpalgres_gcd (mpz_t aF[DEGREE_ALGEBRA], mpalgres_t aP, mpmod_t n) {
+void mpalgres_gcd (mpz_t *aF, mpalgres_ptr aP, mpmod_t n) {
   int i;
 
   for (i=0; i< DEGREE_ALGEBRA; i++) {
@@ -205,7 +57,7 @@ void mpalgres_gcd (mpz_t aF[DEGREE_ALGEBRA], mpalgres_t aP, mpmod_t n) {
 
 
 
-void mpalgres_init (mpalgres_t aP, mpmod_t n) {
+void mpalgres_init (mpalgres_ptr aP, mpmod_t n) {
   int i;
 
   for (i=0; i< DEGREE_ALGEBRA; i++) {
@@ -213,7 +65,7 @@ void mpalgres_init (mpalgres_t aP, mpmod_t n) {
   }
 }
 
-void mpalgres_clear (mpalgres_t aP, mpmod_t n) {
+void mpalgres_clear (mpalgres_ptr aP, mpmod_t n) {
   int i;
 
   for (i=0; i< DEGREE_ALGEBRA; i++) {
@@ -222,14 +74,14 @@ void mpalgres_clear (mpalgres_t aP, mpmod_t n) {
 }
 
 /* aR <- aP */
-void mpalgres_set (mpalgres_t aR, mpalgres_t aP,mpmod_t n) {
+void mpalgres_set (mpalgres_ptr aR, mpalgres_ptr aP,ATTRIBUTE_UNUSED mpmod_t n) {
   int i;
   for (i=0;i<DEGREE_ALGEBRA;i++) {
     mpz_set (aR[i],aP[i]);
   }
 }
 
-void mpalgres_set_zero (mpalgres_t aP,mpmod_t n) {
+void mpalgres_set_zero (mpalgres_ptr aP,mpmod_t n) {
   int i;
   for (i=0;i<DEGREE_ALGEBRA;i++) {
     mpres_set_ui (aP[i],0,n);
@@ -239,7 +91,7 @@ void mpalgres_set_zero (mpalgres_t aP,mpmod_t n) {
 /* aP <- u mod n
    i.e. aP[0] <- u mod n   aP[i]<- 0
  */
-void mpalgres_set_ui (mpalgres_t aP,unsigned long u,mpmod_t n) {
+void mpalgres_set_ui (mpalgres_ptr aP,unsigned long u,mpmod_t n) {
   mpalgres_set_zero(aP,n);
   mpres_set_ui (aP[0] ,u ,n);
 }   
@@ -249,7 +101,7 @@ void mpalgres_set_ui (mpalgres_t aP,unsigned long u,mpmod_t n) {
 /* aP <- p 
    i.e. aP[0] <- p   aP[i]<- 0
  */
-void mpalgres_set_mpres (mpalgres_t aP,mpres_t p,mpmod_t n) {
+void mpalgres_set_mpres (mpalgres_ptr aP,mpres_t p,mpmod_t n) {
   mpalgres_set_zero(aP,n);
   mpz_set (aP[0] ,p);
 }
@@ -257,7 +109,7 @@ void mpalgres_set_mpres (mpalgres_t aP,mpres_t p,mpmod_t n) {
 
 
 
-int mpalgres_is_zero (mpalgres_t aP ,mpalgpol_t pol ,mpmod_t n) {
+int mpalgres_is_zero (mpalgres_ptr aP ,ATTRIBUTE_UNUSED mpalgpol_t pol ,mpmod_t n) {
   int test=1;
   int i;
   for (i=0; i<DEGREE_ALGEBRA;i++) {
@@ -268,7 +120,7 @@ int mpalgres_is_zero (mpalgres_t aP ,mpalgpol_t pol ,mpmod_t n) {
 
 /*  return the degree of the element aP 
     if aP=0 return -1 */
-int mpalgres_degree (mpalgres_t aP ,mpalgpol_t pol ,mpmod_t n) {
+int mpalgres_degree (mpalgres_ptr aP ,ATTRIBUTE_UNUSED mpalgpol_t pol ,mpmod_t n) {
   int i=DEGREE_ALGEBRA-1;
   while (i>=0 && mpres_is_zero(aP[i],n)) {
     i--;
@@ -278,7 +130,7 @@ int mpalgres_degree (mpalgres_t aP ,mpalgpol_t pol ,mpmod_t n) {
 
 
 /*  aR <- -aP  */
-void mpalgres_neg (mpalgres_t aR, mpalgres_t aP, mpalgpol_t pol, mpmod_t n) {
+void mpalgres_neg (mpalgres_ptr aR, mpalgres_ptr aP, ATTRIBUTE_UNUSED mpalgpol_t pol, mpmod_t n) {
   int i;
   for (i=0; i<DEGREE_ALGEBRA; i++) {
     mpres_neg (aR[i],aP[i],n);
@@ -288,7 +140,7 @@ void mpalgres_neg (mpalgres_t aR, mpalgres_t aP, mpalgpol_t pol, mpmod_t n) {
 /*  aR <- -aP*u mod n
     i.e.  aR[i] <- aP[i]*u mod n
   */
-void mpalgres_mul_ui (mpalgres_t aR, mpalgres_t aP, unsigned long u, mpalgpol_t pol, mpmod_t n) {
+void mpalgres_mul_ui (mpalgres_ptr aR, mpalgres_ptr aP, unsigned long u, ATTRIBUTE_UNUSED mpalgpol_t pol, mpmod_t n) {
   int i;
   for (i=0; i<DEGREE_ALGEBRA; i++) {
     mpres_mul_ui (aR[i],aP[i],u,n);
@@ -298,44 +150,44 @@ void mpalgres_mul_ui (mpalgres_t aR, mpalgres_t aP, unsigned long u, mpalgpol_t
 /*  aR <- -aP*p mod n
     i.e.  aR[i] <- aP[i]*p mod n
   */
-void mpalgres_mul_mpres (mpalgres_t aR, mpalgres_t aP, mpres_t p, mpalgpol_t pol, mpmod_t n) {
+void mpalgres_mul_mpres (mpalgres_ptr aR, mpalgres_ptr aP, mpres_t p, ATTRIBUTE_UNUSED mpalgpol_t pol, mpmod_t n) {
   int i;
   for (i=0; i<DEGREE_ALGEBRA; i++) {
     mpres_mul (aR[i],aP[i],p,n);
   }
 }
 
-void mpalgres_add (mpalgres_t aR, mpalgres_t aP, mpalgres_t aQ, mpalgpol_t pol, mpmod_t n) {
+void mpalgres_add (mpalgres_ptr aR, mpalgres_ptr aP, mpalgres_ptr aQ, ATTRIBUTE_UNUSED mpalgpol_t pol, mpmod_t n) {
   int i;
   for (i=0; i<DEGREE_ALGEBRA; i++) {
     mpres_add (aR[i],aP[i],aQ[i],n);
   }
 }
 
-void mpalgres_sub (mpalgres_t aR, mpalgres_t aP, mpalgres_t aQ, mpalgpol_t pol, mpmod_t n) {
+void mpalgres_sub (mpalgres_ptr aR, mpalgres_ptr aP, mpalgres_ptr aQ, ATTRIBUTE_UNUSED mpalgpol_t pol, mpmod_t n) {
   int i;
   for (i=0; i<DEGREE_ALGEBRA; i++) {
     mpres_sub (aR[i],aP[i],aQ[i],n);
   }
 }
 
-void mpalgres_add_mpres (mpalgres_t aR, mpalgres_t aP, mpres_t q, mpalgpol_t pol, mpmod_t n) {
+void mpalgres_add_mpres (mpalgres_ptr aR, mpalgres_ptr aP, mpres_t q, ATTRIBUTE_UNUSED mpalgpol_t pol, mpmod_t n) {
   mpalgres_set (aR,aP,n);
   mpres_add (aR[0] ,aR[0] ,q ,n);
 }
 
-void mpalgres_sub_mpres (mpalgres_t aR, mpalgres_t aP, mpres_t q, mpalgpol_t pol, mpmod_t n) {
+void mpalgres_sub_mpres (mpalgres_ptr aR, mpalgres_ptr aP, mpres_t q, ATTRIBUTE_UNUSED mpalgpol_t pol, mpmod_t n) {
   mpalgres_set (aR,aP,n);
   mpres_sub (aR[0] ,aR[0] ,q ,n);
 
 }
 
-void mpalgres_add_ui (mpalgres_t aR, mpalgres_t aP, unsigned long u, mpalgpol_t pol, mpmod_t n) {
+void mpalgres_add_ui (mpalgres_ptr aR, mpalgres_ptr aP, unsigned long u, ATTRIBUTE_UNUSED mpalgpol_t pol, mpmod_t n) {
   mpalgres_set (aR,aP,n);
   mpres_add_ui (aR[0] ,aR[0] ,u ,n);
 }
 
-void mpalgres_sub_ui (mpalgres_t aR, mpalgres_t aP, unsigned long u, mpalgpol_t pol, mpmod_t n) {
+void mpalgres_sub_ui (mpalgres_ptr aR, mpalgres_ptr aP, unsigned long u, ATTRIBUTE_UNUSED mpalgpol_t pol, mpmod_t n) {
   mpalgres_set (aR,aP,n);
   mpres_sub_ui (aR[0] ,aR[0] ,u ,n);
 }
@@ -344,7 +196,7 @@ void mpalgres_sub_ui (mpalgres_t aR, mpalgres_t aP, unsigned long u, mpalgpol_t
 
 
 /* multiplication by X */
-static void mpalgres_shift (mpalgres_t aR, mpalgres_t aP,
+static void mpalgres_shift (mpalgres_ptr aR, mpalgres_ptr aP,
 			    mpalgpol_t pol, mpmod_t n) {
   int i;
 
@@ -359,7 +211,7 @@ static void mpalgres_shift (mpalgres_t aR, mpalgres_t aP,
 }
 
 /* aR <- aP*aQ */
-void mpalgres_mul (mpalgres_t aR, mpalgres_t aP, mpalgres_t aQ,
+void mpalgres_mul (mpalgres_ptr aR, mpalgres_ptr aP, mpalgres_ptr aQ,
 		   mpalgpol_t pol, mpmod_t n) {
   int i;
 
@@ -400,7 +252,7 @@ void mpalgres_mul (mpalgres_t aR, mpalgres_t aP, mpalgres_t aQ,
 
 
 */
-int mpalgres_invert (mpalgres_t aV, mpalgres_t aQ,
+int mpalgres_invert (mpalgres_ptr aV, mpalgres_ptr aQ,
 		     mpalgpol_t pol, mpmod_t n, mpz_t f) {
 
   mpres_t temp;
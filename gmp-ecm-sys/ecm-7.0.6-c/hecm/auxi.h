@@ -3,12 +3,7 @@
 
 #include "../ecm-impl.h"
 
-void prodTreeCalculkPlus (mpz_t k,double B1);
-void prodTreeCalculkInterPlus (mpz_t Pr,double B1, int n, int* pstop);
-
-void calculk (mpz_t k,double B1);
 void prodTreeCalculk (mpz_t k,double B1);
-void prodTreeCalculkInter (mpz_t Pr,double B1, int n, int* pstop);
 
 
 
@@ -25,6 +20,9 @@ void prodTreeCalculkInter (mpz_t Pr,double B1, int n, int* pstop);
                         
 
 typedef mpres_t mpalgres_t[DEGREE_ALGEBRA];
+/* mpalgres_t as a function parameter: declared as a pointer, so that the
+   compiler does not check its accesses against the size of mpalgres_t */
+typedef mpres_t *mpalgres_ptr;
 
 // polynomial for creating the algebra K[x]/P(x)
 struct mpalgpol
@@ -41,36 +39,36 @@ void mpalgpol_init (mpalgpol_t, mpmod_t);
 void mpalgpol_clear (mpalgpol_t, mpmod_t);
 
 
-void mpalgres_init (mpalgres_t, mpmod_t);
-void mpalgres_clear (mpalgres_t, mpmod_t);
+void mpalgres_init (mpalgres_ptr, mpmod_t);
+void mpalgres_clear (mpalgres_ptr, mpmod_t);
 
-void mpalgres_gcd (mpalgres_t, mpalgres_t, mpmod_t);
+void mpalgres_gcd (mpalgres_ptr, mpalgres_ptr, mpmod_t);
 
 
-void mpalgres_set (mpalgres_t, mpalgres_t ,mpmod_t );
-void mpalgres_set_zero (mpalgres_t ,mpmod_t );
-void mpalgres_set_ui (mpalgres_t ,unsigned long ,mpmod_t );
-void mpalgres_set_mpres (mpalgres_t ,mpres_t ,mpmod_t );
+void mpalgres_set (mpalgres_ptr, mpalgres_ptr ,mpmod_t );
+void mpalgres_set_zero (mpalgres_ptr ,mpmod_t );
+void mpalgres_set_ui (mpalgres_ptr ,unsigned long ,mpmod_t );
+void mpalgres_set_mpres (mpalgres_ptr ,mpres_t ,mpmod_t );
 
-int mpalgres_is_zero (mpalgres_t ,mpalgpol_t ,mpmod_t);
-int mpalgres_degree (mpalgres_t ,mpalgpol_t, mpmod_t);
+int mpalgres_is_zero (mpalgres_ptr ,mpalgpol_t ,mpmod_t);
+int mpalgres_degree (mpalgres_ptr ,mpalgpol_t, mpmod_t);
 
-void mpalgres_neg (mpalgres_t, mpalgres_t, mpalgpol_t, mpmod_t);
+void mpalgres_neg (mpalgres_ptr, mpalgres_ptr, mpalgpol_t, mpmod_t);
 
-int mpalgres_invert (mpalgres_t, mpalgres_t, mpalgpol_t ,mpmod_t, mpz_t);
+int mpalgres_invert (mpalgres_ptr, mpalgres_ptr, mpalgpol_t ,mpmod_t, mpz_t);
 
-void mpalgres_mul (mpalgres_t, mpalgres_t, mpalgres_t, mpalgpol_t, mpmod_t);
-void mpalgres_add (mpalgres_t, mpalgres_t, mpalgres_t, mpalgpol_t, mpmod_t);
-void mpalgres_sub (mpalgres_t, mpalgres_t, mpalgres_t, mpalgpol_t, mpmod_t);
+void mpalgres_mul (mpalgres_ptr, mpalgres_ptr, mpalgres_ptr, mpalgpol_t, mpmod_t);
+void mpalgres_add (mpalgres_ptr, mpalgres_ptr, mpalgres_ptr, mpalgpol_t, mpmod_t);
+void mpalgres_sub (mpalgres_ptr, mpalgres_ptr, mpalgres_ptr, mpalgpol_t, mpmod_t);
 
 
-void mpalgres_mul_ui (mpalgres_t, mpalgres_t, unsigned long,mpalgpol_t,mpmod_t);
-void mpalgres_mul_mpres (mpalgres_t, mpalgres_t, mpres_t, mpalgpol_t, mpmod_t);
+void mpalgres_mul_ui (mpalgres_ptr, mpalgres_ptr, unsigned long,mpalgpol_t,mpmod_t);
+void mpalgres_mul_mpres (mpalgres_ptr, mpalgres_ptr, mpres_t, mpalgpol_t, mpmod_t);
 
-void mpalgres_add_mpres (mpalgres_t, mpalgres_t, mpres_t, mpalgpol_t, mpmod_t);
-void mpalgres_sub_mpres (mpalgres_t, mpalgres_t, mpres_t, mpalgpol_t, mpmod_t);
-void mpalgres_add_ui (mpalgres_t, mpalgres_t, unsigned long,mpalgpol_t,mpmod_t);
-void mpalgres_sub_ui (mpalgres_t, mpalgres_t, unsigned long,mpalgpol_t,mpmod_t);
+void mpalgres_add_mpres (mpalgres_ptr, mpalgres_ptr, mpres_t, mpalgpol_t, mpmod_t);
+void mpalgres_sub_mpres (mpalgres_ptr, mpalgres_ptr, mpres_t, mpalgpol_t, mpmod_t);
+void mpalgres_add_ui (mpalgres_ptr, mpalgres_ptr, unsigned long,mpalgpol_t,mpmod_t);
+void mpalgres_sub_ui (mpalgres_ptr, mpalgres_ptr, unsigned long,mpalgpol_t,mpmod_t);
 
 
 
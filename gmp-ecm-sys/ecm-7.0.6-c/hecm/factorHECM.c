@@ -0,0 +1,223 @@
+#include <limits.h>
+#include <math.h>
+
+#include "../ecm-impl.h"
+
+#include "hecm.h"
+#include "auxi.h"
+#include "generation.h"
+#include "morphismes.h"
+
+
+
+void optionsHECM_init (optionsHECM options) {
+  mpz_init (options->heightMin);
+  mpz_init (options->heightMax);
+
+  options->smallParam = TRUE;
+  options->curveSpecified = FALSE;
+  options->initialCurveSpecified = FALSE;
+  options->verbose = OUTPUT_NORMAL;
+
+  options->nbtests = 1;
+  mpz_set_ui (options->heightMin,0);
+  mpz_set_ui (options->heightMax,0);
+  options->rng = NULL;
+}
+
+
+void optionsHECM_clear (optionsHECM options) {
+  mpz_clear (options->heightMin);
+  mpz_clear (options->heightMax);
+}
+
+
+
+
+/*
+  Bound on a and b for the small parameters s=a/b with nJacobi=2
+  (same bound as in nextParam)
+*/
+static unsigned long hecm_small_height () {
+  unsigned long H;
+  mpz_t t;
+
+  mpz_init_set_ui (t ,LONG_MAX);
+  mpz_mul_ui (t ,t ,4);
+  mpz_root (t ,t ,5);
+  H = mpz_get_ui (t);
+  mpz_clear (t);
+
+  return H;
+}
+
+
+/*
+  Read s=a/b from sigma = a + HECM_SIGMA_BASE*b, or choose it at random
+  with a, b <= HECM_RANDOM_HEIGHT (and put it in sigma) when sigma=0.
+  Return 0 if sigma does not give small parameters.
+*/
+static int hecm_small_param (paraGenCurve para, mpz_t sigma,
+			     unsigned long H, gmp_randstate_t rng) {
+  mpz_t g;
+  int ok;
+
+  if (mpz_sgn (sigma) == 0) {
+    // the constants of most curves with larger a, b do not fit in long
+    H = MIN (H ,HECM_RANDOM_HEIGHT);
+    mpz_init (g);
+    do {
+      mpz_set_ui (para->a ,gmp_urandomm_ui (rng ,H) + 1);
+      mpz_set_ui (para->b ,gmp_urandomm_ui (rng ,H) + 1);
+      mpz_gcd (g ,para->a ,para->b);
+    } while ( mpz_cmp_ui (g,1) != 0 );
+    mpz_clear (g);
+    mpz_mul_ui (sigma ,para->b ,HECM_SIGMA_BASE);
+    mpz_add (sigma ,sigma ,para->a);
+    return 1;
+  }
+
+  mpz_fdiv_qr_ui (para->b ,para->a ,sigma ,HECM_SIGMA_BASE);
+  if ( mpz_sgn (para->a) <= 0 || mpz_cmp_ui (para->a,H) > 0 ||
+       mpz_sgn (para->b) <= 0 || mpz_cmp_ui (para->b,H) > 0 )
+    return 0;
+
+  mpz_init (g);
+  mpz_gcd (g ,para->a ,para->b);
+  ok = ( mpz_cmp_ui (g,1) == 0 );
+  mpz_clear (g);
+
+  return ok;
+}
+
+
+
+
+/*
+  HECM with one hyperelliptic curve, i.e. two elliptic curves.
+  Stage 1 is done on the Kummer surface of the genus 2 curve with small
+  parameters s=a/b (nJacobi=2) given by p->sigma (random if 0), stage 2
+  is the ECM stage 2 on the two elliptic curves in Weierstrass form.
+  Return ECM_FACTOR_FOUND_STEP1 or ECM_FACTOR_FOUND_STEP2 with f the
+  factor (possibly n), ECM_NO_FACTOR_FOUND or ECM_ERROR.
+*/
+int hecm (mpz_t f, mpz_t n, double B1, ecm_params p) {
+  int youpi = ECM_NO_FACTOR_FOUND;
+  int test = HECM_GENERATION_FAIL;
+  int random_sigma, tries;
+  unsigned long H;
+  long st;
+  mpmod_t modulus;
+  paraGenCurve para;
+  optionsHECM options;
+  curve T1,T2;
+  mpz_t B2min,B2;
+
+  set_verbose (p->verbose);
+  ECM_STDOUT = (p->os == NULL) ? stdout : p->os;
+  ECM_STDERR = (p->es == NULL) ? stdout : p->es;
+
+  random_sigma = ( mpz_sgn (p->sigma) == 0 );
+  if (random_sigma)
+    init_randstate (p->rng);
+  H = hecm_small_height ();
+
+  mpmod_init (modulus ,n ,p->repr);
+  paraGenCurve_init (para ,modulus);
+  optionsHECM_init (options);
+  options->curveSpecified = TRUE;
+  options->rng = p->rng;
+  mpz_set_ui (options->heightMax ,H);
+
+  mpres_init (T1.x ,modulus);
+  mpres_init (T1.y ,modulus);
+  mpres_init (T1.A ,modulus);
+  mpres_init (T2.x ,modulus);
+  mpres_init (T2.y ,modulus);
+  mpres_init (T2.A ,modulus);
+
+  mpz_init_set (B2 ,p->B2);
+  if (ECM_IS_DEFAULT_B2 (B2))
+    mpz_set_d (B2 ,pow (ECM_COST * B1 ,DEFAULT_B2_EXPONENT));
+  mpz_init_set (B2min ,p->B2min);
+  if (mpz_sgn (B2min) < 0)
+    mpz_set_d (B2min ,B1);
+
+  st = cputime ();
+
+  // k=lcm(2,..,B1), kept in p->batch_s for the next runs like in batch mode
+  if (B1 != p->batch_last_B1_used || mpz_cmp_ui (p->batch_s ,1) <= 0) {
+    p->batch_last_B1_used = B1;
+    prodTreeCalculk (p->batch_s ,B1);
+  }
+
+  // stage 1, with other random parameters if the generation fails
+  for (tries = 0; tries < 16 && test == HECM_GENERATION_FAIL; tries++) {
+    if (random_sigma)
+      mpz_set_ui (p->sigma ,0);
+    if (hecm_small_param (para ,p->sigma ,H ,p->rng) == 0) {
+      outputf (OUTPUT_ERROR ,"Error, HECM parameter %Zd does not give "
+	       "s=a/b with 1 <= a, b <= %lu coprime\n" ,p->sigma ,H);
+      test = HECM_ERROR;
+      break;
+    }
+    para->nJacobi = 2;
+
+    test = hecm1LowParam (f ,modulus ,p->batch_s ,para ,&T1 ,&T2 ,options);
+    if (!random_sigma)
+      break;
+  }
+  if (test == HECM_GENERATION_FAIL)
+    outputf (OUTPUT_ERROR ,"Error, no HECM curve for s=%Zd/%Zd\n" ,
+	     para->a ,para->b);
+
+  outputf (OUTPUT_NORMAL ,"Using B1=%1.0f, B2=%Zd, HECM s=%Zd/%Zd "
+	   "(sigma=%Zd)\n" ,B1 ,B2 ,para->a ,para->b ,p->sigma);
+  outputf (OUTPUT_NORMAL ,"Step 1 took %ldms\n" ,elltime (st ,cputime ()));
+
+  if (test == HECM_NO_FACTOR_FOUND && mpz_cmp (B2 ,B2min) >= 0) {
+    if (p->stop_asap == NULL || !(*p->stop_asap) ()) {
+      st = cputime ();
+      test = hecm2 (f ,modulus ,&T1 ,&T2 ,B1 ,B2 ,p);
+      set_verbose (p->verbose); // changed by the stage 2 of each curve
+      outputf (OUTPUT_NORMAL ,"Step 2 took %ldms\n" ,elltime (st ,cputime ()));
+      if (test == HECM_FACTOR_FOUND_STEP2)
+	youpi = ECM_FACTOR_FOUND_STEP2;
+      else if (test == HECM_FOUND_ZERO_CURVE_1 ||
+	       test == HECM_FOUND_ZERO_CURVE_2) {
+	mpz_set (f ,n);
+	youpi = ECM_FACTOR_FOUND_STEP2;
+      }
+      else if (test == HECM_ERROR)
+	youpi = ECM_ERROR;
+    }
+  }
+  else if (test == HECM_FACTOR_FOUND_GENERATION ||
+	   test == HECM_FACTOR_FOUND_MORPHISM ||
+	   test == HECM_FACTOR_FOUND_STEP1)
+    youpi = ECM_FACTOR_FOUND_STEP1;
+  else if (test == HECM_FOUND_N ||
+	   test == HECM_FOUND_ZERO_CURVE_1 ||
+	   test == HECM_FOUND_ZERO_CURVE_2 ||
+	   test == HECM_FOUND_ZERO_CURVE_1_AND_2) {
+    // k*P is zero modulo all the factors of n
+    mpz_set (f ,n);
+    youpi = ECM_FACTOR_FOUND_STEP1;
+  }
+  else if (test != HECM_NO_FACTOR_FOUND)
+    youpi = ECM_ERROR;
+
+  mpz_clear (B2min);
+  mpz_clear (B2);
+  mpres_clear (T1.x ,modulus);
+  mpres_clear (T1.y ,modulus);
+  mpres_clear (T1.A ,modulus);
+  mpres_clear (T2.x ,modulus);
+  mpres_clear (T2.y ,modulus);
+  mpres_clear (T2.A ,modulus);
+  optionsHECM_clear (options);
+  paraGenCurve_clear (para ,modulus);
+  mpmod_clear (modulus);
+
+  return youpi;
+}
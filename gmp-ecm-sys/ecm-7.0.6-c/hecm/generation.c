@@ -1615,7 +1615,7 @@ int nextSmallParam (mpz_t a, mpz_t b,
 
 
 
-int nextParam (mpz_t f,mpmod_t n,
+int nextParam (ATTRIBUTE_UNUSED mpz_t f,mpmod_t n,
 	       paraGenCurve para,
 	       optionsHECM options) {
   int test;
@@ -1681,9 +1681,28 @@ int nextParam (mpz_t f,mpmod_t n,
     }
   }
   else { // (options->smallParam == FALSE )
-    para->nJacobi = (rand() % (N_JACOBI_MAX_p1 - N_JACOBI_MIN)) + N_JACOBI_MIN;
+    para->nJacobi = randomNJacobi (options);
     mpres_add_ui (para->s ,para->s ,1 ,n);
     return NEXT_PARAM_CAN_BE_USED;
   }
 
 }
+
+
+
+/*
+  N_JACOBI_MIN <= nJacobi < N_JACOBI_MAX_p1 random
+  Use options->rng when it is set, so that several threads can generate
+  curves at the same time. Otherwise rand() (standalone program).
+*/
+int randomNJacobi (optionsHECM options) {
+  unsigned long r;
+
+  if (options->rng != NULL) {
+    r = gmp_urandomm_ui (options->rng ,N_JACOBI_MAX_p1 - N_JACOBI_MIN);
+  }
+  else {
+    r = rand() % (N_JACOBI_MAX_p1 - N_JACOBI_MIN);
+  }
+  return (int) r + N_JACOBI_MIN;
+}
@@ -111,5 +111,7 @@ int nextSmallParam (mpz_t a, mpz_t b,const long Ha,const long Hb);
 
 int nextParam (mpz_t f,mpmod_t n,paraGenCurve para,optionsHECM options);
 
+int randomNJacobi (optionsHECM options);
+
 
 #endif
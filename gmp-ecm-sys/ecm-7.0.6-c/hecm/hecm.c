@@ -14,27 +14,6 @@
 
 
 
-void optionsHECM_init (optionsHECM options) {
-  mpz_init (options->heightMin);
-  mpz_init (options->heightMax);
-
-  options->smallParam = TRUE;
-  options->curveSpecified = FALSE;
-  options->initialCurveSpecified = FALSE;
-  options->verbose = OUTPUT_NORMAL;
-
-  options->nbtests = 1;
-  mpz_set_ui (options->heightMin,0);
-  mpz_set_ui (options->heightMax,0);
-}
-
-
-void optionsHECM_clear (optionsHECM options) {
-  mpz_clear (options->heightMin);
-  mpz_clear (options->heightMax);
-}
-
-
 void printCurve (paraGenCurve para,optionsHECM options,mpmod_t n) {
   mpz_t s;
   mpz_init (s);
@@ -370,7 +349,7 @@ int main(int argc, char * argv[]) {
 	return 0;
       }
 
-      para->nJacobi= (rand() % (N_JACOBI_MAX_p1 - N_JACOBI_MIN)) + N_JACOBI_MIN;
+      para->nJacobi = randomNJacobi (options);
       // TODO
       if ( mpz_cmp_ui (options->heightMin,3) < 0 ) {
 	mpres_set_ui (para->s ,3 ,n);
@@ -407,7 +386,6 @@ int main(int argc, char * argv[]) {
 
   mpz_init(k);
   prodTreeCalculk(k,B1); // k=lcm(2,3,..,B1)
-  getprime_clear ();
 
 
 
@@ -453,7 +431,7 @@ int main(int argc, char * argv[]) {
 
 
     // stage 2
-    test = hecm2 (f,n,&T1,&T2,B2);
+    test = hecm2 (f,n,&T1,&T2,B1,B2,NULL);
     if (test != HECM_NO_FACTOR_FOUND) {
       break;
     }
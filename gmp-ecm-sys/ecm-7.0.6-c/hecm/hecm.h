@@ -16,6 +16,11 @@
 #define HECM_GENERATION_FAIL 8
 #define HECM_PARAM_TOO_BIG 9
 
+/* for the library, sigma = a + HECM_SIGMA_BASE*b gives s=a/b */
+#define HECM_SIGMA_BASE 65536
+/* bound on a and b for the random s in the library */
+#define HECM_RANDOM_HEIGHT 256
+
 #define TRUE 1
 #define FALSE 0
 
@@ -28,12 +33,16 @@ struct optionsHECM_s {
   unsigned int nbtests;       // number of tests to do
   mpz_t heightMin;            // minimal height for the parameters
   mpz_t heightMax;            // maximal height for the parameters
+  __gmp_randstate_struct *rng; // random source (rand() if NULL)
 };
 typedef struct optionsHECM_s optionsHECM[1];
 
 void optionsHECM_init (optionsHECM options);
 void optionsHECM_clear (optionsHECM options);
 
+/* library entry, called by ecm_factor for ECM_HECM */
+int hecm (mpz_t f, mpz_t n, double B1, ecm_params p);
+
 #include "generation.h"
 
 /* stage 1 */
@@ -41,8 +50,8 @@ int hecm1Normal (mpz_t f ,mpmod_t n ,mpz_t k ,paraGenCurve para ,curve *T1,curve
 int hecm1LowParam (mpz_t f ,mpmod_t n ,mpz_t k ,paraGenCurve para ,curve *T1,curve *T2,optionsHECM options);
 
 /* stage 2 */
-int ecmfactor2 (mpz_t f, mpz_t n, mpz_t A, mpz_t x, mpz_t y, mpz_t B2);
-int hecm2 (mpz_t f, mpmod_t n, curve* T1, curve* T2, mpz_t B2);
+int ecmfactor2 (mpz_t f, mpz_t n, mpz_t A, mpz_t x, mpz_t y, double B1, mpz_t B2, ecm_params p);
+int hecm2 (mpz_t f, mpmod_t n, curve* T1, curve* T2, double B1, mpz_t B2, ecm_params p);
 
 
 
@@ -755,7 +755,7 @@ int jac_to_EllW_Degree1 (mpz_t f, mpmod_t n,
     phi((x1,0)) zero or of 2-torsion.
   We compute 2*phi((x2,y2)) and obtain a multiple of the point
  */
-int degree2_case_y1_equal_zero (mpz_t f,mpmod_t n,curve *T1, curve *T2,DivMumfordU divU, DivMumfordV divV, curveHyperEll cHEll) {
+int degree2_case_y1_equal_zero (mpz_t f,mpmod_t n,curve *T1, curve *T2,DivMumfordU divU, ATTRIBUTE_UNUSED DivMumfordV divV, curveHyperEll cHEll) {
   
   int test;
   mpres_t t1,t2;
@@ -49,7 +49,7 @@ int hecm1Normal (mpz_t f,mpmod_t n,
   // generate the curve
   if (options->curveSpecified == TRUE) { // we want fixed s or nJacobi 
     if (para->nJacobi == 0) {
-      para->nJacobi = (rand()%(N_JACOBI_MAX_p1-N_JACOBI_MIN))+N_JACOBI_MIN;
+      para->nJacobi = randomNJacobi (options);
     }
     
     test = generateNormalCurveSpecified(f,n,para,th,cHEll,P,cMul);
@@ -1,16 +1,20 @@
 #include "../ecm-impl.h"
-#include "../ecm.h"
 
 #include "hecm.h"
 
 /* wrapper for GMP-ECM stage2 for a curve in Weierstrass form
 
-   y^2 = x^2 + A * x + B
+   y^2 = x^3 + A * x + B
 
-   where B is implicitly defined by y^2 - (x^2 + A * x) mod n.
+   where B is implicitly defined by y^2 - (x^3 + A * x) mod n.
+
+   The point is taken as the result of stage 1 up to B1, so that stage 2
+   covers [B1, B2] by default. The stage 2 options (B2min, k, S, ...) are
+   taken from p if not NULL.
 */
 int
-ecmfactor2 (mpz_t f, mpz_t n, mpz_t A, mpz_t x, mpz_t y, mpz_t B2)
+ecmfactor2 (mpz_t f, mpz_t n, mpz_t A, mpz_t x, mpz_t y, double B1,
+            mpz_t B2, ecm_params p)
 {
   ecm_params q;
   int res;
@@ -18,12 +22,38 @@ ecmfactor2 (mpz_t f, mpz_t n, mpz_t A, mpz_t x, mpz_t y, mpz_t B2)
   ecm_init (q);
 
   q->sigma_is_A = -1; // indicates that we give a curve in Weierstrass form 
+  q->param = ECM_PARAM_WEIERSTRASS;
   mpz_set (q->sigma, A);
   mpz_set (q->x, x);
-  mpz_set (q->go, y);
+  mpz_set (q->y, y);
+
+  // same curve as with -param 5 in main.c: B = y^2 - (x^2 + A) * x
+  mpz_mul (q->E->a6, y, y);
+  mpz_mul (q->E->a4, x, x);
+  mpz_add (q->E->a4, q->E->a4, A);
+  mpz_mul (q->E->a4, q->E->a4, x);
+  mpz_sub (q->E->a6, q->E->a6, q->E->a4);
+  mpz_mod (q->E->a6, q->E->a6, n);
+  mpz_set (q->E->a4, A);
+  q->E->type = ECM_EC_TYPE_WEIERSTRASS;
+  q->E->law = ECM_LAW_HOMOGENEOUS;
   mpz_set (q->B2, B2);
+  q->B1done = B1;
+  if (p != NULL) {
+    mpz_set (q->B2min, p->B2min);
+    q->k = p->k;
+    q->S = p->S;
+    q->repr = p->repr;
+    q->nobase2step2 = p->nobase2step2;
+    q->use_ntt = p->use_ntt;
+    q->maxmem = p->maxmem;
+    q->TreeFilename = p->TreeFilename;
+    q->stop_asap = p->stop_asap;
+    q->os = p->os;
+    q->es = p->es;
+  }
 
-  res = ecm_factor (f, n, 0.0, q);
+  res = ecm_factor (f, n, B1, q);
 
   ecm_clear (q);
 
@@ -32,7 +62,8 @@ ecmfactor2 (mpz_t f, mpz_t n, mpz_t A, mpz_t x, mpz_t y, mpz_t B2)
 
 
 
-int hecm2 (mpz_t f, mpmod_t n, curve* T1, curve* T2, mpz_t B2) {
+int hecm2 (mpz_t f, mpmod_t n, curve* T1, curve* T2, double B1, mpz_t B2,
+	   ecm_params p) {
   int test;
   mpres_t g;
   mpz_t x,y,A;
@@ -47,10 +78,17 @@ int hecm2 (mpz_t f, mpmod_t n, curve* T1, curve* T2, mpz_t B2) {
   mpres_get_z (A,T1->A,n);
   mpres_get_z (x,T1->x,n);
   mpres_get_z (y,T1->y,n);
-  test = ecmfactor2 (f, n->orig_modulus, A, x, y, B2);
+  test = ecmfactor2 (f, n->orig_modulus, A, x, y, B1, B2, p);
   mpres_set_z (g,f,n);
   
-  if (test != ECM_NO_FACTOR_FOUND) {
+  if (ECM_ERROR_P (test)) {
+    mpres_clear (g,n);
+    mpz_clear(x);
+    mpz_clear(y);
+    mpz_clear(A);
+    return HECM_ERROR;
+  }
+  else if (test != ECM_NO_FACTOR_FOUND) {
     if (  mpres_is_zero(g,n) == 1 ) { // f=0. 
       mpres_clear (g,n);
       mpz_clear(x);
@@ -71,10 +109,17 @@ int hecm2 (mpz_t f, mpmod_t n, curve* T1, curve* T2, mpz_t B2) {
   mpres_get_z (x,T2->x,n);
   mpres_get_z (y,T2->y,n);
   // stage 2 for the second elliptic curve
-  test = ecmfactor2 (f, n->orig_modulus, A, x, y, B2);
+  test = ecmfactor2 (f, n->orig_modulus, A, x, y, B1, B2, p);
   mpres_set_z (g,f,n);
   
-  if (test != ECM_NO_FACTOR_FOUND) {
+  if (ECM_ERROR_P (test)) {
+    mpres_clear (g,n);
+    mpz_clear(x);
+    mpz_clear(y);
+    mpz_clear(A);
+    return HECM_ERROR;
+  }
+  else if (test != ECM_NO_FACTOR_FOUND) {
     if (  mpres_is_zero(g,n) == 1 ) { // f=0. 
       mpres_clear (g,n);
       mpz_clear(x);
@@ -21,7 +21,19 @@ http://www.gnu.org/licenses/ or write to the Free Software Foundation, Inc.,
 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA. */
 
 #include <stdlib.h>
+#include <string.h>
 #include "ecm-impl.h"
+#include "ecm-gmp.h"
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP) && defined(HAVE_FTRUNCATE) \
+    && defined(HAVE_UNISTD_H) && defined(HAVE_FCNTL_H)
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define TREEFILE_USE_MMAP
+#endif
 
 #ifdef DEBUG
 #define ASSERTD(x) assert(x)
@@ -144,6 +156,321 @@ list_out_raw (FILE *f, listz_t a, unsigned int n)
   return 0;
 }
 
+/* Tree files: the product tree of F written to disk in stage 2 
+   (-treefile). All levels share a single file, level i holding up to len 
+   residues in [0, modulus] of stride limbs each at limb offset 
+   i * len * stride. Each level is written and read back sequentially, in 
+   the same order. Where possible the file is memory-mapped, so that reading 
+   a level costs no more than pointing mpz_t's at the mapping. */
+
+/* The last mapped tree file closed is kept, so that the next stage 2 using 
+   the same file name reuses it instead of creating a new file. It is freed
+   when a tree file of another name is opened, or by treefile_clear(). */
+static treefile_t treefile_cache = NULL;
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t treefile_lock = PTHREAD_MUTEX_INITIALIZER;
+#define TREEFILE_LOCK() pthread_mutex_lock (&treefile_lock)
+#define TREEFILE_UNLOCK() pthread_mutex_unlock (&treefile_lock)
+#else
+#define TREEFILE_LOCK()
+#define TREEFILE_UNLOCK()
+#endif
+
+static void
+treefile_free (treefile_t T)
+{
+#ifdef TREEFILE_USE_MMAP
+  if (T->map != NULL)
+    munmap (T->map, T->map_size);
+  if (T->fd >= 0)
+    close (T->fd);
+#endif
+  if (T->file != NULL)
+    {
+      fclose (T->file);
+      remove (T->filename);
+    }
+  mpz_clear (T->modulus);
+  mpz_clear (T->tmp);
+  free (T->view);
+  free (T->buf);
+  free (T->filename);
+  free (T);
+}
+
+#ifdef TREEFILE_USE_MMAP
+/* Map size bytes of T's file, growing or truncating the file as needed.
+   Return 0 on success, ECM_ERROR on error. */
+static int
+treefile_map (treefile_t T, size_t size)
+{
+  void *map;
+
+  if (T->map != NULL)
+    {
+      if (size <= T->map_size && size >= T->map_size / 2)
+        return 0;
+      munmap (T->map, T->map_size);
+      T->map = NULL;
+    }
+  if (ftruncate (T->fd, (off_t) size) != 0)
+    return ECM_ERROR;
+  map = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, T->fd, 0);
+  if (map == MAP_FAILED)
+    return ECM_ERROR;
+#ifdef HAVE_MADVISE
+  madvise (map, size, MADV_SEQUENTIAL);
+#endif
+  T->map = (mp_limb_t *) map;
+  T->map_size = size;
+  return 0;
+}
+#endif
+
+/* Open a tree file for levels levels of len residues modulo n.
+   Return NULL on error. */
+treefile_t
+treefile_open (const char *filename, unsigned int levels, unsigned long len,
+               mpz_t n)
+{
+  treefile_t T = NULL, old = NULL;
+  size_t stride = mpz_size (n), size;
+
+  if (len == 0 || (double) levels * len * stride * sizeof (mp_limb_t) 
+                  > (double) SIZE_MAX)
+    return NULL;
+  size = (size_t) levels * len * stride * sizeof (mp_limb_t);
+
+  TREEFILE_LOCK();
+  if (treefile_cache != NULL && strcmp (treefile_cache->filename, 
+                                        filename) == 0)
+    T = treefile_cache;
+  else
+    old = treefile_cache;
+  treefile_cache = NULL;
+  TREEFILE_UNLOCK();
+
+  /* the unlinked file of another name would hold its disk space until the
+     process exits */
+  if (old != NULL)
+    treefile_free (old);
+
+  if (T == NULL)
+    {
+      T = (treefile_t) malloc (sizeof (__treefile_struct));
+      if (T == NULL)
+        return NULL;
+      T->filename = (char *) malloc (strlen (filename) + 1);
+      if (T->filename == NULL)
+        {
+          free (T);
+          return NULL;
+        }
+      strcpy (T->filename, filename);
+      mpz_init (T->modulus);
+      mpz_init (T->tmp);
+      T->map = NULL;
+      T->map_size = 0;
+      T->fd = -1;
+      T->file = NULL;
+      T->view = NULL;
+      T->buf = NULL;
+      T->buf_len = 0;
+#ifdef TREEFILE_USE_MMAP
+      T->fd = open (filename, O_RDWR | O_CREAT, 0666);
+      /* The file is only ever accessed through T, so its name can go right
+         away. This also makes sure it does not outlive the process. */
+      if (T->fd >= 0)
+        unlink (filename);
+#endif
+    }
+
+  mpz_set (T->modulus, n);
+  T->levels = levels;
+  T->len = len;
+  T->stride = stride;
+  T->level = 0;
+  T->pos = 0;
+
+  free (T->view);
+  T->view = (listz_t) malloc (len * sizeof (mpz_t));
+  if (T->view == NULL)
+    {
+      treefile_free (T);
+      return NULL;
+    }
+
+#ifdef TREEFILE_USE_MMAP
+  if (T->fd >= 0 && treefile_map (T, size) == 0)
+    return T;
+  if (T->fd >= 0)
+    close (T->fd);
+  T->fd = -1;
+#endif
+
+  /* Fall back to stdio on the file */
+  T->file = fopen (T->filename, "wb+");
+  if (T->file == NULL)
+    {
+      treefile_free (T);
+      return NULL;
+    }
+  return T;
+}
+
+/* Close a tree file, keeping it for reuse if it is mapped */
+void
+treefile_close (treefile_t T)
+{
+  treefile_t old = NULL;
+
+  if (T->map == NULL)
+    {
+      treefile_free (T);
+      return;
+    }
+
+  TREEFILE_LOCK();
+  old = treefile_cache;
+  treefile_cache = T;
+  TREEFILE_UNLOCK();
+
+  if (old != NULL)
+    treefile_free (old);
+}
+
+/* Free the tree file kept by treefile_close(), with its disk space */
+void
+treefile_clear (void)
+{
+  treefile_t old;
+
+  TREEFILE_LOCK();
+  old = treefile_cache;
+  treefile_cache = NULL;
+  TREEFILE_UNLOCK();
+
+  if (old != NULL)
+    treefile_free (old);
+}
+
+/* Start writing or reading level level of the tree */
+void
+treefile_seek (treefile_t T, unsigned int level)
+{
+  const size_t offset = (size_t) level * T->len * T->stride;
+
+  ASSERT_ALWAYS (level < T->levels);
+  T->level = level;
+  T->pos = 0;
+#if defined(TREEFILE_USE_MMAP) && defined(HAVE_MADVISE)
+  if (T->map != NULL)
+    {
+      const uintptr_t page = (uintptr_t) sysconf (_SC_PAGESIZE);
+      char *start = (char *) (T->map + offset);
+      char *aligned = (char *) ((uintptr_t) start & ~(page - 1));
+
+      madvise (aligned, (size_t) (start - aligned) + 
+               T->len * T->stride * sizeof (mp_limb_t), MADV_WILLNEED);
+    }
+#endif
+  if (T->file != NULL)
+    aux_fseek64 (T->file, (int64_t) offset * sizeof (mp_limb_t), SEEK_SET);
+}
+
+/* Make room for n residues in the stdio buffer of T.
+   Return 0 on success, ECM_ERROR on error */
+static int
+treefile_buf_reserve (treefile_t T, unsigned int n)
+{
+  mp_limb_t *buf;
+
+  if (n <= T->buf_len)
+    return 0;
+  buf = (mp_limb_t *) realloc (T->buf, (size_t) n * T->stride * 
+                                       sizeof (mp_limb_t));
+  if (buf == NULL)
+    return ECM_ERROR;
+  T->buf = buf;
+  T->buf_len = n;
+  return 0;
+}
+
+/* Append the n residues of a to the current level of the tree.
+   Return 0 on success, ECM_ERROR on error */
+int
+treefile_write (treefile_t T, listz_t a, unsigned int n)
+{
+  mp_limb_t *dst;
+  unsigned int i;
+
+  ASSERT_ALWAYS (T->pos + n <= T->len);
+  if (T->map != NULL)
+    dst = T->map + ((size_t) T->level * T->len + T->pos) * T->stride;
+  else if (treefile_buf_reserve (T, n) == 0)
+    dst = T->buf;
+  else
+    return ECM_ERROR;
+
+  for (i = 0; i < n; i++, dst += T->stride)
+    {
+      mpz_ptr r = a[i];
+      size_t s;
+
+      if (mpz_sgn (r) < 0 || mpz_size (r) > T->stride)
+        {
+          mpz_mod (T->tmp, r, T->modulus);
+          r = T->tmp;
+        }
+      s = mpz_size (r);
+      MPN_COPY (dst, PTR(r), s);
+      MPN_ZERO (dst + s, T->stride - s);
+    }
+
+  if (T->map == NULL && 
+      fwrite (T->buf, T->stride * sizeof (mp_limb_t), n, T->file) != n)
+    return ECM_ERROR;
+
+  T->pos += n;
+  return 0;
+}
+
+/* Return the next n residues of the current level of the tree, or NULL on
+   error. The residues are read-only, they point into the mapped file (or 
+   into T's buffer) and are valid until the next call. They may be swapped 
+   among themselves, but must not be modified or cleared. */
+listz_t
+treefile_read (treefile_t T, unsigned int n)
+{
+  mp_limb_t *src;
+  unsigned int i;
+
+  ASSERT_ALWAYS (T->pos + n <= T->len);
+  if (T->map != NULL)
+    src = T->map + ((size_t) T->level * T->len + T->pos) * T->stride;
+  else if (treefile_buf_reserve (T, n) == 0 &&
+           fread (T->buf, T->stride * sizeof (mp_limb_t), n, T->file) == n)
+    src = T->buf;
+  else
+    {
+      outputf (OUTPUT_ERROR, "Error reading product tree of F\n");
+      return NULL;
+    }
+
+  for (i = 0; i < n; i++, src += T->stride)
+    {
+      mp_size_t s = T->stride;
+
+      MPN_NORMALIZE (src, s);
+      PTR(T->view[i]) = src;
+      SIZ(T->view[i]) = s;
+      ALLOC(T->view[i]) = 0;
+    }
+
+  T->pos += n;
+  return T->view;
+}
+
 /* p <- q */
 void
 list_set (listz_t p, listz_t q, unsigned int n)
@@ -386,11 +713,12 @@ PolyFromRoots (listz_t G, listz_t a, unsigned int k, listz_t T, mpz_t n)
    the tree should be computed (dolvl < 0 means all levels).
 
    Either Tree <> NULL and TreeFile == NULL, and we write the tree to memory,
-   or Tree == NULL and TreeFile <> NULL, and we write the tree to disk.
+   or Tree == NULL and TreeFile <> NULL, and we write the tree to disk
+   (at the level TreeFile was last seeked to).
 */
 int
 PolyFromRoots_Tree (listz_t G, listz_t a, unsigned int k, listz_t T, 
-               int dolvl, mpz_t n, listz_t *Tree, FILE *TreeFile, 
+               int dolvl, mpz_t n, listz_t *Tree, treefile_t TreeFile, 
                unsigned int sh)
 {
   unsigned int l, m;
@@ -431,8 +759,8 @@ PolyFromRoots_Tree (listz_t G, listz_t a, unsigned int k, listz_t T,
       /* Write this level to disk, if requested */
       if (TreeFile != NULL)
         {
-          if (list_out_raw (TreeFile, H1, l) == ECM_ERROR ||
-              list_out_raw (TreeFile, H1 + l, m) == ECM_ERROR)
+          if (treefile_write (TreeFile, H1, l) == ECM_ERROR ||
+              treefile_write (TreeFile, H1 + l, m) == ECM_ERROR)
             {
               outputf (OUTPUT_ERROR, "Error writing product tree of F\n");
               return ECM_ERROR;
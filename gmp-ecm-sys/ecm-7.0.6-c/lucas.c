@@ -28,7 +28,27 @@ volume 39, number 159, pages 225-234, 1982.
 Evaluating recurrences of form X_{m+n} = f(X_m, X_n, X_{m-n}) via
 Lucas chains, Peter L. Montgomery, December 1983, revised January 1992. */
 
+#include <stdlib.h>
 #include "ecm-impl.h"
+#include "getprime_r.h"
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+/* 1/prac_val[0] = the golden ratio (1+sqrt(5))/2, and 1/prac_val[i] for i>0
+   is the real number whose continued fraction expansion is all 1s
+   except for a 2 in i+1-st place */
+const double prac_val[PRAC_NV] =
+  { 0.61803398874989485, 0.72360679774997897, 0.58017872829546410,
+    0.63283980608870629, 0.61242994950949500, 0.62018198080741576,
+    0.61721461653440386, 0.61834711965622806, 0.61791440652881789,
+    0.61807966846989581};
+
+/* Cost of an addition and of a duplicate, in modular multiplications: 
+   6 and 5 for Montgomery curves, one multiplication or squaring for the
+   Lucas sequences of P+1. */
+static const double prac_add[2] = {6.0, 1.0};
+static const double prac_dup[2] = {5.0, 1.0};
 
 /* P <- V_2(Q) */
 static void
@@ -51,22 +71,25 @@ pp1_add3 (mpres_t P, mpres_t Q, mpres_t R, mpres_t S, mpmod_t n, mpres_t t)
 
 /* computes V_k(P) from P=A and puts the result in P=A. Assumes k>2.
    Uses auxiliary variables t, B, C, T, T2.
+   The chain is the PRAC chain for multiplier prac_val[vi], see
+   prac_best_val().
 */
 void
 pp1_mul_prac (mpres_t A, ecm_uint k, mpmod_t n, mpres_t t, mpres_t B,
-              mpres_t C, mpres_t T, mpres_t T2)
+              mpres_t C, mpres_t T, mpres_t T2, unsigned int vi)
 {
   ecm_uint d, e, r;
-  static double val = 0.61803398874989485; /* 1/(golden ratio) */
 
   /* Note: we used to use several (4) values of "val", but:
      (1) the code to estimate the best value was buggy;
      (2) even after fixing the bug, the overhead to choose the
          best value was larger than the corresponding gain (for a c155
-         and B1=10^7). */
+         and B1=10^7).
+     Now the choice is made once per prime by prac_chains_reserve(), and
+     shared by all runs. */
 
   d = k;
-  r = (ecm_uint) ((double) d * val + 0.5);
+  r = (ecm_uint) ((double) d * prac_val[vi] + 0.5);
   
   /* first iteration always begins by Condition 3, then a swap */
   d = k - r;
@@ -157,3 +180,246 @@ pp1_mul_prac (mpres_t A, ecm_uint k, mpmod_t n, mpres_t t, mpres_t B,
 
   ASSERT(d == 1);
 }
+
+/* returns the number of modular multiplications for computing
+   V_n from V_r * V_{n-r} - V_{n-2r}, with r = round(n*v).
+   w is PRAC_ECM or PRAC_PP1, and selects the cost of an addition and of
+   a duplicate.
+*/
+double
+lucas_cost (ecm_uint n, double v, int w)
+{
+  const double ADD = prac_add[w], DUP = prac_dup[w];
+  ecm_uint d, e, r;
+  double c; /* cost */
+
+  d = n;
+  r = (ecm_uint) ((double) d * v + 0.5);
+  if (r >= n)
+    return (ADD * (double) n);
+  d = n - r;
+  e = 2 * r - n;
+  c = DUP + ADD; /* initial duplicate and final addition */
+  while (d != e)
+    {
+      if (d < e)
+        {
+          r = d;
+          d = e;
+          e = r;
+        }
+      if (d - e <= e / 4 && ((d + e) % 3) == 0)
+        { /* condition 1 */
+          d = (2 * d - e) / 3;
+          e = (e - d) / 2;
+          c += 3.0 * ADD; /* 3 additions */
+        }
+      else if (d - e <= e / 4 && (d - e) % 6 == 0)
+        { /* condition 2 */
+          d = (d - e) / 2;
+          c += ADD + DUP; /* one addition, one duplicate */
+        }
+      else if ((d + 3) / 4 <= e)
+        { /* condition 3 */
+          d -= e;
+          c += ADD; /* one addition */
+        }
+      else if ((d + e) % 2 == 0)
+        { /* condition 4 */
+          d = (d - e) / 2;
+          c += ADD + DUP; /* one addition, one duplicate */
+        }
+      /* now d+e is odd */
+      else if (d % 2 == 0)
+        { /* condition 5 */
+          d /= 2;
+          c += ADD + DUP; /* one addition, one duplicate */
+        }
+      /* now d is odd and e is even */
+      else if (d % 3 == 0)
+        { /* condition 6 */
+          d = d / 3 - e;
+          c += 3.0 * ADD + DUP; /* three additions, one duplicate */
+        }
+      else if ((d + e) % 3 == 0)
+        { /* condition 7 */
+          d = (d - 2 * e) / 3;
+          c += 3.0 * ADD + DUP; /* three additions, one duplicate */
+        }
+      else if ((d - e) % 3 == 0)
+        { /* condition 8 */
+          d = (d - e) / 3;
+          c += 3.0 * ADD + DUP; /* three additions, one duplicate */
+        }
+      else /* necessarily e is even: catches all cases */
+        { /* condition 9 */
+          e /= 2;
+          c += ADD + DUP; /* one addition, one duplicate */
+        }
+    }
+  
+  return c;
+}
+
+/* returns the index i such that the PRAC chain for k with multiplier
+   prac_val[i] is the cheapest one for w = PRAC_ECM or PRAC_PP1 */
+unsigned int
+prac_best_val (ecm_uint k, int w)
+{
+  unsigned int d, i = 0;
+  double c, cmin;
+
+  for (d = 0, cmin = prac_add[w] * (double) k; d < PRAC_NV; d++)
+    {
+      c = lucas_cost (k, prac_val[d], w);
+      if (c < cmin)
+        {
+          cmin = c;
+          i = d;
+        }
+    }
+
+  return i;
+}
+
+/* The best PRAC chain only depends on the prime, so it is chosen once and
+   cached for all curves and threads: chains[j] is prac_best_val() for the
+   j-th odd prime (in the order of getprime_mt, i.e., j=0 for 3).
+   As for the prime table, a cache is never modified once published. */
+struct prac_chains_s {
+  unsigned char *chains;
+  ecm_uint n;     /* number of primes */
+  double bound;   /* all primes <= bound are in */
+  struct prac_chains_s *prev; /* superseded cache */
+};
+
+static struct prac_chains_s *prac_chains[2] = {NULL, NULL};
+
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t prac_chains_lock = PTHREAD_MUTEX_INITIALIZER;
+#define PRAC_CHAINS_LOCK() pthread_mutex_lock (&prac_chains_lock)
+#define PRAC_CHAINS_UNLOCK() pthread_mutex_unlock (&prac_chains_lock)
+#else
+#define PRAC_CHAINS_LOCK()
+#define PRAC_CHAINS_UNLOCK()
+#endif
+
+/* number of primes handled at once when filling a cache */
+#define PRAC_CHAINS_BLOCK 65536
+
+/* Returns the cache for w = PRAC_ECM or PRAC_PP1, with its length in *n,
+   after making sure it covers all primes up to B1 (at most
+   PRIME_TABLE_AUTO_BOUND, as the prime table). For primes past the end of
+   the cache, PRAC_CHAIN() evaluates the candidate chains on the fly.
+   Filling the cache costs as much as choosing the chains in one stage 1,
+   so it is not extended for a run that resumes from B1done > B1/2. */
+const unsigned char *
+prac_chains_reserve (int w, double B1done, double B1, ecm_uint *n)
+{
+  struct prac_chains_s *c;
+  prime_info_t pi;
+  ecm_uint *primes = NULL, alloc, len, p;
+  const unsigned char *ret = NULL;
+
+  *n = 0;
+  B1 = MIN (B1, PRIME_TABLE_AUTO_BOUND);
+
+  PRAC_CHAINS_LOCK();
+  c = prac_chains[w];
+  if ((c != NULL && c->bound >= B1) || B1done > B1 / 2.0)
+    goto done;
+
+  /* the cache is indexed like the shared prime table */
+  if (prime_table_reserve (B1) != 0)
+    goto done;
+
+  /* grow geometrically, as the prime table does */
+  if (c != NULL && 2.0 * c->bound > B1)
+    {
+      B1 = MIN (2.0 * c->bound, PRIME_TABLE_AUTO_BOUND);
+      if (prime_table_reserve (B1) != 0)
+        goto done;
+    }
+
+  c = (struct prac_chains_s *) malloc (sizeof (struct prac_chains_s));
+  primes = (ecm_uint *) malloc (PRAC_CHAINS_BLOCK * sizeof (ecm_uint));
+  alloc = PRAC_CHAINS_BLOCK;
+  if (c != NULL)
+    c->chains = (unsigned char *) malloc (alloc);
+  if (c == NULL || primes == NULL || c->chains == NULL)
+    goto error;
+
+  prime_info_init (pi);
+  p = getprime_mt (pi);
+  for (c->n = 0; (double) p <= B1; )
+    {
+      ecm_int j;
+
+      /* collect a block of primes, then choose their chains in parallel */
+      for (len = 0; len < PRAC_CHAINS_BLOCK && (double) p <= B1; len++)
+        {
+          primes[len] = p;
+          p = getprime_mt (pi);
+        }
+      if (c->n + len > alloc)
+        {
+          unsigned char *newchains;
+          alloc *= 2;
+          newchains = (unsigned char *) realloc (c->chains, alloc);
+          if (newchains == NULL)
+            {
+              prime_info_clear (pi);
+              goto error;
+            }
+          c->chains = newchains;
+        }
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+      for (j = 0; j < (ecm_int) len; j++)
+        c->chains[c->n + j] = (unsigned char) prac_best_val (primes[j], w);
+      c->n += len;
+    }
+  prime_info_clear (pi);
+  free (primes);
+
+  c->bound = B1;
+  c->prev = prac_chains[w];
+  prac_chains[w] = c;
+
+ done:
+  if (c != NULL)
+    {
+      ret = c->chains;
+      *n = c->n;
+    }
+  PRAC_CHAINS_UNLOCK();
+  return ret;
+
+ error:
+  if (c != NULL)
+    free (c->chains);
+  free (c);
+  free (primes);
+  PRAC_CHAINS_UNLOCK();
+  return NULL;
+}
+
+/* Must not be called while another thread runs stage 1. */
+void
+prac_chains_clear (void)
+{
+  struct prac_chains_s *c;
+  int w;
+
+  PRAC_CHAINS_LOCK();
+  for (w = 0; w < 2; w++)
+    while (prac_chains[w] != NULL)
+      {
+        c = prac_chains[w]->prev;
+        free (prac_chains[w]->chains);
+        free (prac_chains[w]);
+        prac_chains[w] = c;
+      }
+  PRAC_CHAINS_UNLOCK();
+}
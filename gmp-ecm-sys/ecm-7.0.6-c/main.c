@@ -123,7 +123,7 @@ usage (void)
     printf ("  -resume file resume residues from file, reads from stdin if file is \"-\"\n");
     printf ("  -chkpnt file save periodic checkpoints during stage 1 to file (for -param 0)\n");
     printf ("  -primetest   perform a primality test on input\n");
-    printf ("  -treefile f  [ECM only] store stage 2 data in files f.0, ... \n");
+    printf ("  -treefile f  [ECM only] store stage 2 data in file f\n");
     printf ("  -maxmem n    use at most n MB of memory in stage 2\n");
     printf ("  -stage1time n add n seconds to ECM stage 1 time (for expected time est.)\n");
 
@@ -260,6 +260,12 @@ print_config (void)
   printf ("NTT_GFP_TWIDDLE_DIT_BREAKOVER undefined\n");
 #endif
 
+#ifdef NTT_GFP_FOURSTEP_THRESHOLD
+  printf ("NTT_GFP_FOURSTEP_THRESHOLD = %d\n", NTT_GFP_FOURSTEP_THRESHOLD);
+#else
+  printf ("NTT_GFP_FOURSTEP_THRESHOLD undefined\n");
+#endif
+
 #ifdef PREREVERTDIVISION_NTT_THRESHOLD
   printf ("PREREVERTDIVISION_NTT_THRESHOLD = %d\n", 
           PREREVERTDIVISION_NTT_THRESHOLD);
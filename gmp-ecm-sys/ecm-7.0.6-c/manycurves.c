@@ -0,0 +1,940 @@
+/* manycurves.c - ECM stage 1 on many curves at once
+   Author: F. Morain
+
+   All curves are in affine Weierstrass form, so that each addition or
+   doubling needs an inversion; the inversions of all curves are done at
+   the same time with Montgomery's trick, at the cost of one modular
+   inversion and 3 multiplications per curve.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <gmp.h> /* GMP header file */
+
+#include "ecm.h" /* ecm header file */
+#include "ecm-impl.h"
+#include "ecm-ecm.h"
+#include "mpmod.h"
+#include "getprime_r.h"
+
+#include "addlaws.h"
+#include "torsions.h"
+#include "manycurves.h"
+
+#define DEBUG_MULTI_EC 0
+
+/* Smallest number of curves per group in all_curves_at_once: Montgomery's
+   trick costs 3 multiplications per curve plus one inversion per group,
+   and an inversion costs a few dozen multiplications at usual sizes. */
+#define MANY_CURVES_MIN_GROUP 16
+
+/********** group law on points **********/
+
+int
+pt_is_zero(ell_point_t P, ATTRIBUTE_UNUSED mpmod_t n)
+{
+    return mpz_sgn(P->z) == 0;
+}
+
+void
+pt_set_to_zero(ell_point_t P, mpmod_t n)
+{
+    mpz_set_ui(P->x, 0);
+    mpres_set_ui(P->y, 1, n);
+    mpz_set_ui(P->z, 0);
+}
+
+void
+pt_assign(ell_point_t Q, ell_point_t P, ATTRIBUTE_UNUSED mpmod_t n)
+{
+    mpres_set(Q->x, P->x, n);
+    mpres_set(Q->y, P->y, n);
+    mpres_set(Q->z, P->z, n);
+}
+
+void
+pt_neg(ell_point_t P, mpmod_t n)
+{
+    if(pt_is_zero(P, n) == 0)
+	mpres_neg(P->y, P->y, n);
+}
+
+void
+pt_many_set_to_zero(ell_point_t *tP, int nE, mpmod_t n)
+{
+    int i;
+
+    for(i = 0; i < nE; i++)
+	pt_set_to_zero(tP[i], n);
+}
+
+void
+pt_many_neg(ell_point_t *tP, int nE, mpmod_t n)
+{
+    int i;
+
+    for(i = 0; i < nE; i++)
+	pt_neg(tP[i], n);
+}
+
+void
+pt_many_assign(ell_point_t *tQ, ell_point_t *tP, int nE, mpmod_t n)
+{
+    int i;
+
+    for(i = 0; i < nE; i++)
+	pt_assign(tQ[i], tP[i], n);
+}
+
+#if DEBUG_ADD_LAWS >= 1
+void
+pt_print(ell_curve_t E, ell_point_t P, mpmod_t n)
+{
+    printf("[");
+    print_mpz_from_mpres(P->x, n);
+    printf(", ");
+    print_mpz_from_mpres(P->y, n);
+    printf(", ");
+    if(E->type == ECM_EC_TYPE_WEIERSTRASS && E->law == ECM_LAW_AFFINE)
+	gmp_printf("%Zd", P->z);
+    else
+	print_mpz_from_mpres(P->z, n);
+    printf("]");
+}
+
+void
+pt_many_print(ell_curve_t *tE, ell_point_t *tP, int nE, mpmod_t n)
+{
+    int i;
+
+    for(i = 0; i < nE; i++){
+	printf("%d: ", i);
+	pt_print(tE[i], tP[i], n);
+	printf(" on E.A=");
+	print_mpz_from_mpres(tE[i]->a4, n);
+	printf("\n");
+    }
+}
+#endif
+
+/* Computes inv[i] = 1/x[i] using only one inversion, a la Montgomery.
+   If takeit[i] != 1, do not compute 1/x[i] (it is probably 0, or irrelevant).
+   We should have inv != x.
+   x[nx] is a buffer.
+   When a factor is found, the i s.t. x[i] is not invertible are looked for
+   and the corresponding values of takeit put to 2.
+*/
+int
+compute_all_inverses(mpz_t f, mpres_t *inv, mpres_t *x, int nx, mpmod_t n, char *takeit)
+{
+    int i;
+
+    /* Montgomery's trick */
+    for(i = 0; i < nx; i++){
+	if(takeit[i] != 1){
+	    if(i == 0)
+		mpres_set_ui(inv[i], 1, n);
+	    else
+		mpres_set(inv[i], inv[i-1], n);
+	}
+	else{
+	    if(i == 0)
+		mpres_set(inv[i], x[i], n);
+	    else
+		mpres_mul(inv[i], inv[i-1], x[i], n);
+	}
+    }
+    /* invert */
+    if(!mpres_invert(x[nx], inv[nx-1], n)){
+	mpres_gcd(f, inv[nx-1], n);
+	/* identifying the x[i]'s */
+	for(i = 0; i < nx; i++){
+	    if(takeit[i] != 1)
+		continue;
+	    mpres_gcd(f, x[i], n);
+	    if(mpz_cmp_ui(f, 1) != 0){
+		outputf (OUTPUT_DEVVERBOSE, "x[%d] not invertible: %Zd\n", i, f);
+		/* ONE DAY: if x[nx] != inv[0], we have another factor! */
+		takeit[i] = 2;
+	    }
+	}
+	return 0;
+    }
+    /* get inverses back */
+    /* say inv = 1/(x1*x2*x3) */
+    for(i = nx-1; i > 0; i--)
+	if(takeit[i] == 1){
+	    mpres_mul(inv[i], x[nx], inv[i-1], n); /* 1/x3 = inv * (x1*x2) */
+	    mpres_mul(x[nx], x[nx], x[i], n); /* inv = 1/(x1*x2) */
+	}
+    mpres_set(inv[0], x[nx], n);
+#if DEBUG_ADD_LAWS >= 1
+    /*    printf("# checking inverses\n"); */
+    mpres_t tmp;
+    mpres_init(tmp, n);
+    for(i = 0; i < nx; i++){
+	if(takeit[i] != 1)
+	    continue;
+	mpres_mul(tmp, inv[i], x[i], n);
+	mpres_get_z(tmp, tmp, n);
+	if(mpz_cmp_ui(tmp, 1) != 0)
+	    printf("ERROR in compute_all_inverses[%d]\n", i);
+    }
+    mpres_clear(tmp, n);
+#endif
+    return 1;
+}
+
+/* Reduces R mod N. mpres_add and mpres_sub only keep the residues of
+   ECM_MOD_MODMULN and ECM_MOD_REDC bounded: with ECM_MOD_MPZ and
+   ECM_MOD_BASE2 they would grow from one group operation to the next. */
+static void
+pt_many_reduce(mpres_t R, mpmod_t n)
+{
+    if(n->repr == ECM_MOD_MPZ || n->repr == ECM_MOD_BASE2)
+	mpz_mod(R, R, n->orig_modulus);
+}
+
+/* NOTE: we can have tR = tP or tQ.
+   The curves i with den[i] not invertible get their factor in tf[i]
+   and ok[i] = 2, and the inversion is done again for the other ones.
+   Returns 0 if no den[i] could be found to be non invertible, which
+   should not happen.
+ */
+static int
+pt_many_common(mpz_t *tf, ell_point_t *tR, ell_point_t *tP, ell_point_t *tQ,
+	       int nE, mpmod_t n, mpres_t *num, mpres_t *den, mpres_t *inv,
+	       char *takeit, char *ok)
+{
+    int i, found;
+
+    while(compute_all_inverses(num[nE], inv, den, nE, n, takeit) == 0){
+	found = 0;
+	for(i = 0; i < nE; i++)
+	    if(takeit[i] == 2){
+		mpres_gcd(tf[i], den[i], n);
+		takeit[i] = 0;
+		ok[i] = 2;
+		found = 1;
+	    }
+	if(found == 0)
+	    return 0;
+    }
+    for(i = 0; i < nE; i++){
+	if(takeit[i] != 1)
+	    continue;
+	/* l:=(inv[i]*num[i]) mod N; */
+	mpres_mul(num[i], num[i], inv[i], n);
+	/* x:=(l^2-P[1]-Q[1]) mod N; */
+	mpres_sqr(den[i], num[i], n);
+	mpres_sub(den[i], den[i], tP[i]->x, n);
+	mpres_sub(den[i], den[i], tQ[i]->x, n);
+	/* tR[i]:=[x, (l*(P[1]-x)-P[2]) mod N, 1]; */
+	mpres_sub(tR[i]->x, tP[i]->x, den[i], n);
+	mpres_mul(tR[i]->x, tR[i]->x, num[i], n);
+	mpres_sub(tR[i]->y, tR[i]->x, tP[i]->y, n);
+	pt_many_reduce(tR[i]->y, n);
+	mpres_set(tR[i]->x, den[i], n);
+	pt_many_reduce(tR[i]->x, n);
+	mpz_set_ui(tR[i]->z, 1);
+    }
+    return 1;
+}
+
+/* num[i]/den[i] <- slope of the tangent at P on E */
+static void
+pt_tangent(mpres_t num, mpres_t den, ell_point_t P, ell_curve_t E, mpmod_t n)
+{
+    mpres_sqr(num, P->x, n);
+    mpres_mul_ui(num, num, 3, n);
+    mpres_add(num, num, E->a4, n);
+    mpres_mul_ui(den, P->y, 2, n);
+}
+
+/* tQ[i] <- 2 * tP[i] for the curves with ok[i] = 1. */
+int
+pt_many_duplicate(mpz_t *tf, ell_point_t *tQ, ell_point_t *tP, ell_curve_t *tE,
+		  int nE, mpmod_t n,
+		  mpres_t *num, mpres_t *den, mpres_t *inv, char *ok)
+{
+    char *takeit = (char *)malloc(nE * sizeof(char));
+    int i, res;
+
+    for(i = 0; i < nE; i++){
+	takeit[i] = 0;
+	if(ok[i] != 1)
+	    continue;
+	if(pt_is_zero(tP[i], n))
+	    pt_set_to_zero(tQ[i], n);
+	else if(mpres_is_zero(tP[i]->y, n)){
+	    /* 2 * P[i] = O_E */
+	    pt_set_to_zero(tQ[i], n);
+	}
+	else{
+	    takeit[i] = 1;
+	    pt_tangent(num[i], den[i], tP[i], tE[i], n);
+	}
+    }
+    res = pt_many_common(tf, tQ, tP, tP, nE, n, num, den, inv, takeit, ok);
+    free(takeit);
+    return res;
+}
+
+/* tR[i] <- tP[i] + tQ[i] for the curves with ok[i] = 1. */
+int
+pt_many_add(mpz_t *tf, ell_point_t *tR, ell_point_t *tP, ell_point_t *tQ, ell_curve_t *tE,
+	    int nE, mpmod_t n,
+	    mpres_t *num, mpres_t *den, mpres_t *inv, char *ok)
+{
+    char *takeit = (char *)malloc(nE * sizeof(char));
+    int i, res;
+
+#if DEBUG_ADD_LAWS >= 2
+    printf("In pt_many_add, adding\n");
+    pt_many_print(tE, tP, nE, n);
+    printf("and\n");
+    pt_many_print(tE, tQ, nE, n);
+#endif
+    for(i = 0; i < nE; i++){
+	takeit[i] = 0;
+	if(ok[i] != 1)
+	    continue;
+	if(pt_is_zero(tP[i], n)){
+#if DEBUG_ADD_LAWS >= 2
+	    printf("# tEP[%d] = O_{E[%d]}\n", i, i);
+#endif
+	    pt_assign(tR[i], tQ[i], n);
+	}
+	else if(pt_is_zero(tQ[i], n)){
+#if DEBUG_ADD_LAWS >= 2
+	    printf("# tEQ[%d] = O_{E[%d]}\n", i, i);
+#endif
+	    pt_assign(tR[i], tP[i], n);
+	}
+	else if(mpres_equal(tQ[i]->x, tP[i]->x, n)){
+	    mpres_add(num[i], tQ[i]->y, tP[i]->y, n);
+	    if(mpres_is_zero(num[i], n)){
+		/* Q[i] = -P[i], including 2 * P[i] = O_E */
+		pt_set_to_zero(tR[i], n);
+	    }
+	    else{
+		/* Q[i] = P[i]: ordinary doubling */
+		takeit[i] = 1;
+		pt_tangent(num[i], den[i], tP[i], tE[i], n);
+	    }
+	}
+	else{
+	    takeit[i] = 1;
+	    mpres_sub(num[i], tQ[i]->y, tP[i]->y, n);
+	    mpres_sub(den[i], tQ[i]->x, tP[i]->x, n);
+	}
+    }
+    res = pt_many_common(tf, tR, tP, tQ, nE, n, num, den, inv, takeit, ok);
+    free(takeit);
+    return res;
+}
+
+/* tER != tEP */
+static int
+pt_many_sub(mpz_t *tf, ell_point_t *tR, ell_point_t *tQ, ell_point_t *tP, ell_curve_t *tE,
+	    int nE, mpmod_t n,
+	    mpres_t *num, mpres_t *den, mpres_t *inv, char *ok)
+{
+    int i, res;
+    char *negated = (char *)malloc(nE * sizeof(char));
+
+    /* ok may change in pt_many_add */
+    memcpy(negated, ok, nE);
+    for(i = 0; i < nE; i++)
+	if(negated[i] == 1)
+	    pt_neg(tP[i], n);
+    res = pt_many_add(tf, tR, tQ, tP, tE, nE, n, num, den, inv, ok);
+    for(i = 0; i < nE; i++)
+	if(negated[i] == 1)
+	    pt_neg(tP[i], n);
+    free(negated);
+    return res;
+}
+
+/* Ordinary binary left-right addition */
+static int
+pt_many_mul_plain(mpz_t *tf, ell_point_t *tQ, ell_point_t *tP, ell_curve_t *tE,
+		  int nE, mpz_t e, mpmod_t n,
+		  mpres_t *num, mpres_t *den, mpres_t *inv, char *ok)
+{
+  size_t l = mpz_sizeinbase (e, 2) - 1; /* l >= 1 */
+  int status = 1;
+
+  pt_many_assign(tQ, tP, nE, n);
+  while (l-- > 0)
+    {
+	if(pt_many_duplicate (tf, tQ, tQ, tE, nE, n, num, den, inv, ok) == 0)
+	  {
+	    status = 0;
+	    break;
+	  }
+#if DEBUG_ADD_LAWS >= 2
+	printf("Rdup:="); pt_many_print(tE, tQ, nE, n); printf(";\n");
+#endif
+	if (ecm_tstbit (e, l))
+	  {
+	      if(pt_many_add (tf, tQ, tP, tQ, tE, nE, n, num, den, inv, ok) == 0)
+	      {
+		status = 0;
+		break;
+	      }
+#if DEBUG_ADD_LAWS >= 2
+	      printf("Radd:="); pt_many_print(tE, tQ, nE, n); printf(";\n");
+#endif
+	  }
+    }
+  return status;
+}
+
+/* Ordinary binary left-right addition; see Solinas00. Morally, we use
+ w = 2. */
+static int
+pt_many_mul_add_sub_si(mpz_t *tf, ell_point_t *tQ, ell_point_t *tP, ell_curve_t *tE, int nE,
+		       long c, mpmod_t n,
+		       mpres_t *num, mpres_t *den, mpres_t *inv, char *ok)
+{
+    long u, S[64];
+    int j, iS = 0, status = 1;
+    ATTRIBUTE_UNUSED int w = 2;
+
+    /* build NAF_w(c) */
+    while(c > 0){
+	if((c & 1) == 1){
+	    /* c is odd */
+	    u = c & (long)3;
+	    if(u == 3)
+		u = -1;
+	}
+	else
+	    u = 0;
+	S[iS++] = u;
+	c -= u;
+	c >>= 1;
+    }
+    /* use it */
+    pt_many_set_to_zero(tQ, nE, n);
+    for(j = iS-1; j >= 0; j--){
+	if(pt_many_duplicate(tf, tQ, tQ, tE, nE, n, num, den, inv, ok) == 0){
+	    status = 0;
+	    break;
+	}
+#if DEBUG_ADD_LAWS >= 2
+	printf("Rdup:="); pt_many_print(tE, tQ, nE, n); printf(";\n");
+#endif
+	if(S[j] == 1){
+	    if(pt_many_add(tf, tQ, tQ, tP, tE, nE, n, num, den, inv, ok) == 0){
+		status = 0;
+		break;
+	    }
+#if DEBUG_ADD_LAWS >= 2
+	    printf("Radd:="); pt_many_print(tE, tQ, nE, n); printf(";\n");
+#endif
+	}
+	else if(S[j] == -1){
+	    if(pt_many_sub(tf, tQ, tQ, tP, tE, nE, n, num, den, inv, ok) == 0){
+		status = 0;
+		break;
+	    }
+#if DEBUG_ADD_LAWS >= 2
+	    printf("Rsub:="); pt_many_print(tE, tQ, nE, n); printf(";\n");
+#endif
+	}
+    }
+  return status;
+}
+
+/* tEQ[i] <- e * tEP[i]; we must have tEQ != tEP */
+/* Returns 0 in case of an unexpected failure of the inversions. */
+int
+pt_many_mul(mpz_t *tf, ell_point_t *tQ, ell_point_t *tP, ell_curve_t *tE, int nE,
+	    mpz_t e, mpmod_t n,
+	    mpres_t *num, mpres_t *den, mpres_t *inv, char *ok)
+{
+  size_t l;
+  int negated = 0, status = 1;
+
+  if (mpz_sgn (e) == 0)
+    {
+	pt_many_set_to_zero(tQ, nE, n);
+	return 1;
+    }
+
+  /* The negative of a point (x:y:z) is (x:-y:z) */
+  if (mpz_sgn (e) < 0)
+    {
+      negated = 1;
+      mpz_neg (e, e);
+      pt_many_neg(tP, nE, n);
+    }
+
+  if (mpz_cmp_ui (e, 1) == 0)
+    {
+      pt_many_assign(tQ, tP, nE, n);
+      goto pt_many_mul_end;
+    }
+
+  l = mpz_sizeinbase (e, 2) - 1; /* l >= 1 */
+  if(l < 32)
+      status = pt_many_mul_add_sub_si(tf, tQ, tP, tE, nE, mpz_get_si(e), n,
+				      num, den, inv, ok);
+  else
+      status = pt_many_mul_plain(tf, tQ, tP, tE, nE, e, n, num, den, inv, ok);
+
+
+pt_many_mul_end:
+
+  /* Undo negation to avoid changing the caller's e value */
+  if (negated){
+    mpz_neg (e, e);
+    pt_many_neg(tP, nE, n);
+  }
+  return status;
+}
+
+/* Copied from classical ecm_stage1.
+   Stage 1 on one group of curves, all sharing their inversions; see
+   all_curves_at_once. The prime table must have been reserved.
+*/
+static int
+curves_at_once_group(mpz_t *tf, char *ok, ell_curve_t *tE, ell_point_t *tP,
+		     int nE, mpmod_t n, double B1, double *B1done,
+		     int (*stop_asap)(void))
+{
+    ell_point_t *tQ, *tR;
+    mpres_t *num, *den, *inv;
+    mpz_t e;
+    double p = 0.0, r;
+    int ret = ECM_NO_FACTOR_FOUND;
+    int i, active;
+    prime_info_t prime_info;
+
+    tQ = (ell_point_t *) malloc (nE * sizeof (ell_point_t));
+    tR = (ell_point_t *) malloc (nE * sizeof (ell_point_t));
+    num = (mpres_t *) malloc ((nE + 1) * sizeof (mpres_t));
+    den = (mpres_t *) malloc ((nE + 1) * sizeof (mpres_t));
+    inv = (mpres_t *) malloc (nE * sizeof (mpres_t));
+    if (tQ == NULL || tR == NULL || num == NULL || den == NULL || inv == NULL)
+      {
+        free (tQ);
+        free (tR);
+        free (num);
+        free (den);
+        free (inv);
+        return ECM_ERROR;
+      }
+
+    prime_info_init (prime_info);
+
+    mpz_init(e);
+    for(i = 0; i < nE; i++){
+	mpres_init(tQ[i]->x, n); mpres_set(tQ[i]->x, tP[i]->x, n);
+	mpres_init(tQ[i]->y, n); mpres_set(tQ[i]->y, tP[i]->y, n);
+	mpres_init(tQ[i]->z, n); mpres_set(tQ[i]->z, tP[i]->z, n);
+
+	mpres_init(tR[i]->x, n);
+	mpres_init(tR[i]->y, n);
+	mpres_init(tR[i]->z, n);
+
+	mpres_init(num[i], n);
+	mpres_init(den[i], n);
+	mpres_init(inv[i], n);
+    }
+    mpres_init(num[nE], n); /* to be used as buffer in compute_all_inverses */
+    mpres_init(den[nE], n); /* to be used as buffer in compute_all_inverses */
+
+#if DEBUG_MULTI_EC >= 2
+    printf("Initial points:\n");
+    pt_many_print(tE, tP, nE, n);
+#endif
+    for (r = 2.0; r <= B1; r *= 2.0)
+	if (r > *B1done){
+	    if(pt_many_duplicate (tf, tQ, tQ, tE, nE, n, num, den, inv, ok) == 0){
+		ret = ECM_ERROR;
+		goto end_of_all;
+	    }
+#if DEBUG_MULTI_EC >= 2
+	    printf("P%ld:=", (long)r); pt_many_print(tE, tQ, nE, n); printf(";\n");
+#endif
+	}
+
+    for (p = getprime_mt (prime_info); p <= B1; p = getprime_mt (prime_info)){
+	for (r = p; r <= B1; r *= p){
+#if DEBUG_MULTI_EC >= 2
+	    printf("## p = %ld at %ldms\n", (long)p, cputime());
+#endif
+	    if (r > *B1done){
+		mpz_set_ui(e, (ecm_uint) p);
+		if(pt_many_mul(tf, tR, tQ, tE, nE, e, n, num, den, inv, ok) == 0){
+		    ret = ECM_ERROR;
+		    goto end_of_all;
+		}
+#if DEBUG_MULTI_EC >= 2
+		pt_many_print(tE, tR, nE, n);
+#endif
+		for(i = 0; i < nE; i++)
+		    if(ok[i] == 1 && pt_is_zero(tR[i], n))
+			ok[i] = 0;
+		pt_many_assign(tQ, tR, nE, n); /* TODO: use pointers */
+	    }
+	    if (stop_asap != NULL && (*stop_asap) ()){
+		outputf (OUTPUT_NORMAL, "Interrupted at prime %.0f\n", p);
+		break;
+	    }
+	}
+	/* stop when no curve is left */
+	for(i = 0, active = 0; i < nE; i++)
+	    active += (ok[i] == 1);
+	if(active == 0){
+	    /* the group has nothing left to do: it counts as having reached
+	       B1 when all_curves_at_once takes the minimum over the groups */
+	    p = B1;
+	    break;
+	}
+	if(stop_asap != NULL && (*stop_asap) ())
+	    break;
+    }
+ end_of_all:
+    /* If stage 1 finished normally, p is the smallest prime > B1 here.
+       In that case, set to B1 */
+    if (p > B1)
+	p = B1;
+
+    if (ret == ECM_NO_FACTOR_FOUND && p > *B1done)
+	*B1done = p;
+
+    prime_info_clear (prime_info); /* free the prime table */
+
+    /* put results back */
+    pt_many_assign(tP, tQ, nE, n);
+    /* normalize all points */
+    for(i = 0; i < nE; i++){
+	if(pt_is_zero(tP[i], n))
+	    pt_set_to_zero(tP[i], n);
+	if(ret == ECM_NO_FACTOR_FOUND && ok[i] == 2)
+	    ret = ECM_FACTOR_FOUND_STEP1;
+    }
+    /* clear temporary variables */
+    mpz_clear(e);
+    for(i = 0; i < nE; i++){
+	mpres_clear(tQ[i]->x, n);
+	mpres_clear(tQ[i]->y, n);
+	mpres_clear(tQ[i]->z, n);
+	mpres_clear(tR[i]->x, n);
+	mpres_clear(tR[i]->y, n);
+	mpres_clear(tR[i]->z, n);
+	mpres_clear(num[i], n);
+	mpres_clear(den[i], n);
+	mpres_clear(inv[i], n);
+    }
+    mpres_clear(num[nE], n);
+    mpres_clear(den[nE], n);
+    free(tQ);
+    free(tR);
+    free(num);
+    free(den);
+    free(inv);
+    return ret;
+}
+
+/* Number of groups of curves for nE curves: one per thread, but with at
+   least MANY_CURVES_MIN_GROUP curves per group. */
+static int
+many_curves_groups(int nE)
+{
+    int ngroups = 1;
+
+#ifdef _OPENMP
+    ngroups = omp_get_max_threads ();
+#endif
+    ngroups = MIN(ngroups, nE / MANY_CURVES_MIN_GROUP);
+    return (ngroups < 1) ? 1 : ngroups;
+}
+
+/* Runs stage 1 on the curves with ok[i] = 1. Those finding a factor get
+   it in tf[i] and ok[i] = 2, those whose point reaches O_E get ok[i] = 0.
+   With OpenMP, the curves are cut into one group per thread, each group
+   doing its own stage 1 with its own inversions and its own copy of n.
+   A group needs one modular inversion per group operation whatever its
+   size, hence groups are not made smaller than MANY_CURVES_MIN_GROUP.
+   Returns ECM_FACTOR_FOUND_STEP1 if some curve found a factor,
+   ECM_ERROR in case of an unexpected failure of the inversions, and
+   ECM_NO_FACTOR_FOUND otherwise.
+*/
+int
+all_curves_at_once(mpz_t *tf, char *ok, ell_curve_t *tE, ell_point_t *tP, int nE,
+		   mpmod_t n, double B1, double *B1done,
+		   int (*stop_asap)(void))
+{
+    const double B1done_in = *B1done;
+    double B1done_min = -1.0;
+    int ret = ECM_NO_FACTOR_FOUND;
+    int g, ngroups = many_curves_groups(nE);
+
+    if (ngroups > 1)
+	outputf (OUTPUT_VERBOSE, "Step 1 in %d groups of about %d curves\n",
+		 ngroups, nE / ngroups);
+
+    prime_table_reserve (MIN (B1, PRIME_TABLE_AUTO_BOUND));
+
+#ifdef _OPENMP
+#pragma omp parallel for if (ngroups > 1) schedule (static, 1)
+#endif
+    for (g = 0; g < ngroups; g++)
+      {
+	const int a = (long) nE * g / ngroups;
+	const int b = (long) nE * (g + 1) / ngroups;
+	double B1done_local = B1done_in;
+	mpmod_t modulus_local;
+	int ret_local;
+
+	mpmod_init_set (modulus_local, n);
+	ret_local = curves_at_once_group (tf + a, ok + a, tE + a, tP + a,
+					  b - a, modulus_local, B1,
+					  &B1done_local, stop_asap);
+	mpmod_clear (modulus_local);
+
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+	{
+	  if (ret_local == ECM_ERROR || ret == ECM_NO_FACTOR_FOUND)
+	    ret = ret_local;
+	  /* the groups may have been interrupted at different primes */
+	  if (B1done_min < 0.0 || B1done_local < B1done_min)
+	    B1done_min = B1done_local;
+	}
+      }
+    *B1done = B1done_min;
+
+    return ret;
+}
+
+/* Puts in E, P the affine Weierstrass form of the curve zE and point zP
+   given by the builders of torsions.c. Returns 1 if this could be done,
+   2 if a factor was found (put in f).
+*/
+static int
+many_curves_set(mpz_t f, ell_curve_t E, ell_point_t P,
+		ell_curve_t zE, ell_point_t zP, mpmod_t n)
+{
+    int ret = ECM_NO_FACTOR_FOUND;
+
+    mpres_set_z(P->x, zP->x, n);
+    mpres_set_z(P->y, zP->y, n);
+    if(zE->type == ECM_EC_TYPE_MONTGOMERY){
+	mpres_set_z(E->a4, zE->a2, n);
+	ret = montgomery_to_weierstrass(f, P->x, P->y, E->a4, n);
+    }
+    else if(zE->type == ECM_EC_TYPE_HESSIAN){
+	mpres_set_z(E->a4, zE->a4, n);
+	ret = hessian_to_weierstrass(f, P->x, P->y, E->a4, n);
+	if(ret == ECM_NO_FACTOR_FOUND)
+	    /* as in ecm(), due to the kernel of the map */
+	    ret = mult_by_3(f, P->x, P->y, E->a4, n);
+    }
+    else
+	mpres_set_z(E->a4, zE->a4, n);
+    return (ret == ECM_NO_FACTOR_FOUND) ? 1 : 2;
+}
+
+/* Builds the curves of parameters smin+a, ..., smin+b-1 of
+   build_many_curves, with a generator whose chunk is the whole range: as
+   long as nothing goes wrong, this is one call to the builder, which gets
+   each curve from the previous one.
+*/
+static void
+build_many_curves_range(mpz_t *tf, char *ok, ell_curve_t *tE, ell_point_t *tP,
+			const char *torsion, int smin, int a, int b, mpmod_t n)
+{
+    torsion_gen_t G;
+    ell_curve_t zE;
+    ell_point_t zP;
+    mpz_t f;
+    int u, i, ret;
+
+    if(torsion_gen_init(G, (char *) torsion, smin + a, smin + b, b - a)
+       != ECM_NO_FACTOR_FOUND)
+	return; /* all these curves keep ok[i] = 0 */
+    mpz_init(f);
+    while((ret = torsion_gen_next(f, zE, zP, &u, G, n)) != 0){
+	i = u - smin;
+	if(ret == 2){
+	    mpz_set(tf[i], f);
+	    ok[i] = 2;
+	    continue;
+	}
+	ok[i] = many_curves_set(tf[i], tE[i], tP[i], zE, zP, n);
+	ell_point_clear(zP, zE, n);
+	ell_curve_clear(zE, n);
+    }
+    mpz_clear(f);
+    torsion_gen_clear(G, n);
+}
+
+/* Builds in tE[i], tP[i] the curve of torsion group torsion obtained
+   from parameter smin+i, converted to affine Weierstrass form.
+   tE[i] and tP[i] are initialized in all cases.
+   Sets ok[i] to 1 if the curve could be built, 2 if a factor was found
+   (put in tf[i]), 0 if smin+i is not a valid parameter.
+   With OpenMP, each thread builds a range of consecutive parameters.
+   Returns ECM_USER_ERROR if the torsion group is unknown,
+   ECM_NO_FACTOR_FOUND otherwise.
+*/
+int
+build_many_curves(mpz_t *tf, char *ok, ell_curve_t *tE, ell_point_t *tP,
+		  const char *torsion, int smin, int nE, mpmod_t n)
+{
+    int i, g, ngroups;
+
+    for(i = 0; i < nE; i++){
+	ell_curve_init(tE[i], ECM_EC_TYPE_WEIERSTRASS, ECM_LAW_AFFINE, n);
+	ell_point_init(tP[i], tE[i], n);
+	ok[i] = 0;
+    }
+    if(torsion_is_known((char *) torsion) == 0)
+	return ECM_USER_ERROR;
+
+    ngroups = many_curves_groups(nE);
+#ifdef _OPENMP
+#pragma omp parallel for if (ngroups > 1) schedule (static, 1)
+#endif
+    for (g = 0; g < ngroups; g++)
+      {
+	mpmod_t modulus_local;
+
+	mpmod_init_set (modulus_local, n);
+	build_many_curves_range (tf, ok, tE, tP, torsion, smin,
+				 (long) nE * g / ngroups,
+				 (long) nE * (g + 1) / ngroups, modulus_local);
+	mpmod_clear (modulus_local);
+      }
+    return ECM_NO_FACTOR_FOUND;
+}
+
+/* Runs ECM with B1 on the nE curves of torsion group torsion built
+   from the parameters smin, ..., smin+nE-1: stage 1 for all curves at
+   once, then stage 2 for each curve (with the bounds of params) which
+   neither found a factor nor reached O_E.
+   res[i] receives the result of curve i (ECM_NO_FACTOR_FOUND,
+   ECM_FACTOR_FOUND_STEP1, ECM_FACTOR_FOUND_STEP2, or ECM_ERROR if smin+i
+   gives no curve) and tf[i] the factor found by curve i, if any.
+   Returns ECM_FACTOR_FOUND_STEP1 if some curve found a factor in stage 1,
+   ECM_FACTOR_FOUND_STEP2 if some curve found one in stage 2 only,
+   ECM_NO_FACTOR_FOUND if none did, and ECM_USER_ERROR or ECM_ERROR in
+   case of error.
+*/
+int
+factor_many_curves(mpz_t *tf, int *res, mpz_t N, double B1,
+		   const char *torsion, int smin, int nE, ecm_params params)
+{
+    ell_curve_t *tE;
+    ell_point_t *tP;
+    char *ok;
+    mpmod_t modulus;
+    ecm_params q;
+    double B1done = ECM_DEFAULT_B1_DONE;
+    int ret, i;
+    long st;
+
+    set_verbose (params->verbose);
+    ECM_STDOUT = (params->os == NULL) ? stdout : params->os;
+    ECM_STDERR = (params->es == NULL) ? stdout : params->es;
+
+    if(mpmod_init(modulus, N, params->repr) != 0)
+	return ECM_ERROR;
+    tE = (ell_curve_t *) malloc (nE * sizeof (ell_curve_t));
+    tP = (ell_point_t *) malloc (nE * sizeof (ell_point_t));
+    ok = (char *) malloc (nE * sizeof (char));
+    if (tE == NULL || tP == NULL || ok == NULL)
+      {
+        free (tE);
+        free (tP);
+        free (ok);
+        mpmod_clear (modulus);
+        return ECM_ERROR;
+      }
+
+    st = cputime ();
+    ret = build_many_curves(tf, ok, tE, tP, torsion, smin, nE, modulus);
+    if(ret == ECM_USER_ERROR){
+	outputf (OUTPUT_ERROR, "Error, unknown torsion group %s\n", torsion);
+	for(i = 0; i < nE; i++)
+	    res[i] = ECM_ERROR;
+	goto clear;
+    }
+    for(i = 0; i < nE; i++)
+	res[i] = (ok[i] == 0) ? ECM_ERROR :
+	    (ok[i] == 2) ? ECM_FACTOR_FOUND_STEP1 : ECM_NO_FACTOR_FOUND;
+
+    ret = all_curves_at_once(tf, ok, tE, tP, nE, modulus, B1, &B1done,
+			     params->stop_asap);
+    outputf (OUTPUT_NORMAL, "Step 1 of %d curves took %ldms\n", nE,
+	     elltime (st, cputime ()));
+    if(ret == ECM_ERROR){
+	/* the curves which found no factor did not complete stage 1 */
+	for(i = 0; i < nE; i++)
+	    res[i] = (ok[i] == 2) ? ECM_FACTOR_FOUND_STEP1 : ECM_ERROR;
+	goto clear;
+    }
+
+    /* stage 2, one curve at a time, with the bounds of params */
+    ecm_init(q);
+    mpz_set(q->B2min, params->B2min);
+    mpz_set(q->B2, params->B2);
+    q->k = params->k;
+    q->S = params->S;
+    q->repr = params->repr;
+    q->nobase2step2 = params->nobase2step2;
+    q->verbose = params->verbose;
+    q->os = params->os;
+    q->es = params->es;
+    q->TreeFilename = params->TreeFilename;
+    q->maxmem = params->maxmem;
+    q->use_ntt = params->use_ntt;
+    q->stop_asap = params->stop_asap;
+    q->sigma_is_A = -1;
+    q->E->type = ECM_EC_TYPE_WEIERSTRASS;
+    q->E->law = ECM_LAW_AFFINE;
+    ret = ECM_NO_FACTOR_FOUND;
+    for(i = 0; i < nE; i++){
+	if(ok[i] == 2){
+	    res[i] = ECM_FACTOR_FOUND_STEP1;
+	    ret = ECM_FACTOR_FOUND_STEP1;
+	    continue;
+	}
+	if(ok[i] == 0 || B1done < B1)
+	    continue;
+	mpres_get_z(q->x, tP[i]->x, modulus);
+	mpres_get_z(q->y, tP[i]->y, modulus);
+	mpres_get_z(q->sigma, tE[i]->a4, modulus);
+	mpz_set(q->E->a4, q->sigma);
+	q->param = ECM_PARAM_DEFAULT;
+	q->B1done = B1done;
+	res[i] = ecm_factor(tf[i], N, B1, q);
+	if(res[i] == ECM_FACTOR_FOUND_STEP2 && ret == ECM_NO_FACTOR_FOUND)
+	    ret = ECM_FACTOR_FOUND_STEP2;
+    }
+    ecm_clear(q);
+
+ clear:
+    for(i = 0; i < nE; i++){
+	ell_point_clear(tP[i], tE[i], modulus);
+	ell_curve_clear(tE[i], modulus);
+    }
+    free(tE);
+    free(tP);
+    free(ok);
+    mpmod_clear(modulus);
+    return ret;
+}
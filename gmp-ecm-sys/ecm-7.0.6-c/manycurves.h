@@ -0,0 +1,26 @@
+/* In all pt_many_* functions, ok[i] is 1 for the curves still in use,
+   0 for those whose point reached O_E, and 2 for those which found
+   a factor, put in tf[i]. */
+
+int compute_all_inverses(mpz_t f, mpres_t *inv, mpres_t *x, int nx,
+			 mpmod_t n, char *takeit);
+void pt_many_set_to_zero(ell_point_t *tP, int nE, mpmod_t n);
+void pt_many_neg(ell_point_t *tP, int nE, mpmod_t n);
+void pt_many_assign(ell_point_t *tQ, ell_point_t *tP, int nE, mpmod_t n);
+void pt_many_print(ell_curve_t *tE, ell_point_t *tP, int nE, mpmod_t n);
+int pt_many_duplicate(mpz_t *tf, ell_point_t *tQ, ell_point_t *tP,
+		      ell_curve_t *tE, int nE, mpmod_t n,
+		      mpres_t *num, mpres_t *den, mpres_t *inv, char *ok);
+int pt_many_add(mpz_t *tf, ell_point_t *tR, ell_point_t *tP, ell_point_t *tQ,
+		ell_curve_t *tE, int nE, mpmod_t n,
+		mpres_t *num, mpres_t *den, mpres_t *inv, char *ok);
+int pt_many_mul(mpz_t *tf, ell_point_t *tQ, ell_point_t *tP, ell_curve_t *tE,
+		int nE, mpz_t e, mpmod_t n,
+		mpres_t *num, mpres_t *den, mpres_t *inv, char *ok);
+int all_curves_at_once(mpz_t *tf, char *ok, ell_curve_t *tE, ell_point_t *tP,
+		       int nE, mpmod_t n, double B1, double *B1done,
+		       int (*stop_asap)(void));
+int build_many_curves(mpz_t *tf, char *ok, ell_curve_t *tE, ell_point_t *tP,
+		      const char *torsion, int smin, int nE, mpmod_t n);
+int factor_many_curves(mpz_t *tf, int *res, mpz_t N, double B1,
+		       const char *torsion, int smin, int nE, ecm_params params);
@@ -22,9 +22,16 @@ http://www.gnu.org/licenses/ or write to the Free Software Foundation, Inc.,
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "ecm-gmp.h"
 #include "ecm-impl.h"
 #include "mpmod.h"
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h> /* for gethostname */
+#endif
 
 #ifdef USE_ASM_REDC
   #include "mulredc.h"
@@ -49,6 +56,9 @@ static void ecm_mulredc_basecase (mpres_t, const mpres_t, const mpres_t,
                                   mpmod_t) ATTRIBUTE_HOT;
 static void base2mod (mpres_t, const mpres_t, mpres_t, mpmod_t) ATTRIBUTE_HOT;
 static void REDC (mpres_t, const mpres_t, mpz_t, mpmod_t);
+#ifndef TUNE
+static void mpmod_profile_init (void);
+#endif
 
 /* returns +/-l if n is a factor of N = 2^l +/- 1 with N <= n^threshold, 
    0 otherwise.
@@ -565,8 +575,19 @@ mulredc_1 (mp_ptr z, const mp_limb_t x, mp_srcptr y, mp_srcptr m,
 #endif /* ifdef HAVE_NATIVE_MULREDC1_N */
 #endif
 
-static int tune_mulredc_table[] = TUNE_MULREDC_TABLE;
-static int tune_sqrredc_table[] = TUNE_SQRREDC_TABLE;
+/* The thresholds between MODMULN, mpz_mod and REDC and the mulredc tables
+   default to the values of ecm-params.h. mpmod_tune() measures them on the
+   running host, and mpmod_init() loads them from the profile of the host
+   (see mpmod_profile_load) the first time it is called. */
+#ifdef TUNE
+#define mpzmod_threshold MPZMOD_THRESHOLD
+#define redc_threshold REDC_THRESHOLD
+#else
+static size_t mpzmod_threshold = MPZMOD_THRESHOLD;
+static size_t redc_threshold = REDC_THRESHOLD;
+#endif
+static int tune_mulredc_table[MULREDC_ASSEMBLY_MAX + 1] = TUNE_MULREDC_TABLE;
+static int tune_sqrredc_table[MULREDC_ASSEMBLY_MAX + 1] = TUNE_SQRREDC_TABLE;
 
 static void 
 ecm_mulredc_basecase_n (mp_ptr rp, mp_srcptr s1p, mp_srcptr s2p, 
@@ -754,6 +775,10 @@ mpmod_init (mpmod_t modulus, const mpz_t N, int repr)
   int base2 = 0, r = 0;
   mp_size_t n = mpz_size (N);
 
+#ifndef TUNE
+  mpmod_profile_init ();
+#endif
+
   switch (repr)
     {
     case ECM_MOD_DEFAULT:
@@ -767,9 +792,9 @@ mpmod_init (mpmod_t modulus, const mpz_t N, int repr)
       __attribute__ ((fallthrough));
 #endif
     case ECM_MOD_NOBASE2:
-      if (mpz_size (N) < MPZMOD_THRESHOLD)
+      if (mpz_size (N) < mpzmod_threshold)
 	repr = ECM_MOD_MODMULN;
-      else if (mpz_size (N) < REDC_THRESHOLD)
+      else if (mpz_size (N) < redc_threshold)
         repr = ECM_MOD_MPZ;
       else
 	repr = ECM_MOD_REDC;
@@ -1836,7 +1861,6 @@ mpres_sub_ui (mpres_t R, const mpres_t S, const unsigned long n,
   ASSERT_NORMALIZED (R);
 }
 
-#if 0
 /* R <- n - S mod modulus
    If repr == ECM_MOD_MODMULN or ECM_MOD_REDC, we need to convert n to
    Montgomery representation before substracting
@@ -1861,7 +1885,6 @@ mpres_ui_sub (mpres_t R, const unsigned long n ,const mpres_t S,
     }
   ASSERT_NORMALIZED (R);
 }
-#endif
 
 /* R <- S1 - S2 mod modulus */
 void 
@@ -2066,6 +2089,7 @@ mpres_out_str (FILE *fd, const unsigned int base, const mpres_t S,
   mpres_get_z (modulus->temp2, S, modulus);
   mpz_out_str (fd, base, modulus->temp2);
 }
+#endif
 
 /* Multiplies S1 by the one-limb integer S2, and does modulo reduction.
    The modulo reduction may imply multiplication of the residue class 
@@ -2137,6 +2161,8 @@ mpres_muldivbysomething_si (mpres_t R, const mpres_t S, const long n,
   ASSERT_NORMALIZED (R);
 }
 
+#if 0 /* those routines are not called in normal operation */
+
 /* Returns 1 if successful, 0 if not */
 static int
 test_mpres_set_z_for_gcd_fix (const int maxk, mpmod_t modulus)
@@ -2475,3 +2501,476 @@ mpresn_addsub (mpres_t R, mpres_t T,
       SIZ(T) = SIZ(S1);
     }
 }
+
+/* Return the number of mpres_mul (mpres_sqr if sqr is non-zero) per
+   millisecond with representation repr (ECM_MOD_MPZ, ECM_MOD_MODMULN or
+   ECM_MOD_REDC), for a random modulus of the given number of limbs,
+   doubling the number of iterations until they take at least granularity
+   milliseconds. */
+double
+mpmod_tune_mul (mp_size_t limbs, int repr, int sqr, gmp_randstate_t rng,
+                long granularity)
+{
+  mpmod_t modulus;
+  mpres_t x, y, z;
+  mpz_t N, p, q;
+  unsigned long i, k = 1;
+  long st;
+
+  mpz_init (N);
+  mpz_init (p);
+  mpz_init (q);
+
+  /* No need to generate a probable prime, just ensure N is not
+     divisible by 2 or 3 */
+  do
+    {
+      mpz_urandomb (N, rng, limbs * GMP_NUMB_BITS);
+      while (mpz_gcd_ui (NULL, N, 6) != 1)
+        mpz_add_ui (N, N, 1);
+    }
+  while ((mp_size_t) mpz_size (N) != limbs);
+
+  if (repr == ECM_MOD_MPZ)
+    mpmod_init_MPZ (modulus, N);
+  else if (repr == ECM_MOD_MODMULN)
+    mpmod_init_MODMULN (modulus, N);
+  else
+    mpmod_init_REDC (modulus, N);
+
+  mpz_urandomm (p, rng, N);
+  mpz_urandomm (q, rng, N);
+
+  mpres_init (x, modulus);
+  mpres_init (y, modulus);
+  mpres_init (z, modulus);
+
+  mpres_set_z (x, p, modulus);
+  mpres_set_z (y, q, modulus);
+
+  do
+    {
+      st = cputime ();
+      for (i = 0; i < k; i++)
+        if (sqr)
+          mpres_sqr (z, x, modulus);
+        else
+          mpres_mul (z, x, y, modulus);
+      k *= 2;
+    }
+  while (elltime (st, cputime ()) < granularity);
+  k /= 2;
+  st = elltime (st, cputime ());
+
+  mpres_clear (x, modulus);
+  mpres_clear (y, modulus);
+  mpres_clear (z, modulus);
+  mpmod_clear (modulus);
+  mpz_clear (N);
+  mpz_clear (p);
+  mpz_clear (q);
+
+  return (double) k / (double) st;
+}
+
+/* Do n mpres_mul (mpres_sqr if sqr is non-zero) modulo the odd number N
+   with representation repr (ECM_MOD_MPZ, ECM_MOD_MODMULN or ECM_MOD_REDC),
+   on residues N/3 and N/5. For benchmarks: the setup of the modulus is
+   included, and the result is thrown away. */
+void
+mpmod_mul_run (const mpz_t N, int repr, int sqr, unsigned long n)
+{
+  mpmod_t modulus;
+  mpres_t x, y, z;
+  mpz_t t;
+  unsigned long i;
+
+  if (repr == ECM_MOD_MPZ)
+    mpmod_init_MPZ (modulus, N);
+  else if (repr == ECM_MOD_MODMULN)
+    mpmod_init_MODMULN (modulus, N);
+  else
+    mpmod_init_REDC (modulus, N);
+
+  mpz_init (t);
+  mpres_init (x, modulus);
+  mpres_init (y, modulus);
+  mpres_init (z, modulus);
+  mpz_tdiv_q_ui (t, N, 3);
+  mpres_set_z (x, t, modulus);
+  mpz_tdiv_q_ui (t, N, 5);
+  mpres_set_z (y, t, modulus);
+
+  for (i = 0; i < n; i++)
+    if (sqr)
+      mpres_sqr (z, x, modulus);
+    else
+      mpres_mul (z, x, y, modulus);
+
+  mpres_clear (x, modulus);
+  mpres_clear (y, modulus);
+  mpres_clear (z, modulus);
+  mpz_clear (t);
+  mpmod_clear (modulus);
+}
+
+#ifndef TUNE
+
+/* Each measurement of mpmod_tune() takes at least that many milliseconds
+   (the tune program uses 250ms); all of them take a few seconds. */
+#define MPMOD_TUNE_GRANULARITY 10
+
+/* Sizes up to which the thresholds are searched, as in tune.c */
+#define MPMOD_TUNE_MAX_LIMBS 512
+
+/* file header, followed by lines "<key> <value>" */
+#define MPMOD_PROFILE_MAGIC "# GMP-ECM mpmod profile"
+
+#define MPMOD_HOST_MAX 256
+
+static int mpmod_profile_checked = 0; /* mpmod_init() looked for a profile */
+
+#ifdef HAVE_PTHREAD_H
+static pthread_once_t mpmod_profile_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t mpmod_profile_lock = PTHREAD_MUTEX_INITIALIZER;
+#define MPMOD_PROFILE_LOCK() pthread_mutex_lock (&mpmod_profile_lock)
+#define MPMOD_PROFILE_UNLOCK() pthread_mutex_unlock (&mpmod_profile_lock)
+#else
+#define MPMOD_PROFILE_LOCK()
+#define MPMOD_PROFILE_UNLOCK()
+#endif
+
+/* The mulredc modes which are compiled in; the other ones fall through to
+   the next mode in ecm_mulredc_basecase_n(). */
+static const int mulredc_modes[] = {
+#ifdef USE_ASM_REDC
+  MPMOD_MULREDC,
+#endif
+#ifdef HAVE___GMPN_REDC_1
+  MPMOD_MUL_REDC1,
+#endif
+#ifdef HAVE___GMPN_REDC_2
+  MPMOD_MUL_REDC2,
+#endif
+  MPMOD_MUL_REDC_C
+};
+
+static void
+mpmod_host_name (char *host, size_t n)
+{
+  const char *s = NULL;
+
+#ifdef HAVE_UNISTD_H
+  if (gethostname (host, n) == 0)
+    {
+      host[n - 1] = '\0';
+      return;
+    }
+#endif
+#ifdef _WIN32
+  s = getenv ("COMPUTERNAME");
+#endif
+  strncpy (host, (s != NULL) ? s : "unknown", n);
+  host[n - 1] = '\0';
+}
+
+/* Put in path the profile file to use when filename is NULL:
+   $ECM_MPMOD_PROFILE, or $HOME/.ecm-mpmod-<host name>, so that a shared home
+   directory holds one profile per host. Return 0 on success, non-zero if
+   there is none (ECM_MPMOD_PROFILE is set to an empty string, or HOME is
+   not set). */
+static int
+mpmod_profile_path (char *path, size_t n, const char *filename)
+{
+  char host[MPMOD_HOST_MAX];
+  const char *s;
+
+  if (filename == NULL)
+    filename = getenv ("ECM_MPMOD_PROFILE");
+  if (filename != NULL)
+    {
+      if (*filename == '\0' || strlen (filename) >= n)
+        return 1;
+      strcpy (path, filename);
+      return 0;
+    }
+
+  s = getenv ("HOME");
+  if (s == NULL)
+    return 1;
+  mpmod_host_name (host, sizeof (host));
+  return snprintf (path, n, "%s/.ecm-mpmod-%s", s, host) >= (int) n;
+}
+
+/* Search the first size in [min_n, max_n) at which repr1 is at least as fast
+   as repr0 by bisection, as crossover() in tune.c. Return max_n if there is
+   none. */
+static size_t
+mpmod_tune_crossover (int repr0, int repr1, size_t min_n, size_t max_n,
+                      gmp_randstate_t rng)
+{
+  size_t mid_n;
+
+  while (min_n < max_n)
+    {
+      mid_n = (min_n + max_n) / 2;
+      if (mpmod_tune_mul (mid_n, repr0, 0, rng, MPMOD_TUNE_GRANULARITY) >
+          mpmod_tune_mul (mid_n, repr1, 0, rng, MPMOD_TUNE_GRANULARITY))
+        min_n = mid_n + 1;
+      else
+        max_n = mid_n;
+    }
+
+  return min_n;
+}
+
+/* Measure the mulredc tables (as bench_mulredc does) and the MODMULN,
+   mpz_mod and REDC thresholds (as tune does) on this host, and use them from
+   now on. The timings are in process CPU time, so nothing else should run
+   in the process meanwhile; must not be called while another thread uses
+   a modulus. */
+void
+mpmod_tune (void)
+{
+  gmp_randstate_t rng;
+  double t, best_t;
+  size_t nn, i;
+  int sqr, *table, best;
+
+  gmp_randinit_default (rng);
+  MPMOD_PROFILE_LOCK();
+
+  /* The tables first: they change the speed of MODMULN, and thus the
+     threshold between MODMULN and mpz_mod */
+  for (nn = 1; nn <= MULREDC_ASSEMBLY_MAX; nn++)
+    for (sqr = 0; sqr <= 1; sqr++)
+      {
+        table = sqr ? tune_sqrredc_table : tune_mulredc_table;
+        best = table[nn];
+        best_t = 0.0;
+        for (i = 0; i < sizeof (mulredc_modes) / sizeof (int); i++)
+          {
+            table[nn] = mulredc_modes[i];
+            t = mpmod_tune_mul (nn, ECM_MOD_MODMULN, sqr, rng,
+                                MPMOD_TUNE_GRANULARITY);
+            if (t > best_t)
+              {
+                best_t = t;
+                best = mulredc_modes[i];
+              }
+          }
+        table[nn] = best;
+      }
+
+  mpzmod_threshold = mpmod_tune_crossover (ECM_MOD_MODMULN, ECM_MOD_MPZ, 1,
+                                           MPMOD_TUNE_MAX_LIMBS, rng);
+  redc_threshold = mpmod_tune_crossover (ECM_MOD_MPZ, ECM_MOD_REDC,
+                                         mpzmod_threshold,
+                                         MPMOD_TUNE_MAX_LIMBS, rng);
+  mpmod_profile_checked = 1;
+
+  MPMOD_PROFILE_UNLOCK();
+  gmp_randclear (rng);
+}
+
+/* Write the current thresholds and tables to filename (or to the default
+   profile if NULL), with the host name and the GMP and GMP-ECM versions
+   that mpmod_profile_load() checks. Return 0 on success. */
+int
+mpmod_profile_save (const char *filename)
+{
+  char path[FILENAME_MAX], tmp[FILENAME_MAX], host[MPMOD_HOST_MAX];
+  FILE *f;
+  int i, ret = 1;
+
+  if (mpmod_profile_path (path, sizeof (path), filename) != 0)
+    return 1;
+  mpmod_host_name (host, sizeof (host));
+
+  /* several processes starting at once on a host may all tune and save */
+  f = aux_fopen_tmp (tmp, sizeof (tmp), path);
+  if (f == NULL)
+    return 1;
+  MPMOD_PROFILE_LOCK();
+  fprintf (f, "%s\n", MPMOD_PROFILE_MAGIC);
+  fprintf (f, "host %s\n", host);
+  fprintf (f, "ecm %s\n", ECM_VERSION);
+  fprintf (f, "gmp %s\n", gmp_version);
+  fprintf (f, "limb_bits %d\n", GMP_NUMB_BITS);
+  fprintf (f, "mpzmod_threshold %lu\n", (unsigned long) mpzmod_threshold);
+  fprintf (f, "redc_threshold %lu\n", (unsigned long) redc_threshold);
+  fprintf (f, "mulredc");
+  for (i = 1; i <= MULREDC_ASSEMBLY_MAX; i++)
+    fprintf (f, " %d", tune_mulredc_table[i]);
+  fprintf (f, "\nsqrredc");
+  for (i = 1; i <= MULREDC_ASSEMBLY_MAX; i++)
+    fprintf (f, " %d", tune_sqrredc_table[i]);
+  fprintf (f, "\n");
+  MPMOD_PROFILE_UNLOCK();
+  if (ferror (f) == 0)
+    ret = 0;
+  if (fclose (f) != 0)
+    ret = 1;
+
+  /* readers never see a partial profile */
+  if (ret == 0 && rename (tmp, path) != 0)
+    ret = 1;
+  if (ret != 0)
+    remove (tmp);
+
+  return ret;
+}
+
+/* Parse the line "<key> <mode for 1 limb> ... <mode for
+   MULREDC_ASSEMBLY_MAX limbs>" into table. Return non-zero on success. */
+static int
+mpmod_profile_table (const char *line, const char *key, int *table)
+{
+  size_t len = strlen (key);
+  char *end;
+  long v;
+  int i;
+
+  if (strncmp (line, key, len) != 0)
+    return 0;
+  line += len;
+  for (i = 1; i <= MULREDC_ASSEMBLY_MAX; i++)
+    {
+      v = strtol (line, &end, 10);
+      if (end == line || v < MPMOD_MULREDC || v > MPMOD_MUL_REDC_C)
+        return 0;
+      table[i] = (int) v;
+      line = end;
+    }
+
+  return 1;
+}
+
+/* Read a profile written by mpmod_profile_save() on this host with the
+   same versions of GMP and GMP-ECM; the caller holds the lock. */
+static int
+mpmod_profile_read (const char *filename)
+{
+  char path[FILENAME_MAX], host[MPMOD_HOST_MAX];
+  char line[MPMOD_HOST_MAX + 16], expected[MPMOD_HOST_MAX + 16];
+  int mul[MULREDC_ASSEMBLY_MAX + 1], sqr[MULREDC_ASSEMBLY_MAX + 1];
+  unsigned long mpzmod = 0, redc = 0;
+  FILE *f;
+  int i, ok = 1;
+
+  if (mpmod_profile_path (path, sizeof (path), filename) != 0)
+    return 1;
+  f = fopen (path, "r");
+  if (f == NULL)
+    return 1;
+
+  mpmod_host_name (host, sizeof (host));
+  for (i = 0; i < 9 && ok; i++)
+    {
+      ok = fgets (line, sizeof (line), f) != NULL;
+      if (!ok)
+        break;
+      switch (i)
+        {
+        case 0: /* header and the lines that must match this host and build */
+          snprintf (expected, sizeof (expected), "%s\n", MPMOD_PROFILE_MAGIC);
+          break;
+        case 1:
+          snprintf (expected, sizeof (expected), "host %s\n", host);
+          break;
+        case 2:
+          snprintf (expected, sizeof (expected), "ecm %s\n", ECM_VERSION);
+          break;
+        case 3:
+          snprintf (expected, sizeof (expected), "gmp %s\n", gmp_version);
+          break;
+        case 4:
+          snprintf (expected, sizeof (expected), "limb_bits %d\n",
+                    GMP_NUMB_BITS);
+          break;
+        case 5:
+          ok = sscanf (line, "mpzmod_threshold %lu", &mpzmod) == 1;
+          continue;
+        case 6:
+          ok = sscanf (line, "redc_threshold %lu", &redc) == 1
+               && mpzmod <= redc;
+          continue;
+        case 7:
+          ok = mpmod_profile_table (line, "mulredc", mul);
+          continue;
+        default:
+          ok = mpmod_profile_table (line, "sqrredc", sqr);
+          continue;
+        }
+      ok = strcmp (line, expected) == 0;
+    }
+  fclose (f);
+  if (!ok)
+    return 1;
+
+  mpzmod_threshold = mpzmod;
+  redc_threshold = redc;
+  for (i = 1; i <= MULREDC_ASSEMBLY_MAX; i++)
+    {
+      tune_mulredc_table[i] = mul[i];
+      tune_sqrredc_table[i] = sqr[i];
+    }
+  mpmod_profile_checked = 1;
+
+  return 0;
+}
+
+/* Load the thresholds and tables from filename (or from the default
+   profile if NULL). A profile from another host or another version of GMP
+   or GMP-ECM is rejected. Return 0 on success; must not be called while
+   another thread uses a modulus. */
+int
+mpmod_profile_load (const char *filename)
+{
+  int ret;
+
+  MPMOD_PROFILE_LOCK();
+  ret = mpmod_profile_read (filename);
+  MPMOD_PROFILE_UNLOCK();
+
+  return ret;
+}
+
+/* Keep the thresholds and tables built in: the default profile is not
+   loaded when the first modulus is built. Has no effect once a modulus
+   has been built or a profile loaded. */
+void
+mpmod_profile_skip (void)
+{
+  MPMOD_PROFILE_LOCK();
+  mpmod_profile_checked = 1;
+  MPMOD_PROFILE_UNLOCK();
+}
+
+static void
+mpmod_profile_first (void)
+{
+  MPMOD_PROFILE_LOCK();
+  if (!mpmod_profile_checked)
+    {
+      mpmod_profile_checked = 1;
+      mpmod_profile_read (NULL);
+    }
+  MPMOD_PROFILE_UNLOCK();
+}
+
+/* Load the default profile, if any, the first time a modulus is built.
+   Every other modulus waits until the tables are set, and afterwards only
+   pays for pthread_once. */
+static void
+mpmod_profile_init (void)
+{
+#ifdef HAVE_PTHREAD_H
+  pthread_once (&mpmod_profile_once, mpmod_profile_first);
+#else
+  if (!mpmod_profile_checked)
+    mpmod_profile_first ();
+#endif
+}
+
+#endif /* TUNE */
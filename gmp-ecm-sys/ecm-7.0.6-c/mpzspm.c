@@ -23,6 +23,9 @@ MA 02110-1301, USA. */
 #include <stdlib.h>
 #include "sp.h"
 #include "ecm-impl.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 /* Tables for the maximum possible modulus (in bit size) for different 
    transform lengths l.
@@ -156,6 +159,44 @@ mpzspm_product_tree_init (mpzspm_t mpzspm)
   mpzspm->d = d;
 }
 
+/* The parallel-for given to each new mpzspm_t */
+static mpzspm_parallel_for_t mpzspm_default_parallel_for = NULL;
+static void *mpzspm_default_parallel_for_ctx = NULL;
+
+/* Must not be called while stage 2 runs in another thread */
+void
+mpzspm_set_parallel_for (mpzspm_parallel_for_t parallel_for, void *ctx)
+{
+  mpzspm_default_parallel_for = parallel_for;
+  mpzspm_default_parallel_for_ctx = ctx;
+}
+
+/* Call body (i, data) for 0 <= i < n, where each call works on vectors of
+   len residues, through the parallel-for of mpzspm if there is one.
+   Otherwise, with OpenMP, the iterations of long vectors are shared with
+   the same static schedule as their first touch in mpzspv_init, so that
+   each thread works on the pages it placed. The loop stays serial for short
+   vectors, and inside a parallel region, such as the product tree branches
+   of ecm_ntt.c. */
+void
+mpzspm_parallel_for (mpzspm_t mpzspm, unsigned long n,
+                     spv_size_t len ATTRIBUTE_UNUSED, mpzspm_body_t body,
+                     void *data)
+{
+  long i;
+
+  if (mpzspm->parallel_for != NULL && n > 1)
+    mpzspm->parallel_for (n, body, data, mpzspm->parallel_for_ctx);
+  else
+    {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if (len > 16384 && !omp_in_parallel ())
+#endif
+      for (i = 0; i < (long) n; i++)
+        body ((unsigned long) i, data);
+    }
+}
+
 /* This function initializes a mpzspm_t structure which contains the number
    of small primes, the small primes with associated primitive roots and 
    precomputed data for the CRT to allow convolution products of length up 
@@ -176,6 +217,8 @@ mpzspm_init (spv_size_t max_len, mpz_t modulus)
   mpzspm = (mpzspm_t) malloc (sizeof (__mpzspm_struct));
   if (mpzspm == NULL)
     return NULL;
+  mpzspm->parallel_for = mpzspm_default_parallel_for;
+  mpzspm->parallel_for_ctx = mpzspm_default_parallel_for_ctx;
   
   /* Upper bound for the number of primes we need.
    * Let minp, maxp denote the min, max permissible prime,
@@ -266,8 +309,11 @@ mpzspm_init (spv_size_t max_len, mpz_t modulus)
   mpzspm->crt3 = (spv_t) malloc (mpzspm->sp_num * sizeof (sp_t));
   mpzspm->crt4 = (spv_t *) malloc (mpzspm->sp_num * sizeof (spv_t));
   mpzspm->crt5 = (spv_t) malloc (mpzspm->sp_num * sizeof (sp_t));
+  mpzspm->crt6_size = mpz_size (modulus);
+  mpzspm->crt6 = (mp_limb_t *) malloc (mpzspm->sp_num * mpzspm->crt6_size
+                                       * sizeof (mp_limb_t));
   CHECK(mpzspm->crt1 == NULL || mpzspm->crt2 == NULL || mpzspm->crt3 == NULL ||
-        mpzspm->crt4 == NULL || mpzspm->crt5 == NULL,
+        mpzspm->crt4 == NULL || mpzspm->crt5 == NULL || mpzspm->crt6 == NULL,
         "Out of memory in mpzspm_init()\n", error_clear_crt);
 
   for (i = 0; i < mpzspm->sp_num; i++)
@@ -294,6 +340,11 @@ mpzspm_init (spv_size_t max_len, mpz_t modulus)
       mpz_init (mpzspm->crt1[i]);
       mpz_mod (mpzspm->crt1[i], T, modulus);
 
+      /* crt6 + i * crt6_size = crt1[i], zero-padded to crt6_size limbs */
+      MPN_ZERO (mpzspm->crt6 + i * mpzspm->crt6_size, mpzspm->crt6_size);
+      MPN_COPY (mpzspm->crt6 + i * mpzspm->crt6_size, PTR(mpzspm->crt1[i]),
+                SIZ(mpzspm->crt1[i]));
+
       /* crt4[i][j] = ((P / p[i]) mod modulus) mod p[j] */
       for (j = 0; j < mpzspm->sp_num; j++)
         {
@@ -341,6 +392,7 @@ mpzspm_init (spv_size_t max_len, mpz_t modulus)
   free (mpzspm->crt3);
   free (mpzspm->crt4);
   free (mpzspm->crt5);
+  free (mpzspm->crt6);
   
   error_clear_mpzspm_spm:
   for (i = 0; i < mpzspm->sp_num; i++)
@@ -396,9 +448,28 @@ void mpzspm_clear (mpzspm_t mpzspm)
   free (mpzspm->crt3);
   free (mpzspm->crt4);
   free (mpzspm->crt5);
+  free (mpzspm->crt6);
   
   mpz_clear (mpzspm->modulus);
   free (mpzspm->spm);
   free (mpzspm);
 }
 
+
+/* Return the smallest transform length >= len that mpzspm supports. This
+   is a power of 2, or 3 times a power of 2 if that is smaller and divides
+   the maximal transform length, which saves up to a third of the
+   zero-padding when len is just above a power of 2. */
+spv_size_t
+mpzspm_ntt_size (const mpzspm_t mpzspm, spv_size_t len)
+{
+  spv_size_t size2, size3;
+
+  size2 = (spv_size_t) 1 << ceil_log_2 (len);
+  size3 = (spv_size_t) 3 << ceil_log_2 ((len + 2) / 3);
+
+  if (size3 < size2 && mpzspm->max_ntt_size % size3 == 0)
+    return size3;
+
+  return size2;
+}
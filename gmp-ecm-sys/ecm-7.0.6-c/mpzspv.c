@@ -50,6 +50,16 @@ mpzspv_init (spv_size_t len, mpzspm_t mpzspm)
 	  return NULL;
 	}
     }
+
+#ifdef _OPENMP
+  /* Touch each vector from the thread that will transform it: without
+     an executor set by ecm_set_parallel_for, mpzspm_parallel_for runs the
+     loops over the primes with the same static schedule, so that the pages
+     of x[i] are placed on that thread's NUMA node */
+#pragma omp parallel for schedule(static) if (len > 16384)
+  for (i = 0; i < mpzspm->sp_num; i++)
+    spv_set_zero (x[i], len);
+#endif
   
   return x;
 }
@@ -238,22 +248,30 @@ int mpzspv_to_mpzv_time = 0;
 int mpzspv_normalise_time = 0;
 #endif
 
-/* convert mpzvi to CRT representation, naive version */
+/* convert mpzv[0..len-1] to CRT representation in x[][offset..offset+len-1],
+   naive version. Each prime runs over the whole block, which fits in the
+   cache, so that its constants stay in registers. */
 static void
-mpzspv_from_mpzv_slow (mpzspv_t x, const spv_size_t offset, mpz_t mpzvi,
-                       mpzspm_t mpzspm)
+mpzspv_from_mpzv_slow (mpzspv_t x, const spv_size_t offset, const mpzv_t mpzv,
+                       const spv_size_t len, mpzspm_t mpzspm)
 {
   const unsigned int sp_num = mpzspm->sp_num;
   unsigned int j;
+  spv_size_t c;
   mp_size_t n = mpz_size (mpzspm->modulus);
 
 #ifdef TIMING_CRT
   mpzspv_from_mpzv_slow_time -= cputime ();
 #endif
   for (j = 0; j < sp_num; j++)
-    x[j][offset] = ecm_mod_1 (PTR(mpzvi), SIZ(mpzvi),
-                              (mp_limb_t) mpzspm->spm[j]->sp, n,
-                              mpzspm->spm[j]->invm, mpzspm->spm[j]->Bpow);
+    {
+      const spm_t spm = mpzspm->spm[j];
+      spv_t spv = x[j] + offset;
+
+      for (c = 0; c < len; c++)
+        spv[c] = ecm_mod_1 (PTR(mpzv[c]), SIZ(mpzv[c]), (mp_limb_t) spm->sp,
+                            n, spm->invm, spm->Bpow);
+    }
 #ifdef TIMING_CRT
   mpzspv_from_mpzv_slow_time += cputime ();
 #endif
@@ -261,38 +279,44 @@ mpzspv_from_mpzv_slow (mpzspv_t x, const spv_size_t offset, mpz_t mpzvi,
      as wide as sp_t */
 }
 
-/* convert mpzvi to CRT representation, fast version, assumes
-   mpzspm->T has been precomputed (see mpzspm.c).
+/* convert mpzv[0..len-1] to CRT representation in x[][offset..offset+len-1],
+   fast version, assumes mpzspm->T has been precomputed (see mpzspm.c).
+   The whole block goes down the remainder tree together, so that each
+   node of T is used for all coefficients while it is in the cache.
+   U is scratch space of len * sp_num initialized mpz_t's, U[c * sp_num + j]
+   holding the remainder of mpzv[c] at the node starting with prime j.
    Warning: this function should be thread-safe, since it might be called
    simultaneously by several threads. */
 static void
-mpzspv_from_mpzv_fast (mpzspv_t x, const spv_size_t offset, mpz_t mpzvi,
-                       mpzspm_t mpzspm)
+mpzspv_from_mpzv_fast (mpzspv_t x, const spv_size_t offset, const mpzv_t mpzv,
+                       const spv_size_t len, mpzv_t U, mpzspm_t mpzspm)
 {
   const unsigned int sp_num = mpzspm->sp_num;
   unsigned int i, j, k, i0 = I0_THRESHOLD, I0;
+  spv_size_t c;
   mpzv_t *T = mpzspm->T;
-  mpz_t *U;
   unsigned int d = mpzspm->d, ni;
 
-  U = malloc (sp_num * sizeof (mpz_t));
-  for (j = 0; j < sp_num; j++)
-    mpz_init (U[j]);
-
   ASSERT (d > i0);
 
-  /* initially we split mpzvi in two */
+  /* initially we split each mpzv[c] in two */
   ni = 1 << (d - 1);
-  mpz_mod (U[0], mpzvi, T[d-1][0]);
-  mpz_mod (U[ni], mpzvi, T[d-1][1]);
+  for (c = 0; c < len; c++)
+    {
+      mpz_mod (U[c * sp_num], mpzv[c], T[d-1][0]);
+      mpz_mod (U[c * sp_num + ni], mpzv[c], T[d-1][1]);
+    }
   for (i = d-1; i-- > i0;)
     { /* goes down from depth i+1 to i */
       ni = 1 << i;
       for (j = k = 0; j + ni < sp_num; j += 2*ni, k += 2)
-        {
-          mpz_mod (U[j+ni], U[j], T[i][k+1]);
-          mpz_mod (U[j], U[j], T[i][k]);
-        }
+        for (c = 0; c < len; c++)
+          {
+            mpz_t *u = U + c * sp_num + j;
+
+            mpz_mod (u[ni], u[0], T[i][k+1]);
+            mpz_mod (u[0], u[0], T[i][k]);
+          }
       /* for the last entry U[j] if j < sp_num, there is nothing to do */
     }
   /* last steps */
@@ -300,15 +324,59 @@ mpzspv_from_mpzv_fast (mpzspv_t x, const spv_size_t offset, mpz_t mpzvi,
   for (j = 0; j < sp_num; j += I0)
     {
       for (k = j; k < j + I0 && k < sp_num; k++)
-        x[k][offset] = mpn_mod_1 (PTR(U[j]), SIZ(U[j]),
-                                  (mp_limb_t) mpzspm->spm[k]->sp);
+        {
+          const mp_limb_t p = (mp_limb_t) mpzspm->spm[k]->sp;
+          spv_t spv = x[k] + offset;
+
+          for (c = 0; c < len; c++)
+            spv[c] = mpn_mod_1 (PTR(U[c * sp_num + j]),
+                                SIZ(U[c * sp_num + j]), p);
+        }
     }
   /* The typecast to mp_limb_t assumes that mp_limb_t is at least
      as wide as sp_t */
+}
 
-  for (j = 0; j < sp_num; j++)
-    mpz_clear (U[j]);
-  free(U);
+/* convert mpzv[start..end-1] to CRT representation, one block of
+   MPZSPV_FROM_MPZV_BLOCK coefficients at a time */
+static void
+mpzspv_from_mpzv_range (mpzspv_t x, const spv_size_t offset,
+                        const mpzv_t mpzv, const spv_size_t start,
+                        const spv_size_t end, mpzspm_t mpzspm)
+{
+  spv_size_t c, l, n = 0;
+  mpzv_t U = NULL;
+
+  if (start >= end)
+    return;
+
+  if (mpzspm->T != NULL)
+    {
+      /* the remainders keep their allocation from one block to the next */
+      n = MIN (MPZSPV_FROM_MPZV_BLOCK, end - start) * mpzspm->sp_num;
+      U = init_list (n);
+      if (U == NULL)
+        {
+          fprintf (stderr, "Cannot allocate memory in mpzspv_from_mpzv\n");
+          exit (1);
+        }
+    }
+
+  for (l = start; l < end; l += MPZSPV_FROM_MPZV_BLOCK)
+    {
+      spv_size_t stride = MIN (MPZSPV_FROM_MPZV_BLOCK, end - l);
+
+      for (c = l; c < l + stride; c++)
+        ASSERT(mpz_sgn (mpzv[c]) >= 0); /* We can't handle negative values */
+
+      if (U == NULL)
+        mpzspv_from_mpzv_slow (x, offset + l, mpzv + l, stride, mpzspm);
+      else
+        mpzspv_from_mpzv_fast (x, offset + l, mpzv + l, stride, U, mpzspm);
+    }
+
+  if (U != NULL)
+    clear_list (U, n);
 }
 
 #if defined(TRACE_mpzspv_from_mpzv) || defined(TRACE_ntt_sqr_reciprocal)
@@ -327,34 +395,15 @@ ntt_print_vec (const char *msg, const spv_t spv, const spv_size_t l,
 }
 #endif
 
-/* Convert m to CRT representation modulo sp_num moduli */
-static inline void
-mpzspv_from_mpzv_one(mpzspv_t x, const spv_size_t offset, mpz_t m, mpzspm_t mpzspm)
-{
-  unsigned int j;
-  if (mpz_sgn (m) == 0)
-    {
-      const unsigned int sp_num = mpzspm->sp_num;
-      for (j = 0; j < sp_num; j++)
-        x[j][offset] = 0;
-    }
-  else
-    {
-      ASSERT(mpz_sgn (m) > 0); /* We can't handle negative values */
-      if (mpzspm->T == NULL)
-        mpzspv_from_mpzv_slow (x, offset, m, mpzspm);
-      else
-        mpzspv_from_mpzv_fast (x, offset, m, mpzspm);
-    }
-}
-
 /* convert an array of len mpz_t numbers to CRT representation modulo
    sp_num moduli */
 void
 mpzspv_from_mpzv (mpzspv_t x, const spv_size_t offset, const mpzv_t mpzv,
     const spv_size_t len, mpzspm_t mpzspm)
 {
+#ifdef TRACE_mpzspv_from_mpzv
   long i;
+#endif
   ASSERT (mpzspv_verify (x, offset + len, 0, mpzspm));
   ASSERT (sizeof (mp_limb_t) >= sizeof (sp_t));
 
@@ -373,21 +422,26 @@ mpzspv_from_mpzv (mpzspv_t x, const spv_size_t offset, const mpzv_t mpzv,
      returns 0. Unfortunately, even with only 1 thread nested parallel regions
      incur large overhead with (possibly useless?) futex syscalls. */
   if (omp_get_level() == 0) {
-    /* Multi-threading with dynamic scheduling slows things down */
-#pragma omp parallel private(i) if (len > 16384)
-#pragma omp for schedule(static)
-    for (i = 0; i < (long) len; i++)
+    /* Multi-threading with dynamic scheduling slows things down, so each
+       thread gets one contiguous range of whole blocks */
+#pragma omp parallel if (len > 16384)
     {
-      mpzspv_from_mpzv_one(x, i + offset, mpzv[i], mpzspm);
+      const spv_size_t blocks = (len + MPZSPV_FROM_MPZV_BLOCK - 1)
+                                / MPZSPV_FROM_MPZV_BLOCK;
+      const spv_size_t t = omp_get_thread_num (), nt = omp_get_num_threads ();
+
+      mpzspv_from_mpzv_range (x, offset, mpzv,
+                              MIN (len, blocks * t / nt
+                                        * MPZSPV_FROM_MPZV_BLOCK),
+                              MIN (len, blocks * (t + 1) / nt
+                                        * MPZSPV_FROM_MPZV_BLOCK),
+                              mpzspm);
     }
   } else {
 #endif
 
     /* Code path without OpenMP */
-    for (i = 0; i < (long) len; i++)
-    {
-      mpzspv_from_mpzv_one(x, i + offset, mpzv[i], mpzspm);
-    }
+    mpzspv_from_mpzv_range (x, offset, mpzv, 0, len, mpzspm);
 #if defined(_OPENMP)
   }
 #endif
@@ -410,21 +464,30 @@ mpzspv_from_mpzv (mpzspv_t x, const spv_size_t offset, const mpzv_t mpzv,
  * t_i = u_i q_i mod p_i. Then u = P \alpha - P round(\alpha) where
  * \alpha = \sum_i t_i/p_i
  *
+ * The coefficients are reconstructed MPZSPV_NORMALISE_STRIDE at a time as
+ * limb vectors: for each small prime, the t_i of the whole block are
+ * computed by one spv_mul_sp call, and t_i * (P/p_i mod N) is accumulated
+ * with mpn_addmul_1 from the limb matrix crt6, so that x[i] and the row of
+ * crt6 are streamed once per block.
+ *
  * time: O(len * sp_num^2) where sp_num is proportional to the modulus size
- * memory: MPZSPV_NORMALISE_STRIDE floats */
+ * memory: MPZSPV_NORMALISE_STRIDE floats, sp's and (n + 2) limbs each,
+ *         where n = mpzspm->crt6_size */
 void
 mpzspv_to_mpzv (mpzspv_t x, spv_size_t offset, mpzv_t mpzv,
     spv_size_t len, mpzspm_t mpzspm)
 {
   unsigned int i;
   spv_size_t k, l;
+  const mp_size_t n = mpzspm->crt6_size, an = n + 2;
   float *f = (float *) malloc (MPZSPV_NORMALISE_STRIDE * sizeof (float));
+  spv_t t = (spv_t) malloc (MPZSPV_NORMALISE_STRIDE * sizeof (sp_t));
+  mp_limb_t *acc = (mp_limb_t *) malloc (MPZSPV_NORMALISE_STRIDE * an
+                                         * sizeof (mp_limb_t));
   float prime_recip;
-  sp_t t;
   spm_t *spm = mpzspm->spm;
-  mpz_t mt;
 
-  if (f == NULL)
+  if (f == NULL || t == NULL || acc == NULL)
     {
       fprintf (stderr, "Cannot allocate memory in mpzspv_to_mpzv\n");
       exit (1);
@@ -432,50 +495,45 @@ mpzspv_to_mpzv (mpzspv_t x, spv_size_t offset, mpzv_t mpzv,
   
   ASSERT (mpzspv_verify (x, offset, len, mpzspm));
   ASSERT_ALWAYS(mpzspm->sp_num <= 1677721);
+  ASSERT (sizeof (mp_limb_t) >= sizeof (sp_t));
 
 #ifdef TIMING_CRT
   mpzspv_to_mpzv_time -= cputime ();
 #endif
-  mpz_init (mt);
   for (l = 0; l < len; l += MPZSPV_NORMALISE_STRIDE)
     {
       spv_size_t stride = MIN (MPZSPV_NORMALISE_STRIDE, len - l);
 
       /* we apply the above theorem to mpzv[l]...mpzv[l+stride-1] at once */
       for (k = 0; k < stride; k++)
-        {
-          f[k] = 0.5; /* this is performed len times */
-          mpz_set_ui (mpzv[k + l], 0);
-        }
+        f[k] = 0.5; /* this is performed len times */
+      MPN_ZERO (acc, stride * an);
   
     for (i = 0; i < mpzspm->sp_num; i++)
       {
         /* this loop is performed len*sp_num/MPZSPV_NORMALISE_STRIDE times */
+        const mp_limb_t *crt1 = mpzspm->crt6 + i * n;
 
         /* prime_recip = 1/p_i * (1+u)^2 wih |u| <= 2^(-24) where one
            exponent is due to the sp -> float conversion, and one to the
            division */
         prime_recip = 1.0f / (float) spm[i]->sp; /* 1/p_i */
+
+        /* crt3[i] = p_i/P mod p_i (q_i in the theorem) */
+        spv_mul_sp (t, x[i] + l + offset, mpzspm->crt3[i], stride,
+                    spm[i]->sp, spm[i]->mul_c);
       
         for (k = 0; k < stride; k++)
           {
             /* this loop is performed len*sp_num times */
+            mp_limb_t *a = acc + k * an, cy;
 
-            /* crt3[i] = p_i/P mod p_i (q_i in the theorem) */
-  	    t = sp_mul (x[i][l + k + offset], mpzspm->crt3[i], spm[i]->sp,
-                  spm[i]->mul_c);
-
-            /* crt1[i] = P / p_i mod modulus: we accumulate in mpzv[l + k]
-               the sum of P t_i/p_i = t_i (P/p_i) mod N.
-               If N has n limbs, crt1[i] has n limbs too,
-               thus mpzv[l+k] has about n limbs */
-            if (sizeof (sp_t) > sizeof (unsigned long))
-              {
-                mpz_set_sp (mt, t);
-                mpz_addmul (mpzv[l + k], mpzspm->crt1[i], mt);
-              }
-            else
-              mpz_addmul_ui (mpzv[l + k], mpzspm->crt1[i], t);
+            /* crt1[i] = P / p_i mod modulus: we accumulate in a the sum
+               of P t_i/p_i = t_i (P/p_i) mod N. Each term is less than
+               p_i B^n, so the sum fits in n + 2 limbs */
+            cy = mpn_addmul_1 (a, crt1, n, (mp_limb_t) t[k]);
+            a[n] += cy;
+            a[n + 1] += (a[n] < cy);
 
             /* After the conversion from t to float and the multiplication,
                the value of (float) t * prime_recip = t/p_i * (1+v)^4
@@ -485,16 +543,30 @@ mpzspv_to_mpzv (mpzspv_t x, spv_size_t offset, mpzv_t mpzv,
                than 0.5, we need sp_num <= 2^23/5 thus sp_num <= 1677721.
                This corresponds to a number of at most 15656374 digits on a
                32-bit machine, and at most 31312749 digits on 64-bit. */
-	    f[k] += (float) t * prime_recip;
+	    f[k] += (float) t[k] * prime_recip;
           }
       }
 
-    /* crt2[i] = -i*P mod modulus */
     for (k = 0; k < stride; k++)
-      mpz_add (mpzv[l + k], mpzv[l + k], mpzspm->crt2[(unsigned int) f[k]]);
+      {
+        mp_limb_t *a = acc + k * an;
+        /* crt2[i] = -i*P mod modulus */
+        mpz_srcptr c = mpzspm->crt2[(unsigned int) f[k]];
+        mp_size_t size = an;
+
+        if (SIZ(c) != 0)
+          {
+            mp_limb_t cy = mpn_add (a, a, an, PTR(c), SIZ(c));
+            ASSERT_ALWAYS (cy == 0);
+          }
+        MPN_NORMALIZE (a, size);
+        MPN_COPY (MPZ_REALLOC (mpzv[l + k], size), a, size);
+        SIZ(mpzv[l + k]) = size;
+      }
   }
   
-  mpz_clear (mt);
+  free (acc);
+  free (t);
   free (f);
 #ifdef TIMING_CRT
   mpzspv_to_mpzv_time += cputime ();
@@ -537,7 +609,8 @@ mpzspv_normalise (mpzspv_t x, spv_size_t offset, spv_size_t len,
   unsigned int i, j, sp_num = mpzspm->sp_num;
   spv_size_t k, l;
   sp_t v;
-  spv_t s, d, w;
+  spv_t w;
+  mp_limb_t *s, *d;
   spm_t *spm = mpzspm->spm;
   float prime_recip;
   float *f;
@@ -549,8 +622,8 @@ mpzspv_normalise (mpzspv_t x, spv_size_t offset, spv_size_t len,
   ASSERT (mpzspv_verify (x, offset, len, mpzspm));
 
   f = (float *) malloc (MPZSPV_NORMALISE_STRIDE * sizeof (float));
-  s = (spv_t) malloc (3 * MPZSPV_NORMALISE_STRIDE * sizeof (sp_t));
-  d = (spv_t) malloc (3 * MPZSPV_NORMALISE_STRIDE * sizeof (sp_t));
+  s = (mp_limb_t *) malloc (3 * MPZSPV_NORMALISE_STRIDE * sizeof (mp_limb_t));
+  d = (mp_limb_t *) malloc (3 * MPZSPV_NORMALISE_STRIDE * sizeof (mp_limb_t));
   if (f == NULL || s == NULL || d == NULL)
     {
       fprintf (stderr, "Cannot allocate memory in mpzspv_normalise\n");
@@ -558,7 +631,7 @@ mpzspv_normalise (mpzspv_t x, spv_size_t offset, spv_size_t len,
     }
   t = mpzspv_init (MPZSPV_NORMALISE_STRIDE, mpzspm);
   
-  memset (s, 0, 3 * MPZSPV_NORMALISE_STRIDE * sizeof (sp_t));
+  memset (s, 0, 3 * MPZSPV_NORMALISE_STRIDE * sizeof (mp_limb_t));
 
   for (l = 0; l < len; l += MPZSPV_NORMALISE_STRIDE)
     {
@@ -591,7 +664,8 @@ mpzspv_normalise (mpzspv_t x, spv_size_t offset, spv_size_t len,
               /* this is executed len*sp_num times */
 
               /* crt5[i] = (-P mod modulus) mod p_i */
-	      umul_ppmm (d[3 * k + 1], d[3 * k], mpzspm->crt5[i], (sp_t) f[k]);
+	      umul_ppmm (d[3 * k + 1], d[3 * k], (mp_limb_t) mpzspm->crt5[i],
+	                 (mp_limb_t) f[k]);
               /* {d+3*k,2} = ((-P mod modulus) mod p_i) * round(sum(t_j/p_j)),
                  this accounts for the right term in Theorem 4.1 */
               d[3 * k + 2] = 0;
@@ -607,18 +681,19 @@ mpzspv_normalise (mpzspv_t x, spv_size_t offset, spv_size_t len,
 	      for (k = 0; k < stride; k++)
                 /* this is executed len*sp_num^2 times, and computes the left
                    term in Theorem 4.1 */
-	        umul_ppmm (s[3 * k + 1], s[3 * k], w[k + l], v);
+	        umul_ppmm (s[3 * k + 1], s[3 * k], (mp_limb_t) w[k + l],
+	                   (mp_limb_t) v);
  	      
 	      /* This mpn_add_n adds in parallel all "stride" contributions,
                  and accounts for about a third of the function's runtime.
                  Since d has size O(stride), the cumulated complexity of this
                  call is O(len*sp_num^2) */
-	      mpn_add_n ((mp_ptr) d, (mp_srcptr) d, (mp_srcptr) s, 3 * stride);
+	      mpn_add_n (d, d, s, 3 * stride);
             }      
 
           /* we finally reduce the contribution modulo each p_i */
           for (k = 0; k < stride; k++)
-            t[i][k] = mpn_mod_1 ((mp_ptr) (d + 3 * k), 3, spm[i]->sp);
+            t[i][k] = mpn_mod_1 (d + 3 * k, 3, spm[i]->sp);
         }	  
       mpzspv_set (x, l + offset, t, 0, stride, mpzspm);
     }
@@ -633,69 +708,126 @@ mpzspv_normalise (mpzspv_t x, spv_size_t offset, spv_size_t len,
 #endif
 }
 
+/* Arguments of the per-prime loops of mpzspv_to_ntt, mpzspv_from_ntt and
+   mpzspv_mul_ntt, which are run by mpzspm_parallel_for() */
+typedef struct
+{
+  mpzspv_t r, x, y;
+  spv_size_t offsetr, offsetx, offsety, lenx, leny;
+  spv_size_t ntt_size, log2_ntt_size, monic_pos;
+  int monic, steps, radix3;
+  mpzspm_t mpzspm;
+} mpzspv_ntt_args_t;
+
+/* ntt_size is either 2^k or 3 * 2^k, see mpzspm_ntt_size() */
+static void
+mpzspv_ntt_args_size (mpzspv_ntt_args_t *a, spv_size_t ntt_size)
+{
+  a->ntt_size = ntt_size;
+  a->radix3 = (ntt_size % 3 == 0);
+  a->log2_ntt_size = ceil_log_2 (a->radix3 ? ntt_size / 3 : ntt_size);
+  ASSERT (ntt_size == (spv_size_t) (a->radix3 ? 3 : 1) << a->log2_ntt_size);
+  ASSERT (a->mpzspm->max_ntt_size % ntt_size == 0);
+}
+
+/* Reduce x[i] + offset modulo X^ntt_size - 1, add the monic term and do
+   a forward transform */
+static void
+mpzspv_to_ntt_1 (spv_t spv, spv_size_t len, const mpzspv_ntt_args_t *a,
+                 spm_t spm)
+{
+  spv_size_t j;
+
+  if (a->ntt_size < len)
+    {
+      for (j = a->ntt_size; j < len; j += a->ntt_size)
+        spv_add (spv, spv, spv + j, a->ntt_size, spm->sp);
+    }
+  if (a->ntt_size > len)
+    spv_set_zero (spv + len, a->ntt_size - len);
+
+  if (a->monic)
+    spv[len % a->ntt_size] = sp_add (spv[len % a->ntt_size], 1, spm->sp);
+
+  if (a->radix3)
+    spv_ntt_gfp_dif3 (spv, a->log2_ntt_size, spm);
+  else
+    spv_ntt_gfp_dif (spv, a->log2_ntt_size, spm);
+}
+
+/* Inverse transform, divide by ntt_size and remove the monic term */
+static void
+mpzspv_from_ntt_1 (spv_t spv, const mpzspv_ntt_args_t *a, spm_t spm)
+{
+  ASSERT (sizeof (mp_limb_t) >= sizeof (sp_t));
+
+  if (a->radix3)
+    spv_ntt_gfp_dit3 (spv, a->log2_ntt_size, spm);
+  else
+    spv_ntt_gfp_dit (spv, a->log2_ntt_size, spm);
+
+  /* spm->sp - (spm->sp - 1) / ntt_size is the inverse of ntt_size */
+  spv_mul_sp (spv, spv, spm->sp - (spm->sp - 1) / a->ntt_size,
+      a->ntt_size, spm->sp, spm->mul_c);
+
+  if (a->monic_pos)
+    spv[a->monic_pos % a->ntt_size] = sp_sub (spv[a->monic_pos % a->ntt_size],
+        1, spm->sp);
+}
+
+static void
+mpzspv_to_ntt_body (unsigned long i, void *data)
+{
+  const mpzspv_ntt_args_t *a = (const mpzspv_ntt_args_t *) data;
+
+  mpzspv_to_ntt_1 (a->x[i] + a->offsetx, a->lenx, a, a->mpzspm->spm[i]);
+}
+
 void
 mpzspv_to_ntt (mpzspv_t x, spv_size_t offset, spv_size_t len,
     spv_size_t ntt_size, int monic, mpzspm_t mpzspm)
 {
-  unsigned int i;
-  spv_size_t j, log2_ntt_size;
-  spm_t spm;
-  spv_t spv;
+  mpzspv_ntt_args_t a;
   
   ASSERT (mpzspv_verify (x, offset, len, mpzspm));
   ASSERT (mpzspv_verify (x, offset + ntt_size, 0, mpzspm));
   
-  log2_ntt_size = ceil_log_2 (ntt_size);
+  a.x = x;
+  a.offsetx = offset;
+  a.lenx = len;
+  a.monic = monic;
+  a.mpzspm = mpzspm;
+  mpzspv_ntt_args_size (&a, ntt_size);
+
+  mpzspm_parallel_for (mpzspm, mpzspm->sp_num, ntt_size, mpzspv_to_ntt_body,
+                       &a);
+}
 
-  for (i = 0; i < mpzspm->sp_num; i++)
-    {
-      spm = mpzspm->spm[i];
-      spv = x[i] + offset;
-      
-      if (ntt_size < len)
-        {
-	  for (j = ntt_size; j < len; j += ntt_size)
-	    spv_add (spv, spv, spv + j, ntt_size, spm->sp);
-	}
-      if (ntt_size > len)
-	spv_set_zero (spv + len, ntt_size - len);
+#if 0
+static void
+mpzspv_from_ntt_body (unsigned long i, void *data)
+{
+  const mpzspv_ntt_args_t *a = (const mpzspv_ntt_args_t *) data;
 
-      if (monic)
-	spv[len % ntt_size] = sp_add (spv[len % ntt_size], 1, spm->sp);
-      
-      spv_ntt_gfp_dif (spv, log2_ntt_size, spm);
-    }
+  mpzspv_from_ntt_1 (a->r[i] + a->offsetr, a, a->mpzspm->spm[i]);
 }
 
-#if 0
 void
 mpzspv_from_ntt (mpzspv_t x, spv_size_t offset, spv_size_t ntt_size,
                  spv_size_t monic_pos, mpzspm_t mpzspm)
 {
-  unsigned int i;
-  spv_size_t log2_ntt_size;
-  spm_t spm;
-  spv_t spv;
+  mpzspv_ntt_args_t a;
   
   ASSERT (mpzspv_verify (x, offset, ntt_size, mpzspm));
   
-  log2_ntt_size = ceil_log_2 (ntt_size);
-
-  for (i = 0; i < mpzspm->sp_num; i++)
-    {
-      spm = mpzspm->spm[i];
-      spv = x[i] + offset;
-      
-      spv_ntt_gfp_dit (spv, log2_ntt_size, spm);
-
-      /* spm->sp - (spm->sp - 1) / ntt_size is the inverse of ntt_size */
-      spv_mul_sp (spv, spv, spm->sp - (spm->sp - 1) / ntt_size,
-	  ntt_size, spm->sp, spm->mul_c);
-      
-      if (monic_pos)
-	spv[monic_pos % ntt_size] = sp_sub (spv[monic_pos % ntt_size],
-	    1, spm->sp);
-    }
+  a.r = x;
+  a.offsetr = offset;
+  a.monic_pos = monic_pos;
+  a.mpzspm = mpzspm;
+  mpzspv_ntt_args_size (&a, ntt_size);
+
+  mpzspm_parallel_for (mpzspm, mpzspm->sp_num, ntt_size, mpzspv_from_ntt_body,
+                       &a);
 }
 #endif
 
@@ -711,6 +843,28 @@ mpzspv_random (mpzspv_t x, spv_size_t offset, spv_size_t len, mpzspm_t mpzspm)
 }
 
 
+static void
+mpzspv_mul_ntt_body (unsigned long i, void *data)
+{
+  const mpzspv_ntt_args_t *a = (const mpzspv_ntt_args_t *) data;
+  spm_t spm = a->mpzspm->spm[i];
+  spv_t spvr = a->r[i] + a->offsetr;
+  spv_t spvx = a->x[i] + a->offsetx;
+  spv_t spvy = a->y[i] + a->offsety;
+
+  if ((a->steps & NTT_MUL_STEP_FFT1) != 0)
+    mpzspv_to_ntt_1 (spvx, a->lenx, a, spm);
+
+  if ((a->steps & NTT_MUL_STEP_FFT2) != 0)
+    mpzspv_to_ntt_1 (spvy, a->leny, a, spm);
+
+  if ((a->steps & NTT_MUL_STEP_MUL) != 0)
+    spv_pwmul (spvr, spvx, spvy, a->ntt_size, spm->sp, spm->mul_c);
+
+  if ((a->steps & NTT_MUL_STEP_IFFT) != 0)
+    mpzspv_from_ntt_1 (spvr, a, spm);
+}
+
 /* Do multiplication via NTT. Depending on the value of "steps", does 
    in-place forward transform of x, in-place forward transform of y, 
    pair-wise multiplication of x by y to r, in-place inverse transform of r. 
@@ -726,8 +880,7 @@ mpzspv_mul_ntt (mpzspv_t r, const spv_size_t offsetr,
     const spv_size_t ntt_size, const int monic, const spv_size_t monic_pos, 
     mpzspm_t mpzspm, const int steps)
 {
-  spv_size_t log2_ntt_size;
-  int i;
+  mpzspv_ntt_args_t a;
   
   ASSERT (mpzspv_verify (x, offsetx, lenx, mpzspm));
   ASSERT (mpzspv_verify (y, offsety, leny, mpzspm));
@@ -735,80 +888,31 @@ mpzspv_mul_ntt (mpzspv_t r, const spv_size_t offsetr,
   ASSERT (mpzspv_verify (y, offsety + ntt_size, 0, mpzspm));
   ASSERT (mpzspv_verify (r, offsetr + ntt_size, 0, mpzspm));
   
-  log2_ntt_size = ceil_log_2 (ntt_size);
-
-  /* Need parallelization at higher level (e.g., handling a branch of the 
-     product tree in one thread) to make this worthwhile for ECM */
-#define MPZSPV_MUL_NTT_OPENMP 0
-
-#if defined(_OPENMP) && MPZSPV_MUL_NTT_OPENMP
-#pragma omp parallel if (ntt_size > 16384)
-  {
-#pragma omp for
-#endif
-  for (i = 0; i < (int) mpzspm->sp_num; i++)
-    {
-      spv_size_t j;
-      spm_t spm = mpzspm->spm[i];
-      spv_t spvr = r[i] + offsetr;
-      spv_t spvx = x[i] + offsetx;
-      spv_t spvy = y[i] + offsety;
-
-      if ((steps & NTT_MUL_STEP_FFT1) != 0) {
-        if (ntt_size < lenx)
-          {
-            for (j = ntt_size; j < lenx; j += ntt_size)
-              spv_add (spvx, spvx, spvx + j, ntt_size, spm->sp);
-          }
-        if (ntt_size > lenx)
-          spv_set_zero (spvx + lenx, ntt_size - lenx);
-
-        if (monic)
-          spvx[lenx % ntt_size] = sp_add (spvx[lenx % ntt_size], 1, spm->sp);
-
-        spv_ntt_gfp_dif (spvx, log2_ntt_size, spm);
-      }
-
-      if ((steps & NTT_MUL_STEP_FFT2) != 0) {
-        if (ntt_size < leny)
-          {
-            for (j = ntt_size; j < leny; j += ntt_size)
-              spv_add (spvy, spvy, spvy + j, ntt_size, spm->sp);
-          }
-        if (ntt_size > leny)
-          spv_set_zero (spvy + leny, ntt_size - leny);
-
-        if (monic)
-          spvy[leny % ntt_size] = sp_add (spvy[leny % ntt_size], 1, spm->sp);
-
-        spv_ntt_gfp_dif (spvy, log2_ntt_size, spm);
-      }
-
-      if ((steps & NTT_MUL_STEP_MUL) != 0) {
-        spv_pwmul (spvr, spvx, spvy, ntt_size, spm->sp, spm->mul_c);
-      }
-
-      if ((steps & NTT_MUL_STEP_IFFT) != 0) {
-        ASSERT (sizeof (mp_limb_t) >= sizeof (sp_t));
-
-        spv_ntt_gfp_dit (spvr, log2_ntt_size, spm);
-
-        /* spm->sp - (spm->sp - 1) / ntt_size is the inverse of ntt_size */
-        spv_mul_sp (spvr, spvr, spm->sp - (spm->sp - 1) / ntt_size,
-            ntt_size, spm->sp, spm->mul_c);
-
-        if (monic_pos)
-          spvr[monic_pos % ntt_size] = sp_sub (spvr[monic_pos % ntt_size],
-              1, spm->sp);
-      }
-    }
-#if defined(_OPENMP) && MPZSPV_MUL_NTT_OPENMP
-  }
-#endif
+  a.r = r;
+  a.offsetr = offsetr;
+  a.x = x;
+  a.offsetx = offsetx;
+  a.lenx = lenx;
+  a.y = y;
+  a.offsety = offsety;
+  a.leny = leny;
+  a.monic = monic;
+  a.monic_pos = monic_pos;
+  a.steps = steps;
+  a.mpzspm = mpzspm;
+  mpzspv_ntt_args_size (&a, ntt_size);
+
+  /* ECM itself parallelizes at a higher level, handling the branches of 
+     a level of the product tree in different threads (see ecm_ntt.c):
+     there the loop over the small primes is serial, unless the application
+     set a parallel-for with ecm_set_parallel_for() */
+  mpzspm_parallel_for (mpzspm, mpzspm->sp_num, ntt_size, mpzspv_mul_ntt_body,
+                       &a);
 }
 
 /* Computes a DCT-I of the length dctlen. Input is the spvlen coefficients
-   in spv. tmp is temp space and must have space for 2*dctlen-2 sp_t's */
+   in spv. tmp is temp space and must have space for 2*dctlen-2 sp_t's.
+   The DFT length 2*dctlen-2 is either 2^k or 3*2^k, see mpzspm_ntt_size() */
 
 void
 mpzspv_to_dct1 (mpzspv_t dct, const mpzspv_t spv, const spv_size_t spvlen, 
@@ -816,13 +920,18 @@ mpzspv_to_dct1 (mpzspv_t dct, const mpzspv_t spv, const spv_size_t spvlen,
 		const mpzspm_t mpzspm)
 {
   const spv_size_t l = 2 * (dctlen - 1); /* Length for the DFT */
-  const spv_size_t log2_l = ceil_log_2 (l);
+  const int radix3 = (l % 3 == 0);
+  /* Length of the radix-2 transforms */
+  const spv_size_t l2 = radix3 ? l / 3 : l;
+  const spv_size_t log2_l = ceil_log_2 (l2);
   int j;
 
+  ASSERT (l == (spv_size_t) (radix3 ? 3 : 1) << log2_l);
+
 #ifdef _OPENMP
 #pragma omp parallel private(j)
   {
-#pragma omp for
+#pragma omp for schedule(static)
 #endif
   for (j = 0; j < (int) mpzspm->sp_num; j++)
     {
@@ -844,7 +953,10 @@ mpzspv_to_dct1 (mpzspv_t dct, const mpzspv_t spv, const spv_size_t spvlen,
       printf ("]\n");
 #endif
       
-      spv_ntt_gfp_dif (tmp[j], log2_l, spm);
+      if (radix3)
+        spv_ntt_gfp_dif3 (tmp[j], log2_l, spm);
+      else
+        spv_ntt_gfp_dif (tmp[j], log2_l, spm);
 
 #if 0
       printf ("mpzspv_to_dct1: tmp[%d] = [", j);
@@ -867,7 +979,7 @@ mpzspv_to_dct1 (mpzspv_t dct, const mpzspv_t spv, const spv_size_t spvlen,
          scrambled data works */
       {
         spv_size_t m = 5;
-        for (i = 2; i < l; i += 2L)
+        for (i = 2; i < l2; i += 2L)
           {
             /* This works, but why? */
             if (i + i / 2L > m)
@@ -878,13 +990,24 @@ mpzspv_to_dct1 (mpzspv_t dct, const mpzspv_t spv, const spv_size_t spvlen,
             printf ("mpzspv_to_dct1: DFT[%lu] == DFT[%lu]\n", i, m - i);
 #endif
           }
+        /* With radix 3, the second third of the transform is the
+           reversed last third */
+        for (i = 0; radix3 && i < l2; i++)
+          ASSERT (tmp[j][l2 + i] == tmp[j][3 * l2 - 1 - i]);
       }
 #endif
 
       /* Copy coefficients to dct buffer */
-      for (i = 0; i < l / 2; i++)
+      for (i = 0; i < l2 / 2; i++)
         dct[j][i] = tmp[j][i * 2];
-      dct[j][l / 2] = tmp[j][1];
+      dct[j][l2 / 2] = tmp[j][1];
+
+      /* With radix 3, the first third of the transform is the DFT of the
+         symmetric length-l2 polynomial spv mod (X^l2 - 1), which is
+         handled as above, and the l2 coefficients of the second third
+         follow */
+      if (radix3)
+        spv_set (dct[j] + l2 / 2 + 1, tmp[j] + l2, l2);
     }
 #ifdef _OPENMP
   }
@@ -903,52 +1026,89 @@ mpzspv_to_dct1 (mpzspv_t dct, const mpzspv_t spv, const spv_size_t spvlen,
    NTT_MUL_STEP_IFFT: do inverse transform 
 */
 
+/* Point-wise product of the scrambled length-len DFT of a polynomial by
+   the DFT of a symmetric polynomial, of which dct holds the coefficients
+   0 ... len/2 as stored by mpzspv_to_dct1() */
+static void
+spv_mul_by_dct (spv_t spv, const spv_t dct, const spv_size_t len,
+                const spm_t spm)
+{
+  unsigned long i, m;
+
+  m = 5UL;
+  
+  spv[0] = sp_mul (spv[0], dct[0], spm->sp, spm->mul_c);
+  spv[1] = sp_mul (spv[1], dct[len / 2UL], spm->sp, spm->mul_c);
+  
+  for (i = 2UL; i < len; i += 2UL)
+    {
+      /* This works, but why? */
+      if (i + i / 2UL > m)
+        m = 2UL * m + 1;
+      
+      spv[i] = sp_mul (spv[i], dct[i / 2UL], spm->sp, spm->mul_c);
+      spv[m - i] = sp_mul (spv[m - i], dct[i / 2UL], spm->sp, 
+                           spm->mul_c);
+    }
+}
+
 void
 mpzspv_mul_by_dct (mpzspv_t dft, const mpzspv_t dct, const spv_size_t len, 
 		   const mpzspm_t mpzspm, const int steps)
 {
   int j;
-  spv_size_t log2_len = ceil_log_2 (len);
+  const int radix3 = (len % 3 == 0);
+  /* Length of the radix-2 transforms */
+  const spv_size_t len2 = radix3 ? len / 3 : len;
+  spv_size_t log2_len = ceil_log_2 (len2);
   
 #ifdef _OPENMP
 #pragma omp parallel private(j)
   {
-#pragma omp for
+#pragma omp for schedule(static)
 #endif
     for (j = 0; j < (int) (mpzspm->sp_num); j++)
       {
 	const spm_t spm = mpzspm->spm[j];
 	const spv_t spv = dft[j];
-	unsigned long i, m;
+	unsigned long i;
 	
 	/* Forward DFT of dft[j] */
 	if ((steps & NTT_MUL_STEP_FFT1) != 0)
-	  spv_ntt_gfp_dif (spv, log2_len, spm);
+	  {
+	    if (radix3)
+	      spv_ntt_gfp_dif3 (spv, log2_len, spm);
+	    else
+	      spv_ntt_gfp_dif (spv, log2_len, spm);
+	  }
 	
 	/* Point-wise product */
 	if ((steps & NTT_MUL_STEP_MUL) != 0)
 	  {
-	    m = 5UL;
-	    
-	    spv[0] = sp_mul (spv[0], dct[j][0], spm->sp, spm->mul_c);
-	    spv[1] = sp_mul (spv[1], dct[j][len / 2UL], spm->sp, spm->mul_c);
-	    
-	    for (i = 2UL; i < len; i += 2UL)
+	    spv_mul_by_dct (spv, dct[j], len2, spm);
+
+	    /* The second third of the DFT of the RLP follows its first
+	       third in dct, and the last third is the second one reversed */
+	    if (radix3)
 	      {
-		/* This works, but why? */
-		if (i + i / 2UL > m)
-		  m = 2UL * m + 1;
-		
-		spv[i] = sp_mul (spv[i], dct[j][i / 2UL], spm->sp, spm->mul_c);
-		spv[m - i] = sp_mul (spv[m - i], dct[j][i / 2UL], spm->sp, 
-				     spm->mul_c);
+		const spv_t dct3 = dct[j] + len2 / 2 + 1;
+
+		spv_pwmul (spv + len2, spv + len2, dct3, len2, spm->sp,
+			   spm->mul_c);
+		for (i = 0; i < len2; i++)
+		  spv[2 * len2 + i] = sp_mul (spv[2 * len2 + i],
+					      dct3[len2 - 1 - i],
+					      spm->sp, spm->mul_c);
 	      }
 	  }
 	
 	/* Inverse transform of dft[j] */
 	if ((steps & NTT_MUL_STEP_IFFT) != 0)
 	  {
-	    spv_ntt_gfp_dit (spv, log2_len, spm);
+	    if (radix3)
+	      spv_ntt_gfp_dit3 (spv, log2_len, spm);
+	    else
+	      spv_ntt_gfp_dit (spv, log2_len, spm);
 	    
 	    /* Divide by transform length. FIXME: scale the DCT of h instead */
 	    spv_mul_sp (spv, spv, spm->sp - (spm->sp - 1) / len, len, 
@@ -977,7 +1137,7 @@ mpzspv_sqr_reciprocal (mpzspv_t dft, const spv_size_t n,
 #ifdef _OPENMP
 #pragma omp parallel
   {
-#pragma omp for
+#pragma omp for schedule(static)
 #endif
     for (j = 0; j < (int) (mpzspm->sp_num); j++)
       {
@@ -23,6 +23,8 @@
 #include "torsions.h"
 #endif
 
+#include "manycurves.h"
+
 #define DEBUG_MULTI_EC 0
 #define MULTI_USE_ADD_SUB 1
 
@@ -308,7 +310,9 @@ get_add_sub_w(mpz_t e)
 	return 7;
 }
 
-/* pack everybody */
+/* pack everybody, in the limbs of s, so that s can be copied, saved
+   and cleared as any mpz_t: the last short is a nonzero end marker,
+   thus s is normalized */
 void
 add_sub_pack(mpz_t s, int w, short *S, size_t iS)
 {
@@ -316,18 +320,17 @@ add_sub_pack(mpz_t s, int w, short *S, size_t iS)
     size_t cte2 = ((size_t) 1) << 16;
     unsigned short *tmp;
 
-    nsh = iS / cte;
-    if(iS % cte != 0)
-	nsh++;
-    nsh *= cte;
-    nsh += 4;
+    nsh = (4 + iS + 1 + cte - 1) / cte; /* number of limbs */
+    mpz_realloc2(s, nsh * GMP_NUMB_BITS);
+    tmp = (unsigned short *)s->_mp_d; /* humf */
+    memset(tmp, 0, nsh * sizeof(mp_limb_t));
     /* coding */
-    tmp = (unsigned short *)malloc(nsh * sizeof(unsigned short));
     tmp[0] = w;
     tmp[1] = iS / cte2;
     tmp[2] = iS % cte2;
     memcpy(tmp+4, S, iS * sizeof(unsigned short));
-    s->_mp_d = (mp_limb_t *)tmp; /* humf */
+    tmp[nsh * cte - 1] = 1;
+    s->_mp_size = (int) nsh;
 }
 
 void add_sub_unpack(int *w, short **S, size_t *iS, mpz_t s)
@@ -685,6 +688,8 @@ compute_s_4_add_sub(mpz_t s, ecm_uint B1, int disc)
 	   elltime(tp,cputime()));
     if(iS == 0){
 	printf("build_NAF: Slen=%"PRIu64" too small\n", Slen);
+	free(S);
+	mpz_clear(t);
 	return 0;
     }
     add_sub_pack(s, w, S, iS);
@@ -947,589 +952,7 @@ one_curve_at_a_time(mpz_t f, char *ok, ell_curve_t *tE, ell_point_t *tP, int nE,
  Using parallelism.
 **********************************************************************/
 
-/********** group law on points **********/
-
-int
-pt_is_zero(ell_point_t P, ATTRIBUTE_UNUSED mpmod_t n)
-{
-    return mpz_sgn(P->z) == 0;
-}
-
-void
-pt_set_to_zero(ell_point_t P, mpmod_t n)
-{
-    mpz_set_ui(P->x, 0);
-    mpres_set_ui(P->y, 1, n);
-    mpz_set_ui(P->z, 0);
-}
-
-void
-pt_assign(ell_point_t Q, ell_point_t P, ATTRIBUTE_UNUSED mpmod_t n)
-{
-    mpres_set(Q->x, P->x, n);
-    mpres_set(Q->y, P->y, n);
-    mpres_set(Q->z, P->z, n);
-}
-
-void
-pt_neg(ell_point_t P, mpmod_t n)
-{
-    if(pt_is_zero(P, n) == 0)
-	mpres_neg(P->y, P->y, n);
-}
-
-void
-pt_many_set_to_zero(ell_point_t *tP, int nE, mpmod_t n)
-{
-    int i;
-
-    for(i = 0; i < nE; i++)
-	pt_set_to_zero(tP[i], n);
-}
-
-void
-pt_many_neg(ell_point_t *tP, int nE, mpmod_t n)
-{
-    int i;
-
-    for(i = 0; i < nE; i++)
-	pt_neg(tP[i], n);
-}
-
-void
-pt_many_assign(ell_point_t *tQ, ell_point_t *tP, int nE, mpmod_t n)
-{
-    int i;
-
-    for(i = 0; i < nE; i++)
-	pt_assign(tQ[i], tP[i], n);
-}
-
-void
-pt_print(ell_curve_t E, ell_point_t P, mpmod_t n)
-{
-    printf("[");
-    print_mpz_from_mpres(P->x, n);
-    printf(", ");
-    print_mpz_from_mpres(P->y, n);
-    printf(", ");
-    if(E->type == ECM_EC_TYPE_WEIERSTRASS && E->law == ECM_LAW_AFFINE)
-	gmp_printf("%Zd", P->z);
-    else
-	print_mpz_from_mpres(P->z, n);
-    printf("]");
-}
-
-void
-pt_many_print(ell_curve_t *tE, ell_point_t *tP, int nE, mpmod_t n)
-{
-    int i;
-
-    for(i = 0; i < nE; i++){
-	printf("%d: ", i);
-	pt_print(tE[i], tP[i], n);
-	printf(" on E.A=");
-	print_mpz_from_mpres(tE[i]->a4, n);
-	printf("\n");
-    }
-}
-
-/* Computes inv[i] = 1/x[i] using only one inversion, a la Montgomery.
-   If takeit[i] != 1, do not compute 1/x[i] (it is probably 0, or irrelevant).
-   We should have inv != x.
-   x[nx] is a buffer.
-   When a factor is found, the i s.t. x[i] is not invertible are looked for
-   and the corresponding values of takeit put to 2.
-*/
-int
-compute_all_inverses(mpz_t f, mpres_t *inv, mpres_t *x, int nx, mpmod_t n, char *takeit)
-{
-    int i;
-
-#if 0
-    /* plain version, to debug the architecture */
-    for(i = 0; i < nx; i++){
-	if(takeit[i] != 1)
-	    continue;
-	if(!mpres_invert(inv[i], x[i], n)){
-	    mpres_gcd(inv[0], x[i], n); // FIXME!!
-#if DEBUG_ADD_LAWS >= 1
-	    gmp_printf ("Factor[%d]: %Zd\n", i, inv[0]);
-#endif
-	    return 0;
-	}
-    }
-#else
-    /* Montgomery's trick */
-    for(i = 0; i < nx; i++){
-	if(takeit[i] != 1){
-	    if(i == 0)
-		mpres_set_ui(inv[i], 1, n);
-	    else
-		mpres_set(inv[i], inv[i-1], n);
-	}
-	else{
-	    if(i == 0)
-		mpres_set(inv[i], x[i], n);
-	    else
-		mpres_mul(inv[i], inv[i-1], x[i], n);
-	}
-    }
-    /* invert */
-    if(!mpres_invert(x[nx], inv[nx-1], n)){
-	mpres_gcd(f, inv[nx-1], n);
-#if DEBUG_ADD_LAWS >= 1
-	gmp_printf ("Factor[%d]: %Zd\n", i, f);
-#endif
-	/* identifying the x[i]'s */
-	for(i = 0; i < nx; i++){
-	    mpres_gcd(f, x[i], n);
-	    if(mpz_cmp_ui(f, 1) != 0){
-#if DEBUG_ADD_LAWS >= 0
-		gmp_printf ("# x[%d] not invertible: %Zd\n", i, f);
-#endif
-		/* ONE DAY: if x[nx] != inv[0], we have another factor! */
-		takeit[i] = 2;
-	    }
-	}
-	return 0;
-    }
-    /* get inverses back */
-    /* say inv = 1/(x1*x2*x3) */
-    for(i = nx-1; i > 0; i--)
-	if(takeit[i] == 1){
-	    mpres_mul(inv[i], x[nx], inv[i-1], n); /* 1/x3 = inv * (x1*x2) */
-	    mpres_mul(x[nx], x[nx], x[i], n); /* inv = 1/(x1*x2) */
-	}
-    mpres_set(inv[0], x[nx], n);
-#endif
-#if DEBUG_ADD_LAWS >= 1
-    /*    printf("# checking inverses\n"); */
-    mpres_t tmp;
-    mpres_init(tmp, n);
-    for(i = 0; i < nx; i++){
-	mpres_mul(tmp, inv[i], x[i], n);
-	mpres_get_z(tmp, tmp, n);
-	if(mpz_cmp_ui(tmp, 1) != 0)
-	    printf("ERROR in compute_all_inverses[%d]\n", i);
-    }
-    mpres_clear(tmp, n);
-#endif
-    return 1;
-}
-
-/* NOTE: we can have tR = tP or tQ.
-   In case a factor is found, it is put in num[nE].
- */
-int
-pt_many_common(mpz_t f, ell_point_t *tR, ell_point_t *tP, ell_point_t *tQ, 
-	       int nE, mpmod_t n, mpres_t *num, mpres_t *den, mpres_t *inv,
-	       char *takeit)
-{
-    int i;
-
-    if(compute_all_inverses(f, inv, den, nE, n, takeit) == 0){
-	mpz_set(num[nE], inv[0]);
-	return 0;
-    }
-    for(i = 0; i < nE; i++){
-	if(takeit[i] != 1)
-	    continue;
-	/* l:=(inv[i]*num[i]) mod N; */
-	mpres_mul(num[i], num[i], inv[i], n);
-	/* x:=(l^2-P[1]-Q[1]) mod N; */
-	mpres_sqr(den[i], num[i], n);
-	mpres_sub(den[i], den[i], tP[i]->x, n);
-	mpres_sub(den[i], den[i], tQ[i]->x, n);
-	/* tR[i]:=[x, (l*(P[1]-x)-P[2]) mod N, 1]; */
-	mpres_sub(tR[i]->x, tP[i]->x, den[i], n);
-	mpres_mul(tR[i]->x, tR[i]->x, num[i], n);
-	mpres_sub(tR[i]->y, tR[i]->x, tP[i]->y, n);
-	mpres_set(tR[i]->x, den[i], n);
-    }
-    return 1;
-}
-
-/*   In case a factor is found, it is put in num[nE]. */
-int
-pt_many_duplicate(mpz_t f, ell_point_t *tQ, ell_point_t *tP, ell_curve_t *tE,
-		  int nE, mpmod_t n, 
-		  mpres_t *num, mpres_t *den, mpres_t *inv, char *ok)
-{
-    char *takeit = (char *)malloc(nE * sizeof(char));
-    int i, res;
-
-    memcpy(takeit, ok, nE);
-    for(i = 0; i < nE; i++){
-	if(ok[i] == 0)
-	    continue; /* takeit[i] = 0 */
-	if(pt_is_zero(tP[i], n)){
-	    takeit[i] = 0;
-	    pt_set_to_zero(tQ[i], n);
-	}
-	else if(mpz_sgn(tP[i]->y) == 0){
-	    /* 2 * P[i] = O_E */
-	    takeit[i] = 0;
-	    pt_set_to_zero(tP[i], n);
-	    printf("# [2] * P[%d] = O_E\n", i);
-	}
-	else{
-	    mpres_sqr(num[i], tP[i]->x, n);
-	    mpres_mul_ui(num[i], num[i], 3, n);
-	    mpres_add(num[i], num[i], tE[i]->a4, n);
-	    mpres_mul_ui(den[i], tP[i]->y, 2, n);
-	}
-    }
-    res = pt_many_common(f, tQ, tP, tP, nE, n, num, den, inv, takeit);
-    /* TODO: case takeit[i] == 2 */
-    free(takeit);
-    return res;
-}
-
-/* R[i] <- P[i] + Q[i], or a factor is found which is put in num[nE]. */
-int
-pt_many_add(mpz_t f, ell_point_t *tR, ell_point_t *tP, ell_point_t *tQ, ell_curve_t *tE, 
-	    int nE, mpmod_t n, 
-	    mpres_t *num, mpres_t *den, mpres_t *inv, char *ok)
-{
-    char *takeit = (char *)malloc(nE * sizeof(char));
-    int i, res;
-
-    memcpy(takeit, ok, nE);
-#if DEBUG_ADD_LAWS >= 2
-    printf("In pt_many_add, adding\n");
-    pt_many_print(tE, tP, nE, n);
-    printf("and\n");
-    pt_many_print(tE, tQ, nE, n);
-#endif
-    for(i = 0; i < nE; i++){
-	if(ok[i] == 0)
-	    continue; /* takeit[i] = 0 */
-	if(pt_is_zero(tP[i], n)){
-#if DEBUG_ADD_LAWS >= 2
-	    printf("# tEP[%d] = O_{E[%d]}\n", i, i);
-#endif
-	    takeit[i] = 0;
-	    pt_assign(tR[i], tQ[i], n);
-	}
-	else if(pt_is_zero(tQ[i], n)){
-#if DEBUG_ADD_LAWS >= 2
-	    printf("# tEQ[%d] = O_{E[%d]}\n", i, i);
-#endif
-	    takeit[i] = 0;
-	    pt_assign(tR[i], tP[i], n);
-	}
-	else if(pt_is_equal(tP[i], tQ[i])){
-	    /* we should double */
-	    if(mpz_sgn(tP[i]->y) == 0){
-#if DEBUG_ADD_LAWS >= 2
-		printf("# 2 * P[%d] = O_{E[%d]}\n", i, i);
-#endif
-		takeit[i] = 0;
-		pt_set_to_zero(tR[i], n);
-	    }
-	    else{
-		/* ordinary doubling */
-		mpres_sqr(num[i], tP[i]->x, n);
-		mpres_mul_ui(num[i], num[i], 3, n);
-		mpres_add(num[i], num[i], tE[i]->a4, n);
-		mpres_mul_ui(den[i], tP[i]->y, 2, n);
-	    }
-	}
-	else if(mpres_equal(tQ[i]->x, tP[i]->x, n)){
-	    mpres_add(num[i], tQ[i]->x, tP[i]->x, n);
-	    if(mpz_sgn(num[i]) == 0){
-		takeit[i] = 0;
-		pt_set_to_zero(tR[i], n);
-	    }
-	}
-	else{
-	    mpres_sub(num[i], tQ[i]->y, tP[i]->y, n);
-	    mpres_sub(den[i], tQ[i]->x, tP[i]->x, n);
-	}
-    }
-    res = pt_many_common(f, tR, tP, tQ, nE, n, num, den, inv, takeit);
-    /* TODO: case takeit[i] == 2 */
-    free(takeit);
-    return res;
-}
-
-/* tER != tEP */
-static int
-pt_many_sub(mpz_t f, ell_point_t *tR, ell_point_t *tQ, ell_point_t *tP, ell_curve_t *tE,
-	    int nE, mpmod_t n, 
-	    mpres_t *num, mpres_t *den, mpres_t *inv, char *ok)
-{
-    int i, res;
-
-    for(i = 0; i < nE; i++)
-	if(ok[i] == 1)
-	    pt_neg(tP[i], n);
-    res = pt_many_add(f, tR, tQ, tP, tE, nE, n, num, den, inv, ok);
-    for(i = 0; i < nE; i++)
-	if(ok[i] == 1)
-	    pt_neg(tP[i], n);
-    return res;
-}
-
-/* Ordinary binary left-right addition */
-static int
-pt_many_mul_plain(mpz_t f, ell_point_t *tQ, ell_point_t *tP, ell_curve_t *tE,
-		  int nE, mpz_t e, mpmod_t n, 
-		  mpres_t *num, mpres_t *den, mpres_t *inv, char *ok)
-{
-  size_t l = mpz_sizeinbase (e, 2) - 1; /* l >= 1 */
-  int status = 1;
-
-  pt_many_assign(tQ, tP, nE, n);
-  while (l-- > 0)
-    {
-	if(pt_many_duplicate (f, tQ, tQ, tE, nE, n, num, den, inv, ok) == 0)
-	  {
-	    status = 0;
-	    break;
-	  }
-#if DEBUG_ADD_LAWS >= 2
-	printf("Rdup:="); pt_many_print(tE, tQ, nE, n); printf(";\n");
-#endif
-	if (ecm_tstbit (e, l))
-	  {
-	      if(pt_many_add (f, tQ, tP, tQ, tE, nE, n, num, den, inv, ok) == 0)
-	      {
-		status = 0;
-		break;
-	      }
-#if DEBUG_ADD_LAWS >= 2
-	      printf("Radd:="); pt_many_print(tE, tQ, nE, n); printf(";\n");
-#endif
-	  }
-    }
-  return status;
-}
-
-/* Ordinary binary left-right addition; see Solinas00. Morally, we use
- w = 2. */
-static int
-pt_many_mul_add_sub_si(mpz_t f, ell_point_t *tQ, ell_point_t *tP, ell_curve_t *tE, int nE,
-		       long c, mpmod_t n, 
-		       mpres_t *num, mpres_t *den, mpres_t *inv, char *ok)
-{
-    long u, S[64];
-    int j, iS = 0, status = 1;
-    ATTRIBUTE_UNUSED int w = 2;
-
-    /* build NAF_w(c) */
-    while(c > 0){
-	if((c & 1) == 1){
-	    /* c is odd */
-	    u = c & (long)3;
-	    if(u == 3)
-		u = -1;
-	}
-	else
-	    u = 0;
-	S[iS++] = u;
-	c >>= 1;
-    }
-    /* use it */
-    pt_many_set_to_zero(tQ, nE, n);
-    for(j = iS-1; j >= 0; j--){
-	if(pt_many_duplicate(f, tQ, tQ, tE, nE, n, num, den, inv, ok) == 0){
-	    status = 0;
-	    break;
-	}
-#if DEBUG_ADD_LAWS >= 2
-	printf("Rdup:="); pt_many_print(tE, tQ, nE, n); printf(";\n");
-#endif
-	if(S[j] == 1){
-	    if(pt_many_add(f, tQ, tQ, tP, tE, nE, n, num, den, inv, ok) == 0){
-		status = 0;
-		break;
-	    }
-#if DEBUG_ADD_LAWS >= 2
-	    printf("Radd:="); pt_many_print(tE, tQ, nE, n); printf(";\n");
-#endif
-	}
-	else if(S[j] == -1){
-	    if(pt_many_sub(f, tQ, tQ, tP, tE, nE, n, num, den, inv, ok) == 0){
-		status = 0;
-		break;
-	    }
-#if DEBUG_ADD_LAWS >= 2
-	    printf("Rsub:="); pt_many_print(tE, tQ, nE, n); printf(";\n");
-#endif
-	}
-    }
-  return status;
-}
-
-/* tEQ[i] <- e * tEP[i]; we must have tEQ != tEP */
-/* If a factor is found, it is put back in num[nE]. */
-int
-pt_many_mul(mpz_t f, ell_point_t *tQ, ell_point_t *tP, ell_curve_t *tE, int nE,
-	    mpz_t e, mpmod_t n, 
-	    mpres_t *num, mpres_t *den, mpres_t *inv, char *ok)
-{
-  size_t l;
-  int negated = 0, status = 1;
-
-  if (mpz_sgn (e) == 0)
-    {
-	pt_many_set_to_zero(tQ, nE, n);
-	return 1;
-    }
-
-  /* The negative of a point (x:y:z) is (x:-y:z) */
-  if (mpz_sgn (e) < 0)
-    {
-      negated = 1;
-      mpz_neg (e, e);
-      pt_many_neg(tP, nE, n);
-    }
-
-  if (mpz_cmp_ui (e, 1) == 0)
-    goto pt_many_mul_end;
-
-  l = mpz_sizeinbase (e, 2) - 1; /* l >= 1 */
-  if(l < 32)
-      status = pt_many_mul_add_sub_si(f, tQ, tP, tE, nE, mpz_get_si(e), n,
-				      num, den, inv, ok);
-  else
-      status = pt_many_mul_plain(f, tQ, tP, tE, nE, e, n, num, den, inv, ok);
-
-
-pt_many_mul_end:
-
-  /* Undo negation to avoid changing the caller's e value */
-  if (negated){
-    mpz_neg (e, e);
-    pt_many_neg(tP, nE, n);
-  }
-  return status;
-}
-
-/* Copied from classical ecm_stage1. */
-int
-all_curves_at_once(mpz_t f, char *ok, ell_curve_t *tE, ell_point_t *tP, int nE,
-		   mpmod_t n, double B1, double *B1done, 
-		   int (*stop_asap)(void), char *chkfilename)
-{
-    ell_point_t tQ[NCURVE_MAX], tR[NCURVE_MAX];
-    mpz_t num[NCURVE_MAX+1], den[NCURVE_MAX+1], inv[NCURVE_MAX], e;
-    double p = 0.0, r, last_chkpnt_p;
-    int ret = ECM_NO_FACTOR_FOUND;
-    long last_chkpnt_time;
-    int i;
-    prime_info_t prime_info;
-    
-    mpz_init(e);
-    for(i = 0; i < nE; i++){
-	mpres_init(tQ[i]->x, n); mpres_set(tQ[i]->x, tP[i]->x, n);
-	mpres_init(tQ[i]->y, n); mpres_set(tQ[i]->y, tP[i]->y, n);
-	mpres_init(tQ[i]->z, n); mpres_set(tQ[i]->z, tP[i]->z, n);
-	
-	mpres_init(tR[i]->x, n);
-	mpres_init(tR[i]->y, n);
-	mpres_init(tR[i]->z, n);
-	
-	mpres_init(num[i], n);
-	mpres_init(den[i], n);
-	mpres_init(inv[i], n);
-    }
-    mpres_init(num[nE], n); /* to be used as buffer in compute_all_inverses */
-    mpres_init(den[nE], n); /* to be used as buffer in compute_all_inverses */
-    
-    last_chkpnt_time = cputime ();
-    
-#if DEBUG_MULTI_EC >= 2
-    printf("Initial points:\n");
-    pt_many_print(tP, nE, n);
-#endif
-    for (r = 2.0; r <= B1; r *= 2.0)
-	if (r > *B1done){
-	    if(pt_many_duplicate (tQ, tQ, tE, nE, n, num, den, inv, ok) == 0){
-		mpz_set(f, num[nE]);
-		ret = ECM_FACTOR_FOUND_STEP1;
-		goto end_of_all;
-	    }
-#if DEBUG_MULTI_EC >= 2
-	    printf("P%ld:=", (long)r); pt_many_print(tQ, nE, n); printf(";\n");
-#endif
-	}
-
-    last_chkpnt_p = 3.;
-    prime_info_init (prime_info);
-    for (p = getprime_mt (prime_info); p <= B1; p = getprime_mt (prime_info)){
-	for (r = p; r <= B1; r *= p){
-#if DEBUG_MULTI_EC >= 2
-	    printf("## p = %ld at %ldms\n", (long)p, cputime());
-#endif
-	    if (r > *B1done){
-		mpz_set_ui(e, (ecm_uint) p);
-		if(pt_many_mul(tR, tQ, tE, nE, e, n, num, den, inv, ok) == 0){
-		    mpz_set(f, num[nE]);
-		    ret = ECM_FACTOR_FOUND_STEP1;
-		    goto end_of_all;
-		}
-#if DEBUG_MULTI_EC >= 2
-		pt_many_print(tR, nE, n);
-#endif
-		for(i = 0; i < nE; i++)
-		    if(pt_is_zero(tR[i], n))
-			ok[i] = 0;
-		pt_many_assign(tQ, tR, nE, n); /* TODO: use pointers */
-	    }
-	    if (stop_asap != NULL && (*stop_asap) ()){
-		outputf (OUTPUT_NORMAL, "Interrupted at prime %.0f\n", p);
-		break;
-	    }
-	    
-	    /* WARNING: not activated yet */
-	    if (chkfilename != NULL && p > last_chkpnt_p + 10000. && 
-		elltime (last_chkpnt_time, cputime ()) > CHKPNT_PERIOD){
-#if 0 /* TODO: make this work for many curves */
-		writechkfile (chkfilename, ECM_ECM, MAX(p, *B1done), n, A, x, y, z);
-#endif
-		last_chkpnt_p = p;
-		last_chkpnt_time = cputime ();
-	    }
-	}
-    }
- end_of_all:
-    /* If stage 1 finished normally, p is the smallest prime > B1 here.
-       In that case, set to B1 */
-    if (p > B1)
-	p = B1;
-    
-    if (p > *B1done)
-	*B1done = p;
-    
-#if 0
-    if (chkfilename != NULL)
-	writechkfile (chkfilename, ECM_ECM, *B1done, n, A, x, y, z);
-#endif
-    prime_info_clear (prime_info); /* free the prime table */
-    
-    /* put results back */
-    pt_many_assign(tP, tQ, nE, n);
-    /* normalize all points */
-    for(i = 0; i < nE; i++)
-	if(pt_is_zero(tP[i], n))
-	    pt_set_to_zero(tP[i], n);
-    /* clear temporary variables */
-    mpz_clear(e);
-    for(i = 0; i < nE; i++){
-	mpres_clear(tQ[i]->x, n);
-	mpres_clear(tQ[i]->y, n);
-	mpres_clear(tQ[i]->z, n);
-	mpres_clear(num[i], n);
-	mpres_clear(den[i], n);
-	mpres_clear(inv[i], n);
-    }
-    mpres_clear(num[nE], n);
-    mpres_clear(den[nE], n);
-    return ret;
-}
+/* the group law on many points is in manycurves.c */
 
 int
 read_and_prepare(mpz_t f ATTRIBUTE_UNUSED, mpz_t x ATTRIBUTE_UNUSED, mpq_t q,
@@ -1560,6 +983,7 @@ process_many_curves(mpz_t f, mpmod_t n, double B1, mpz_t B2,
 {
     double B1done;
     ell_point_t tQ[NCURVE_MAX];
+    mpz_t tf[NCURVE_MAX];
     char *ok = (char *)malloc(nE * sizeof(char));
     int ret = 0, i;
     long st = cputime ();
@@ -1577,10 +1001,20 @@ process_many_curves(mpz_t f, mpmod_t n, double B1, mpz_t B2,
 	ell_point_set(tQ[i], tP[i], tE[i], n);
     }
     B1done = 1.0;
-    ret = all_curves_at_once(f, ok, tE, tQ, nE, n, B1, &B1done, NULL, NULL);
+    for(i = 0; i < nE; i++)
+	mpz_init(tf[i]);
+    ret = all_curves_at_once(tf, ok, tE, tQ, nE, n, B1, &B1done, NULL);
     printf("# Step 1 took %ldms\n", elltime (st, cputime ()));
+    /* keep the factor of the first curve that found one */
+    for(i = 0; i < nE; i++)
+	if(ok[i] == 2){
+	    mpz_set(f, tf[i]);
+	    break;
+	}
+    for(i = 0; i < nE; i++)
+	mpz_clear(tf[i]);
 
-    if(ret != ECM_NO_FACTOR_FOUND){
+    if(ret == ECM_FACTOR_FOUND_STEP1){
 	ret = conclude_on_factor(n->orig_modulus, f, params->verbose);
 #if DEBUG_MULTI_EC >= 2
 	if(ret == ECM_PRIME_FAC_PRIME_COFAC || ret == ECM_PRIME_FAC_COMP_COFAC)
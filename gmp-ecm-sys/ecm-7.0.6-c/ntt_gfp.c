@@ -21,6 +21,155 @@ MA 02110-1301, USA. */
 #include "sp.h"
 #include "ecm-impl.h"
 
+/*--------------------------- FOUR-STEP NTT ------------------------------*/
+
+/* Number of columns the four-step transforms gather at a time */
+#define NTT_FOURSTEP_COLUMNS 16
+
+/* The blocks of powers of a root are built on the stack so that one spm
+   can be used by several threads at once. Align them on 16 bytes for
+   the SSE2 code. */
+#define NTT_BLOCK_ALIGN(buf) \
+  ((spv_t) (buf) + ((16 - (size_t) (buf) % 16) % 16) / sizeof (sp_t))
+#define NTT_BLOCK_ALLOC (MAX_NTT_BLOCK_SIZE + 16 / sizeof (sp_t))
+
+static spv_size_t
+bit_reverse (spv_size_t i, spv_size_t bits)
+{
+  spv_size_t r = 0;
+
+  for (; bits > 0; bits--, i >>= 1)
+    r = (r << 1) | (i & 1);
+
+  return r;
+}
+
+/* x[i] *= root^i for 0 <= i < len */
+static void
+spv_mul_powers (spv_t x, sp_t root, spv_size_t len, sp_t p, sp_t d)
+{
+  sp_t wbuf[NTT_BLOCK_ALLOC];
+  spv_t w = NTT_BLOCK_ALIGN (wbuf);
+  spv_size_t i, block_size = MIN(len, MAX_NTT_BLOCK_SIZE);
+
+  w[0] = 1;
+  for (i = 1; i < block_size; i++)
+    w[i] = sp_mul (w[i-1], root, p, d);
+
+  root = sp_pow (root, block_size, p, d);
+
+  for (i = 0; i < len; i += block_size)
+    {
+      if (i)
+        spv_mul_sp (w, w, root, block_size, p, d);
+
+      spv_pwmul (x + i, x + i, w, block_size, p, d);
+    }
+}
+
+/* Apply ntt to the 2^log2_cols columns of length 2^log2_rows of x, stored
+   row by row. The columns are copied to buf NTT_FOURSTEP_COLUMNS at a time
+   so that the transforms work on contiguous data. */
+static void
+spv_ntt_columns (spv_t x, spv_size_t log2_rows, spv_size_t log2_cols,
+                 spv_t buf, spm_t data,
+                 void (*ntt) (spv_t, spv_size_t, spm_t))
+{
+  spv_size_t rows = (spv_size_t) 1 << log2_rows;
+  spv_size_t cols = (spv_size_t) 1 << log2_cols;
+  spv_size_t ncols = MIN(cols, NTT_FOURSTEP_COLUMNS);
+  spv_size_t i, j, k;
+
+  for (j = 0; j < cols; j += ncols)
+    {
+      for (i = 0; i < rows; i++)
+        for (k = 0; k < ncols; k++)
+          buf[k * rows + i] = x[i * cols + j + k];
+
+      for (k = 0; k < ncols; k++)
+        ntt (buf + k * rows, log2_rows, data);
+
+      for (i = 0; i < rows; i++)
+        for (k = 0; k < ncols; k++)
+          x[i * cols + j + k] = buf[k * rows + i];
+    }
+}
+
+/* Four-step (Bailey) transforms for data that doesn't fit in the L2
+   cache. x is seen as a 2^log2_rows by 2^log2_cols matrix: the columns
+   are transformed, the element in row i, column c is multiplied by
+   root^(c * bitrev(i)), and then the rows are transformed. This gives
+   the same bit-reversed output as the radix-2 dif code. The dit
+   transform performs the same steps in reverse order.
+
+   The twiddle factors of a row are the powers of a single root, which
+   costs one sp_pow per row; a table of all of them would be as large
+   as the data itself. Return 0 if the column buffer can't be allocated,
+   in which case nothing has been done. */
+static int
+spv_ntt_gfp_dif_fourstep (spv_t x, spv_size_t log2_len, spm_t data)
+{
+  sp_t p = data->sp;
+  sp_t d = data->mul_c;
+  spv_size_t log2_cols = log2_len / 2;
+  spv_size_t log2_rows = log2_len - log2_cols;
+  spv_size_t cols = (spv_size_t) 1 << log2_cols;
+  spv_size_t i;
+  sp_t root = data->nttdata->ntt_roots[log2_len];
+  spv_t buf;
+
+  buf = (spv_t) sp_aligned_malloc ((NTT_FOURSTEP_COLUMNS << log2_rows) *
+                                   sizeof (sp_t));
+  if (buf == NULL)
+    return 0;
+
+  spv_ntt_columns (x, log2_rows, log2_cols, buf, data, spv_ntt_gfp_dif);
+  sp_aligned_free (buf);
+
+  for (i = 0; i < ((spv_size_t) 1 << log2_rows); i++)
+    {
+      if (i)
+        spv_mul_powers (x + i * cols,
+                        sp_pow (root, bit_reverse (i, log2_rows), p, d),
+                        cols, p, d);
+      spv_ntt_gfp_dif (x + i * cols, log2_cols, data);
+    }
+
+  return 1;
+}
+
+static int
+spv_ntt_gfp_dit_fourstep (spv_t x, spv_size_t log2_len, spm_t data)
+{
+  sp_t p = data->sp;
+  sp_t d = data->mul_c;
+  spv_size_t log2_cols = log2_len / 2;
+  spv_size_t log2_rows = log2_len - log2_cols;
+  spv_size_t cols = (spv_size_t) 1 << log2_cols;
+  spv_size_t i;
+  sp_t root = data->inttdata->ntt_roots[log2_len];
+  spv_t buf;
+
+  buf = (spv_t) sp_aligned_malloc ((NTT_FOURSTEP_COLUMNS << log2_rows) *
+                                   sizeof (sp_t));
+  if (buf == NULL)
+    return 0;
+
+  for (i = 0; i < ((spv_size_t) 1 << log2_rows); i++)
+    {
+      spv_ntt_gfp_dit (x + i * cols, log2_cols, data);
+      if (i)
+        spv_mul_powers (x + i * cols,
+                        sp_pow (root, bit_reverse (i, log2_rows), p, d),
+                        cols, p, d);
+    }
+
+  spv_ntt_columns (x, log2_rows, log2_cols, buf, data, spv_ntt_gfp_dit);
+  sp_aligned_free (buf);
+
+  return 1;
+}
+
 /*--------------------------- FORWARD NTT --------------------------------*/
 static void bfly_dif(spv_t x0, spv_t x1, spv_t w,
 			spv_size_t len, sp_t p, sp_t d)
@@ -316,6 +465,9 @@ spv_ntt_gfp_dif (spv_t x, spv_size_t log2_len, spm_t data)
 	        data->nttdata->twiddle_size - (1 << log2_len);
       spv_ntt_dif_core (x, w, log2_len, p, d);
     }
+  else if (log2_len > NTT_GFP_FOURSTEP_THRESHOLD &&
+           spv_ntt_gfp_dif_fourstep (x, log2_len, data))
+    return;
   else
     {
       /* recursive version for data that
@@ -329,7 +481,8 @@ spv_ntt_gfp_dif (spv_t x, spv_size_t log2_len, spm_t data)
           spv_size_t i;
 	  spv_size_t block_size = MIN(len, MAX_NTT_BLOCK_SIZE);
           sp_t root = roots[log2_len];
-	  spv_t w = data->scratch;
+	  sp_t wbuf[NTT_BLOCK_ALLOC];
+	  spv_t w = NTT_BLOCK_ALIGN (wbuf);
 
 	  w[0] = 1;
 	  for (i = 1; i < block_size; i++)
@@ -643,6 +796,9 @@ spv_ntt_gfp_dit (spv_t x, spv_size_t log2_len, spm_t data)
 	        data->inttdata->twiddle_size - (1 << log2_len);
       spv_ntt_dit_core (x, w, log2_len, p, d);
     }
+  else if (log2_len > NTT_GFP_FOURSTEP_THRESHOLD &&
+           spv_ntt_gfp_dit_fourstep (x, log2_len, data))
+    return;
   else
     {
       spv_size_t len = 1 << (log2_len - 1);
@@ -657,7 +813,8 @@ spv_ntt_gfp_dit (spv_t x, spv_size_t log2_len, spm_t data)
           spv_size_t i;
 	  spv_size_t block_size = MIN(len, MAX_NTT_BLOCK_SIZE);
           sp_t root = roots[log2_len];
-	  spv_t w = data->scratch;
+	  sp_t wbuf[NTT_BLOCK_ALLOC];
+	  spv_t w = NTT_BLOCK_ALIGN (wbuf);
 
 	  w[0] = 1;
 	  for (i = 1; i < block_size; i++)
@@ -675,3 +832,72 @@ spv_ntt_gfp_dit (spv_t x, spv_size_t log2_len, spm_t data)
 	}
     }
 }
+
+/*--------------------------- RADIX-3 NTT --------------------------------*/
+
+/* Transforms of length 3 * 2^log2_len, which must divide sp - 1. With
+   L = 2^log2_len, x is split into thirds x0, x1, x2 and reduced modulo
+   X^L - w^j for j = 0, 1, 2, where w is a primitive cube root of unity.
+   Substituting X = g^j Y, where g^L = w, turns each remainder into a
+   cyclic convolution of length L that the radix-2 code transforms.
+   The output is in no natural order, but the dit transform undoes it. */
+void
+spv_ntt_gfp_dif3 (spv_t x, spv_size_t log2_len, spm_t data)
+{
+  sp_t p = data->sp;
+  sp_t d = data->mul_c;
+  spv_size_t i, len = (spv_size_t) 1 << log2_len;
+  spv_t x0 = x, x1 = x + len, x2 = x + 2 * len;
+  sp_t g = data->nttdata->ntt3_roots[log2_len];
+  sp_t g2 = sp_sqr (g, p, d);
+  sp_t w = data->nttdata->ntt3_roots[0];
+  sp_t t1 = 1, t2 = 1;
+
+  for (i = 0; i < len; i++)
+    {
+      sp_t a = x0[i], b = x1[i], c = x2[i];
+      /* w^2 = -1 - w, so the remainders need a single multiplication */
+      sp_t s = sp_mul (sp_sub (b, c, p), w, p, d);
+
+      x0[i] = sp_add (sp_add (a, b, p), c, p);
+      x1[i] = sp_mul (sp_add (sp_sub (a, c, p), s, p), t1, p, d);
+      x2[i] = sp_mul (sp_sub (sp_sub (a, b, p), s, p), t2, p, d);
+      t1 = sp_mul (t1, g, p, d);
+      t2 = sp_mul (t2, g2, p, d);
+    }
+
+  spv_ntt_gfp_dif (x0, log2_len, data);
+  spv_ntt_gfp_dif (x1, log2_len, data);
+  spv_ntt_gfp_dif (x2, log2_len, data);
+}
+
+void
+spv_ntt_gfp_dit3 (spv_t x, spv_size_t log2_len, spm_t data)
+{
+  sp_t p = data->sp;
+  sp_t d = data->mul_c;
+  spv_size_t i, len = (spv_size_t) 1 << log2_len;
+  spv_t x0 = x, x1 = x + len, x2 = x + 2 * len;
+  sp_t g = data->inttdata->ntt3_roots[log2_len];
+  sp_t g2 = sp_sqr (g, p, d);
+  sp_t w = data->inttdata->ntt3_roots[0];
+  sp_t t1 = 1, t2 = 1;
+
+  spv_ntt_gfp_dit (x0, log2_len, data);
+  spv_ntt_gfp_dit (x1, log2_len, data);
+  spv_ntt_gfp_dit (x2, log2_len, data);
+
+  for (i = 0; i < len; i++)
+    {
+      sp_t a = x0[i];
+      sp_t b = sp_mul (x1[i], t1, p, d);
+      sp_t c = sp_mul (x2[i], t2, p, d);
+      sp_t s = sp_mul (sp_sub (b, c, p), w, p, d);
+
+      x0[i] = sp_add (sp_add (a, b, p), c, p);
+      x1[i] = sp_add (sp_sub (a, c, p), s, p);
+      x2[i] = sp_sub (sp_sub (a, b, p), s, p);
+      t1 = sp_mul (t1, g, p, d);
+      t2 = sp_mul (t2, g2, p, d);
+    }
+}
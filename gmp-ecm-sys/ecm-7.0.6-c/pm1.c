@@ -210,6 +210,7 @@ pm1_stage1 (mpz_t f, mpres_t a, mpmod_t n, double B1, double *B1done,
      primes */
   /* Add small primes <= MIN(sqrt(B1), cascade_limit) in the appropriate 
      power to the cascade */
+  prime_table_reserve (MIN (B1, PRIME_TABLE_AUTO_BOUND));
   prime_info_init (prime_info);
   for (p = 2.; p <= MIN(B0, cascade_limit); p = (double) getprime_mt (prime_info))
     {
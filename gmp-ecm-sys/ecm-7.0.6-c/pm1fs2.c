@@ -542,6 +542,22 @@ est_cost (const unsigned long s_2, const unsigned long l, const int use_ntt,
     abort (); /* Invalid value for method */
 }
 
+/* Return the next transform length to try after l in choose_P().
+   For NTT, we have lengths 2^k and 3*2^k (see mpzspm_ntt_size()), so we 
+   alternate between them, with k > 0 for 3*2^k so that the DCT-I of h 
+   has an integral length.
+   For non-NTT, we have arbitrary transform lengths so we can decrease 
+   in smaller steps... let's say by, umm, 25% each time? */
+static unsigned long
+next_l (const unsigned long l, const int use_ntt)
+{
+  if (!use_ntt)
+    return 3 * l / 4;
+  if (l % 3 == 0)
+    return l / 3 * 2; /* 3*2^k -> 2^(k+1) */
+  return (l >= 8) ? 3 * l / 4 : l / 2; /* 2^k -> 3*2^(k-2) */
+}
+
 /* Choose P so that a stage 2 range from B2min to B2 can be covered with
    multipoint evaluations, each using a convolution of length at most lmax. 
    The parameters for stage 2 are stored in finalparams, the final effective
@@ -602,8 +618,8 @@ choose_P (const mpz_t B2min, const mpz_t B2, const unsigned long lmax,
   if (mpz_cmp (B2, B2min) < 0)
     return 0L;
 
-  /* If we use the NTT, we allow only power-of-two transform lengths.
-     In that case, the code below assumes that lmax is a power of two.
+  /* If we use the NTT, we allow only transform lengths 2^k and 3*2^k,
+     and the code below assumes that lmax is a power of two.
      If that is not the case, print error and return. */
   if (use_ntt && (lmax & (lmax - 1UL)) != 0)
     {
@@ -662,12 +678,9 @@ choose_P (const mpz_t B2min, const mpz_t B2, const unsigned long lmax,
       /* Try all possible transform lengths and store parameters in 
 	 P, s_1, s_2, l if they are better than the previously best ones */
        
-      /* Keep reducing tryl to find best parameters. For NTT, we only have 
-	 power of 2 lengths so far, so we can simply divide by 2. 
-	 For non-NTT, we have arbitrary transform lengths so we can decrease 
-	 in smaller steps... let's say by, umm, 25% each time? */
+      /* Keep reducing tryl to find best parameters, see next_l() */
       for (tryl = lmax; mpz_cmp_ui (lmin, tryl) <= 0;
-	   tryl = (use_ntt) ? tryl / 2 : 3 * tryl / 4)
+	   tryl = next_l (tryl, use_ntt))
 	{
 	  trys_1 = choose_s_1 (tryphiP, min_s2, tryl / 2, use_ntt);
 	  if (trys_1 == 0)
@@ -21,14 +21,8 @@ http://www.gnu.org/licenses/ or write to the Free Software Foundation, Inc.,
 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA. */
 
 #include <stdlib.h>
-#include <string.h> /* for strlen */
 #include "ecm-impl.h"
 
-#ifdef HAVE_UNISTD_H
-# include <unistd.h> /* for unlink */
-#endif
-
-
 #ifndef MAX
 #define MAX(a,b) (((a) > (b)) ? (a) : (b))
 #endif
@@ -59,11 +53,14 @@ print_vect (listz_t t, unsigned int l)
  * polynomial at the root of the tree. sh is the shift we need to
  * apply to find the actual coefficients of the polynomial at the root
  * of the tree.
+ * If TreeFile is not NULL, the tree is read from it, starting at the
+ * level it was last seeked to.
+ * Return 0 on success, ECM_ERROR on error.
  */
 
-void
+int
 TUpTree (listz_t b, listz_t *Tree, unsigned int k, listz_t tmp, int dolvl,
-         unsigned int sh, mpz_t n, FILE *TreeFile)
+         unsigned int sh, mpz_t n, treefile_t TreeFile)
 {
     unsigned int m, l;
 
@@ -71,7 +68,7 @@ TUpTree (listz_t b, listz_t *Tree, unsigned int k, listz_t tmp, int dolvl,
     l = k - m;
     
     if (k == 1)
-      return;
+      return 0;
    
 #ifdef DEBUG
     fprintf (ECM_STDOUT, "In TupTree, k = %d.\n", k);
@@ -87,18 +84,25 @@ TUpTree (listz_t b, listz_t *Tree, unsigned int k, listz_t tmp, int dolvl,
       {
         if (TreeFile != NULL)
           {
-            list_inp_raw (tmp + k, TreeFile, l);
+            listz_t a;
+
+            /* The residues read from the tree file are used in place */
+            a = treefile_read (TreeFile, l);
+            if (a == NULL)
+              return ECM_ERROR;
 #ifdef DEBUG_TREEDATA
             printf ("Read from file: ");
-            print_vect (tmp + k, l);
+            print_vect (a, l);
 #endif
-            TMulGen (tmp + l, m - 1, tmp + k, l - 1, b, k - 1, tmp + k + l, n);
-            list_inp_raw (tmp + k, TreeFile, m);
+            TMulGen (tmp + l, m - 1, a, l - 1, b, k - 1, tmp + k, n);
+            a = treefile_read (TreeFile, m);
+            if (a == NULL)
+              return ECM_ERROR;
 #ifdef DEBUG_TREEDATA
-            print_vect (tmp + k, m);
+            print_vect (a, m);
             printf ("\n");
 #endif
-            TMulGen (tmp, l - 1, tmp + k, m - 1, b, k - 1, tmp + k + m, n);
+            TMulGen (tmp, l - 1, a, m - 1, b, k - 1, tmp + k, n);
           }
         else
           {
@@ -138,9 +142,12 @@ TUpTree (listz_t b, listz_t *Tree, unsigned int k, listz_t tmp, int dolvl,
       {
         if (dolvl > 0)
           dolvl--;
-        TUpTree (b, Tree + 1, l, tmp, dolvl, sh, n, TreeFile);
-        TUpTree (b + l, Tree + 1, m, tmp, dolvl, sh + l, n, TreeFile);
+        if (TUpTree (b, Tree + 1, l, tmp, dolvl, sh, n, TreeFile) 
+            == ECM_ERROR)
+          return ECM_ERROR;
+        return TUpTree (b + l, Tree + 1, m, tmp, dolvl, sh + l, n, TreeFile);
       }
+    return 0;
 }
 
 static unsigned int
@@ -198,7 +205,7 @@ Since list_mul_mem(k) >= 2*k, the maximum is the 1st.
 int
 polyeval_tellegen (listz_t b, unsigned int k, listz_t *Tree, listz_t tmp,
                    unsigned int sizeT, listz_t invF, mpz_t n, 
-                   char *TreeFilename)
+                   treefile_t TreeFile)
 {
     unsigned int tupspace;
     unsigned int tkspace;
@@ -206,15 +213,12 @@ polyeval_tellegen (listz_t b, unsigned int k, listz_t *Tree, listz_t tmp,
         r = 0; /* return value, 0 = no error */
     listz_t T;
 
-    ASSERT(Tree != NULL || TreeFilename != NULL);
+    ASSERT(Tree != NULL || TreeFile != NULL);
     
     tupspace = TUpTree_space (k) + k;
     tkspace = 2 * k - 1 + list_mul_mem (k);
 
     tupspace = MAX (tupspace, tkspace);
-    
-    if (TreeFilename != NULL)
-      tupspace += (k + 1) / 2;
 
     if (sizeT >= tupspace)
         T = tmp;
@@ -247,32 +251,18 @@ polyeval_tellegen (listz_t b, unsigned int k, listz_t *Tree, listz_t tmp,
         list_mod (T, T + k - 1, k, n);
       }
     list_revert (T, k);
-    if (TreeFilename != NULL)
+    if (TreeFile != NULL)
       {
         unsigned int lgk, i;
-        FILE *TreeFile;
-	char *fullname = (char *) malloc (strlen (TreeFilename) + 1 + 2 + 1);
-        ASSERT_ALWAYS(fullname != NULL);
 
 	lgk = ceil_log2 (k);
-        for (i = 0; i < lgk; i++)
+        for (i = 0; i < lgk && r == 0; i++)
           {
-            sprintf (fullname, "%s.%d", TreeFilename, i);
-            
-	    TreeFile = fopen (fullname, "rb");
-            if (TreeFile == NULL)
-              {
-                outputf (OUTPUT_ERROR, 
-                         "Error opening file %s for product tree of F\n",
-                         fullname);
-                r = ECM_ERROR;
-                goto clear_T;
-              }
-            TUpTree (T, NULL, k, T + k, i, 0, n, TreeFile);
-            fclose (TreeFile);
-            unlink (fullname);
+            treefile_seek (TreeFile, i);
+            r = TUpTree (T, NULL, k, T + k, i, 0, n, TreeFile);
           }
-        free (fullname);
+        if (r != 0)
+          goto clear_T;
       }
     else
       TUpTree (T, Tree, k, T + k, -1, 0, n, NULL);
@@ -130,6 +130,8 @@ pp1_stage1 (mpz_t f, mpres_t P0, mpmod_t n, double B1, double *B1done,
   unsigned int max_size, size_n;
   long last_chkpnt_time;
   prime_info_t prime_info;
+  const unsigned char *chains;
+  ecm_uint nchains;
 
   mpz_init (g);
   mpres_init (P, n);
@@ -168,6 +170,8 @@ pp1_stage1 (mpz_t f, mpres_t P0, mpmod_t n, double B1, double *B1done,
   last_chkpnt_p = 2.;
   last_chkpnt_time = cputime ();
   /* first loop through small primes <= sqrt(B1) */
+  prime_table_reserve (MIN (B1, PRIME_TABLE_AUTO_BOUND));
+  chains = prac_chains_reserve (PRAC_PP1, *B1done, B1, &nchains);
   prime_info_init (prime_info);
   for (p = 2.0; p <= B0; p = (double) getprime_mt (prime_info))
     {
@@ -201,7 +205,9 @@ pp1_stage1 (mpz_t f, mpres_t P0, mpmod_t n, double B1, double *B1done,
   /* then all primes > sqrt(B1) and taken with exponent 1 */
   for (; p <= B1; p = (double) getprime_mt (prime_info))
     {
-      pp1_mul_prac (P0, (ecm_uint) p, n, P, Q, R, S, T);
+      pp1_mul_prac (P0, (ecm_uint) p, n, P, Q, R, S, T,
+                    PRAC_CHAIN (chains, nchains, prime_info_index (prime_info),
+                                (ecm_uint) p, PRAC_PP1));
   
       if (stop_asap != NULL && (*stop_asap) ())
         goto interrupt;
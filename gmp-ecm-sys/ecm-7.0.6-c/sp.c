@@ -21,6 +21,9 @@ MA 02110-1301, USA. */
 #include <stdio.h> /* for stderr */
 #include <stdlib.h>
 #include "sp.h"
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP) && defined(HAVE_MUNMAP)
+#include <sys/mman.h>
+#endif
 
 /* Test if m is a base "a" strong probable prime */
 
@@ -93,21 +96,75 @@ sp_prime (sp_t x)
 
 #define CACHE_LINE_SIZE 64
 
+/* Vectors of at least this many bytes get their own anonymous mapping,
+   backed by 2 MB pages if the system has some to offer */
+#define HUGE_PAGE_SIZE ((size_t) 2 << 20)
+
+/* The header below the aligned pointer holds the address to free and the
+   length of the mapping, 0 if the block comes from malloc */
+#define HEADER_SIZE (2 * sizeof (void *))
+
+static void *
+sp_huge_malloc (size_t len, size_t *maplen)
+{
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP) && defined(HAVE_MUNMAP)
+  void *map;
+  const size_t size = (len + CACHE_LINE_SIZE + HUGE_PAGE_SIZE - 1)
+                      & ~(HUGE_PAGE_SIZE - 1);
+
+  if (len < HUGE_PAGE_SIZE)
+    return NULL;
+
+#ifdef MAP_HUGETLB
+  /* explicit huge pages, fails at once if none are reserved */
+  map = mmap (NULL, size, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (map != MAP_FAILED)
+    {
+      *maplen = size;
+      return map;
+    }
+#endif
+
+  map = mmap (NULL, size, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (map == MAP_FAILED)
+    return NULL;
+#if defined(HAVE_MADVISE) && defined(MADV_HUGEPAGE)
+  /* ask for transparent huge pages, the kernel may still refuse */
+  madvise (map, size, MADV_HUGEPAGE);
+#endif
+  *maplen = size;
+  return map;
+#else
+  return NULL;
+#endif
+}
+
+/* Allocate len bytes aligned on a cache line. Large blocks are mapped
+   with huge pages where possible, which saves TLB misses when the NTT
+   strides through them. The pages are not touched here, so that they end
+   up on the NUMA node of the thread that first writes to them (see
+   mpzspv_init). */
 void *
 sp_aligned_malloc (size_t len)
 {
   void *ptr, *aligned_ptr;
-  size_t addr;
+  size_t addr, maplen = 0;
 
-  ptr = malloc (len + CACHE_LINE_SIZE);
+  ptr = sp_huge_malloc (len, &maplen);
+  if (ptr == NULL)
+    ptr = malloc (len + CACHE_LINE_SIZE + HEADER_SIZE);
   if (ptr == NULL)
     return NULL;
 
-  addr = (size_t)ptr;				
-  addr = CACHE_LINE_SIZE - (addr % CACHE_LINE_SIZE);
+  addr = (size_t)ptr + HEADER_SIZE;
+  addr = HEADER_SIZE + (CACHE_LINE_SIZE - addr % CACHE_LINE_SIZE)
+                       % CACHE_LINE_SIZE;
   aligned_ptr = (void *)((char *)ptr + addr);
 
   *( (void **)aligned_ptr - 1 ) = ptr;
+  *( (size_t *)aligned_ptr - 2 ) = maplen;
   return aligned_ptr;
 }
 
@@ -115,9 +172,18 @@ void
 sp_aligned_free (void *newptr) 
 {
   void *ptr;
+  size_t maplen;
 
   if (newptr == NULL) 
     return;
   ptr = *( (void **)newptr - 1 );
+  maplen = *( (size_t *)newptr - 2 );
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP) && defined(HAVE_MUNMAP)
+  if (maplen != 0)
+    {
+      munmap (ptr, maplen);
+      return;
+    }
+#endif
   free (ptr);
 }
@@ -41,6 +41,7 @@ MA 02110-1301, USA.
 #else
 extern size_t NTT_GFP_TWIDDLE_DIF_BREAKOVER;
 extern size_t NTT_GFP_TWIDDLE_DIT_BREAKOVER;
+extern size_t NTT_GFP_FOURSTEP_THRESHOLD;
 extern size_t MUL_NTT_THRESHOLD;
 extern size_t PREREVERTDIVISION_NTT_THRESHOLD;
 extern size_t POLYINVERT_NTT_THRESHOLD;
@@ -95,6 +96,9 @@ typedef mp_limb_t UDItype;
    and the naive method for fewer moduli. We must have I0_THRESHOLD >= 1. */
 #define I0_THRESHOLD 7
 
+/* mpzspv_from_mpzv converts blocks of this many coefficients at a time */
+#define MPZSPV_FROM_MPZV_BLOCK 16
+
 /*********
  * TYPES *
  *********/
@@ -132,7 +136,7 @@ typedef uint64_t sp_t;
 #endif
 
 #define SP_MIN ((sp_t)1 << (SP_NUMB_BITS - 1))
-#define SP_MAX ((sp_t)(-1) >> (W_TYPE_SIZE - SP_NUMB_BITS))
+#define SP_MAX ((sp_t)(-1) >> (SP_TYPE_BITS - SP_NUMB_BITS))
 
 /* vector of residues modulo a common small prime */
 typedef sp_t * spv_t;
@@ -143,6 +147,8 @@ typedef unsigned long spv_size_t;
 typedef struct
 {
   spv_t ntt_roots;
+  spv_t ntt3_roots;	/* primitive 3*2^i-th roots, NULL if 3 does not
+			   divide the maximal transform length */
   spv_size_t twiddle_size;
   spv_t twiddle;
 } __sp_nttdata;
@@ -166,13 +172,12 @@ typedef struct
 {
   sp_t sp;		/* value of the sp */
   sp_t mul_c;		/* constant used for reduction mod sp */
-  sp_t invm;            /* -1/sp mod 2^GMP_NUMB_BITS */
+  mp_limb_t invm;       /* -1/sp mod 2^GMP_NUMB_BITS */
   sp_t Bpow;            /* B^(n+1) mod sp where the input N has n limbs */
   sp_t prim_root;
   sp_t inv_prim_root;
   sp_nttdata_t nttdata;
   sp_nttdata_t inttdata;
-  spv_t scratch;
 } __spm_struct;
 
 typedef __spm_struct * spm_t;
@@ -181,6 +186,13 @@ typedef __spm_struct * spm_t;
 
 typedef mpz_t * mpzv_t;
 
+/* A parallel-for calls body (i, data) once for each 0 <= i < n, possibly
+   from several threads, and returns when all calls are done. Its last
+   argument is the context given with it. See ecm_set_parallel_for(). */
+typedef void (*mpzspm_body_t) (unsigned long, void *);
+typedef void (*mpzspm_parallel_for_t) (unsigned long, mpzspm_body_t, void *,
+                                       void *);
+
 typedef struct
   {
     /* number of small primes needed to represent each coeff */
@@ -195,10 +207,16 @@ typedef struct
     /* precomputed crt constants, see mpzspm.c */
     mpzv_t crt1, crt2;
     sp_t *crt3, **crt4, *crt5;
+    mp_limb_t *crt6;      /* crt1 as a sp_num x crt6_size limb matrix */
+    mp_size_t crt6_size;  /* number of limbs of modulus */
 
     /* product tree to speed up conversion from mpz to sp */
     mpzv_t *T;            /* product tree */
     unsigned int d;       /* ceil(log(sp_num)/log(2)) */
+
+    /* runs the loops over the small primes, NULL for a serial loop */
+    mpzspm_parallel_for_t parallel_for;
+    void *parallel_for_ctx;
   } __mpzspm_struct;
 
 typedef __mpzspm_struct * mpzspm_t;
@@ -248,7 +266,7 @@ mpz_set_sp (mpz_t m, const sp_t n)
 static inline sp_t 
 mpz_get_sp (const mpz_t n)
 {
-  if (sizeof (sp_t) == sizeof (unsigned long))
+  if (sizeof (sp_t) <= sizeof (unsigned long))
     {
       return (sp_t) mpz_get_ui (n);
     }
@@ -339,7 +357,7 @@ static inline sp_t sp_add(sp_t a, sp_t b, sp_t m)
         sub     edx, m
         cmovnc  eax, edx
     }
-#elif SP_NUMB_BITS <= W_TYPE_SIZE - 1
+#elif SP_NUMB_BITS <= SP_TYPE_BITS - 1
   sp_t t = a + b;
   if (t >= m)
     t -= m;
@@ -351,7 +369,30 @@ static inline sp_t sp_add(sp_t a, sp_t b, sp_t m)
 
 /* functions used for modular reduction */
 
-#if SP_NUMB_BITS <= W_TYPE_SIZE - 2
+/* The reduction works on words of SP_WORD_BITS bits. This is the limb
+   size, except for 30 and 31-bit primes on 64-bit hosts, where sp_t has
+   32 bits and a double word fits in a limb. */
+#if SP_TYPE_BITS < W_TYPE_SIZE
+#define SP_WORD_BITS SP_TYPE_BITS
+#define sp_umul_ppmm(ph, pl, x, y)                                     \
+  do {                                                                 \
+    mp_limb_t __p = (mp_limb_t) (x) * (mp_limb_t) (y);                 \
+    (ph) = (sp_t) (__p >> SP_TYPE_BITS);                               \
+    (pl) = (sp_t) __p;                                                 \
+  } while (0)
+#define sp_udiv_qrnnd(q, r, nh, nl, d)                                 \
+  do {                                                                 \
+    mp_limb_t __n = ((mp_limb_t) (nh) << SP_TYPE_BITS) | (mp_limb_t) (nl); \
+    (q) = (sp_t) (__n / (d));                                          \
+    (r) = (sp_t) (__n % (d));                                          \
+  } while (0)
+#else
+#define SP_WORD_BITS W_TYPE_SIZE
+#define sp_umul_ppmm umul_ppmm
+#define sp_udiv_qrnnd udiv_qrnnd
+#endif
+
+#if SP_NUMB_BITS <= SP_WORD_BITS - 2
 
 	/* having a small modulus allows the reciprocal
 	 * to be one bit larger, which guarantees that the
@@ -360,20 +401,20 @@ static inline sp_t sp_add(sp_t a, sp_t b, sp_t m)
 
 #define sp_reciprocal(invxl,xl)              \
   do {                                       \
-    ATTRIBUTE_UNUSED mp_limb_t dummy;        \
-    udiv_qrnnd (invxl, dummy,                \
+    ATTRIBUTE_UNUSED sp_t dummy;             \
+    sp_udiv_qrnnd (invxl, dummy,             \
 		(sp_t) 1 << (2 * SP_NUMB_BITS + 1 -	\
-		W_TYPE_SIZE), 0, xl);        \
+		SP_WORD_BITS), 0, xl);       \
   } while (0)
 
 static inline sp_t sp_udiv_rem(sp_t nh, sp_t nl, sp_t d, sp_t di)
 {
   sp_t r;
-  mp_limb_t q1, q2;
-  ATTRIBUTE_UNUSED mp_limb_t tmp;
-  q1 = nh << (2*(W_TYPE_SIZE - SP_NUMB_BITS)) |
-	    nl >> (2*SP_NUMB_BITS - W_TYPE_SIZE);
-  umul_ppmm (q2, tmp, q1, di);
+  sp_t q1, q2;
+  ATTRIBUTE_UNUSED sp_t tmp;
+  q1 = nh << (2*(SP_WORD_BITS - SP_NUMB_BITS)) |
+	    nl >> (2*SP_NUMB_BITS - SP_WORD_BITS);
+  sp_umul_ppmm (q2, tmp, q1, di);
   r = nl - d * (q2 >> 1);
   return sp_sub(r, d, d);
 }
@@ -382,19 +423,19 @@ static inline sp_t sp_udiv_rem(sp_t nh, sp_t nl, sp_t d, sp_t di)
 
 #define sp_reciprocal(invxl,xl)              \
   do {                                       \
-    ATTRIBUTE_UNUSED mp_limb_t dummy;        \
-    udiv_qrnnd (invxl, dummy,                \
+    ATTRIBUTE_UNUSED sp_t dummy;             \
+    sp_udiv_qrnnd (invxl, dummy,             \
 		(sp_t) 1 << (2 * SP_NUMB_BITS -	\
-		W_TYPE_SIZE), 0, xl);        \
+		SP_WORD_BITS), 0, xl);       \
   } while (0)
 
 static inline sp_t sp_udiv_rem(sp_t nh, sp_t nl, sp_t d, sp_t di)
 {
-  mp_limb_t q1, q2, tmp, dqh, dql;
-  q1 = nh << (2*(W_TYPE_SIZE - SP_NUMB_BITS)) |
-	    nl >> (2*SP_NUMB_BITS - W_TYPE_SIZE);
-  umul_ppmm (q2, tmp, q1, di);
-  umul_ppmm (dqh, dql, q2, d);
+  sp_t q1, q2, tmp, dqh, dql;
+  q1 = nh << (2*(SP_WORD_BITS - SP_NUMB_BITS)) |
+	    nl >> (2*SP_NUMB_BITS - SP_WORD_BITS);
+  sp_umul_ppmm (q2, tmp, q1, di);
+  sp_umul_ppmm (dqh, dql, q2, d);
 
   tmp = nl;
   nl = tmp - dql;
@@ -412,7 +453,7 @@ static inline sp_t
 sp_mul (sp_t x, sp_t y, sp_t m, sp_t d)
 {
   sp_t u, v;
-  umul_ppmm (u, v, x, y);
+  sp_umul_ppmm (u, v, x, y);
   return sp_udiv_rem (u, v, m, d);
 }
 
@@ -421,7 +462,7 @@ static inline sp_t
 sp_sqr (sp_t x, sp_t m, sp_t d)
 {
   sp_t u, v;
-  umul_ppmm (u, v, x, x);
+  sp_umul_ppmm (u, v, x, x);
   return sp_udiv_rem (u, v, m, d);
 }
 
@@ -488,12 +529,18 @@ void spv_random (spv_t, spv_size_t, sp_t);
 
 void spv_ntt_gfp_dif (spv_t, spv_size_t, spm_t);
 void spv_ntt_gfp_dit (spv_t, spv_size_t, spm_t);
+void spv_ntt_gfp_dif3 (spv_t, spv_size_t, spm_t);
+void spv_ntt_gfp_dit3 (spv_t, spv_size_t, spm_t);
 
 /* mpzspm */
 
 spv_size_t mpzspm_max_len (mpz_t);
 mpzspm_t mpzspm_init (spv_size_t, mpz_t);
 void mpzspm_clear (mpzspm_t);
+spv_size_t mpzspm_ntt_size (const mpzspm_t, spv_size_t);
+void mpzspm_set_parallel_for (mpzspm_parallel_for_t, void *);
+void mpzspm_parallel_for (mpzspm_t, unsigned long, spv_size_t, mpzspm_body_t,
+                          void *);
 
 /* mpzspv */
 
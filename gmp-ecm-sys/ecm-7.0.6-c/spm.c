@@ -42,11 +42,14 @@ ordpow (const sp_t q, sp_t a, const sp_t sp, const sp_t mul_c)
 }
 
 /* initialize roots of unity and twiddle factors for one NTT.
+   prim_root3 is a primitive 3*2^log2_len-th root of unity, or 0 if
+   there is none.
    If successful, returns 1.
    If unsuccessful, returns 0 (and frees allocated memory) */
 static int
 nttdata_init (const sp_t sp, const sp_t mul_c, 
-		const sp_t prim_root, const spv_size_t log2_len,
+		const sp_t prim_root, const sp_t prim_root3,
+		const spv_size_t log2_len,
 		sp_nttdata_t data, spv_size_t breakover)
 {
   spv_t r, t;
@@ -62,10 +65,28 @@ nttdata_init (const sp_t sp, const sp_t mul_c,
   for (i--; (int)i >= 0; i--)
     r[i] = sp_sqr (r[i+1], sp, mul_c);
 
+  data->ntt3_roots = NULL;
+  if (prim_root3 != 0)
+    {
+      t = data->ntt3_roots =
+	  (spv_t) sp_aligned_malloc ((log2_len + 1) * sizeof(sp_t));
+      if (t == NULL)
+        {
+          sp_aligned_free (r);
+          return 0;
+        }
+
+      i = log2_len;
+      t[i] = prim_root3;
+      for (i--; (int)i >= 0; i--)
+        t[i] = sp_sqr (t[i+1], sp, mul_c);
+    }
+
   k = MIN(log2_len, breakover);
   t = data->twiddle = (spv_t) sp_aligned_malloc (sizeof(sp_t) << k);
   if (t == NULL)
     {
+      sp_aligned_free (data->ntt3_roots);
       sp_aligned_free (r);
       return 0;
     }
@@ -86,6 +107,7 @@ static void
 nttdata_clear(sp_nttdata_t data)
 {
   sp_aligned_free(data->ntt_roots);
+  sp_aligned_free(data->ntt3_roots);
   sp_aligned_free(data->twiddle);
 }
 
@@ -108,6 +130,16 @@ spm_init (spv_size_t n, sp_t sp, mp_size_t k)
   sp_reciprocal (spm->mul_c, sp);
 
   /* compute spm->invm = -1/p mod B where B = 2^GMP_NUMB_BITS */
+#if SP_TYPE_BITS < W_TYPE_SIZE
+  /* sp_t is narrower than a limb: use Newton's iteration, each step
+     doubles the number of correct low bits, starting from 3 */
+  {
+    mp_limb_t inv = sp;
+    for (q = 3; q < GMP_NUMB_BITS; q *= 2)
+      inv *= 2 - (mp_limb_t) sp * inv;
+    spm->invm = -inv;
+  }
+#else
   a = sp_pow (2, GMP_NUMB_BITS, sp, spm->mul_c); /* a = B mod p */
   a = sp_inv (a, sp, spm->mul_c);                /* a = 1/B mod p */
   /* a = 1/B mod p thus B*a - 1 = invm*p */
@@ -123,6 +155,7 @@ spm_init (spv_size_t n, sp_t sp, mp_size_t k)
   udiv_qrnnd (bd, sc, a, b, sp << 1);
 #endif
   spm->invm = bd;
+#endif
 
   /* compute spm->Bpow = B^(k+1) mod p */
   spm->Bpow = sp_pow (2, GMP_NUMB_BITS * (k + 1), sp, spm->mul_c);
@@ -218,21 +251,21 @@ spm_init (spv_size_t n, sp_t sp, mp_size_t k)
   if (nttdata_init (sp, spm->mul_c, 
                     sp_pow (spm->prim_root, 
                             n >> ntt_power, sp, spm->mul_c),
+                    (n % 3 == 0) ? sp_pow (spm->prim_root,
+                                           (n / 3) >> ntt_power,
+                                           sp, spm->mul_c) : 0,
                     ntt_power, spm->nttdata, 
                     NTT_GFP_TWIDDLE_DIF_BREAKOVER))
     {
       if (nttdata_init (sp, spm->mul_c, 
                         sp_pow (spm->inv_prim_root, 
                                 n >> ntt_power, sp, spm->mul_c),
+                        (n % 3 == 0) ? sp_pow (spm->inv_prim_root,
+                                               (n / 3) >> ntt_power,
+                                               sp, spm->mul_c) : 0,
                         ntt_power, spm->inttdata, 
                         NTT_GFP_TWIDDLE_DIT_BREAKOVER))
-        {
-          spm->scratch = (spv_t) sp_aligned_malloc (MAX_NTT_BLOCK_SIZE *
-                                                    sizeof(sp_t));
-          if (spm->scratch != NULL)
-            return spm;
-          nttdata_clear (spm->inttdata);
-        }
+        return spm;
       nttdata_clear (spm->nttdata);
     }
   free (spm);
@@ -244,6 +277,5 @@ spm_clear (spm_t spm)
 {
   nttdata_clear (spm->nttdata);
   nttdata_clear (spm->inttdata);
-  sp_aligned_free (spm->scratch);
   free (spm);
 }
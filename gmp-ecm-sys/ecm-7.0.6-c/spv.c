@@ -33,6 +33,237 @@ MA 02110-1301, USA. */
  * other than for temporary variables. Unless otherwise specified, any
  * of the input pointers can be equal. */
 
+/* On x86_64, the pointwise operations have AVX2 and AVX-512 versions,
+ * chosen at run time from what the cpu supports. With 64-bit sp_t, the
+ * products do the same arithmetic as sp_mul() lane by lane, with the
+ * 64 x 64-bit products pieced together from 32 x 32-bit ones. That takes
+ * 11 multiplications per lane, which only beats the scalar code with 8
+ * lanes, so the AVX2 versions are limited to additions and negations.
+ * With 32-bit sp_t (SP_NUMB_BITS <= 31), a vector holds twice as many
+ * residues, and for primes of at most 30 bits the products take 3
+ * multiplications per lane, as in the SSE2 code for i386. */
+
+#if defined(HAVE_SIMD_TARGET) && defined(__x86_64__) &&                      \
+    (SP_TYPE_BITS == 32 || SP_NUMB_BITS <= W_TYPE_SIZE - 2)
+#define SPV_SIMD 1
+#include <immintrin.h>
+
+#define SPV_SIMD_NONE 0
+#define SPV_SIMD_AVX2 1
+#define SPV_SIMD_AVX512 2
+
+static int
+spv_simd_level (void)
+{
+  static int level = -1; /* not known yet, the race is harmless */
+
+  if (level < 0)
+    {
+      __builtin_cpu_init ();
+      if (__builtin_cpu_supports ("avx512f"))
+        level = SPV_SIMD_AVX512;
+      else if (__builtin_cpu_supports ("avx2"))
+        level = SPV_SIMD_AVX2;
+      else
+        level = SPV_SIMD_NONE;
+    }
+  return level;
+}
+
+/* Define the kernels for vectors of type V with N bits in lanes of B bits,
+   P being the prefix of the intrinsics, SET1 the one to broadcast a sp_t,
+   TARGET the function attribute and SUFFIX that of the names */
+#define SPV_SIMD_ADD_KERNELS(V, N, B, P, SET1, TARGET, SUFFIX)               \
+                                                                             \
+/* r >= m ? r - m : r */                                                     \
+static inline TARGET V                                                       \
+spv_sub_if_ge_##SUFFIX (V r, V m)                                            \
+{                                                                            \
+  return P##_sub_epi##B (r, SPV_SIMD_ANDNOT_GT_##SUFFIX (m, r));             \
+}                                                                            \
+                                                                             \
+static TARGET spv_size_t                                                     \
+spv_add_##SUFFIX (spv_t r, spv_t x, spv_t y, spv_size_t len, sp_t m)         \
+{                                                                            \
+  const V vm = SET1 (m);                                                     \
+  spv_size_t i;                                                              \
+                                                                             \
+  for (i = 0; i + N / B <= len; i += N / B)                                  \
+    P##_storeu_si##N ((V *) (r + i), spv_sub_if_ge_##SUFFIX (                \
+      P##_add_epi##B (P##_loadu_si##N ((V *) (x + i)),                       \
+                      P##_loadu_si##N ((V *) (y + i))), vm));                \
+  return i;                                                                  \
+}                                                                            \
+                                                                             \
+static TARGET spv_size_t                                                     \
+spv_neg_##SUFFIX (spv_t r, spv_t x, spv_size_t len, sp_t m)                  \
+{                                                                            \
+  const V vm = SET1 (m);                                                     \
+  spv_size_t i;                                                              \
+                                                                             \
+  /* m - 0 = m is reduced to 0 */                                            \
+  for (i = 0; i + N / B <= len; i += N / B)                                  \
+    P##_storeu_si##N ((V *) (r + i), spv_sub_if_ge_##SUFFIX (                \
+      P##_sub_epi##B (vm, P##_loadu_si##N ((V *) (x + i))), vm));            \
+  return i;                                                                  \
+}
+
+/* x * y mod m in 64-bit lanes */
+#define SPV_SIMD_SP_MUL64(V, N, P, SET1, TARGET, SUFFIX)                     \
+                                                                             \
+/* hi * 2^64 + lo = a * b, from four 32 x 32 -> 64-bit products */           \
+static inline TARGET void                                                    \
+spv_mul_ppmm_##SUFFIX (V *hi, V *lo, V a, V b)                               \
+{                                                                            \
+  const V mask = SET1 (0xffffffff);                                          \
+  V a1 = P##_srli_epi64 (a, 32), b1 = P##_srli_epi64 (b, 32);                \
+  V p00 = P##_mul_epu32 (a, b), p01 = P##_mul_epu32 (a, b1);                 \
+  V p10 = P##_mul_epu32 (a1, b), p11 = P##_mul_epu32 (a1, b1);               \
+  V mid = P##_add_epi64 (P##_srli_epi64 (p00, 32),                           \
+            P##_add_epi64 (P##_and_si##N (p01, mask),                        \
+                           P##_and_si##N (p10, mask)));                      \
+  *lo = P##_or_si##N (P##_and_si##N (p00, mask), P##_slli_epi64 (mid, 32));  \
+  *hi = P##_add_epi64 (P##_add_epi64 (p11, P##_srli_epi64 (mid, 32)),        \
+          P##_add_epi64 (P##_srli_epi64 (p01, 32), P##_srli_epi64 (p10, 32))); \
+}                                                                            \
+                                                                             \
+/* low 64 bits of a * b */                                                   \
+static inline TARGET V                                                       \
+spv_mullo_##SUFFIX (V a, V b)                                                \
+{                                                                            \
+  V cross = P##_add_epi64 (P##_mul_epu32 (a, P##_srli_epi64 (b, 32)),        \
+                           P##_mul_epu32 (P##_srli_epi64 (a, 32), b));       \
+  return P##_add_epi64 (P##_mul_epu32 (a, b), P##_slli_epi64 (cross, 32));   \
+}                                                                            \
+                                                                             \
+/* x * y mod m, as sp_mul() with sp_udiv_rem() for small moduli */           \
+static inline TARGET V                                                       \
+sp_mul_##SUFFIX (V x, V y, V m, V d)                                         \
+{                                                                            \
+  V u, v, q, t;                                                              \
+                                                                             \
+  spv_mul_ppmm_##SUFFIX (&u, &v, x, y);                                      \
+  q = P##_or_si##N (P##_slli_epi64 (u, 2 * (W_TYPE_SIZE - SP_NUMB_BITS)),    \
+                    P##_srli_epi64 (v, 2 * SP_NUMB_BITS - W_TYPE_SIZE));     \
+  spv_mul_ppmm_##SUFFIX (&q, &t, q, d);                                      \
+  v = P##_sub_epi64 (v, spv_mullo_##SUFFIX (P##_srli_epi64 (q, 1), m));      \
+  return spv_sub_if_ge_##SUFFIX (v, m);                                      \
+}
+
+/* x * y mod m in 32-bit lanes: the even and the odd lanes are multiplied
+   into 64-bit products, which hold the double word of sp_udiv_rem() */
+#define SPV_SIMD_SP_MUL32(V, N, P, TARGET, SUFFIX)                           \
+                                                                             \
+/* the remainder of the product u, in the low half of each 64-bit lane */    \
+static inline TARGET V                                                       \
+sp_rem_##SUFFIX (V u, V m, V d)                                              \
+{                                                                            \
+  V q = P##_mul_epu32 (P##_srli_epi64 (u, 2 * SP_NUMB_BITS - 32), d);        \
+                                                                             \
+  return P##_sub_epi64 (u, P##_mul_epu32 (P##_srli_epi64 (q, 33), m));       \
+}                                                                            \
+                                                                             \
+static inline TARGET V                                                       \
+sp_mul_##SUFFIX (V x, V y, V m, V d)                                         \
+{                                                                            \
+  V even = P##_mul_epu32 (x, y);                                             \
+  V odd = P##_mul_epu32 (P##_srli_epi64 (x, 32), P##_srli_epi64 (y, 32));    \
+                                                                             \
+  return spv_sub_if_ge_##SUFFIX (P##_or_si##N (sp_rem_##SUFFIX (even, m, d), \
+    P##_slli_epi64 (sp_rem_##SUFFIX (odd, m, d), 32)), m);                   \
+}
+
+#define SPV_SIMD_MUL_KERNELS(V, N, B, P, SET1, TARGET, SUFFIX)               \
+                                                                             \
+static TARGET spv_size_t                                                     \
+spv_pwmul_##SUFFIX (spv_t r, spv_t x, spv_t y, spv_size_t len, sp_t m,       \
+                    sp_t d)                                                  \
+{                                                                            \
+  const V vm = SET1 (m), vd = SET1 (d);                                      \
+  spv_size_t i;                                                              \
+                                                                             \
+  for (i = 0; i + N / B <= len; i += N / B)                                  \
+    P##_storeu_si##N ((V *) (r + i), sp_mul_##SUFFIX (                       \
+      P##_loadu_si##N ((V *) (x + i)), P##_loadu_si##N ((V *) (y + i)),      \
+      vm, vd));                                                              \
+  return i;                                                                  \
+}                                                                            \
+                                                                             \
+static TARGET spv_size_t                                                     \
+spv_mul_sp_##SUFFIX (spv_t r, spv_t x, sp_t c, spv_size_t len, sp_t m,       \
+                     sp_t d)                                                 \
+{                                                                            \
+  const V vm = SET1 (m), vd = SET1 (d);                                      \
+  const V vc = SET1 (c);                                                     \
+  spv_size_t i;                                                              \
+                                                                             \
+  for (i = 0; i + N / B <= len; i += N / B)                                  \
+    P##_storeu_si##N ((V *) (r + i), sp_mul_##SUFFIX (                       \
+      P##_loadu_si##N ((V *) (x + i)), vc, vm, vd));                         \
+  return i;                                                                  \
+}
+
+/* Set i to the length of the prefix done by the widest kernel the cpu
+   supports, or leave it alone */
+#define SPV_SIMD_RUN(i, name, args)                                          \
+  do {                                                                       \
+    switch (spv_simd_level ())                                               \
+      {                                                                      \
+        case SPV_SIMD_AVX512: i = name##_avx512 args; break;                 \
+        case SPV_SIMD_AVX2: i = name##_avx2 args; break;                     \
+      }                                                                      \
+  } while (0)
+
+#if SP_TYPE_BITS == 64
+/* m where r >= m, else 0. The AVX2 compare is signed, which is fine as
+   the lanes are below 2^(SP_NUMB_BITS + 1) */
+#define SPV_SIMD_ANDNOT_GT_avx2(m, r)                                        \
+  _mm256_andnot_si256 (_mm256_cmpgt_epi64 (m, r), m)
+#define SPV_SIMD_ANDNOT_GT_avx512(m, r)                                      \
+  _mm512_maskz_mov_epi64 (_mm512_cmpge_epu64_mask (r, m), m)
+
+SPV_SIMD_ADD_KERNELS(__m256i, 256, 64, _mm256, _mm256_set1_epi64x,
+                     __attribute__ ((target ("avx2"))), avx2)
+SPV_SIMD_ADD_KERNELS(__m512i, 512, 64, _mm512, _mm512_set1_epi64,
+                     __attribute__ ((target ("avx512f"))), avx512)
+SPV_SIMD_SP_MUL64(__m512i, 512, _mm512, _mm512_set1_epi64,
+                  __attribute__ ((target ("avx512f"))), avx512)
+SPV_SIMD_MUL_KERNELS(__m512i, 512, 64, _mm512, _mm512_set1_epi64,
+                     __attribute__ ((target ("avx512f"))), avx512)
+#define SPV_SIMD_MUL 1
+#define SPV_SIMD_MUL_RUN(i, name, args)                                      \
+  do {                                                                       \
+    if (spv_simd_level () == SPV_SIMD_AVX512)                                \
+      i = name##_avx512 args;                                                \
+  } while (0)
+
+#else /* 32-bit sp_t */
+/* m where r >= m, else 0. The lanes may exceed 2^31, so the AVX2 compare
+   goes through an unsigned max */
+#define SPV_SIMD_ANDNOT_GT_avx2(m, r)                                        \
+  _mm256_and_si256 (_mm256_cmpeq_epi32 (_mm256_max_epu32 (r, m), r), m)
+#define SPV_SIMD_ANDNOT_GT_avx512(m, r)                                      \
+  _mm512_maskz_mov_epi32 (_mm512_cmpge_epu32_mask (r, m), m)
+
+SPV_SIMD_ADD_KERNELS(__m256i, 256, 32, _mm256, _mm256_set1_epi32,
+                     __attribute__ ((target ("avx2"))), avx2)
+SPV_SIMD_ADD_KERNELS(__m512i, 512, 32, _mm512, _mm512_set1_epi32,
+                     __attribute__ ((target ("avx512f"))), avx512)
+#if SP_NUMB_BITS <= SP_TYPE_BITS - 2
+SPV_SIMD_SP_MUL32(__m256i, 256, _mm256,
+                  __attribute__ ((target ("avx2"))), avx2)
+SPV_SIMD_SP_MUL32(__m512i, 512, _mm512,
+                  __attribute__ ((target ("avx512f"))), avx512)
+SPV_SIMD_MUL_KERNELS(__m256i, 256, 32, _mm256, _mm256_set1_epi32,
+                     __attribute__ ((target ("avx2"))), avx2)
+SPV_SIMD_MUL_KERNELS(__m512i, 512, 32, _mm512, _mm512_set1_epi32,
+                     __attribute__ ((target ("avx512f"))), avx512)
+#define SPV_SIMD_MUL 1
+#define SPV_SIMD_MUL_RUN SPV_SIMD_RUN
+#endif
+#endif
+#endif
+
 #ifdef WANT_ASSERT
 int
 spv_verify (spv_t x, spv_size_t len, const sp_t m)
@@ -109,7 +340,11 @@ spv_add (spv_t r, spv_t x, spv_t y, spv_size_t len, sp_t m)
   ASSERT (r >= x + len || x >= r);
   ASSERT (r >= y + len || y >= r);
   
-  for (i = 0; i < len; i++)
+  i = 0;
+#ifdef SPV_SIMD
+  SPV_SIMD_RUN (i, spv_add, (r, x, y, len, m));
+#endif
+  for (; i < len; i++)
     r[i] = sp_add (x[i], y[i], m);
 }
 
@@ -117,9 +352,12 @@ spv_add (spv_t r, spv_t x, spv_t y, spv_size_t len, sp_t m)
 void
 spv_neg (spv_t r, spv_t x, spv_size_t len, sp_t m)
 {
-  spv_size_t i;
+  spv_size_t i = 0;
 
-  for (i = 0; i < len; i++)
+#ifdef SPV_SIMD
+  SPV_SIMD_RUN (i, spv_neg, (r, x, len, m));
+#endif
+  for (; i < len; i++)
     r[i] = sp_sub (0, x[i], m);
 }
 
@@ -202,6 +440,8 @@ spv_pwmul (spv_t r, spv_t x, spv_t y, spv_size_t len, sp_t m, sp_t d)
 	"g"(len & (spv_size_t)(~3)), "g"(m), "g"(d)
        :"%xmm0", "%xmm1", "%xmm2", "%xmm3",
         "%xmm5", "%xmm6", "%xmm7", "cc", "memory");
+#elif defined(SPV_SIMD_MUL)
+  SPV_SIMD_MUL_RUN (i, spv_pwmul, (r, x, y, len, m, d));
 #elif defined( _MSC_VER ) && defined( SSE2)
     __asm
     {   push        esi
@@ -359,6 +599,8 @@ spv_mul_sp (spv_t r, spv_t x, sp_t c, spv_size_t len, sp_t m, sp_t d)
 	"g"(len & (spv_size_t)(~3)), "g"(m), "g"(d)
        :"%xmm0", "%xmm1", "%xmm2", "%xmm3",
         "%xmm4", "%xmm5", "%xmm6", "%xmm7", "cc", "memory");
+#elif defined(SPV_SIMD_MUL)
+  SPV_SIMD_MUL_RUN (i, spv_mul_sp, (r, x, c, len, m, d));
 #elif defined( _MSC_VER ) && defined( SSE2) 
     __asm
     {   push        esi
@@ -443,9 +685,14 @@ void
 spv_random (spv_t x, spv_size_t len, sp_t m)
 {
   spv_size_t i;
-  mpn_random ((mp_ptr) x, len);
-  
+  mp_limb_t t;
+
+  /* sp_t may be narrower than a limb */
   for (i = 0; i < len; i++)
-    while (x[i] >= m)
-      x[i] -= m;
+    {
+      mpn_random (&t, 1);
+      x[i] = (sp_t) t;
+      while (x[i] >= m)
+        x[i] -= m;
+    }
 }
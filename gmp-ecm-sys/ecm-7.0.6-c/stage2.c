@@ -24,11 +24,6 @@ http://www.gnu.org/licenses/ or write to the Free Software Foundation, Inc.,
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h> /* for floor */
-#include <string.h> /* for strlen */
-
-#ifdef HAVE_UNISTD_H
-#include <unistd.h> /* for unlink */
-#endif
 
 #include "ecm-impl.h"
 #include "sp.h"
@@ -335,6 +330,7 @@ stage2 (mpz_t f, void *X, mpmod_t modulus, unsigned long dF, unsigned long k,
   long st, st0;
   void *rootsG_state = NULL;
   listz_t *Tree = NULL; /* stores the product tree for F */
+  treefile_t TreeFile = NULL; /* or this, if TreeFilename != NULL */
   unsigned int lgk; /* ceil(log(k)/log(2)) */
   listz_t invF = NULL;
   double mem;
@@ -436,38 +432,31 @@ stage2 (mpz_t f, void *X, mpmod_t modulus, unsigned long dF, unsigned long k,
   st = cputime ();
   if (TreeFilename != NULL)
     {
-      FILE *TreeFile;
-      char *fullname = (char *) malloc (strlen (TreeFilename) + 1 + 2 + 1);
       int ret;
-      ASSERT_ALWAYS(fullname != NULL);
+
+      TreeFile = treefile_open (TreeFilename, lgk, dF, n);
+      if (TreeFile == NULL)
+        {
+          outputf (OUTPUT_ERROR, "Error opening file for product tree of F\n");
+          youpi = ECM_ERROR;
+          goto free_Tree_i;
+        }
       
       for (i = lgk; i > 0; i--)
         {
           if (stop_asap != NULL && (*stop_asap)())
             goto free_Tree_i;
-          sprintf (fullname, "%s.%lu", TreeFilename, i - 1);
-          
-	  TreeFile = fopen (fullname, "wb");
-          if (TreeFile == NULL)
-            {
-              outputf (OUTPUT_ERROR, 
-                       "Error opening file for product tree of F\n");
-              youpi = ECM_ERROR;
-              goto free_Tree_i;
-            }
+          treefile_seek (TreeFile, i - 1);
 	  
           ret = (use_ntt) ? ntt_PolyFromRoots_Tree (F, F, dF, T, i - 1,
                                                     mpzspm, NULL, TreeFile)
             : PolyFromRoots_Tree (F, F, dF, T, i - 1, n, NULL, TreeFile, 0);
 	  if (ret == ECM_ERROR)
 	    {
-              fclose (TreeFile);
               youpi = ECM_ERROR;
               goto free_Tree_i;
             }
-          fclose (TreeFile);
         }
-      free (fullname);
     }
   else
     {
@@ -701,10 +690,10 @@ stage2 (mpz_t f, void *X, mpmod_t modulus, unsigned long dF, unsigned long k,
   st = cputime ();
   if (use_ntt)
     youpi = ntt_polyevalT (T, dF, Tree, T + dF + 1, sp_invF,
-	mpzspm, TreeFilename);
+	mpzspm, TreeFile);
   else
     youpi = polyeval_tellegen (T, dF, Tree, T + dF + 1, sizeT - dF - 1, invF,
-	n, TreeFilename);
+	n, TreeFile);
 
   if (youpi)
     {
@@ -754,7 +743,8 @@ free_Tree_i:
         clear_list (Tree[i], dF);
       free (Tree);
     }
-  /* the trees are already cleared by ntt_polyevalT or polyeval_tellegen */
+  if (TreeFile != NULL)
+    treefile_close (TreeFile);
   mpz_clear (n);
 
 clear_T:
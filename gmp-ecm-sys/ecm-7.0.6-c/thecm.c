@@ -0,0 +1,93 @@
+/* thecm.c - check that ECM_HECM finds a known factor in stage 1 and in
+   stage 2 with fixed curves.
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 3 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, see
+http://www.gnu.org/licenses/ or write to the Free Software Foundation, Inc.,
+51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <gmp.h> /* GMP header file */
+#include "ecm.h" /* ecm header file */
+
+/* nextprime(10^9) * nextprime(10^29) */
+#define N_STR "100000000700000000000000000319000002233"
+#define P_STR "1000000007"
+
+/* sigma = a + SIGMA_BASE*b gives the HECM parameter s=a/b */
+#define SIGMA_BASE 65536UL
+
+static const struct
+{
+  unsigned long a, b;
+  double B1;
+  int stage2;   /* 0: stage 1 only (B2=0), 1: default B2 */
+  int expected;
+} cases[] = {
+  { 7, 1, 20000.0, 0, ECM_FACTOR_FOUND_STEP1 },
+  /* the same curve finds nothing in stage 1 with a smaller B1 ... */
+  { 15, 1, 200.0, 0, ECM_NO_FACTOR_FOUND },
+  /* ... and finds p in stage 2 */
+  { 15, 1, 200.0, 1, ECM_FACTOR_FOUND_STEP2 }
+};
+
+#define NCASES (int) (sizeof (cases) / sizeof (cases[0]))
+
+static int
+check (mpz_t n, mpz_t p, int i)
+{
+  ecm_params q;
+  mpz_t f;
+  int ret, errors = 0;
+
+  mpz_init (f);
+  ecm_init (q);
+  q->method = ECM_HECM;
+  mpz_set_ui (q->sigma, cases[i].a + SIGMA_BASE * cases[i].b);
+  if (cases[i].stage2 == 0)
+    mpz_set_ui (q->B2, 0);
+  ret = ecm_factor (f, n, cases[i].B1, q);
+  if (ret != cases[i].expected)
+    {
+      fprintf (stderr, "s=%lu/%lu, B1=%.0f%s: ecm_factor returns %d, "
+               "expected %d\n", cases[i].a, cases[i].b, cases[i].B1,
+               cases[i].stage2 ? "" : ", B2=0", ret, cases[i].expected);
+      errors++;
+    }
+  else if (ECM_FACTOR_FOUND_P (ret) && mpz_cmp (f, p) != 0)
+    {
+      gmp_fprintf (stderr, "s=%lu/%lu, B1=%.0f: found %Zd, expected %Zd\n",
+                   cases[i].a, cases[i].b, cases[i].B1, f, p);
+      errors++;
+    }
+  ecm_clear (q);
+  mpz_clear (f);
+  return errors;
+}
+
+int
+main (void)
+{
+  mpz_t n, p;
+  int i, errors = 0;
+
+  mpz_init_set_str (n, N_STR, 10);
+  mpz_init_set_str (p, P_STR, 10);
+  for (i = 0; i < NCASES; i++)
+    errors += check (n, p, i);
+  mpz_clear (p);
+  mpz_clear (n);
+
+  return (errors == 0) ? 0 : 1;
+}
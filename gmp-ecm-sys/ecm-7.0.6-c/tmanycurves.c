@@ -0,0 +1,114 @@
+/* tmanycurves.c - check that ecm_factor_many_curves gives the same result
+   with each modular arithmetic.
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 3 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, see
+http://www.gnu.org/licenses/ or write to the Free Software Foundation, Inc.,
+51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <gmp.h> /* GMP header file */
+#include "ecm.h" /* ecm header file */
+
+#define NCURVES 8
+#define SMIN 2
+#define B1 20000.0
+
+/* 2^67-1 = 193707721 * 761838257287 */
+#define N_STR "147573952589676412927"
+
+/* ECM_MOD_BASE2 is selected by the exponent: -67 stands for 2^67-1 */
+static const struct
+{
+  const char *name;
+  int repr;
+} reprs[] = {
+  { "mpz", ECM_MOD_MPZ },
+  { "modmuln", ECM_MOD_MODMULN },
+  { "redc", ECM_MOD_REDC },
+  { "base2", -67 }
+};
+
+#define NREPRS (int) (sizeof (reprs) / sizeof (reprs[0]))
+
+/* Runs the curves with the arithmetic repr, and puts their results in
+   res and f. */
+static int
+run (int *res, mpz_t *f, mpz_t n, const char *torsion, int repr)
+{
+  ecm_params q;
+  int ret;
+
+  ecm_init (q);
+  q->repr = repr;
+  mpz_set_ui (q->B2, 0); /* stage 1 only */
+  ret = ecm_factor_many_curves (f, res, n, B1, torsion, SMIN, NCURVES, q);
+  ecm_clear (q);
+  return ret;
+}
+
+static int
+check (mpz_t n, const char *torsion)
+{
+  int res[NREPRS][NCURVES], ret[NREPRS];
+  mpz_t f[NREPRS][NCURVES];
+  int i, j, errors = 0;
+
+  for (i = 0; i < NREPRS; i++)
+    {
+      for (j = 0; j < NCURVES; j++)
+        mpz_init (f[i][j]);
+      ret[i] = run (res[i], f[i], n, torsion, reprs[i].repr);
+    }
+
+  for (i = 1; i < NREPRS; i++)
+    {
+      if (ret[i] != ret[0])
+        {
+          fprintf (stderr, "%s: %s returns %d, %s returns %d\n", torsion,
+                   reprs[i].name, ret[i], reprs[0].name, ret[0]);
+          errors++;
+        }
+      for (j = 0; j < NCURVES; j++)
+        if (res[i][j] != res[0][j] ||
+            (ECM_FACTOR_FOUND_P (res[0][j]) &&
+             mpz_cmp (f[i][j], f[0][j]) != 0))
+          {
+            gmp_fprintf (stderr, "%s: curve %d: %s gives %d (%Zd), "
+                         "%s gives %d (%Zd)\n", torsion, SMIN + j,
+                         reprs[i].name, res[i][j], f[i][j],
+                         reprs[0].name, res[0][j], f[0][j]);
+            errors++;
+          }
+    }
+
+  for (i = 0; i < NREPRS; i++)
+    for (j = 0; j < NCURVES; j++)
+      mpz_clear (f[i][j]);
+  return errors;
+}
+
+int
+main (void)
+{
+  mpz_t n;
+  int errors = 0;
+
+  mpz_init_set_str (n, N_STR, 10);
+  errors += check (n, "Z5");
+  errors += check (n, "Z7");
+  mpz_clear (n);
+
+  return (errors == 0) ? 0 : 1;
+}
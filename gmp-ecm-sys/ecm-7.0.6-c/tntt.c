@@ -0,0 +1,210 @@
+/* tntt.c - check the NTT convolutions of length 2^k and 3*2^k against
+   the schoolbook product.
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 3 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; see the file COPYING.  If not, see
+http://www.gnu.org/licenses/ or write to the Free Software Foundation, Inc.,
+51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ecm-impl.h"
+
+/* The primes support all the lengths 2^k and 3*2^k up to MAX_LEN */
+#define MAX_LEN (3 << 7)
+
+/* 2^127-1 */
+#define N_STR "170141183460469231731687303715884105727"
+
+static gmp_randstate_t state;
+
+static mpzv_t
+init_mpzv (spv_size_t len)
+{
+  mpzv_t v = (mpzv_t) malloc (len * sizeof (mpz_t));
+  spv_size_t i;
+
+  if (v == NULL)
+    abort ();
+  for (i = 0; i < len; i++)
+    mpz_init (v[i]);
+  return v;
+}
+
+static void
+clear_mpzv (mpzv_t v, spv_size_t len)
+{
+  spv_size_t i;
+
+  for (i = 0; i < len; i++)
+    mpz_clear (v[i]);
+  free (v);
+}
+
+/* r = x * y mod (X^len - 1, n), where x has lenx coefficients and y has
+   leny */
+static void
+cyclic_mul (mpzv_t r, mpzv_t x, spv_size_t lenx, mpzv_t y, spv_size_t leny,
+            spv_size_t len, mpz_t n)
+{
+  spv_size_t i, j;
+
+  for (i = 0; i < len; i++)
+    mpz_set_ui (r[i], 0);
+  for (i = 0; i < lenx; i++)
+    for (j = 0; j < leny; j++)
+      mpz_addmul (r[(i + j) % len], x[i], y[j]);
+  for (i = 0; i < len; i++)
+    mpz_mod (r[i], r[i], n);
+}
+
+static int
+compare (const char *what, mpzv_t r, mpzv_t s, spv_size_t len, mpz_t n)
+{
+  spv_size_t i;
+
+  for (i = 0; i < len; i++)
+    {
+      mpz_mod (r[i], r[i], n);
+      if (mpz_cmp (r[i], s[i]) != 0)
+        {
+          fprintf (stderr, "%s of length %lu: coefficient %lu differs\n",
+                   what, (unsigned long) len, (unsigned long) i);
+          return 1;
+        }
+    }
+  return 0;
+}
+
+/* Product of polynomials of len / 2 + 1 and len / 2 coefficients with
+   mpzspv_mul_ntt, which fills the whole transform */
+static int
+check_mul (spv_size_t len, mpz_t n, mpzspm_t mpzspm)
+{
+  const spv_size_t lenx = len / 2 + 1, leny = len / 2;
+  mpzv_t x = init_mpzv (lenx), y = init_mpzv (leny);
+  mpzv_t r = init_mpzv (len), s = init_mpzv (len);
+  mpzspv_t u = mpzspv_init (len, mpzspm), v = mpzspv_init (len, mpzspm);
+  spv_size_t i;
+  int errors;
+
+  for (i = 0; i < lenx; i++)
+    mpz_urandomm (x[i], state, n);
+  for (i = 0; i < leny; i++)
+    mpz_urandomm (y[i], state, n);
+
+  mpzspv_from_mpzv (u, 0, x, lenx, mpzspm);
+  mpzspv_from_mpzv (v, 0, y, leny, mpzspm);
+  mpzspv_mul_ntt (u, 0, u, 0, lenx, v, 0, leny, len, 0, 0, mpzspm,
+    NTT_MUL_STEP_FFT1 + NTT_MUL_STEP_FFT2 + NTT_MUL_STEP_MUL +
+    NTT_MUL_STEP_IFFT);
+  mpzspv_to_mpzv (u, 0, r, len, mpzspm);
+
+  cyclic_mul (s, x, lenx, y, leny, len, n);
+  errors = compare ("mpzspv_mul_ntt", r, s, len, n);
+
+  mpzspv_clear (u, mpzspm);
+  mpzspv_clear (v, mpzspm);
+  clear_mpzv (x, lenx);
+  clear_mpzv (y, leny);
+  clear_mpzv (r, len);
+  clear_mpzv (s, len);
+  return errors;
+}
+
+/* Product of a polynomial of len coefficients by a symmetric one of
+   degree len / 4 in each direction, with mpzspv_mul_by_dct as in the
+   P+-1 stage 2 */
+static int
+check_mul_by_dct (spv_size_t len, mpz_t n, mpzspm_t mpzspm)
+{
+  const spv_size_t lenh = len / 4 + 1, dctlen = len / 2 + 1;
+  mpzv_t g = init_mpzv (len), h = init_mpzv (len);
+  mpzv_t r = init_mpzv (len), s = init_mpzv (len);
+  mpzspv_t g_ntt = mpzspv_init (len, mpzspm);
+  mpzspv_t h_ntt = mpzspv_init (dctlen, mpzspm);
+  mpzspv_t tmp = mpzspv_init (len, mpzspm);
+  spv_size_t i;
+  int errors;
+
+  for (i = 0; i < len; i++)
+    mpz_urandomm (g[i], state, n);
+  /* h[i] = h[len - i], with the coefficients of degree -len/4 ... len/4 */
+  for (i = 0; i < len; i++)
+    mpz_set_ui (h[i], 0);
+  for (i = 0; i < lenh; i++)
+    {
+      mpz_urandomm (h[i], state, n);
+      if (i > 0)
+        mpz_set (h[len - i], h[i]);
+    }
+
+  mpzspv_from_mpzv (h_ntt, 0, h, lenh, mpzspm);
+  mpzspv_to_dct1 (h_ntt, h_ntt, lenh, dctlen, tmp, mpzspm);
+  mpzspv_from_mpzv (g_ntt, 0, g, len, mpzspm);
+  mpzspv_mul_by_dct (g_ntt, h_ntt, len, mpzspm,
+    NTT_MUL_STEP_FFT1 + NTT_MUL_STEP_MUL + NTT_MUL_STEP_IFFT);
+  mpzspv_to_mpzv (g_ntt, 0, r, len, mpzspm);
+
+  cyclic_mul (s, g, len, h, len, len, n);
+  errors = compare ("mpzspv_mul_by_dct", r, s, len, n);
+
+  mpzspv_clear (g_ntt, mpzspm);
+  mpzspv_clear (h_ntt, mpzspm);
+  mpzspv_clear (tmp, mpzspm);
+  clear_mpzv (g, len);
+  clear_mpzv (h, len);
+  clear_mpzv (r, len);
+  clear_mpzv (s, len);
+  return errors;
+}
+
+int
+main (void)
+{
+  mpz_t n;
+  mpzspm_t mpzspm;
+  spv_size_t len;
+  int errors = 0;
+
+  gmp_randinit_default (state);
+  mpz_init_set_str (n, N_STR, 10);
+  mpzspm = mpzspm_init (MAX_LEN, n);
+  if (mpzspm == NULL)
+    {
+      fprintf (stderr, "mpzspm_init failed\n");
+      return 1;
+    }
+
+  /* A product of 80 coefficients fits in 96 = 3*2^5 */
+  if (mpzspm_ntt_size (mpzspm, 80) != 96 ||
+      mpzspm_ntt_size (mpzspm, 100) != 128)
+    {
+      fprintf (stderr, "mpzspm_ntt_size: wrong transform length\n");
+      errors++;
+    }
+
+  for (len = 4; len <= MAX_LEN / 3; len *= 2)
+    {
+      errors += check_mul (len, n, mpzspm);
+      errors += check_mul (3 * len, n, mpzspm);
+      errors += check_mul_by_dct (len, n, mpzspm);
+      errors += check_mul_by_dct (3 * len, n, mpzspm);
+    }
+
+  mpzspm_clear (mpzspm);
+  mpz_clear (n);
+  gmp_randclear (state);
+
+  return (errors == 0) ? 0 : 1;
+}
@@ -243,11 +243,11 @@ forbidden(char *torsion, int u){
 */
 int
 build_curves_with_torsion_Z5(mpz_t f, mpmod_t n,
-			     ell_curve_t *tE, ell_point_t *tP,
+			     ell_curve_t *tE, ell_point_t *tP, int *tu,
 			     int smin, int smax, int nE)
 {
     mpz_t A, B, X, Y;
-    int s, ret = ECM_NO_FACTOR_FOUND, nc = 0;
+    int s, i, ret = ECM_NO_FACTOR_FOUND, nc = 0;
     mpz_t x0, y0, c, tmp;
 
     mpz_init(A);
@@ -258,8 +258,10 @@ build_curves_with_torsion_Z5(mpz_t f, mpmod_t n,
     mpz_init(y0);
     mpz_init(c);
     mpz_init(tmp);
-    ell_curve_init(tE[nc], ECM_EC_TYPE_WEIERSTRASS, ECM_LAW_AFFINE, n);
-    ell_point_init(tP[nc], tE[nc], n);
+    for(i = 0; i < nE; i++){
+	ell_curve_init(tE[i], ECM_EC_TYPE_WEIERSTRASS, ECM_LAW_AFFINE, n);
+	ell_point_init(tP[i], tE[i], n);
+    }
     for(s = smin; s < smax; s++){
 	mpz_set_si(x0, s);
 	/* c:=1/2*x0*(4*x0+1)/(3*x0+1); */
@@ -296,6 +298,8 @@ build_curves_with_torsion_Z5(mpz_t f, mpmod_t n,
 	mpz_set(tE[nc]->a6, B);
 	mpz_set(tP[nc]->x, X);
 	mpz_set(tP[nc]->y, Y);
+	if(tu != NULL)
+	    tu[nc] = s;
 	nc++;
 	if(nc >= nE)
 	    break;
@@ -416,10 +420,10 @@ build_curves_with_torsion_aux(ell_curve_t Eaux, ell_point_t Paux,
 */
 int
 build_curves_with_torsion_Z7(mpz_t fac, mpmod_t n, 
-			     ell_curve_t *tE, ell_point_t *tP,
+			     ell_curve_t *tE, ell_point_t *tP, int *tu,
 			     int umin, int umax, int nE)
 {
-    int u, ret = ECM_NO_FACTOR_FOUND, nc = 0;
+    int u, i, ret = ECM_NO_FACTOR_FOUND, nc = 0;
     mpz_t A2, A1div2, x0, y0, cte, d, c, b, kx0, ky0, A, B, X, Y;
     mpres_t tmp;
     ell_curve_t E;
@@ -450,8 +454,10 @@ build_curves_with_torsion_Z7(mpz_t fac, mpmod_t n,
     mpz_init(kx0);
     mpz_init(ky0);
     ell_point_init(Q, E, n);
-    ell_curve_init(tE[nc], ECM_EC_TYPE_WEIERSTRASS, ECM_LAW_AFFINE, n);
-    ell_point_init(tP[nc], tE[nc], n);
+    for(i = 0; i < nE; i++){
+	ell_curve_init(tE[i], ECM_EC_TYPE_WEIERSTRASS, ECM_LAW_AFFINE, n);
+	ell_point_init(tP[i], tE[i], n);
+    }
     mpz_set_si(d, umin-1);
     if(ell_point_mul(fac, Q, d, P, E, n) == 0){
 	printf("found factor during init of Q in Z7\n");
@@ -503,7 +509,7 @@ build_curves_with_torsion_Z7(mpz_t fac, mpmod_t n,
 	mpz_mod(b, b, n->orig_modulus);
 	/* to short Weierstrass form */
 	kubert_to_weierstrass(A, B, X, Y, b, c, kx0, ky0, n->orig_modulus);
-	if(check_weierstrass(A, B, X, Y, tmp, x0, n->orig_modulus) == 0){
+	if(check_weierstrass(A, B, X, Y, b, c, n->orig_modulus) == 0){
 	    ret = ECM_ERROR;
             break;
 	}
@@ -516,6 +522,8 @@ build_curves_with_torsion_Z7(mpz_t fac, mpmod_t n,
 	gmp_printf("P[%d]:=[%Zd, %Zd, %Zd];\n", 
 		   nc, tP[nc]->x, tP[nc]->y, tP[nc]->z);
 #endif
+	if(tu != NULL)
+	    tu[nc] = u;
 	nc++;
 	if(nc >= nE)
 	    break;
@@ -550,9 +558,10 @@ build_curves_with_torsion_Z7(mpz_t fac, mpmod_t n,
 */
 int
 build_curves_with_torsion_Z9(mpz_t fac, mpmod_t n, ell_curve_t *tE, 
-			     ell_point_t *tP, int umin, int umax, int nE)
+			     ell_point_t *tP, int *tu,
+			     int umin, int umax, int nE)
 {
-    int u, ret = ECM_NO_FACTOR_FOUND, nc = 0;
+    int u, i, ret = ECM_NO_FACTOR_FOUND, nc = 0;
     mpz_t A2, A1div2, x0, y0, cte, d, c, b, kx0, ky0, A, B, X, Y, f;
     mpres_t tmp;
     ell_curve_t E;
@@ -583,8 +592,10 @@ build_curves_with_torsion_Z9(mpz_t fac, mpmod_t n, ell_curve_t *tE,
     mpz_init(kx0);
     mpz_init(ky0);
     ell_point_init(Q, E, n);
-    ell_curve_init(tE[nc], ECM_EC_TYPE_WEIERSTRASS, ECM_LAW_AFFINE, n);
-    ell_point_init(tP[nc], tE[nc], n);
+    for(i = 0; i < nE; i++){
+	ell_curve_init(tE[i], ECM_EC_TYPE_WEIERSTRASS, ECM_LAW_AFFINE, n);
+	ell_point_init(tP[i], tE[i], n);
+    }
     mpz_set_si(d, umin-1);
     if(ell_point_mul(fac, Q, d, P, E, n) == 0){
 	printf("found factor during init of Q in Z9\n");
@@ -648,7 +659,7 @@ build_curves_with_torsion_Z9(mpz_t fac, mpmod_t n, ell_curve_t *tE,
 #endif
 	/* to short Weierstrass form */
 	kubert_to_weierstrass(A, B, X, Y, b, c, kx0, ky0, n->orig_modulus);
-	if(check_weierstrass(A, B, X, Y, tmp, x0, n->orig_modulus) == 0){
+	if(check_weierstrass(A, B, X, Y, b, c, n->orig_modulus) == 0){
             ret = ECM_ERROR;
             break;
         }
@@ -656,6 +667,8 @@ build_curves_with_torsion_Z9(mpz_t fac, mpmod_t n, ell_curve_t *tE,
         mpz_set(tE[nc]->a6, B);
         mpz_set(tP[nc]->x, X);
         mpz_set(tP[nc]->y, Y);
+	if(tu != NULL)
+	    tu[nc] = u;
 	nc++;
 	if(nc >= nE)
 	    break;
@@ -684,9 +697,10 @@ build_curves_with_torsion_Z9(mpz_t fac, mpmod_t n, ell_curve_t *tE,
 
 int
 build_curves_with_torsion_Z10(mpz_t fac, mpmod_t n, ell_curve_t *tE, 
-			      ell_point_t *tP, int umin, int umax, int nE)
+			      ell_point_t *tP, int *tu,
+			      int umin, int umax, int nE)
 {
-    int u, ret = ECM_NO_FACTOR_FOUND, nc = 0;
+    int u, i, ret = ECM_NO_FACTOR_FOUND, nc = 0;
     mpz_t A2, A1div2, x0, y0, cte, d, c, b, kx0, ky0, A, B, X, Y;
     mpz_t f;
     mpres_t tmp;
@@ -718,18 +732,24 @@ build_curves_with_torsion_Z10(mpz_t fac, mpmod_t n, ell_curve_t *tE,
     mpz_init(kx0);
     mpz_init(ky0);
     ell_point_init(Q, E, n);
-    ell_curve_init(tE[nc], ECM_EC_TYPE_WEIERSTRASS, ECM_LAW_AFFINE, n);
-    ell_point_init(tP[nc], tE[nc], n);
-    for(u = umin; u < umax; u++){
-	if(forbidden("Z10", u))
-	    continue;
+    for(i = 0; i < nE; i++){
+	ell_curve_init(tE[i], ECM_EC_TYPE_WEIERSTRASS, ECM_LAW_AFFINE, n);
+	ell_point_init(tP[i], tE[i], n);
+    }
+    mpz_set_si(d, umin-1);
+    if(ell_point_mul(fac, Q, d, P, E, n) == 0){
+	printf("found factor during init of Q in Z10\n");
+	ret = ECM_FACTOR_FOUND_STEP1;
+    }
+    for(u = umin; (ret != ECM_FACTOR_FOUND_STEP1) && u < umax; u++){
 	/* update Qaux */
-	mpz_set_si(d, u);
-	if(ell_point_mul(fac, Q, d, P, E, n) == 0){
+	if(ell_point_add(fac, Q, P, Q, E, n) == 0){
 	    printf("found factor during update of Q in Z10\n");
 	    ret = ECM_FACTOR_FOUND_STEP1;
 	    break;
 	}
+	if(forbidden("Z10", u))
+	    continue;
 #if DEBUG_TORSION >= 2
 	printf("(s, t)[%d]:=", u);
 	pt_print(E, Q, n);
@@ -789,7 +809,7 @@ build_curves_with_torsion_Z10(mpz_t fac, mpmod_t n, ell_curve_t *tE,
 #endif
 	/* to short Weierstrass form */
 	kubert_to_weierstrass(A, B, X, Y, b, c, kx0, ky0, n->orig_modulus);
-	if(check_weierstrass(A, B, X, Y, tmp, x0, n->orig_modulus) == 0){
+	if(check_weierstrass(A, B, X, Y, b, c, n->orig_modulus) == 0){
             ret = ECM_ERROR;
             break;
         }
@@ -797,6 +817,8 @@ build_curves_with_torsion_Z10(mpz_t fac, mpmod_t n, ell_curve_t *tE,
         mpz_set(tE[nc]->a6, B);
         mpz_set(tP[nc]->x, X);
         mpz_set(tP[nc]->y, Y);
+	if(tu != NULL)
+	    tu[nc] = u;
 	nc++;
 	if(nc >= nE)
 	    break;
@@ -834,10 +856,10 @@ build_curves_with_torsion_Z10(mpz_t fac, mpmod_t n, ell_curve_t *tE,
 */
 int
 build_curves_with_torsion_Z2xZ8(mpz_t fac, mpmod_t n, 
-				ell_curve_t *tE, ell_point_t *tP,
+				ell_curve_t *tE, ell_point_t *tP, int *tu,
 				int umin, int umax, int nE)
 {
-    int u, nc = 0, ret = ECM_NO_FACTOR_FOUND;
+    int u, i, nc = 0, ret = ECM_NO_FACTOR_FOUND;
     mpz_t tmp, a, b, alpha, beta, c, d, kx0, ky0, wx0, mb;
     mpres_t tmp2;
     ell_curve_t E;
@@ -856,8 +878,10 @@ build_curves_with_torsion_Z2xZ8(mpz_t fac, mpmod_t n,
     mpz_init(mb);
 
     /* to Montgomery form */
-    ell_curve_init(tE[nc], ECM_EC_TYPE_MONTGOMERY, ECM_LAW_HOMOGENEOUS,n);
-    ell_point_init(tP[nc], tE[nc], n);
+    for(i = 0; i < nE; i++){
+	ell_curve_init(tE[i], ECM_EC_TYPE_MONTGOMERY, ECM_LAW_HOMOGENEOUS, n);
+	ell_point_init(tP[i], tE[i], n);
+    }
 
     /* Eaux = [-8, -32] */
     /* Paux = [12, 40, 1] */
@@ -1040,6 +1064,8 @@ build_curves_with_torsion_Z2xZ8(mpz_t fac, mpmod_t n,
 	gmp_printf("my0:=%Zd;\n", tmp);
 	printf("chk:=(mb*my0^2-mx0^3-ma*mx0^2-mx0) mod N;\n");
 #endif
+	if(tu != NULL)
+	    tu[nc] = u;
 	nc++;
 	if(nc >= nE)
 	    break;
@@ -1072,10 +1098,10 @@ build_curves_with_torsion_Z2xZ8(mpz_t fac, mpmod_t n,
    A more simpler and more efficient stuff, using Hessian form. */
 int
 build_curves_with_torsion_Z3xZ3(mpz_t f, mpmod_t n, 
-				ell_curve_t *tE, ell_point_t *tP,
+				ell_curve_t *tE, ell_point_t *tP, int *tu,
 				int umin, int umax, int nE)
 {
-    int u, nc = 0, ret = ECM_NO_FACTOR_FOUND;
+    int u, i, nc = 0, ret = ECM_NO_FACTOR_FOUND;
     mpz_t u0, v0, D, num, den;
 
     mpz_init(u0);
@@ -1083,8 +1109,10 @@ build_curves_with_torsion_Z3xZ3(mpz_t f, mpmod_t n,
     mpz_init(den);
     mpz_init(D);
     mpz_init_set_si(v0, umin-1); /* to prevent u0 = v0 */
-    ell_curve_init_set(tE[nc],ECM_EC_TYPE_HESSIAN,ECM_LAW_HOMOGENEOUS,D,n);
-    ell_point_init(tP[nc], tE[nc], n);
+    for(i = 0; i < nE; i++){
+	ell_curve_init_set(tE[i], ECM_EC_TYPE_HESSIAN, ECM_LAW_HOMOGENEOUS, D, n);
+	ell_point_init(tP[i], tE[i], n);
+    }
     for(u = umin; u < umax; u++){
 	if(forbidden("Z3xZ3", u))
 	    continue;
@@ -1118,9 +1146,12 @@ build_curves_with_torsion_Z3xZ3(mpz_t f, mpmod_t n,
 	    ret = ECM_ERROR;
 	    break;
 	}
+	mpz_set(tE[nc]->a4, D);
 	mpz_set(tP[nc]->x, u0);
 	mpz_set(tP[nc]->y, v0);
 	mpz_set_ui(tP[nc]->z, 1);
+	if(tu != NULL)
+	    tu[nc] = u;
 	nc++;
 	if(nc >= nE)
 	    break;
@@ -1136,10 +1167,10 @@ build_curves_with_torsion_Z3xZ3(mpz_t f, mpmod_t n,
 /* For a small price, add a 2-torsion point, also over Q(sqrt(-3)). */
 int
 build_curves_with_torsion_Z3xZ6(mpz_t f, mpmod_t n, 
-				ell_curve_t *tE, ell_point_t *tP,
+				ell_curve_t *tE, ell_point_t *tP, int *tu,
 				int umin, int umax, int nE)
 {
-    int u, nc = 0, ret = ECM_NO_FACTOR_FOUND;
+    int u, i, nc = 0, ret = ECM_NO_FACTOR_FOUND;
     ell_curve_t E;
     ell_point_t P, Q;
     mpres_t tmp, num, den, tk, sk;
@@ -1156,8 +1187,10 @@ build_curves_with_torsion_Z3xZ6(mpz_t f, mpmod_t n,
     mpres_set_ui(tmp, 0, n);
     ell_curve_init_set(E, ECM_EC_TYPE_WEIERSTRASS, ECM_LAW_AFFINE, tmp, n);
     ell_point_init(P, E, n);
-    ell_curve_init(tE[nc], ECM_EC_TYPE_HESSIAN, ECM_LAW_HOMOGENEOUS, n);
-    ell_point_init(tP[nc], tE[nc], n);
+    for(i = 0; i < nE; i++){
+	ell_curve_init(tE[i], ECM_EC_TYPE_HESSIAN, ECM_LAW_HOMOGENEOUS, n);
+	ell_point_init(tP[i], tE[i], n);
+    }
     mpz_set_str(f, "2", 10);
     mpres_set_z(P->x, f, n);
     mpz_set_str(f, "2", 10);
@@ -1165,10 +1198,14 @@ build_curves_with_torsion_Z3xZ6(mpz_t f, mpmod_t n,
     mpz_set_ui(P->z, 1);
 
     ell_point_init(Q, E, n);
-    for(u = umin; u < umax; u++){
+    mpz_set_si(f, umin-1);
+    if(ell_point_mul(f, Q, f, P, E, n) == 0){
+	printf("found factor in Z3xZ6 (init of Q)\n");
+	ret = ECM_FACTOR_FOUND_STEP1;
+    }
+    for(u = umin; (ret != ECM_FACTOR_FOUND_STEP1) && u < umax; u++){
 	/* update Qaux */
-	mpz_set_si(f, u);
-	if(ell_point_mul(f, Q, f, P, E, n) == 0){
+	if(ell_point_add(f, Q, P, Q, E, n) == 0){
 	    printf("found factor in Z3xZ6 (update of Q)\n");
 	    ret = ECM_FACTOR_FOUND_STEP1;
 	    break;
@@ -1221,6 +1258,8 @@ build_curves_with_torsion_Z3xZ6(mpz_t f, mpmod_t n,
 	/* v0:=-1; */
 	mpz_sub_si(tP[nc]->y, n->orig_modulus, 1);
         mpz_set_ui(tP[nc]->z, 1);
+	if(tu != NULL)
+	    tu[nc] = u;
 	nc++;
 	if(nc >= nE)
 	    break;
@@ -1251,11 +1290,11 @@ build_curves_with_torsion_Z3xZ6(mpz_t f, mpmod_t n,
 */
 int
 build_curves_with_torsion_Z4xZ4(mpz_t f, mpmod_t n, ell_curve_t *tE,
-				ell_point_t *tP,
+				ell_point_t *tP, int *tu,
 				int smin, int smax, int nE)
 {
     mpz_t tau, lambda, nu2, tmp, b, x0;
-    int nu, nc = 0, ret = ECM_NO_FACTOR_FOUND;
+    int nu, i, nc = 0, ret = ECM_NO_FACTOR_FOUND;
 
     mpz_init(tau);
     mpz_init(lambda);
@@ -1264,8 +1303,10 @@ build_curves_with_torsion_Z4xZ4(mpz_t f, mpmod_t n, ell_curve_t *tE,
     mpz_init(b);
     mpz_init(x0);
     /* to Montgomery form */
-    ell_curve_init(tE[nc], ECM_EC_TYPE_MONTGOMERY, ECM_LAW_HOMOGENEOUS, n);
-    ell_point_init(tP[nc], tE[nc], n);
+    for(i = 0; i < nE; i++){
+	ell_curve_init(tE[i], ECM_EC_TYPE_MONTGOMERY, ECM_LAW_HOMOGENEOUS, n);
+	ell_point_init(tP[i], tE[i], n);
+    }
     for(nu = smin; nu < smax; nu++){
 	mpz_set_si(nu2, nu*nu);
 	/* tau:=(nu^2+3)/2/nu; */
@@ -1307,7 +1348,10 @@ build_curves_with_torsion_Z4xZ4(mpz_t f, mpmod_t n, ell_curve_t *tE,
 	mpz_add_si(tmp, x0, 2);
 	mpz_mul_si(tmp, tmp, -2);
 	mpz_mod(tmp, tmp, n->orig_modulus);
-	mod_from_rat2(tE[nc]->a4, tmp, x0, n->orig_modulus);
+	mod_from_rat2(tE[nc]->a2, tmp, x0, n->orig_modulus);
+	/* as for Z2xZ8, b*y^2 = x^3 + a2*x^2 + a4*x + a6 */
+	mpz_set_ui(tE[nc]->a4, 1);
+	mpz_set_ui(tE[nc]->a6, 0);
 	/* now compute real x0 */
 	/* x0:=3*(3*nu^12+34*nu^10+117*nu^8+316*nu^6+1053*nu^4+2754*nu^2+2187); */
 	mpz_set_si(x0, 3);
@@ -1324,16 +1368,18 @@ build_curves_with_torsion_Z4xZ4(mpz_t f, mpmod_t n, ell_curve_t *tE,
 	printf("nu:=%d;\n", nu);
 	gmp_printf("tau:=%Zd;\n", tau);
 	gmp_printf("lambda:=%Zd;\n", lambda);
-	gmp_printf("a:=%Zd;\n", tE[nc]->a4);
+	gmp_printf("a:=%Zd;\n", tE[nc]->a2);
 	gmp_printf("x0:=%Zd;\n", x0);
 #endif
 	/* x:=b*x0-a/3; not needed: y:=b*y0 */
 	mpz_set_si(tmp, 3);
-	mod_from_rat2(tP[nc]->x, tE[nc]->a4, tmp, n->orig_modulus);
+	mod_from_rat2(tP[nc]->x, tE[nc]->a2, tmp, n->orig_modulus);
 	mpz_mul(b, b, x0);
 	mpz_mod(b, b, n->orig_modulus);
 	mpz_sub(tP[nc]->x, b, tP[nc]->x);
 	mpz_mod(tP[nc]->x, tP[nc]->x, n->orig_modulus);
+	if(tu != NULL)
+	    tu[nc] = nu;
 	nc++;
 	if(nc >= nE)
 	    break;
@@ -1351,35 +1397,58 @@ build_curves_with_torsion_Z4xZ4(mpz_t f, mpmod_t n, ell_curve_t *tE,
     return ret;
 }
 
+/* Returns 1 if curves of torsion group torsion can be built, 0 otherwise. */
+int
+torsion_is_known(char *torsion)
+{
+    const char *known[] = {"Z5", "Z7", "Z9", "Z10", "Z2xZ8",
+			   "Z3xZ3", "Z3xZ6", "Z4xZ4", NULL};
+    int i;
+
+    for(i = 0; known[i] != NULL; i++)
+	if(strcmp(torsion, known[i]) == 0)
+	    return 1;
+    return 0;
+}
+
 /* Assuming we can generate curves with given torsion using parameter s
    in interval [smin..smax[.
+   tE[0..nE[ and tP[0..nE[ are initialized, unless ECM_USER_ERROR is
+   returned. If tu is not NULL, tu[i] receives the parameter of curve i.
+   Consecutive parameters are obtained cheaply in one call, e.g., with one
+   addition on the auxiliary curve each.
 */
 int
-build_curves_with_torsion(mpz_t f, mpmod_t n, ell_curve_t *tE, ell_point_t *tP,
-			  char *torsion, int smin, int smax, int nE)
+build_curves_with_torsion_params(mpz_t f, mpmod_t n, ell_curve_t *tE,
+				 ell_point_t *tP, int *tu, char *torsion,
+				 int smin, int smax, int nE)
 {
     int ret = 0;
 
     /* over Q: see Atkin-Morain, Math. Comp., 1993 */
     if(strcmp(torsion, "Z5") == 0)
-	return build_curves_with_torsion_Z5(f, n, tE, tP, smin, smax, nE);
+	return build_curves_with_torsion_Z5(f, n, tE, tP, tu, smin, smax, nE);
     else if(strcmp(torsion, "Z7") == 0)
-	return build_curves_with_torsion_Z7(f, n, tE, tP, smin, smax, nE);
+	return build_curves_with_torsion_Z7(f, n, tE, tP, tu, smin, smax, nE);
     else if(strcmp(torsion, "Z9") == 0)
-	return build_curves_with_torsion_Z9(f, n, tE, tP, smin, smax, nE);
+	return build_curves_with_torsion_Z9(f, n, tE, tP, tu, smin, smax, nE);
     else if(strcmp(torsion, "Z10") == 0)
-	return build_curves_with_torsion_Z10(f, n, tE, tP, smin, smax, nE);
+	return build_curves_with_torsion_Z10(f, n, tE, tP, tu, smin, smax, nE);
     else if(strcmp(torsion, "Z2xZ8") == 0)
-	return build_curves_with_torsion_Z2xZ8(f, n, tE, tP, smin, smax, nE);
+	return build_curves_with_torsion_Z2xZ8(f, n, tE, tP, tu,
+					       smin, smax, nE);
     /* no longer over Q */
     /** interesting when p = 1 mod 3 **/
     else if(strcmp(torsion, "Z3xZ3") == 0) /* over Q(sqrt(-3)) */
-	return build_curves_with_torsion_Z3xZ3(f, n, tE, tP, smin, smax, nE);
+	return build_curves_with_torsion_Z3xZ3(f, n, tE, tP, tu,
+					       smin, smax, nE);
     else if(strcmp(torsion, "Z3xZ6") == 0) /* over Q(sqrt(-3)) */
-	return build_curves_with_torsion_Z3xZ6(f, n, tE, tP, smin, smax, nE);
+	return build_curves_with_torsion_Z3xZ6(f, n, tE, tP, tu,
+					       smin, smax, nE);
     /** interesting when p = 1 mod 4 **/
     else if(strcmp(torsion, "Z4xZ4") == 0) /* over Q(sqrt(-1)) */
-	return build_curves_with_torsion_Z4xZ4(f, n, tE, tP, smin, smax, nE);
+	return build_curves_with_torsion_Z4xZ4(f, n, tE, tP, tu,
+					       smin, smax, nE);
     else{
 	printf("Unknown torsion group: %s\n", torsion);
 	ret = ECM_USER_ERROR;
@@ -1387,6 +1456,142 @@ build_curves_with_torsion(mpz_t f, mpmod_t n, ell_curve_t *tE, ell_point_t *tP,
     return ret;
 }
 
+int
+build_curves_with_torsion(mpz_t f, mpmod_t n, ell_curve_t *tE, ell_point_t *tP,
+			  char *torsion, int smin, int smax, int nE)
+{
+    return build_curves_with_torsion_params(f, n, tE, tP, NULL, torsion,
+					    smin, smax, nE);
+}
+
+/********** lazy enumeration **********/
+
+/* Prepares G to hand out, one at a time, the curves of torsion group
+   torsion of parameters [umin..umax[. They are built chunk curves at a
+   time, with one call to the builder, which gets each curve from the
+   previous one (Z3xZ3 curves are built one at a time, since they depend on
+   the first parameter of the call). torsion must stay valid until
+   torsion_gen_clear.
+   Returns ECM_USER_ERROR if torsion has no builder (G is then not
+   initialized), ECM_NO_FACTOR_FOUND otherwise.
+*/
+int
+torsion_gen_init(torsion_gen_t G, char *torsion, int umin, int umax,
+		 int chunk)
+{
+    if(torsion_is_known(torsion) == 0)
+	return ECM_USER_ERROR;
+    if(strcmp(torsion, "Z3xZ3") == 0 || chunk < 1)
+	chunk = 1;
+    G->torsion = torsion;
+    G->u = umin;
+    G->umax = umax;
+    G->chunk = chunk;
+    G->tE = (ell_curve_t *) malloc (chunk * sizeof (ell_curve_t));
+    G->tP = (ell_point_t *) malloc (chunk * sizeof (ell_point_t));
+    G->tu = (int *) malloc (chunk * sizeof (int));
+    G->m = 0;
+    G->nc = 0;
+    G->next = 0;
+    G->factor = 0;
+    mpz_init(G->f);
+    if(G->tE == NULL || G->tP == NULL || G->tu == NULL)
+	G->u = umax; /* no curve will be handed out */
+    return ECM_NO_FACTOR_FOUND;
+}
+
+/* Frees the curves of the last builder call. */
+static void
+torsion_gen_free_chunk(torsion_gen_t G, mpmod_t n)
+{
+    int j;
+
+    for(j = 0; j < G->m; j++){
+	ell_point_clear(G->tP[j], G->tE[j], n);
+	ell_curve_clear(G->tE[j], n);
+    }
+    G->m = 0;
+}
+
+/* Calls the builder on the next chunk of parameters. As long as nothing
+   goes wrong, the next call starts after the chunk; when the builder
+   stopped on some parameter (keeping the factor found there, if any), it
+   starts from the next one.
+*/
+static void
+torsion_gen_fill(torsion_gen_t G, mpmod_t n)
+{
+    int umax = MIN(G->umax, G->u + G->chunk), v, j, ret;
+
+    torsion_gen_free_chunk(G, n);
+    G->m = umax - G->u;
+    for(j = 0; j < G->m; j++)
+	G->tu[j] = G->u - 1; /* not a parameter */
+    ret = build_curves_with_torsion_params(G->f, n, G->tE, G->tP, G->tu,
+					   G->torsion, G->u, umax, G->m);
+    for(j = 0; j < G->m && G->tu[j] >= G->u; j++);
+    G->nc = j;
+    G->next = 0;
+    /* if it failed, the builder stopped on the first parameter it did
+       not use */
+    v = (j > 0) ? G->tu[j-1] + 1 : G->u;
+    if(ret == ECM_FACTOR_FOUND_STEP1 && v < umax){
+	G->fu = v;
+	G->factor = 1;
+    }
+    G->u = (ret == ECM_NO_FACTOR_FOUND) ? umax : v + 1;
+}
+
+/* Hands out the next curve of G: E and P are initialized and receive it,
+   in the raw modular form of the builders, and *u gets its parameter.
+   Returns 1 in that case, 2 if a factor was found (put in f) when building
+   the curve of parameter *u (E and P are then not initialized), and 0 when
+   no parameter is left.
+*/
+int
+torsion_gen_next(mpz_t f, ell_curve_t E, ell_point_t P, int *u,
+		 torsion_gen_t G, mpmod_t n)
+{
+    __ell_curve_struct *zE;
+    __ell_point_struct *zP;
+
+    while(G->next == G->nc){
+	if(G->factor){
+	    G->factor = 0;
+	    mpz_set(f, G->f);
+	    *u = G->fu;
+	    return 2;
+	}
+	if(G->u >= G->umax)
+	    return 0;
+	torsion_gen_fill(G, n);
+    }
+    zE = G->tE[G->next];
+    zP = G->tP[G->next];
+    ell_curve_init(E, zE->type, zE->law, n);
+    mpz_set(E->a1, zE->a1);
+    mpz_set(E->a3, zE->a3);
+    mpz_set(E->a2, zE->a2);
+    mpz_set(E->a4, zE->a4);
+    mpz_set(E->a6, zE->a6);
+    ell_point_init(P, E, n);
+    mpz_set(P->x, zP->x);
+    mpz_set(P->y, zP->y);
+    mpz_set(P->z, zP->z);
+    *u = G->tu[G->next++];
+    return 1;
+}
+
+void
+torsion_gen_clear(torsion_gen_t G, mpmod_t n)
+{
+    torsion_gen_free_chunk(G, n);
+    free(G->tE);
+    free(G->tP);
+    free(G->tu);
+    mpz_clear(G->f);
+}
+
 /* E is a curve with given torsion and (x, y) a point on E mod n.
    OUTPUT: ECM_NO_FACTOR_FOUND if everything went ok
            ECM_FACTOR_FOUND_STEP1 in case a factor was found when building E.
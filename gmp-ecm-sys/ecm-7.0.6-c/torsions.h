@@ -5,32 +5,60 @@ void ec_force_point(ell_curve_t E, ell_point_t P, long *x0, mpz_t n);
 
 int
 build_curves_with_torsion_Z5(mpz_t f, mpmod_t n, 
-			     ell_curve_t *tE, ell_point_t *tP,
+			     ell_curve_t *tE, ell_point_t *tP, int *tu,
 			     int smin, int smax, int nE);
 int
 build_curves_with_torsion_Z7(mpz_t f, mpmod_t n, 
-			     ell_curve_t *tE, ell_point_t *tP,
+			     ell_curve_t *tE, ell_point_t *tP, int *tu,
 			     int umin, int umax, int nE);
 int
 build_curves_with_torsion_Z9(mpz_t fac, mpmod_t n, ell_curve_t *tE, 
-			     ell_point_t *tP, int umin, int umax, int nE);
+			     ell_point_t *tP, int *tu,
+			     int umin, int umax, int nE);
 int
 build_curves_with_torsion_Z10(mpz_t fac, mpmod_t n, ell_curve_t *tE, 
-			      ell_point_t *tP, int umin, int umax, int nE);
+			      ell_point_t *tP, int *tu,
+			      int umin, int umax, int nE);
 int
 build_curves_with_torsion_Z2xZ8(mpz_t f, mpmod_t n, 
-				ell_curve_t *tE, ell_point_t *tP,
+				ell_curve_t *tE, ell_point_t *tP, int *tu,
 				int umin, int umax, int nE);
 int
 build_curves_with_torsion_Z3xZ3_DuNa(mpmod_t n, ell_curve_t *tE, ell_point_t *tP,
 				     int smin, int smax, int nE);
 int
 build_curves_with_torsion_Z3xZ3(mpz_t f, mpmod_t n, 
-				ell_curve_t *tE, ell_point_t *tP,
+				ell_curve_t *tE, ell_point_t *tP, int *tu,
 				int umin, int umax, int nE);
 int
 build_curves_with_torsion_Z3xZ6(mpz_t f, mpmod_t n, 
-				ell_curve_t *tE, ell_point_t *tP,
+				ell_curve_t *tE, ell_point_t *tP, int *tu,
 				int umin, int umax, int nE);
+int torsion_is_known(char *torsion);
+int build_curves_with_torsion_params(mpz_t f, mpmod_t n, ell_curve_t *tE,
+				     ell_point_t *tP, int *tu, char *torsion,
+				     int smin, int smax, int nE);
 int build_curves_with_torsion(mpz_t f, mpmod_t n, ell_curve_t *tE, ell_point_t *tP, char *torsion, int smin, int smax, int nE);
 int build_curves_with_torsion2(mpz_t f, mpz_t n, ell_curve_t E,  mpz_t x, mpz_t y, char *torsion, mpz_t sigma);
+
+/* State of the lazy enumeration of the curves of a torsion group */
+typedef struct
+{
+  char *torsion;
+  int u, umax;       /* next parameter to build, end of the range */
+  int chunk;         /* number of parameters per builder call */
+  ell_curve_t *tE;   /* curves of the last builder call */
+  ell_point_t *tP;
+  int *tu;           /* their parameters */
+  int m;             /* number of curves initialized by the last call */
+  int nc, next;      /* number of curves built, next one to hand out */
+  int factor, fu;    /* a factor f was found on parameter fu */
+  mpz_t f;
+} __torsion_gen_struct;
+typedef __torsion_gen_struct torsion_gen_t[1];
+
+int torsion_gen_init(torsion_gen_t G, char *torsion, int umin, int umax,
+		     int chunk);
+int torsion_gen_next(mpz_t f, ell_curve_t E, ell_point_t P, int *u,
+		     torsion_gen_t G, mpmod_t n);
+void torsion_gen_clear(torsion_gen_t G, mpmod_t n);
@@ -81,6 +81,7 @@ size_t MPZMOD_THRESHOLD;
 size_t REDC_THRESHOLD;
 size_t NTT_GFP_TWIDDLE_DIF_BREAKOVER = MAX_LOG2_LEN;
 size_t NTT_GFP_TWIDDLE_DIT_BREAKOVER = MAX_LOG2_LEN;
+size_t NTT_GFP_FOURSTEP_THRESHOLD = MAX_LOG2_LEN;
 size_t MUL_NTT_THRESHOLD;
 size_t PREREVERTDIVISION_NTT_THRESHOLD;
 size_t POLYINVERT_NTT_THRESHOLD;
@@ -94,107 +95,19 @@ mpz_quick_random (mpz_t x, mpz_t M)
 }
 
 
+/* the measurements themselves are done by mpmod_tune_mul() in mpmod.c,
+   which the library also uses to tune itself at run time */
 double
 tune_mpres_mul (mp_size_t limbs, int repr)
 {
-  mpmod_t modulus;
-  mpres_t x, y, z;
-  mpz_t N, p, q;
-  unsigned int __k = 1, __i;
-  long __st;
-
-  mpz_init (N);
-  mpz_init (p);
-  mpz_init (q);
-  
-  /* No need to generate a probable prime, just ensure N is not
-     divisible by 2 or 3 */
-  do
-    {
-      mpz_urandomb (N, gmp_randstate, limbs * GMP_NUMB_BITS);
-      while (mpz_gcd_ui (NULL, N, 6) != 1)
-        mpz_add_ui (N, N, 1);
-    }
-  while ((mp_size_t) mpz_size (N) != limbs);
-  
-  if (repr == ECM_MOD_MPZ)
-    mpmod_init_MPZ (modulus, N);
-  else if (repr == ECM_MOD_MODMULN)
-    mpmod_init_MODMULN (modulus, N);
-  else if (repr == ECM_MOD_REDC)
-    mpmod_init_REDC (modulus, N);
-
-  mpz_urandomm (p, gmp_randstate, N);
-  mpz_urandomm (q, gmp_randstate, N);
-  
-  mpres_init (x, modulus);
-  mpres_init (y, modulus);
-  mpres_init (z, modulus);
-
-  mpres_set_z (x, p, modulus);
-  mpres_set_z (y, q, modulus);
-
-  TUNE_FUNC_LOOP (mpres_mul (z, x, y, modulus));
-
-  mpres_clear (x, modulus);
-  mpres_clear (y, modulus);
-  mpres_clear (z, modulus);
-  mpmod_clear (modulus);
-  mpz_clear (N);
-  mpz_clear (p);
-  mpz_clear (q);
-
-  return (double) __k / (double) __st;
+  return mpmod_tune_mul (limbs, repr, 0, gmp_randstate, GRANULARITY);
 }
 
-#if 0
 double
 tune_mpres_sqr (mp_size_t limbs, int repr)
 {
-  mpmod_t modulus;
-  mpres_t x, z;
-  mpz_t N, p;
-  unsigned int __k = 1, __i;
-  long __st;
-
-  mpz_init (N);
-  mpz_init (p);
-  
-  /* No need to generate a probable prime, just ensure N is not
-     divisible by 2 or 3 */
-  do
-    {
-      mpz_urandomb (N, gmp_randstate, limbs * GMP_NUMB_BITS);
-      while (mpz_gcd_ui (NULL, N, 6) != 1)
-        mpz_add_ui (N, N, 1);
-    }
-  while ((mp_size_t) mpz_size (N) != limbs);
-  
-  if (repr == ECM_MOD_MPZ)
-    mpmod_init_MPZ (modulus, N);
-  else if (repr == ECM_MOD_MODMULN)
-    mpmod_init_MODMULN (modulus, N);
-  else if (repr == ECM_MOD_REDC)
-    mpmod_init_REDC (modulus, N);
-
-  mpz_urandomm (p, gmp_randstate, N);
-  
-  mpres_init (x, modulus);
-  mpres_init (z, modulus);
-
-  mpres_set_z (x, p, modulus);
-
-  TUNE_FUNC_LOOP (mpres_sqr (z, x, modulus));
-
-  mpres_clear (x, modulus);
-  mpres_clear (z, modulus);
-  mpmod_clear (modulus);
-  mpz_clear (N);
-  mpz_clear (p);
-
-  return (double) __k / (double) __st;
+  return mpmod_tune_mul (limbs, repr, 1, gmp_randstate, GRANULARITY);
 }
-#endif
 
 double
 tune_mpres_mul_mpz (size_t n)
@@ -226,6 +139,13 @@ TUNE_FUNC_START (tune_spv_ntt_gfp_dit)
 TUNE_FUNC_END (tune_spv_ntt_gfp_dit_recursive)
 
 
+TUNE_FUNC_START (tune_spv_ntt_gfp_fourstep)
+  NTT_GFP_FOURSTEP_THRESHOLD = n;
+  TUNE_FUNC_LOOP (spv_ntt_gfp_dif (spv, max_log2_len, spm);
+                  spv_ntt_gfp_dit (spv, max_log2_len, spm));
+TUNE_FUNC_END (tune_spv_ntt_gfp_fourstep)
+
+
 TUNE_FUNC_START (tune_ntt_mul)
   MUL_NTT_THRESHOLD = 0;
 
@@ -560,6 +480,13 @@ main (int argc, char **argv)
 
   printf ("#define NTT_GFP_TWIDDLE_DIT_BREAKOVER %lu\n",
       (unsigned long) NTT_GFP_TWIDDLE_DIT_BREAKOVER);
+
+  /* max_log2_len means the four-step code is not used up to MAX_LEN */
+  NTT_GFP_FOURSTEP_THRESHOLD = maximise
+      (tune_spv_ntt_gfp_fourstep, min_log2_len, max_log2_len + 1);
+
+  printf ("#define NTT_GFP_FOURSTEP_THRESHOLD %lu\n",
+      (unsigned long) NTT_GFP_FOURSTEP_THRESHOLD);
   
   MUL_NTT_THRESHOLD = 1 << crossover2 (tune_list_mul, tune_ntt_mul, 1,
       max_log2_len, 2);
@@ -17,6 +17,7 @@ pub const ECM_MOD_REDC: u32 = 4;
 pub const ECM_ECM: u32 = 0;
 pub const ECM_PM1: u32 = 1;
 pub const ECM_PP1: u32 = 2;
+pub const ECM_HECM: u32 = 3;
 pub const ECM_USER_ERROR: i32 = -2;
 pub const ECM_ERROR: i32 = -1;
 pub const ECM_NO_FACTOR_FOUND: u32 = 0;
@@ -1103,3 +1104,83 @@ extern "C" {
 extern "C" {
     pub fn ecm_clear(params: *mut __ecm_param_struct);
 }
+extern "C" {
+    pub fn ecm_prime_table_reserve(b1: f64) -> ::std::os::raw::c_int;
+}
+extern "C" {
+    pub fn ecm_prime_table_save(filename: *const ::std::os::raw::c_char) -> ::std::os::raw::c_int;
+}
+extern "C" {
+    pub fn ecm_prime_table_load(filename: *const ::std::os::raw::c_char) -> ::std::os::raw::c_int;
+}
+extern "C" {
+    pub fn ecm_prime_table_clear();
+}
+extern "C" {
+    pub fn ecm_treefile_clear();
+}
+extern "C" {
+    pub fn ecm_batch_s_dir(dir: *const ::std::os::raw::c_char) -> ::std::os::raw::c_int;
+}
+extern "C" {
+    pub fn ecm_batch_s_clear();
+}
+extern "C" {
+    pub fn ecm_mpmod_profile_load(filename: *const ::std::os::raw::c_char) -> ::std::os::raw::c_int;
+}
+extern "C" {
+    pub fn ecm_mpmod_tune(filename: *const ::std::os::raw::c_char) -> ::std::os::raw::c_int;
+}
+extern "C" {
+    pub fn ecm_mpmod_autotune(filename: *const ::std::os::raw::c_char) -> ::std::os::raw::c_int;
+}
+extern "C" {
+    pub fn ecm_mpmod_profile_skip();
+}
+extern "C" {
+    pub fn ecm_mpres_mul_run(
+        n: *mut __mpz_struct,
+        repr: ::std::os::raw::c_int,
+        sqr: ::std::os::raw::c_int,
+        count: ::std::os::raw::c_ulong,
+    ) -> ::std::os::raw::c_int;
+}
+pub type ecm_parallel_body_t = ::std::option::Option<
+    unsafe extern "C" fn(arg1: ::std::os::raw::c_ulong, arg2: *mut ::std::os::raw::c_void),
+>;
+pub type ecm_parallel_for_t = ::std::option::Option<
+    unsafe extern "C" fn(
+        arg1: ::std::os::raw::c_ulong,
+        arg2: ecm_parallel_body_t,
+        arg3: *mut ::std::os::raw::c_void,
+        arg4: *mut ::std::os::raw::c_void,
+    ),
+>;
+extern "C" {
+    pub fn ecm_set_parallel_for(
+        parallel_for: ecm_parallel_for_t,
+        ctx: *mut ::std::os::raw::c_void,
+    );
+}
+pub const ECM_COMPOSITE: u32 = 0;
+pub const ECM_PROBAB_PRIME: u32 = 1;
+pub const ECM_PRIME: u32 = 2;
+extern "C" {
+    pub fn ecm_prove_prime(
+        n: *mut __mpz_struct,
+        parallel_for: ecm_parallel_for_t,
+        ctx: *mut ::std::os::raw::c_void,
+    ) -> ::std::os::raw::c_int;
+}
+extern "C" {
+    pub fn ecm_factor_many_curves(
+        factors: *mut mpz_t,
+        res: *mut ::std::os::raw::c_int,
+        n: *mut __mpz_struct,
+        b1: f64,
+        torsion: *const ::std::os::raw::c_char,
+        smin: ::std::os::raw::c_int,
+        ncurves: ::std::os::raw::c_int,
+        params: *mut __ecm_param_struct,
+    ) -> ::std::os::raw::c_int;
+}
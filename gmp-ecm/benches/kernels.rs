@@ -0,0 +1,127 @@
+//! Benchmarks of the hot kernels, for moduli from 1 limb to 4096 bits.
+//!
+//! Run with `cargo bench`; criterion writes the results of each benchmark as
+//! JSON to `target/criterion/<group>/<id>/new/estimates.json`. With
+//! cargo-criterion, `cargo criterion --message-format=json` prints them all
+//! on stdout instead.
+
+use std::time::{Duration, Instant};
+
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion};
+use gmp_ecm::{ecm_factor, run_modular_products, EcmMethod, EcmParams, ModularArithmetic, NTT};
+use rug::{rand::RandState, Integer};
+
+/// Sizes of the moduli, in bits.
+const BITS: [u32; 7] = [64, 128, 256, 512, 1024, 2048, 4096];
+
+/// Curve of all the ECM benchmarks.
+const SIGMA: u32 = 7;
+
+/// Returns the same prime of `bits` bits on every run: unless a group order
+/// happens to be smooth, no factor is found and no run stops early.
+fn modulus(bits: u32) -> Integer {
+    let mut rand = RandState::new();
+    let mut n = Integer::from(Integer::random_bits(bits, &mut rand));
+    n.set_bit(bits - 1, true);
+    n.next_prime()
+}
+
+fn params() -> EcmParams {
+    EcmParams {
+        sigma: Some(Integer::from(SIGMA)),
+        verbose: false,
+        ..Default::default()
+    }
+}
+
+/// Stage 1 only: stage 2 is skipped when B2 < B2min = B1.
+fn stage1_params() -> EcmParams {
+    EcmParams {
+        b2: Some(Integer::ZERO),
+        ..params()
+    }
+}
+
+/// Runs `params` on every size of modulus, in the group `name`.
+fn bench_factor(c: &mut Criterion, name: &str, b1: f64, params: &EcmParams) {
+    let mut group = c.benchmark_group(name);
+    group.sample_size(10);
+    for bits in BITS {
+        let n = modulus(bits);
+        group.bench_with_input(BenchmarkId::from_parameter(bits), &n, |b, n| {
+            b.iter(|| ecm_factor(n, b1, params))
+        });
+    }
+    group.finish();
+}
+
+/// One ECM curve with the default parametrization and stage 2 bound.
+fn ecm_curve(c: &mut Criterion) {
+    bench_factor(c, "ecm_curve", 10_000.0, &params());
+}
+
+/// ECM stage 1 with the batch parametrization (param 1), which computes
+/// the product of all the prime powers up to B1 first.
+fn batch_stage1(c: &mut Criterion) {
+    let params = EcmParams {
+        param: Some(1),
+        ..stage1_params()
+    };
+    bench_factor(c, "batch_stage1", 10_000.0, &params);
+}
+
+fn pm1_stage1(c: &mut Criterion) {
+    let params = EcmParams {
+        method: EcmMethod::Pm1,
+        ..stage1_params()
+    };
+    bench_factor(c, "pm1_stage1", 100_000.0, &params);
+}
+
+/// ECM with a small B1, so that stage 2 takes most of the time.
+fn stage2(c: &mut Criterion) {
+    for (name, ntt) in [
+        ("stage2_ntt", NTT::Enabled),
+        ("stage2_no_ntt", NTT::Disabled),
+    ] {
+        let params = EcmParams {
+            b2: Some(Integer::from(10_000_000)),
+            ntt,
+            ..params()
+        };
+        bench_factor(c, name, 1_000.0, &params);
+    }
+}
+
+/// `mpres_mul` and `mpres_sqr` with each modular arithmetic.
+fn mpres(c: &mut Criterion) {
+    for (name, square) in [("mpres_mul", false), ("mpres_sqr", true)] {
+        let mut group = c.benchmark_group(name);
+        for arithmetic in [
+            ModularArithmetic::Mpz,
+            ModularArithmetic::Modmuln,
+            ModularArithmetic::Redc,
+        ] {
+            for bits in BITS {
+                let n = modulus(bits);
+                let id = BenchmarkId::new(format!("{arithmetic:?}"), bits);
+                group.bench_with_input(id, &n, |b, n| {
+                    b.iter_custom(|iters| {
+                        let start = Instant::now();
+                        assert!(run_modular_products(n, arithmetic, square, iters));
+                        start.elapsed()
+                    })
+                });
+            }
+        }
+        group.finish();
+    }
+}
+
+criterion_group! {
+    name = curves;
+    config = Criterion::default().measurement_time(Duration::from_secs(10));
+    targets = ecm_curve, batch_stage1, pm1_stage1, stage2
+}
+criterion_group!(kernels, mpres);
+criterion_main!(curves, kernels);
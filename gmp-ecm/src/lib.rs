@@ -4,10 +4,22 @@
 
 use gmp_ecm_sys::__mpz_struct;
 use rug::Integer;
-use std::ffi::CStr;
+use std::cell::RefCell;
+use std::ffi::{CStr, CString};
+use std::io;
+use std::os::raw::{c_int, c_ulong, c_void};
+use std::path::Path;
+use std::ptr;
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{Arc, Mutex, OnceLock};
+use std::thread;
 
 mod params;
+mod pool;
+mod prefilter;
 pub use params::*;
+pub use pool::*;
+pub use prefilter::*;
 
 /// Returns the version of the ECM library.
 pub fn ecm_version() -> &'static str {
@@ -15,20 +27,416 @@ pub fn ecm_version() -> &'static str {
 }
 
 /// Returns one factor of N using the Elliptic Curve Method.
+///
+/// With [`EcmMethod::Pp1`] and [`EcmParams::pp1_seeds`] greater than one,
+/// that many random seeds are run concurrently, one per thread, and all of
+/// them stop as soon as one finds a factor.
 pub fn ecm_factor(n: &Integer, b1: f64, params: &EcmParams) -> Integer {
-    let mut n = n.clone();
+    match params.method {
+        EcmMethod::Pp1 if params.pp1_seeds > 1 => pp1_factor_seeds(n, b1, params),
+        _ => factor_raw(n, b1, &mut RawEcmParams::from(params)).1,
+    }
+}
 
-    unsafe {
-        let mut params = RawEcmParams::from(params);
-        let mut factor = Integer::ZERO;
+fn factor_raw(n: &Integer, b1: f64, params: &mut RawEcmParams) -> (c_int, Integer) {
+    let mut n = n.clone();
+    let mut factor = Integer::ZERO;
 
+    let res = unsafe {
         gmp_ecm_sys::ecm_factor(
             factor.as_raw_mut() as *mut __mpz_struct,
             n.as_raw_mut() as *mut __mpz_struct,
             b1,
             params.as_mut_ptr(),
-        );
+        )
+    };
+
+    (res, factor)
+}
+
+/// Result of one curve of [`ecm_factor_many_curves`].
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub enum CurveResult {
+    /// The curve found no factor
+    NoFactor,
+    /// The curve found a factor in stage 1
+    Stage1(Integer),
+    /// The curve found a factor in stage 2
+    Stage2(Integer),
+    /// The parameter gives no curve of the family, or the run failed
+    Error,
+}
+
+/// Runs ECM on `count` curves with torsion group `torsion`, built from the
+/// parameters `smin..smin + count`, and returns the result of each curve.
+///
+/// Stage 1 is done for all the curves at once in affine Weierstrass form,
+/// with a single modular inversion per step for the whole batch. Stage 2 is
+/// then done curve by curve, with the bounds of `params`. The method of
+/// `params` is ignored. If the run fails, every curve that found no factor
+/// reports [`CurveResult::Error`].
+///
+/// # Panics
+///
+/// Panics if `count` does not fit in a C `int`.
+pub fn ecm_factor_many_curves(
+    n: &Integer,
+    b1: f64,
+    torsion: TorsionGroup,
+    smin: i32,
+    count: usize,
+    params: &EcmParams,
+) -> Vec<CurveResult> {
+    let ncurves = c_int::try_from(count).expect("too many curves");
+    let mut n = n.clone();
+    let mut factors = vec![Integer::ZERO; count];
+    let mut res: Vec<c_int> = vec![-1; count];
+    let torsion = CString::new(torsion.as_str()).unwrap();
+    let mut params = RawEcmParams::from(params);
+
+    let ret = unsafe {
+        // Integer is a transparent wrapper around mpz_t
+        gmp_ecm_sys::ecm_factor_many_curves(
+            factors.as_mut_ptr() as *mut gmp_ecm_sys::mpz_t,
+            res.as_mut_ptr(),
+            n.as_raw_mut() as *mut __mpz_struct,
+            b1,
+            torsion.as_ptr(),
+            smin,
+            ncurves,
+            params.as_mut_ptr(),
+        )
+    };
+
+    factors
+        .into_iter()
+        .zip(res)
+        .map(|(factor, res)| match res {
+            0 if ret < 0 => CurveResult::Error,
+            0 => CurveResult::NoFactor,
+            1 => CurveResult::Stage1(factor),
+            2 => CurveResult::Stage2(factor),
+            _ => CurveResult::Error,
+        })
+        .collect()
+}
+
+thread_local! {
+    /// Flag polled by [`pp1_stop_asap`] in the current thread.
+    static STOP: RefCell<Option<Arc<AtomicBool>>> = const { RefCell::new(None) };
+}
+
+extern "C" fn pp1_stop_asap() -> c_int {
+    STOP.with(|stop| {
+        stop.borrow()
+            .as_ref()
+            .is_some_and(|stop| stop.load(Ordering::Relaxed)) as c_int
+    })
+}
+
+/// Runs `params.pp1_seeds` P+1 seeds concurrently and returns the first
+/// factor found.
+fn pp1_factor_seeds(n: &Integer, b1: f64, params: &EcmParams) -> Integer {
+    // Build the prime table once so that the seeds share it instead of
+    // racing to sieve; the first seed to reach stage 1 builds the PRAC
+    // chains, which the other seeds then wait for and share.
+    reserve_prime_table(b1);
+
+    let stop = Arc::new(AtomicBool::new(false));
+    thread::scope(|scope| {
+        let seeds: Vec<_> = (0..params.pp1_seeds)
+            .map(|_| {
+                let stop = Arc::clone(&stop);
+                scope.spawn(move || {
+                    STOP.with(|cell| *cell.borrow_mut() = Some(Arc::clone(&stop)));
+                    let mut raw = RawEcmParams::from(params);
+                    raw.set_stop_asap(pp1_stop_asap);
+                    let (res, factor) = factor_raw(n, b1, &mut raw);
+                    STOP.with(|cell| *cell.borrow_mut() = None);
+                    if res > 0 {
+                        stop.store(true, Ordering::Relaxed);
+                    }
+                    (res, factor)
+                })
+            })
+            .collect();
+
+        let mut found = None;
+        let mut last = Integer::ZERO;
+        for seed in seeds {
+            let (res, factor) = seed.join().expect("P+1 seed panicked");
+            if res > 0 && found.is_none() {
+                found = Some(factor);
+            } else {
+                last = factor;
+            }
+        }
+        found.unwrap_or(last)
+    })
+}
+
+/// Makes sure the process-wide prime table covers all primes up to `b1`.
+///
+/// Stage 1 of every method reads its primes from a single table shared by all
+/// threads, which is extended on demand. Reserving the largest B1 in use up
+/// front builds it once. Returns `false` if the table could not be built, in
+/// which case each run sieves its own primes.
+pub fn reserve_prime_table(b1: f64) -> bool {
+    unsafe { gmp_ecm_sys::ecm_prime_table_reserve(b1) == 0 }
+}
+
+/// Saves the process-wide prime table to a file.
+pub fn save_prime_table(path: &Path) -> io::Result<()> {
+    let path = path_to_cstring(path)?;
+    match unsafe { gmp_ecm_sys::ecm_prime_table_save(path.as_ptr()) } {
+        0 => Ok(()),
+        _ => Err(io::Error::other("Cannot save prime table")),
+    }
+}
 
-        factor
+/// Loads a prime table saved by [`save_prime_table`].
+///
+/// The file is memory-mapped where possible, so that processes using the same
+/// file share a single copy.
+pub fn load_prime_table(path: &Path) -> io::Result<()> {
+    let path = path_to_cstring(path)?;
+    match unsafe { gmp_ecm_sys::ecm_prime_table_load(path.as_ptr()) } {
+        0 => Ok(()),
+        _ => Err(io::Error::new(
+            io::ErrorKind::InvalidData,
+            "Cannot load prime table",
+        )),
     }
 }
+
+/// Keeps the batch exponent of ECM stage 1 (with curve parametrizations 1 to
+/// 3, the product of the prime powers up to B1) in the directory `dir`.
+///
+/// The exponent is computed once per B1 and shared by all threads of the
+/// process. With a directory, it is also saved there, and other processes
+/// memory-map the file instead of computing it again. `None` stops using
+/// the directory. The exponent of each B1 stays in memory until
+/// [`clear_batch_s_cache`].
+pub fn set_batch_s_dir(dir: Option<&Path>) -> io::Result<()> {
+    let dir = dir.map(path_to_cstring).transpose()?;
+    let dir = dir.as_ref().map_or(ptr::null(), |dir| dir.as_ptr());
+    match unsafe { gmp_ecm_sys::ecm_batch_s_dir(dir) } {
+        0 => Ok(()),
+        _ => Err(io::Error::other("Cannot set batch exponent directory")),
+    }
+}
+
+/// Frees the batch exponents kept for all the B1 used so far (about 180 MB
+/// for B1 = 1e9), which processes going through many B1 should call from
+/// time to time.
+///
+/// # Safety
+///
+/// No other thread may run a factorization at the same time: its stage 1
+/// may be reading one of the exponents.
+pub unsafe fn clear_batch_s_cache() {
+    gmp_ecm_sys::ecm_batch_s_clear()
+}
+
+/// Loads the thresholds of the modular arithmetic saved by [`tune_mpmod`].
+///
+/// With `None`, loads the default profile: `$ECM_MPMOD_PROFILE`, or else
+/// `$HOME/.ecm-mpmod-<host name>`, which the first factorization of the
+/// process loads anyway if it exists. A profile from another host or another
+/// version of GMP or GMP-ECM is rejected.
+pub fn load_mpmod_profile(path: Option<&Path>) -> io::Result<()> {
+    let path = path.map(path_to_cstring).transpose()?;
+    let path = path.as_ref().map_or(ptr::null(), |path| path.as_ptr());
+    match unsafe { gmp_ecm_sys::ecm_mpmod_profile_load(path) } {
+        0 => Ok(()),
+        _ => Err(io::Error::new(
+            io::ErrorKind::InvalidData,
+            "Cannot load mpmod profile",
+        )),
+    }
+}
+
+/// Measures the thresholds between the MODMULN, mpz_mod and REDC modular
+/// arithmetics and the best mulredc code for each size on this host, uses
+/// them, and saves them to `path` (the default profile with `None`).
+///
+/// Takes a few seconds of CPU time, and must not be called while another
+/// thread is factoring.
+pub fn tune_mpmod(path: Option<&Path>) -> io::Result<()> {
+    let path = path.map(path_to_cstring).transpose()?;
+    let path = path.as_ref().map_or(ptr::null(), |path| path.as_ptr());
+    match unsafe { gmp_ecm_sys::ecm_mpmod_tune(path) } {
+        0 => Ok(()),
+        _ => Err(io::Error::other("Cannot save mpmod profile")),
+    }
+}
+
+/// Loads the mpmod profile at `path` (the default profile with `None`), or
+/// runs [`tune_mpmod`] if there is none yet for this host.
+pub fn autotune_mpmod(path: Option<&Path>) -> io::Result<()> {
+    let path = path.map(path_to_cstring).transpose()?;
+    let path = path.as_ref().map_or(ptr::null(), |path| path.as_ptr());
+    match unsafe { gmp_ecm_sys::ecm_mpmod_autotune(path) } {
+        0 => Ok(()),
+        _ => Err(io::Error::other("Cannot save mpmod profile")),
+    }
+}
+
+/// Keeps the thresholds of the modular arithmetic built in for the
+/// architecture: the default profile is not loaded by the first
+/// factorization of the process.
+///
+/// Has no effect once a factorization has started or a profile has been
+/// loaded.
+pub fn skip_mpmod_profile() {
+    unsafe { gmp_ecm_sys::ecm_mpmod_profile_skip() }
+}
+
+/// Runs `count` modular multiplications (squarings if `square`) modulo the
+/// odd number `n` with `arithmetic`, as the stages of all methods do.
+///
+/// Meant for benchmarks: the setup of the modulus is included, and the result
+/// is thrown away. Returns `false` if `n` is even or less than 3.
+pub fn run_modular_products(
+    n: &Integer,
+    arithmetic: ModularArithmetic,
+    square: bool,
+    count: u64,
+) -> bool {
+    let mut n = n.clone();
+    let repr = match arithmetic {
+        ModularArithmetic::Mpz => gmp_ecm_sys::ECM_MOD_MPZ,
+        ModularArithmetic::Modmuln => gmp_ecm_sys::ECM_MOD_MODMULN,
+        ModularArithmetic::Redc => gmp_ecm_sys::ECM_MOD_REDC,
+    };
+
+    unsafe {
+        gmp_ecm_sys::ecm_mpres_mul_run(
+            n.as_raw_mut() as *mut __mpz_struct,
+            repr as c_int,
+            square as c_int,
+            count as c_ulong,
+        ) == 0
+    }
+}
+
+/// Runs the independent loops of the library: over the small primes of the
+/// NTT stage 2, and over the Jacobi sum tests of [`prove_prime_with`].
+///
+/// The branches of the product tree may already run in separate threads, so
+/// `parallel_for` can be called from several threads at once.
+pub trait ParallelFor: Sync {
+    /// Calls `body(i)` once for each `i` in `0..n`, in any order, and returns
+    /// when all calls are done.
+    fn parallel_for(&self, n: usize, body: &(dyn Fn(usize) + Sync));
+}
+
+/// The executor set by [`set_parallel_for`], kept until it is replaced.
+static PARALLEL_FOR: Mutex<Option<Box<Box<dyn ParallelFor + Send>>>> = Mutex::new(None);
+
+/// Sets the executor of the loops over the small primes of the NTT stage 2,
+/// or restores the serial loops with `None`. The previous executor is
+/// dropped.
+///
+/// Applies to the runs started afterwards, and must not be called while
+/// another thread is factoring.
+pub fn set_parallel_for(executor: Option<Box<dyn ParallelFor + Send>>) {
+    let mut installed = PARALLEL_FOR.lock().unwrap();
+    // The C side needs a thin pointer
+    let executor = executor.map(Box::new);
+    unsafe {
+        match &executor {
+            Some(executor) => gmp_ecm_sys::ecm_set_parallel_for(
+                Some(installed_parallel_for),
+                &**executor as *const Box<dyn ParallelFor + Send> as *mut c_void,
+            ),
+            None => gmp_ecm_sys::ecm_set_parallel_for(None, std::ptr::null_mut()),
+        }
+    }
+    *installed = executor;
+}
+
+unsafe extern "C" fn installed_parallel_for(
+    n: c_ulong,
+    body: gmp_ecm_sys::ecm_parallel_body_t,
+    data: *mut c_void,
+    ctx: *mut c_void,
+) {
+    let executor = &**(ctx as *const Box<dyn ParallelFor + Send>);
+    run_parallel_for(executor, n, body, data);
+}
+
+unsafe extern "C" fn parallel_for_trampoline(
+    n: c_ulong,
+    body: gmp_ecm_sys::ecm_parallel_body_t,
+    data: *mut c_void,
+    ctx: *mut c_void,
+) {
+    let executor = *(ctx as *const &dyn ParallelFor);
+    run_parallel_for(executor, n, body, data);
+}
+
+fn run_parallel_for(
+    executor: &dyn ParallelFor,
+    n: c_ulong,
+    body: gmp_ecm_sys::ecm_parallel_body_t,
+    data: *mut c_void,
+) {
+    let body = body.expect("null loop body");
+    // The loop data is shared by all iterations, each of which touches only
+    // its own small prime or its own Jacobi sum test
+    let data = data as usize;
+    executor.parallel_for(n as usize, &|i| unsafe {
+        body(i as c_ulong, data as *mut c_void)
+    });
+}
+
+/// Result of [`prove_prime`].
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Primality {
+    /// The number is composite
+    Composite,
+    /// The number passed a BPSW test, but is too large for APR-CL (above
+    /// about 6000 digits)
+    ProbablePrime,
+    /// The number is proven prime
+    Prime,
+}
+
+/// Proves `n` prime or composite with APR-CL.
+///
+/// The Jacobi sum tests for the different (p, q) pairs are independent, so
+/// they run concurrently, on a pool of one thread per available core started
+/// by the first call.
+pub fn prove_prime(n: &Integer) -> Primality {
+    static POOL: OnceLock<ThreadPool> = OnceLock::new();
+    let pool = POOL.get_or_init(|| {
+        ThreadPool::new(thread::available_parallelism().map_or(1, |threads| threads.get()))
+    });
+    prove_prime_with(n, pool)
+}
+
+/// Same as [`prove_prime`], with the Jacobi sum tests run by `executor`.
+pub fn prove_prime_with(n: &Integer, executor: &dyn ParallelFor) -> Primality {
+    let mut n = n.clone();
+
+    let res = unsafe {
+        gmp_ecm_sys::ecm_prove_prime(
+            n.as_raw_mut() as *mut __mpz_struct,
+            Some(parallel_for_trampoline),
+            &executor as *const &dyn ParallelFor as *mut c_void,
+        )
+    };
+
+    match res as u32 {
+        gmp_ecm_sys::ECM_PRIME => Primality::Prime,
+        gmp_ecm_sys::ECM_PROBAB_PRIME => Primality::ProbablePrime,
+        _ => Primality::Composite,
+    }
+}
+
+fn path_to_cstring(path: &Path) -> io::Result<CString> {
+    path.to_str()
+        .and_then(|path| CString::new(path).ok())
+        .ok_or_else(|| io::Error::new(io::ErrorKind::InvalidInput, "Invalid path"))
+}
@@ -1,7 +1,11 @@
-use std::{str::FromStr, time::Duration};
+use std::{path::PathBuf, str::FromStr, time::Duration};
 
 use clap::{command, Parser};
-use gmp_ecm::{ecm_factor, EcmMethod, EcmParams, NTT};
+use gmp_ecm::{
+    autotune_mpmod, ecm_factor, ecm_factor_many_curves, prove_prime, set_batch_s_dir,
+    set_parallel_for, skip_mpmod_profile, Cofactor, EcmMethod, EcmParams, Prefilter, ThreadPool,
+    TorsionGroup, NTT,
+};
 use rug::Integer;
 use update_informer::{registry, Check};
 
@@ -10,6 +14,22 @@ fn parse_integer(s: &str) -> Result<Integer, std::io::Error> {
         .map_err(|_| std::io::Error::new(std::io::ErrorKind::InvalidInput, "Invalid integer"))
 }
 
+fn parse_torsion(s: &str) -> Result<TorsionGroup, std::io::Error> {
+    [
+        TorsionGroup::Z5,
+        TorsionGroup::Z7,
+        TorsionGroup::Z9,
+        TorsionGroup::Z10,
+        TorsionGroup::Z2xZ8,
+        TorsionGroup::Z3xZ3,
+        TorsionGroup::Z3xZ6,
+        TorsionGroup::Z4xZ4,
+    ]
+    .into_iter()
+    .find(|torsion| torsion.as_str() == s)
+    .ok_or_else(|| std::io::Error::new(std::io::ErrorKind::InvalidInput, "Unknown torsion group"))
+}
+
 #[derive(Parser, Debug, Clone)]
 #[command(author, version)]
 struct Args {
@@ -24,6 +44,9 @@ struct Args {
     /// Perform P+1 instead of the default method (ECM).
     #[clap(long)]
     pp1: bool,
+    /// Perform HECM (two elliptic curves per run, from a genus 2 curve) instead of the default method (ECM).
+    #[clap(long, conflicts_with_all = &["pm1", "pp1", "torsion"])]
+    hecm: bool,
 
     // Bounds
     /// Stage 1 bound (all primes 2 <= p <= B1 are processed in step 1).
@@ -43,15 +66,24 @@ struct Args {
     /// Initial y point. [default: generated from sigma for ECM, or at random for P-1 and P+1]
     #[clap(short, long, value_parser = parse_integer)]
     y0: Option<Integer>, // allow rational numbers
-    /// [ECM only] Curve parametrization.
-    #[clap(long, value_parser = parse_integer, conflicts_with_all = &["pm1", "pp1"])]
-    param: usize,
+    /// [ECM only] Curve parametrization, from 0 to 3 (1 to 3 run stage 1 in batch mode). [default: chosen from the input]
+    #[clap(long, value_parser = clap::value_parser!(i32).range(0..=3), conflicts_with_all = &["pm1", "pp1", "hecm", "torsion"])]
+    param: Option<i32>,
     /// [ECM only] Seed of the curve generator (can use --sigma i:s to specify --param i at the same). [default: random]
     #[clap(long, value_parser = parse_integer, conflicts_with_all = &["pm1", "pp1"])]
     sigma: Option<Integer>,
     /// [ECM only] Curve coefficient. [default: generated from sigma]
     #[clap(short, value_parser = parse_integer, conflicts_with_all = &["pm1", "pp1"])]
     a: Option<Integer>,
+    /// [ECM only] Use curves with torsion group Z5, Z7, Z9, Z10, Z2xZ8, Z3xZ3, Z3xZ6 or Z4xZ4, built from --sigma. [default: none]
+    #[clap(long, value_parser = parse_torsion, conflicts_with_all = &["pm1", "pp1", "a", "x0", "y0"])]
+    torsion: Option<TorsionGroup>,
+    /// [ECM only] Keep the stage 1 exponent of the batch parametrizations in this directory, for the next runs with the same B1. [default: none]
+    #[clap(long, conflicts_with_all = &["pm1", "pp1"])]
+    batch_dir: Option<PathBuf>,
+    /// [ECM only] With --torsion, run n curves with consecutive parameters, doing their stage 1 at once. [default: 1]
+    #[clap(long, default_value_t = 1, requires = "torsion")]
+    curves: usize,
     // TODO: go
 
     // Stage 2 parameters
@@ -74,6 +106,9 @@ struct Args {
     /// Never use NTT convolution routines in stage 2. [default: auto]
     #[clap(long, conflicts_with = "ntt")]
     no_ntt: bool,
+    /// Use n threads for each NTT over the small primes in stage 2. [default: 1]
+    #[clap(long, default_value_t = 1, conflicts_with = "no_ntt")]
+    ntt_threads: usize,
 
     // Modular arithmetic options
     /// Use GMP's mpz_mod function (sub-quadratic for large inputs, but induces some overhead for small ones). [default: auto]
@@ -94,6 +129,14 @@ struct Args {
     /// Force use of special base-2 code, input number must divide 2^n+1 if n > 0, or 2^|n|-1 if n < 0. [default: auto]
     #[clap(long, value_parser = parse_integer)]
     base2: Option<Integer>,
+    /// Use the thresholds of the modular arithmetic built in for the architecture, instead of the profile of this host (measured on the first run and saved to $ECM_MPMOD_PROFILE or ~/.ecm-mpmod-<host>).
+    #[clap(long)]
+    no_autotune: bool,
+
+    // P+1 options
+    /// [P+1 only] Run n random seeds concurrently, one per thread, and stop all of them at the first factor. [default: 1]
+    #[clap(long, default_value_t = 1, conflicts_with_all = &["pm1", "x0"])]
+    pp1_seeds: usize,
 
     // Loop mode
     /// Perform n runs on each input number and stop if a factor is found. [default: 1]
@@ -102,8 +145,16 @@ struct Args {
     /// Stop processing a candidate if a factor is found. (looping mode)
     #[clap(long, conflicts_with_all = &["sigma", "x0", "y0"])]
     one: bool,
+    // Input filtering
+    /// Before running ECM, divide out the primes up to the given bound and stop if what is left is 1, a probable prime or a power of one; ECM then runs on the cofactor. [default: no filtering]
+    #[clap(long)]
+    prefilter: Option<u32>,
+
     // Output
-    // TODO: quiet, verbose, timestamp, torsion, primetest, stage1time
+    /// Prove the factor and the cofactor prime or composite with APR-CL, using all cores.
+    #[clap(long)]
+    primetest: bool,
+    // TODO: quiet, verbose, timestamp, stage1time
 }
 
 fn main() {
@@ -119,15 +170,39 @@ fn main() {
     // Parse command line arguments
     let args = Args::parse();
 
+    if args.no_autotune {
+        skip_mpmod_profile();
+    } else if let Err(err) = autotune_mpmod(None) {
+        eprintln!("Warning: {err}, the measured thresholds are only used for this run");
+    }
+
+    if let Some(dir) = &args.batch_dir {
+        if let Err(err) = set_batch_s_dir(Some(dir)) {
+            eprintln!("Warning: {err}, the batch exponent is not saved");
+        }
+    }
+
+    if args.ntt_threads > 1 {
+        set_parallel_for(Some(Box::new(ThreadPool::new(args.ntt_threads))));
+    }
+
     // Set static parameters
     let params = EcmParams {
         // Factoring method
-        method: if args.pp1 {
+        method: if args.pm1 {
+            EcmMethod::Pm1
+        } else if args.pp1 {
             EcmMethod::Pp1
+        } else if args.hecm {
+            EcmMethod::Hecm
         } else {
             EcmMethod::Ecm
         },
 
+        // Curve parameters
+        param: args.param,
+        sigma: args.sigma.clone(),
+
         // Bounds
         b2: args.b2,
         b2_min: args.b2_min,
@@ -140,7 +215,54 @@ fn main() {
         } else {
             NTT::Auto
         },
+
+        // P+1 parameters
+        pp1_seeds: args.pp1_seeds,
+
+        // Output
+        verbose: true,
     };
-    let res = ecm_factor(&args.n, args.b1, &params);
+
+    let mut n = args.n.clone();
+    if let Some(bound) = args.prefilter {
+        let filtered = Prefilter::new(bound).run(&n);
+        for (p, e) in &filtered.small_factors {
+            println!("Small factor: {p}^{e}");
+        }
+        match filtered.status {
+            Cofactor::One => return,
+            Cofactor::ProbablePrime => {
+                println!(
+                    "Probable prime cofactor: {}^{}",
+                    filtered.cofactor, filtered.exponent
+                );
+                return;
+            }
+            Cofactor::Composite => {
+                if filtered.cofactor != n {
+                    println!(
+                        "Composite cofactor: {}^{}",
+                        filtered.cofactor, filtered.exponent
+                    );
+                }
+                n = filtered.cofactor;
+            }
+        }
+    }
+
+    if let Some(torsion) = args.torsion {
+        let smin = args.sigma.and_then(|sigma| sigma.to_i32()).unwrap_or(1);
+        let results = ecm_factor_many_curves(&n, args.b1, torsion, smin, args.curves, &params);
+        for (param, res) in (smin..).zip(results) {
+            println!("Curve {param}: {:?}", res);
+        }
+        return;
+    }
+    let res = ecm_factor(&n, args.b1, &params);
     println!("Found factor: {:?}", res);
+    if args.primetest && res > 1 && res != n {
+        let cofactor = Integer::from(&n / &res);
+        println!("Factor is {:?}", prove_prime(&res));
+        println!("Cofactor is {:?}", prove_prime(&cofactor));
+    }
 }
@@ -12,6 +12,19 @@ pub enum EcmMethod {
     Pm1,
     /// P+1 method
     Pp1,
+    /// Hyperelliptic curve method: stage 1 on a Kummer surface (two elliptic curves at once)
+    Hecm,
+}
+
+/// Arithmetic modulo N, as used by the stages of all methods.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum ModularArithmetic {
+    /// GMP's mpz_mod (sub-quadratic, with some overhead for small inputs)
+    Mpz,
+    /// Montgomery's multiplication, quadratic version
+    Modmuln,
+    /// Montgomery's multiplication, sub-quadratic version
+    Redc,
 }
 
 /// Usage of the Number-Theoretic Transform code for polynomial arithmetic in stage 2
@@ -25,12 +38,55 @@ pub enum NTT {
     Enabled,
 }
 
+/// Torsion group of a family of elliptic curves.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum TorsionGroup {
+    /// Z/5Z, over Q
+    Z5,
+    /// Z/7Z, over Q
+    Z7,
+    /// Z/9Z, over Q
+    Z9,
+    /// Z/10Z, over Q
+    Z10,
+    /// Z/2Z x Z/8Z, over Q
+    Z2xZ8,
+    /// Z/3Z x Z/3Z, over Q(sqrt(-3)), interesting when p = 1 mod 3
+    Z3xZ3,
+    /// Z/3Z x Z/6Z, over Q(sqrt(-3)), interesting when p = 1 mod 3
+    Z3xZ6,
+    /// Z/4Z x Z/4Z, over Q(sqrt(-1)), interesting when p = 1 mod 4
+    Z4xZ4,
+}
+
+impl TorsionGroup {
+    /// Returns the name of the group, as given to the `-torsion` option of ecm.
+    pub fn as_str(&self) -> &'static str {
+        match self {
+            TorsionGroup::Z5 => "Z5",
+            TorsionGroup::Z7 => "Z7",
+            TorsionGroup::Z9 => "Z9",
+            TorsionGroup::Z10 => "Z10",
+            TorsionGroup::Z2xZ8 => "Z2xZ8",
+            TorsionGroup::Z3xZ3 => "Z3xZ3",
+            TorsionGroup::Z3xZ6 => "Z3xZ6",
+            TorsionGroup::Z4xZ4 => "Z4xZ4",
+        }
+    }
+}
+
 /// ECM parameters.
 #[derive(Debug, Clone)]
 pub struct EcmParams {
     /// Factorization method, default is ecm
     pub method: EcmMethod,
 
+    // Curve parameters
+    /// [ECM only] Curve parametrization (0 to 3, as the `-param` option of ecm) [default: chosen from the input]
+    pub param: Option<i32>,
+    /// [ECM only] Seed of the curve generator [default: random]
+    pub sigma: Option<Integer>,
+
     // Bounds
     /// Stage 2 bound (all primes B1 <= p <= B2 are processed in step 2)
     pub b2: Option<Integer>,
@@ -40,15 +96,27 @@ pub struct EcmParams {
     // Stage 2 parameters
     /// Usage of the Number-Theoretic Transform code for polynomial arithmetic in stage 2
     pub ntt: NTT,
+
+    // P+1 parameters
+    /// [P+1 only] Number of random seeds run concurrently, one per thread; all of them stop at the first factor
+    pub pp1_seeds: usize,
+
+    // Output
+    /// Print the parameters and the time of each stage, as ecm does, default is true
+    pub verbose: bool,
 }
 
 impl Default for EcmParams {
     fn default() -> Self {
         Self {
             method: EcmMethod::Ecm,
+            param: None,
+            sigma: None,
             b2: None,
             b2_min: None,
             ntt: NTT::Auto,
+            pp1_seeds: 1,
+            verbose: true,
         }
     }
 }
@@ -59,6 +127,10 @@ impl RawEcmParams {
     pub fn as_mut_ptr(&mut self) -> *mut gmp_ecm_sys::__ecm_param_struct {
         &mut self.0
     }
+
+    pub fn set_stop_asap(&mut self, stop_asap: extern "C" fn() -> std::os::raw::c_int) {
+        self.0.stop_asap = Some(stop_asap);
+    }
 }
 
 impl From<&EcmParams> for RawEcmParams {
@@ -73,7 +145,14 @@ impl From<&EcmParams> for RawEcmParams {
             EcmMethod::Ecm => 0,
             EcmMethod::Pm1 => 1,
             EcmMethod::Pp1 => 2,
+            EcmMethod::Hecm => 3,
         };
+        if let Some(param) = params.param {
+            raw.param = param;
+        }
+        if let Some(sigma) = &params.sigma {
+            unsafe { gmp::mpz_set(raw.sigma.as_mut_ptr() as *mut gmp::mpz_t, sigma.as_raw()) };
+        }
         if let Some(b2) = &params.b2 {
             unsafe { gmp::mpz_set(raw.B2.as_mut_ptr() as *mut gmp::mpz_t, b2.as_raw()) };
         }
@@ -85,7 +164,7 @@ impl From<&EcmParams> for RawEcmParams {
             NTT::Auto => 1,
             NTT::Enabled => 2,
         };
-        raw.verbose = 1;
+        raw.verbose = params.verbose.into();
 
         Self(raw)
     }
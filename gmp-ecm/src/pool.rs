@@ -0,0 +1,211 @@
+use std::any::Any;
+use std::panic::{self, AssertUnwindSafe};
+use std::sync::atomic::{AtomicBool, AtomicUsize, Ordering};
+use std::sync::{Arc, Condvar, Mutex};
+use std::thread::{self, JoinHandle};
+
+use crate::ParallelFor;
+
+/// A [`ParallelFor`] running the loops on threads started once, when the
+/// pool is created, and stopped when it is dropped.
+///
+/// The pool runs one loop at a time. A loop started while it runs another
+/// one (from another branch of the product tree, or from a loop body) runs
+/// serially in the calling thread: the loops of a pool of `n` threads never
+/// use more than `n` threads, plus the callers of the concurrent loops.
+pub struct ThreadPool {
+    shared: Arc<Shared>,
+    busy: AtomicBool,
+    workers: Vec<JoinHandle<()>>,
+}
+
+struct Shared {
+    state: Mutex<State>,
+    start: Condvar,
+    done: Condvar,
+}
+
+struct State {
+    job: Option<Job>,
+    /// Number of the current job, for the workers to tell it from the last one
+    generation: u64,
+    /// Workers still running the current job
+    running: usize,
+    panic: Option<Box<dyn Any + Send>>,
+    stop: bool,
+}
+
+/// A loop, borrowed from the stack of [`ThreadPool::parallel_for`], which
+/// waits for all the workers to be done with it before returning.
+#[derive(Clone, Copy)]
+struct Job {
+    n: usize,
+    next: &'static AtomicUsize,
+    body: &'static (dyn Fn(usize) + Sync),
+}
+
+impl Job {
+    fn run(self) {
+        loop {
+            let i = self.next.fetch_add(1, Ordering::Relaxed);
+            if i >= self.n {
+                break;
+            }
+            (self.body)(i);
+        }
+    }
+}
+
+impl ThreadPool {
+    /// Starts a pool running each loop on `threads` threads: the caller of
+    /// [`ParallelFor::parallel_for`] and `threads - 1` workers.
+    pub fn new(threads: usize) -> Self {
+        let shared = Arc::new(Shared {
+            state: Mutex::new(State {
+                job: None,
+                generation: 0,
+                running: 0,
+                panic: None,
+                stop: false,
+            }),
+            start: Condvar::new(),
+            done: Condvar::new(),
+        });
+        let workers = (1..threads)
+            .map(|_| {
+                let shared = Arc::clone(&shared);
+                thread::spawn(move || worker(&shared))
+            })
+            .collect();
+        ThreadPool {
+            shared,
+            busy: AtomicBool::new(false),
+            workers,
+        }
+    }
+
+    /// Returns the number of threads running each loop.
+    pub fn threads(&self) -> usize {
+        self.workers.len() + 1
+    }
+}
+
+fn worker(shared: &Shared) {
+    let mut seen = 0;
+    loop {
+        let job = {
+            let mut state = shared.state.lock().unwrap();
+            while state.generation == seen && !state.stop {
+                state = shared.start.wait(state).unwrap();
+            }
+            if state.stop {
+                return;
+            }
+            seen = state.generation;
+            state.job.expect("no job")
+        };
+
+        let res = panic::catch_unwind(AssertUnwindSafe(|| job.run()));
+
+        let mut state = shared.state.lock().unwrap();
+        if let Err(panic) = res {
+            state.panic.get_or_insert(panic);
+        }
+        state.running -= 1;
+        if state.running == 0 {
+            shared.done.notify_all();
+        }
+    }
+}
+
+impl ParallelFor for ThreadPool {
+    fn parallel_for(&self, n: usize, body: &(dyn Fn(usize) + Sync)) {
+        if n <= 1
+            || self.workers.is_empty()
+            || self
+                .busy
+                .compare_exchange(false, true, Ordering::Acquire, Ordering::Relaxed)
+                .is_err()
+        {
+            (0..n).for_each(body);
+            return;
+        }
+
+        let next = AtomicUsize::new(0);
+        // The workers are done with the job when `running` drops to 0, which
+        // is waited for below, even if `body` panics
+        let job = unsafe {
+            Job {
+                n,
+                next: &*(&next as *const AtomicUsize),
+                body: std::mem::transmute::<&(dyn Fn(usize) + Sync), &'static (dyn Fn(usize) + Sync)>(
+                    body,
+                ),
+            }
+        };
+        {
+            let mut state = self.shared.state.lock().unwrap();
+            state.job = Some(job);
+            state.generation += 1;
+            state.running = self.workers.len();
+            self.shared.start.notify_all();
+        }
+
+        let res = panic::catch_unwind(AssertUnwindSafe(|| job.run()));
+
+        let panic = {
+            let mut state = self.shared.state.lock().unwrap();
+            while state.running > 0 {
+                state = self.shared.done.wait(state).unwrap();
+            }
+            state.job = None;
+            state.panic.take()
+        };
+        self.busy.store(false, Ordering::Release);
+
+        if let Some(panic) = res.err().or(panic) {
+            panic::resume_unwind(panic);
+        }
+    }
+}
+
+impl Drop for ThreadPool {
+    fn drop(&mut self) {
+        self.shared.state.lock().unwrap().stop = true;
+        self.shared.start.notify_all();
+        for worker in self.workers.drain(..) {
+            let _ = worker.join();
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn runs_each_index_once() {
+        let pool = ThreadPool::new(4);
+        for n in [0, 1, 3, 100] {
+            let counts: Vec<_> = (0..n).map(|_| AtomicUsize::new(0)).collect();
+            pool.parallel_for(n, &|i| {
+                counts[i].fetch_add(1, Ordering::Relaxed);
+            });
+            assert!(counts
+                .iter()
+                .all(|count| count.load(Ordering::Relaxed) == 1));
+        }
+    }
+
+    #[test]
+    fn nested_loops_run_serially() {
+        let pool = ThreadPool::new(4);
+        let total = AtomicUsize::new(0);
+        pool.parallel_for(8, &|_| {
+            pool.parallel_for(8, &|_| {
+                total.fetch_add(1, Ordering::Relaxed);
+            });
+        });
+        assert_eq!(total.load(Ordering::Relaxed), 64);
+    }
+}
@@ -0,0 +1,253 @@
+use rug::{integer::IsPrime, Integer};
+
+/// With at most 24 repetitions, `mpz_probab_prime_p` only does trial
+/// divisions and a Baillie-PSW test (GMP 6.2 or later).
+const BPSW_REPS: u32 = 24;
+
+/// Status of the cofactor left by [`Prefilter::run`].
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Cofactor {
+    /// All the prime factors are below the trial division bound
+    One,
+    /// The cofactor passed a BPSW probable prime test
+    ProbablePrime,
+    /// The cofactor is composite, with no prime factor below the trial division bound
+    Composite,
+}
+
+/// Result of [`Prefilter::run`]: `n = small factors * cofactor^exponent`.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct Prefiltered {
+    /// Prime factors below the trial division bound, with their multiplicity
+    pub small_factors: Vec<(u32, u32)>,
+    /// What is left of `n`, reduced to its smallest root when it is a perfect power
+    pub cofactor: Integer,
+    /// Power of the cofactor in `n`
+    pub exponent: u32,
+    /// Status of the cofactor
+    pub status: Cofactor,
+}
+
+impl Prefiltered {
+    /// Returns `true` if the cofactor is composite, i.e. is worth running ECM on.
+    pub fn needs_ecm(&self) -> bool {
+        self.status == Cofactor::Composite
+    }
+}
+
+/// Cheap tests run on the inputs before spending ECM curves on them: trial
+/// division by the primes up to a bound, then a BPSW probable prime test and
+/// perfect power detection on the cofactor.
+///
+/// The product tree of the primes is built once by [`Prefilter::new`], so the
+/// same `Prefilter` should be used for all the inputs.
+#[derive(Debug, Clone)]
+pub struct Prefilter {
+    bound: u32,
+    /// `tree[0]` holds the primes, `tree[k][i]` is the product of
+    /// `tree[k - 1][2i]` and `tree[k - 1][2i + 1]`, the last level holds the
+    /// product of all the primes
+    tree: Vec<Vec<Integer>>,
+}
+
+impl Prefilter {
+    /// Builds the product tree of the primes up to `bound`.
+    pub fn new(bound: u32) -> Self {
+        let mut level: Vec<Integer> = primes_up_to(bound).into_iter().map(Integer::from).collect();
+        let mut tree = Vec::new();
+
+        while level.len() > 1 {
+            let next = level
+                .chunks(2)
+                .map(|pair| match pair {
+                    [a, b] => Integer::from(a * b),
+                    [a] => a.clone(),
+                    _ => unreachable!(),
+                })
+                .collect();
+            tree.push(level);
+            level = next;
+        }
+        if !level.is_empty() {
+            tree.push(level);
+        }
+
+        Self { bound, tree }
+    }
+
+    /// Returns the trial division bound.
+    pub fn bound(&self) -> u32 {
+        self.bound
+    }
+
+    /// Runs the tests on `n`, which must be positive.
+    pub fn run(&self, n: &Integer) -> Prefiltered {
+        let mut cofactor = n.clone();
+        let mut small_factors = Vec::new();
+
+        // n mod (product of the primes) shares with the product exactly the
+        // primes dividing n, whose product g is small: it is enough to walk
+        // down the tree in the branches that have a common factor with g
+        if let Some(root) = self.tree.last() {
+            let root = &root[0];
+            let rem = Integer::from(n % root);
+            let g = Integer::from(rem.gcd_ref(root));
+            if g != 1 {
+                self.small_primes_dividing(self.tree.len() - 1, 0, &g, &mut small_factors);
+            }
+        }
+        for (p, e) in small_factors.iter_mut() {
+            *e = cofactor.remove_factor_mut(&Integer::from(*p));
+        }
+
+        if cofactor == 1 {
+            return Prefiltered {
+                small_factors,
+                cofactor,
+                exponent: 1,
+                status: Cofactor::One,
+            };
+        }
+
+        let mut exponent = 1;
+        let mut status = Cofactor::Composite;
+        if cofactor.is_probably_prime(BPSW_REPS) != IsPrime::No {
+            status = Cofactor::ProbablePrime;
+        } else if cofactor.is_perfect_power() {
+            (cofactor, exponent) = smallest_root(cofactor);
+            if cofactor.is_probably_prime(BPSW_REPS) != IsPrime::No {
+                status = Cofactor::ProbablePrime;
+            }
+        }
+
+        Prefiltered {
+            small_factors,
+            cofactor,
+            exponent,
+            status,
+        }
+    }
+
+    /// Appends the primes of the subtree at `tree[level][index]` that divide `g`.
+    fn small_primes_dividing(
+        &self,
+        level: usize,
+        index: usize,
+        g: &Integer,
+        primes: &mut Vec<(u32, u32)>,
+    ) {
+        let node = &self.tree[level][index];
+        let g = Integer::from(g.gcd_ref(node));
+        if g == 1 {
+            return;
+        }
+        if level == 0 {
+            primes.push((node.to_u32().unwrap(), 0));
+            return;
+        }
+        for child in [2 * index, 2 * index + 1] {
+            if child < self.tree[level - 1].len() {
+                self.small_primes_dividing(level - 1, child, &g, primes);
+            }
+        }
+    }
+}
+
+/// Returns `(r, e)` with `n = r^e` and `e` as large as possible.
+fn smallest_root(n: Integer) -> (Integer, u32) {
+    let mut root = n;
+    let mut exponent = 1;
+    let mut k = 2;
+
+    // a k-th power with k > log2(root) would have a root below 2
+    while k <= root.significant_bits() {
+        let (r, rem) = root.clone().root_rem(Integer::new(), k);
+        if rem == 0 {
+            root = r;
+            exponent *= k;
+        } else {
+            k += 1;
+        }
+    }
+
+    (root, exponent)
+}
+
+/// Sieve of Eratosthenes.
+fn primes_up_to(bound: u32) -> Vec<u32> {
+    let bound = bound as usize;
+    let mut composite = vec![false; bound + 1];
+    let mut primes = Vec::new();
+
+    for i in 2..=bound {
+        if composite[i] {
+            continue;
+        }
+        primes.push(i as u32);
+        for j in (i * i..=bound).step_by(i) {
+            composite[j] = true;
+        }
+    }
+
+    primes
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use rug::ops::Pow;
+
+    fn run(bound: u32, n: Integer) -> Prefiltered {
+        Prefilter::new(bound).run(&n)
+    }
+
+    #[test]
+    fn one() {
+        let filtered = run(100, Integer::from(1));
+        assert!(filtered.small_factors.is_empty());
+        assert_eq!(filtered.cofactor, 1);
+        assert_eq!(filtered.status, Cofactor::One);
+    }
+
+    #[test]
+    fn small_prime_powers() {
+        let n = Integer::from(Integer::u_pow_u(2, 10)) * Integer::from(Integer::u_pow_u(7, 5));
+        let filtered = run(10, n);
+        assert_eq!(filtered.small_factors, [(2, 10), (7, 5)]);
+        assert_eq!(filtered.status, Cofactor::One);
+    }
+
+    #[test]
+    fn factor_at_the_bound() {
+        let p = Integer::from(1_000_000_007);
+        let filtered = run(97, Integer::from(97) * &p);
+        assert_eq!(filtered.small_factors, [(97, 1)]);
+        assert_eq!(filtered.cofactor, p);
+        assert_eq!(filtered.status, Cofactor::ProbablePrime);
+
+        let filtered = run(96, Integer::from(97) * &p);
+        assert!(filtered.small_factors.is_empty());
+        assert_eq!(filtered.status, Cofactor::Composite);
+    }
+
+    #[test]
+    fn large_prime_power() {
+        let p = Integer::from(1_000_000_007);
+        let filtered = run(100, Integer::from(3) * p.clone().pow(3));
+        assert_eq!(filtered.small_factors, [(3, 1)]);
+        assert_eq!(filtered.cofactor, p);
+        assert_eq!(filtered.exponent, 3);
+        assert_eq!(filtered.status, Cofactor::ProbablePrime);
+    }
+
+    #[test]
+    fn composite_power() {
+        let m = Integer::from(1_000_000_007) * Integer::from(998_244_353);
+        let filtered = run(100, m.clone().pow(6));
+        assert!(filtered.small_factors.is_empty());
+        assert_eq!(filtered.cofactor, m);
+        assert_eq!(filtered.exponent, 6);
+        assert_eq!(filtered.status, Cofactor::Composite);
+        assert!(filtered.needs_ecm());
+    }
+}